@@ -0,0 +1,90 @@
+# boot_timing.py
+# Measures the lamp's time to light after warm resets: restarts it through
+# /api/restart a number of times and reads back the reset reason, whether
+# the output was restored from RTC memory, and timeToLightUs from
+# /api/status.
+#
+#   python boot_timing.py                        -> smartlamp.local, 5 restarts
+#   python boot_timing.py 192.168.68.50 --runs 20
+#
+# timeToLightUs counts from the start of the app, so the ROM and second-stage
+# bootloader (roughly 100-300 ms, before any of our code runs) come on top.
+# For a cold boot, power-cycle the lamp and read the "Time to light" line in
+# the serial log, or run this with --runs 0 to read the status of the
+# current boot.
+import json
+import statistics
+import sys
+import time
+import urllib.error
+import urllib.request
+
+TIMEOUT_S = 3
+RECONNECT_S = 60    # WiFi association + mDNS after the restart
+
+
+def status(base):
+    with urllib.request.urlopen(base + '/api/status', timeout=TIMEOUT_S) as response:
+        return json.loads(response.read())
+
+
+def restart(base):
+    request = urllib.request.Request(base + '/api/restart', data=b'', method='POST')
+    try:
+        urllib.request.urlopen(request, timeout=TIMEOUT_S).read()
+    except (urllib.error.URLError, OSError):
+        pass    # The connection may drop as the lamp resets
+
+
+def wait_for_status(base):
+    deadline = time.time() + RECONNECT_S
+    time.sleep(2)
+    while time.time() < deadline:
+        try:
+            return status(base)
+        except (urllib.error.URLError, OSError, ValueError):
+            time.sleep(1)
+    return None
+
+
+def show(run, s):
+    print(f'{run:>4} {s["resetReason"]:>10} {"yes" if s["warmBoot"] else "no":>8} '
+          f'{s["timeToLightUs"] / 1000:>10.2f}')
+
+
+def main(argv):
+    host, runs = 'smartlamp.local', 5
+    args = iter(argv)
+    for arg in args:
+        if arg == '--runs':
+            runs = int(next(args))
+        else:
+            host = arg
+    base = f'http://{host}'
+
+    print(f'{"run":>4} {"reset":>10} {"restored":>8} {"light ms":>10}')
+    if runs == 0:
+        show(0, status(base))
+        return 0
+
+    times = []
+    for run in range(1, runs + 1):
+        restart(base)
+        s = wait_for_status(base)
+        if s is None:
+            print(f'{run:>4} lamp did not come back within {RECONNECT_S} s')
+            return 1
+        show(run, s)
+        if s['warmBoot']:
+            times.append(s['timeToLightUs'] / 1000)
+
+    if times:
+        print(f'restored {len(times)}/{runs}: median {statistics.median(times):.2f} ms, '
+              f'max {max(times):.2f} ms after app start')
+    else:
+        print('Output was never restored; check WARM_BOOT_RESTORE and that the lamp was lit')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -1,4 +1,4 @@
-from flask import Flask, request, jsonify
+from flask import Flask, request, jsonify, send_file
 import csv
 from datetime import datetime
 import os
@@ -59,5 +59,18 @@ def list_devices():
     except Exception as e:
         return jsonify({'error': str(e)}), 500
 
+@app.route('/api/firmware/delta', methods=['GET'])
+def firmware_delta():
+    # Deltas are built with ota_delta.py and named after the running image's ELF sha
+    source = request.args.get('from', '')
+    if not source.isalnum():
+        return jsonify({'error': 'Missing or invalid from parameter'}), 400
+
+    filename = os.path.join('firmware', 'deltas', f'{source}.ldp')
+    if not os.path.isfile(filename):
+        return '', 204
+
+    return send_file(filename, mimetype='application/octet-stream')
+
 if __name__ == '__main__':
     app.run(host='0.0.0.0', port=4999, debug=True)
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+// Host stand-in for the Arduino-ESP32 core, just enough of it for src/ to
+// build and run natively (the native environments in platformio.ini).
+// Hardware state lives in HostDevice.h.
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "WString.h"
+#include "IPAddress.h"
+#include "HardwareSerial.h"
+#include "Esp.h"
+#include "freertos/FreeRTOS.h"
+
+using std::abs;
+using std::max;
+using std::min;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+// RTC memory is per thread here, so lamps run side by side on threads
+// (sim/fleet) don't race on WarmBoot's record; none of them warm-resets
+#define RTC_NOINIT_ATTR thread_local
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+#define LOW 0x0
+#define HIGH 0x1
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define PULLUP 0x04
+#define INPUT_PULLUP 0x05
+#define PULLDOWN 0x08
+#define INPUT_PULLDOWN 0x09
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+typedef enum {
+    ADC_0db,
+    ADC_2_5db,
+    ADC_6db,
+    ADC_11db
+} adc_attenuation_t;
+
+uint16_t analogRead(uint8_t pin);
+uint32_t analogReadMilliVolts(uint8_t pin);
+void analogReadResolution(uint8_t bits);
+void analogSetAttenuation(adc_attenuation_t attenuation);
+void analogSetPinAttenuation(uint8_t pin, adc_attenuation_t attenuation);
+
+uint32_t ledcSetup(uint8_t channel, uint32_t freq, uint8_t resolutionBits);
+void ledcWrite(uint8_t channel, uint32_t duty);
+uint32_t ledcRead(uint8_t channel);
+uint32_t ledcChangeFrequency(uint8_t channel, uint32_t freq, uint8_t resolutionBits);
+void ledcAttachPin(uint8_t pin, uint8_t channel);
+void ledcDetachPin(uint8_t pin);
+
+bool setCpuFrequencyMhz(uint32_t mhz);
+uint32_t getCpuFrequencyMhz();
+uint32_t getXtalFrequencyMhz();
+uint32_t getApbFrequency();
+
+uint16_t touchRead(uint8_t pin);
+void touchAttachInterrupt(uint8_t pin, void (*isr)(), uint16_t threshold);
+
+void btStop();
@@ -0,0 +1,27 @@
+#pragma once
+#include "WiFi.h"
+
+enum class DNSReplyCode {
+    NoError = 0,
+    FormError = 1,
+    ServerFailure = 2,
+    NonExistentDomain = 3
+};
+
+// Captive portal DNS over UDP on 127.0.0.1:HostDevice::dnsPort. A queries
+// for domainName ("*" for any) get resolvedIP, everything else the error
+// reply code.
+class DNSServer {
+public:
+    ~DNSServer() { stop(); }
+    void setErrorReplyCode(DNSReplyCode code) { errorReplyCode = code; }
+    bool start(uint16_t port, const String& domainName, const IPAddress& resolvedIP);
+    void processNextRequest();
+    void stop();
+
+private:
+    int fd = -1;
+    String domain;
+    IPAddress address;
+    DNSReplyCode errorReplyCode = DNSReplyCode::NonExistentDomain;
+};
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Reads and writes the current device's HostDevice::eeprom
+class EEPROMClass {
+public:
+    bool begin(size_t size);
+    uint8_t read(int address);
+    void write(int address, uint8_t value);
+    bool commit() { return true; }
+    void end() {}
+
+    template <typename T>
+    T& get(int address, T& value) {
+        memcpy(&value, data() + address, sizeof(T));
+        return value;
+    }
+    template <typename T>
+    const T& put(int address, const T& value) {
+        memcpy(data() + address, &value, sizeof(T));
+        return value;
+    }
+
+private:
+    uint8_t* data();
+};
+
+extern EEPROMClass EEPROM;
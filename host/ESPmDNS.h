@@ -0,0 +1,15 @@
+#pragma once
+#include "Arduino.h"
+
+class MDNSResponder {
+public:
+    bool begin(const char* hostName) { (void)hostName; return true; }
+    void addService(const char* service, const char* protocol, uint16_t port) {
+        (void)service;
+        (void)protocol;
+        (void)port;
+    }
+    void end() {}
+};
+
+extern MDNSResponder MDNS;
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdint>
+
+class EspClass {
+public:
+    uint64_t getEfuseMac();
+    void restart();
+    // Host time at the simulated CPU clock, so cycle counts scale with it
+    uint32_t getCycleCount();
+    uint32_t getCpuFreqMHz();
+    uint32_t getHeapSize();
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getMaxAllocHeap();
+    uint32_t getSketchSize() { return 1048576; }
+    uint32_t getFreeSketchSpace() { return 1966080; }
+};
+
+extern EspClass ESP;
@@ -0,0 +1,46 @@
+#pragma once
+#include "WiFi.h"
+#include <string>
+
+#define HTTP_CODE_OK 200
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_NO_HTTP_SERVER (-7)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+// One request per connection over a POSIX socket, sent to the server set in
+// HostDevice (serverHost, serverPort) whatever host the URL names. With no
+// server set every request is refused.
+class HTTPClient {
+public:
+    ~HTTPClient() { end(); }
+    bool begin(const String& url);
+    bool begin(WiFiClient& client, const String& url) { (void)client; return begin(url); }
+    void addHeader(const String& name, const String& value);
+    void setTimeout(uint16_t timeoutMs) { timeout = timeoutMs; }
+    void setReuse(bool reuse) { (void)reuse; }
+    int GET();
+    int POST(const String& payload);
+    int getSize() { return size; }
+    String getString();
+    WiFiClient* getStreamPtr() { return &stream; }
+    bool connected() { return stream.connected(); }
+    void end();
+
+private:
+    static const uint16_t DEFAULT_TIMEOUT_MS = 5000;   // HTTPCLIENT_DEFAULT_TCP_TIMEOUT
+
+    std::string hostHeader;
+    std::string path;
+    std::string headers;
+    uint16_t timeout = DEFAULT_TIMEOUT_MS;
+    int size = -1;
+    WiFiClient stream;   // The response body as it arrives on the socket
+
+    int sendRequest(const char* method, const String& payload);
+    int connectToServer();
+    int readResponseHead();
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "WString.h"
+#include "IPAddress.h"
+
+// Serial on the host writes to the current device's console (HostDevice::serialMuted / serialCapture)
+class HardwareSerial {
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    void end() {}
+    void flush() {}
+    operator bool() const { return true; }
+    int availableForWrite() { return 128; }
+
+    size_t write(uint8_t c) { return write(&c, 1); }
+    size_t write(const uint8_t* data, size_t size);
+    int printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+    size_t print(const char* text);
+    size_t print(const String& text) { return print(text.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int value) { return print(String(value)); }
+    size_t print(unsigned int value) { return print(String(value)); }
+    size_t print(long value) { return print(String(value)); }
+    size_t print(unsigned long value) { return print(String(value)); }
+    size_t print(double value, int decimals = 2) { return print(String(value, decimals)); }
+    size_t print(const IPAddress& address) { return print(address.toString()); }
+
+    size_t println() { return print("\r\n"); }
+    template <typename T>
+    size_t println(const T& value) { return print(value) + println(); }
+};
+
+extern HardwareSerial Serial;
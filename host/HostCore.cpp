@@ -0,0 +1,314 @@
+// Arduino core, FreeRTOS and ESP class on top of HostDevice
+#include "Arduino.h"
+#include "EEPROM.h"
+#include "HostDevice.h"
+#include <chrono>
+#include <cstdarg>
+#include <string>
+#include <thread>
+
+HardwareSerial Serial;
+EspClass ESP;
+EEPROMClass EEPROM;
+
+namespace {
+    HostDevice& device() {
+        return HostDevice::current();
+    }
+}
+
+// Time
+
+unsigned long millis() {
+    return (unsigned long)(device().nowUs() / 1000);
+}
+
+unsigned long micros() {
+    return (unsigned long)device().nowUs();
+}
+
+void delay(uint32_t ms) {
+    device().sleepUs((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us) {
+    device().sleepUs(us);
+}
+
+void yield() {
+    std::this_thread::yield();
+}
+
+// GPIO and ADC
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    (void)mode;
+    device().detachPin(pin);
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    device().pinLevel[pin] = value ? 1 : 0;
+}
+
+int digitalRead(uint8_t pin) {
+    return device().pinLevel[pin];
+}
+
+uint16_t analogRead(uint8_t pin) {
+    HostDevice& d = device();
+    uint32_t maxRaw = (1u << d.adcResolution) - 1;
+    uint32_t raw = (d.pinMv[pin] * maxRaw + HostDevice::ADC_FULL_SCALE_MV / 2) / HostDevice::ADC_FULL_SCALE_MV;
+    return (uint16_t)min(raw, maxRaw);
+}
+
+uint32_t analogReadMilliVolts(uint8_t pin) {
+    return min(device().pinMv[pin], HostDevice::ADC_FULL_SCALE_MV);
+}
+
+void analogReadResolution(uint8_t bits) {
+    device().adcResolution = bits;
+}
+
+void analogSetAttenuation(adc_attenuation_t attenuation) {
+    (void)attenuation;
+}
+
+void analogSetPinAttenuation(uint8_t pin, adc_attenuation_t attenuation) {
+    (void)pin;
+    (void)attenuation;
+}
+
+// LEDC. A channel pair shares a timer, so a frequency set on one applies to both.
+
+uint32_t ledcSetup(uint8_t channel, uint32_t freq, uint8_t resolutionBits) {
+    HostDevice& d = device();
+    int timer = HostDevice::ledcTimer(channel);
+    for (int i = 0; i < HostDevice::LEDC_CHANNELS; i++) {
+        if (HostDevice::ledcTimer(i) == timer && (i / 8) == (channel / 8)) {
+            d.ledc[i].freq = freq;
+            d.ledc[i].resolution = resolutionBits;
+        }
+    }
+    return freq;
+}
+
+void ledcWrite(uint8_t channel, uint32_t duty) {
+    HostDevice::LedcChannel& c = device().ledc[channel];
+    c.duty = c.pendingDuty = duty;
+    c.hpoint = c.pendingHpoint = 0;
+    c.writes++;
+}
+
+uint32_t ledcRead(uint8_t channel) {
+    return device().ledc[channel].duty;
+}
+
+uint32_t ledcChangeFrequency(uint8_t channel, uint32_t freq, uint8_t resolutionBits) {
+    device().timerFrequencyChanges[HostDevice::ledcTimer(channel)]++;
+    return ledcSetup(channel, freq, resolutionBits);
+}
+
+void ledcAttachPin(uint8_t pin, uint8_t channel) {
+    device().attachLedc(pin, channel);
+}
+
+void ledcDetachPin(uint8_t pin) {
+    device().detachPin(pin);
+}
+
+// CPU clock
+
+bool setCpuFrequencyMhz(uint32_t mhz) {
+    switch (mhz) {
+        case 10: case 20: case 40: case 80: case 160:
+            device().cpuMhz = (int)mhz;
+            return true;
+        default:
+            return false;
+    }
+}
+
+uint32_t getCpuFrequencyMhz() {
+    return (uint32_t)device().cpuMhz;
+}
+
+uint32_t getXtalFrequencyMhz() {
+    return 40;
+}
+
+uint32_t getApbFrequency() {
+    return (uint32_t)min(device().cpuMhz, 80) * 1000000UL;
+}
+
+// Touch
+
+uint16_t touchRead(uint8_t pin) {
+    (void)pin;
+    return (uint16_t)device().touchValue;
+}
+
+void touchAttachInterrupt(uint8_t pin, void (*isr)(), uint16_t threshold) {
+    (void)pin;
+    device().touchIsr = isr;
+    device().touchThreshold = threshold;
+}
+
+void btStop() {}
+
+// Serial
+
+size_t HardwareSerial::write(const uint8_t* data, size_t size) {
+    HostDevice& d = device();
+    if (d.serialMuted) {
+        return size;
+    }
+    if (d.serialCapture) {
+        d.serialCapture->append((const char*)data, size);
+    } else {
+        fwrite(data, 1, size, stdout);
+    }
+    return size;
+}
+
+size_t HardwareSerial::print(const char* text) {
+    return write((const uint8_t*)text, strlen(text));
+}
+
+int HardwareSerial::printf(const char* format, ...) {
+    char small[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(small, sizeof(small), format, args);
+    va_end(args);
+    if (length < 0) {
+        return length;
+    }
+    if ((size_t)length < sizeof(small)) {
+        write((const uint8_t*)small, length);
+        return length;
+    }
+    std::string large(length + 1, '\0');
+    va_start(args, format);
+    vsnprintf(&large[0], large.size(), format, args);
+    va_end(args);
+    write((const uint8_t*)large.data(), length);
+    return length;
+}
+
+// ESP
+
+uint64_t EspClass::getEfuseMac() {
+    return device().efuseMac;
+}
+
+void EspClass::restart() {
+    HostDevice& d = device();
+    d.restarts++;
+    d.resetReason = 3;   // ESP_RST_SW
+    if (d.onRestart) {
+        d.onRestart();
+        return;
+    }
+    fflush(stdout);
+    exit(0);
+}
+
+uint32_t EspClass::getCycleCount() {
+    using namespace std::chrono;
+    uint64_t ns = (uint64_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    return (uint32_t)(ns * (uint64_t)device().cpuMhz / 1000);
+}
+
+uint32_t EspClass::getCpuFreqMHz() {
+    return (uint32_t)device().cpuMhz;
+}
+
+uint32_t EspClass::getHeapSize() {
+    return device().heapSize;
+}
+
+uint32_t EspClass::getFreeHeap() {
+    return device().currentFreeHeap();
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+    return device().minFreeHeap();
+}
+
+uint32_t EspClass::getMaxAllocHeap() {
+    // Fragmentation isn't modelled; the largest block is a fixed share of free
+    return device().currentFreeHeap() / 10 * 9;
+}
+
+// EEPROM
+
+bool EEPROMClass::begin(size_t size) {
+    return size <= (size_t)HostDevice::EEPROM_SIZE;
+}
+
+uint8_t EEPROMClass::read(int address) {
+    return data()[address];
+}
+
+void EEPROMClass::write(int address, uint8_t value) {
+    data()[address] = value;
+}
+
+uint8_t* EEPROMClass::data() {
+    return device().eeprom;
+}
+
+// FreeRTOS: one thread per task, on the creator's device
+
+struct HostTask {
+    std::string name;
+    uint32_t stackDepth;
+};
+
+namespace {
+    thread_local HostTask threadTask{"thread", 8192};
+    thread_local HostTask* currentTask = nullptr;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackDepth, void* param,
+                       UBaseType_t priority, TaskHandle_t* handle) {
+    (void)priority;
+    HostTask* task = new HostTask{name, stackDepth};
+    if (handle) {
+        *handle = task;
+    }
+    HostDevice* owner = &device();
+    std::thread([=]() {
+        HostDevice::select(owner);
+        currentTask = task;
+        function(param);
+    }).detach();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackDepth,
+                                   void* param, UBaseType_t priority, TaskHandle_t* handle, BaseType_t core) {
+    (void)core;
+    return xTaskCreate(function, name, stackDepth, param, priority, handle);
+}
+
+void vTaskDelete(TaskHandle_t handle) {
+    (void)handle;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    delay(ticks);
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t)millis();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return currentTask ? currentTask : &threadTask;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t handle) {
+    // Stack use isn't measured on the host; report the whole stack as unused
+    return handle ? handle->stackDepth : threadTask.stackDepth;
+}
@@ -0,0 +1,128 @@
+#include "HostDevice.h"
+#include <malloc.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace {
+    uint64_t steadyNs() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    thread_local HostDevice* selected = nullptr;
+}
+
+HostDevice& HostDevice::current() {
+    static HostDevice defaultDevice;
+    return selected ? *selected : defaultDevice;
+}
+
+void HostDevice::select(HostDevice* device) {
+    selected = device;
+}
+
+HostDevice::HostDevice() : heapInUseAtStart(mallinfo2().uordblks), realStartNs(steadyNs()) {
+    memset(eeprom, 0xFF, sizeof(eeprom));
+}
+
+uint32_t HostDevice::currentFreeHeap() {
+    int64_t grown = (int64_t)mallinfo2().uordblks - (int64_t)heapInUseAtStart;
+    uint32_t free = (uint32_t)std::max<int64_t>(0, std::min<int64_t>(freeHeap - grown, heapSize));
+    uint32_t lowest = lowestFreeHeap.load();
+    while (free < lowest && !lowestFreeHeap.compare_exchange_weak(lowest, free)) {
+    }
+    return free;
+}
+
+uint32_t HostDevice::minFreeHeap() {
+    currentFreeHeap();
+    return lowestFreeHeap;
+}
+
+void HostDevice::useVirtualClock(uint64_t startUs) {
+    virtualClock = true;
+    virtualUs = startUs;
+}
+
+uint64_t HostDevice::nowUs() const {
+    if (virtualClock) {
+        return virtualUs.load(std::memory_order_relaxed);
+    }
+    return (steadyNs() - realStartNs) / 1000;
+}
+
+void HostDevice::advanceUs(uint64_t us) {
+    if (virtualClock) {
+        virtualUs.fetch_add(us, std::memory_order_relaxed);
+    }
+}
+
+void HostDevice::sleepUs(uint64_t us) {
+    if (virtualClock) {
+        advanceUs(us);
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(us));
+    }
+}
+
+void HostDevice::setPackVoltage(int pin, float volts, float dividerRatio) {
+    pinMv[pin] = (uint32_t)(volts * 1000.0f / dividerRatio + 0.5f);
+}
+
+void HostDevice::setKnob(int pin, float fraction) {
+    pinMv[pin] = (uint32_t)(fraction * ADC_FULL_SCALE_MV + 0.5f);
+}
+
+void HostDevice::attachLedc(int pin, int channel) {
+    if (ledc[channel].pin == pin) {
+        return;   // Same signal in the GPIO matrix, no glitch
+    }
+    detachPin(pin);
+    ledc[channel].pin = pin;
+}
+
+void HostDevice::detachPin(int pin) {
+    for (LedcChannel& channel : ledc) {
+        if (channel.pin == pin) {
+            channel.pin = -1;
+            pinDetaches[pin]++;
+        }
+    }
+}
+
+float HostDevice::pinOutput(int pin) const {
+    for (const LedcChannel& channel : ledc) {
+        if (channel.pin == pin && channel.resolution > 0) {
+            return (float)channel.duty / (float)((1u << channel.resolution) - 1);
+        }
+    }
+    return pinLevel[pin] ? 1.0f : 0.0f;
+}
+
+void HostDevice::setWifiMode(int mode) {
+    uint64_t now = nowUs();
+    if (wifiMode == 0 && mode != 0) {
+        radioOnSinceUs = now;
+    } else if (wifiMode != 0 && mode == 0) {
+        radioOnUs += now - radioOnSinceUs;
+        associating = false;
+    }
+    wifiMode = mode;
+}
+
+bool HostDevice::wifiConnected() const {
+    return wifiMode != 0 && associating && apReachable && nowUs() >= associatedAtUs;
+}
+
+uint64_t HostDevice::totalRadioOnUs() const {
+    return radioOnUs + (wifiMode != 0 ? nowUs() - radioOnSinceUs : 0);
+}
+
+void HostDevice::setTouch(int value) {
+    touchValue = value;
+    if (touchIsr && value < touchThreshold) {
+        touchIsr();
+    }
+}
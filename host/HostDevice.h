@@ -0,0 +1,145 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// The simulated board behind the fake Arduino core in host/. Everything the
+// firmware reads from or writes to hardware lives here, so tests and host
+// programs can drive the inputs and look at the outputs.
+//
+// Each thread works on one device at a time (select()); tasks started with
+// xTaskCreate() inherit their creator's. Without select() everything runs
+// on one default device. The clock is real time unless useVirtualClock()
+// is called, after which it only moves on delay(), light sleep and advance().
+struct HostDevice {
+    static HostDevice& current();
+    static void select(HostDevice* device);  // nullptr: back to the default device
+
+    HostDevice();
+
+    // Clock
+    void useVirtualClock(uint64_t startUs = 0);
+    bool hasVirtualClock() const { return virtualClock; }
+    uint64_t nowUs() const;
+    void advanceMs(uint64_t ms) { advanceUs(ms * 1000); }
+    void advanceUs(uint64_t us);
+    void sleepUs(uint64_t us);   // delay() and light sleep: advance, or really sleep
+
+    // Analog inputs in millivolts at the pin; analogRead() scales them with
+    // the same linear curve the fake esp_adc_cal characterisation uses
+    static constexpr int PIN_COUNT = 64;
+    static constexpr uint32_t ADC_FULL_SCALE_MV = 3100;
+    uint32_t pinMv[PIN_COUNT] = {};
+    int adcResolution = 12;
+    void setPackVoltage(int pin, float volts, float dividerRatio);
+    void setKnob(int pin, float fraction);   // 0-1 of the ADC range
+
+    // Digital pins and LEDC. A pin shows its channel's duty while attached;
+    // pinMode() takes it back from the LEDC like the GPIO matrix does.
+    struct LedcChannel {
+        int pin = -1;
+        uint32_t freq = 0;
+        int resolution = 0;
+        uint32_t duty = 0;
+        uint32_t hpoint = 0;
+        uint32_t pendingDuty = 0;
+        uint32_t pendingHpoint = 0;
+        uint32_t writes = 0;
+    };
+    static constexpr int LEDC_CHANNELS = 16;
+    static constexpr int LEDC_TIMERS = 4;
+    LedcChannel ledc[LEDC_CHANNELS];
+    uint32_t timerResets[LEDC_TIMERS] = {};
+    uint32_t timerFrequencyChanges[LEDC_TIMERS] = {};
+    int pinLevel[PIN_COUNT] = {};
+    uint32_t pinDetaches[PIN_COUNT] = {};   // Taken off a channel, even if reattached later
+    void attachLedc(int pin, int channel);
+    void detachPin(int pin);
+    float pinOutput(int pin) const;          // 0-1: duty fraction or digital level
+    static int ledcTimer(int channel) { return (channel / 2) % LEDC_TIMERS; }
+
+    // CPU clock
+    int cpuMhz = 160;
+
+    // WiFi: WiFi.begin() associates after associationMs while the access
+    // point is reachable. radioOnUs adds up the time the radio was on.
+    int wifiMode = 0;                 // wifi_mode_t
+    bool apReachable = true;
+    uint32_t associationMs = 1500;
+    bool associating = false;
+    uint64_t associatedAtUs = 0;
+    uint64_t radioOnSinceUs = 0;
+    uint64_t radioOnUs = 0;
+    uint32_t associations = 0;
+    void setWifiMode(int mode);
+    bool wifiConnected() const;
+    uint64_t totalRadioOnUs() const;
+
+    // Sockets: WebServer and DNSServer listen on 127.0.0.1 at these ports
+    // instead of 80 and 53. 0 picks a free port, -1 leaves them closed.
+    // The ports actually bound show up in the bound* fields once begin() ran.
+    int httpPort = -1;
+    int dnsPort = -1;
+    std::atomic<int> boundHttpPort{0};
+    std::atomic<int> boundDnsPort{0};
+    // HTTPClient connects here instead of the host in the URL, which is on
+    // the lamp's LAN; -1 refuses every request. Answered and failed requests
+    // are counted, and onHttpRequest sees each with the real time it took.
+    std::string serverHost = "127.0.0.1";
+    int serverPort = -1;
+    uint32_t httpResponses = 0;
+    uint32_t httpFailures = 0;
+    std::function<void(const char* method, int code, uint64_t realUs)> onHttpRequest;
+    // WiFiClient::connect() goes to serverHost at this port instead of the
+    // host and port it names (the MQTT broker); -1 refuses. Bytes on the
+    // lamp's TCP connections, HTTPClient's and WiFiClient's, count both ways.
+    int brokerPort = -1;
+    std::atomic<uint64_t> tcpBytesSent{0};
+    std::atomic<uint64_t> tcpBytesReceived{0};
+
+    // Touch pad: setTouch() fires the interrupt while below its threshold
+    int touchValue = 1000;
+    uint16_t touchThreshold = 0;
+    void (*touchIsr)() = nullptr;
+    void setTouch(int value);
+
+    // Sleep and reset
+    uint64_t sleepWakeupUs = 0;
+    uint64_t lightSleepUs = 0;
+    uint32_t lightSleeps = 0;
+    int resetReason = 1;              // esp_reset_reason_t, ESP_RST_POWERON
+    uint32_t restarts = 0;
+    std::function<void()> onRestart;  // ESP.restart(); exits the process when unset
+
+    // OTA: the app0 and app1 partitions hold otaImage[0] and [1]; flash past
+    // the end of an image reads as erased (0xFF). The lamp runs from
+    // runningOta, and esp_ota_set_boot_partition() sets bootOta.
+    std::string otaImage[2];
+    int runningOta = 0;
+    int bootOta = 0;
+    int otaWriting = -1;              // Partition an open esp_ota_begin() writes to
+
+    // Identity, storage and heap
+    uint64_t efuseMac = 0x0000A1B2C3D4E5F6ULL;
+    static constexpr int EEPROM_SIZE = 4096;
+    uint8_t eeprom[EEPROM_SIZE];
+    // Heap: freeHeap is what the firmware finds free at boot. From there
+    // the free figure follows the process heap (mallinfo2), so a leak or
+    // growth in a host run shows up in ESP.getFreeHeap() and MemStats.
+    uint32_t heapSize = 327680;
+    uint32_t freeHeap = 280000;
+    uint32_t currentFreeHeap();       // Also moves the low-water mark
+    uint32_t minFreeHeap();
+
+    // Serial goes to stdout, into capture when set, or nowhere when muted
+    bool serialMuted = false;
+    std::string* serialCapture = nullptr;
+
+private:
+    size_t heapInUseAtStart = 0;
+    std::atomic<uint32_t> lowestFreeHeap{UINT32_MAX};
+    bool virtualClock = false;
+    std::atomic<uint64_t> virtualUs{0};
+    uint64_t realStartNs = 0;
+};
@@ -0,0 +1,144 @@
+// HTTPClient over a POSIX socket, one request per connection
+#include "HTTPClient.h"
+#include "HostDevice.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <chrono>
+
+namespace {
+    const size_t MAX_HEAD_BYTES = 16 * 1024;
+
+    uint64_t steadyUs() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    bool sendAll(WiFiClient& stream, const char* data, size_t size) {
+        return stream.write((const uint8_t*)data, size) == size;
+    }
+}
+
+bool HTTPClient::begin(const String& url) {
+    end();
+    std::string text = url.c_str();
+    size_t scheme = text.find("://");
+    size_t hostStart = scheme == std::string::npos ? 0 : scheme + 3;
+    size_t pathStart = text.find('/', hostStart);
+    hostHeader = text.substr(hostStart, pathStart - hostStart);
+    path = pathStart == std::string::npos ? "/" : text.substr(pathStart);
+    headers.clear();
+    return !hostHeader.empty();
+}
+
+void HTTPClient::addHeader(const String& name, const String& value) {
+    headers += std::string(name.c_str()) + ": " + value.c_str() + "\r\n";
+}
+
+int HTTPClient::GET() {
+    return sendRequest("GET", String());
+}
+
+int HTTPClient::POST(const String& payload) {
+    return sendRequest("POST", payload);
+}
+
+String HTTPClient::getString() {
+    stream.receive(size, timeout);
+    if (size >= 0 && stream.buffered.size() > (size_t)size) {
+        stream.buffered.resize((size_t)size);
+    }
+    String body = stream.buffered.c_str();
+    stream.buffered.clear();
+    return body;
+}
+
+void HTTPClient::end() {
+    stream.stop();
+    size = -1;
+}
+
+int HTTPClient::sendRequest(const char* method, const String& payload) {
+    HostDevice& device = HostDevice::current();
+    uint64_t start = steadyUs();
+    size = -1;
+    int code = connectToServer();
+    if (code == 0) {
+        // The headers the ESP32 client sends
+        std::string request = std::string(method) + " " + path + " HTTP/1.1\r\n" +
+                              "Host: " + hostHeader + "\r\n" +
+                              "User-Agent: ESP32HTTPClient\r\n" +
+                              "Connection: close\r\n" +
+                              "Accept-Encoding: identity;q=1,chunked;q=0.1,*;q=0\r\n" + headers;
+        if (strcmp(method, "GET") != 0) {
+            request += "Content-Length: " + std::to_string(payload.length()) + "\r\n";
+        }
+        request += "\r\n";
+        if (!sendAll(stream, request.data(), request.size())) {
+            code = HTTPC_ERROR_SEND_HEADER_FAILED;
+        } else if (!sendAll(stream, payload.c_str(), payload.length())) {
+            code = HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+        } else {
+            code = readResponseHead();
+        }
+    }
+    if (code > 0) {
+        device.httpResponses++;
+    } else {
+        device.httpFailures++;
+        stream.stop();
+    }
+    if (device.onHttpRequest) {
+        device.onHttpRequest(method, code, steadyUs() - start);
+    }
+    return code;
+}
+
+int HTTPClient::connectToServer() {
+    stream.stop();
+    HostDevice& device = HostDevice::current();
+    if (device.serverPort < 0) {
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+    // Connect timeout, and then every read and write, like the client's
+    if (!stream.connectTo(device.serverHost, device.serverPort, timeout)) {
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+    return 0;
+}
+
+int HTTPClient::readResponseHead() {
+    std::string head;
+    size_t headEnd;
+    char chunk[1024];
+    while ((headEnd = head.find("\r\n\r\n")) == std::string::npos) {
+        if (head.size() > MAX_HEAD_BYTES) {
+            return HTTPC_ERROR_NO_HTTP_SERVER;
+        }
+        ssize_t received = recv(stream.fd, chunk, sizeof(chunk), 0);
+        if (received < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK ? HTTPC_ERROR_READ_TIMEOUT : HTTPC_ERROR_CONNECTION_LOST;
+        }
+        if (received == 0) {
+            return HTTPC_ERROR_CONNECTION_LOST;
+        }
+        HostDevice::current().tcpBytesReceived += (uint64_t)received;
+        head.append(chunk, (size_t)received);
+    }
+    int code = 0;
+    if (sscanf(head.c_str(), "HTTP/1.%*d %d", &code) != 1 || code <= 0) {
+        return HTTPC_ERROR_NO_HTTP_SERVER;
+    }
+    stream.buffered = head.substr(headEnd + 4);
+    head.resize(headEnd + 2);
+
+    std::string lower = head;
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return (char)tolower(c); });
+    size_t field = lower.find("\r\ncontent-length:");
+    if (field != std::string::npos) {
+        size = atoi(head.c_str() + field + 17);
+    }
+    return code;
+}
@@ -0,0 +1,208 @@
+// ESP-IDF pieces the firmware calls directly
+#include "HostDevice.h"
+#include <driver/ledc.h>
+#include <esp_adc_cal.h>
+#include <esp_heap_caps.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <esp_sleep.h>
+#include <esp_system.h>
+#include <malloc.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+// LEDC
+
+esp_err_t ledc_set_duty_with_hpoint(ledc_mode_t mode, ledc_channel_t channel, uint32_t duty, uint32_t hpoint) {
+    HostDevice::LedcChannel& c = HostDevice::current().ledc[mode * 8 + channel];
+    c.pendingDuty = duty;
+    c.pendingHpoint = hpoint;
+    return ESP_OK;
+}
+
+esp_err_t ledc_update_duty(ledc_mode_t mode, ledc_channel_t channel) {
+    HostDevice::LedcChannel& c = HostDevice::current().ledc[mode * 8 + channel];
+    c.duty = c.pendingDuty;
+    c.hpoint = c.pendingHpoint;
+    c.writes++;
+    return ESP_OK;
+}
+
+esp_err_t ledc_timer_rst(ledc_mode_t mode, ledc_timer_t timer) {
+    (void)mode;
+    HostDevice::current().timerResets[timer]++;
+    return ESP_OK;
+}
+
+// Sleep and reset
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t timeUs) {
+    HostDevice::current().sleepWakeupUs = timeUs;
+    return ESP_OK;
+}
+
+esp_err_t esp_light_sleep_start() {
+    HostDevice& device = HostDevice::current();
+    device.sleepUs(device.sleepWakeupUs);
+    device.lightSleepUs += device.sleepWakeupUs;
+    device.lightSleeps++;
+    return ESP_OK;
+}
+
+esp_reset_reason_t esp_reset_reason() {
+    return (esp_reset_reason_t)HostDevice::current().resetReason;
+}
+
+// Heap
+
+size_t heap_caps_get_allocated_size(void* ptr) {
+    return malloc_usable_size(ptr);
+}
+
+void heap_caps_free(void* ptr) {
+    free(ptr);
+}
+
+// ADC calibration
+
+esp_adc_cal_value_t esp_adc_cal_characterize(adc_unit_t unit, adc_atten_t atten, adc_bits_width_t width,
+                                             uint32_t defaultVref, esp_adc_cal_characteristics_t* chars) {
+    chars->adc_num = unit;
+    chars->atten = atten;
+    chars->bit_width = width;
+    chars->coeff_a = HostDevice::ADC_FULL_SCALE_MV;
+    chars->coeff_b = 0;
+    chars->vref = defaultVref;
+    return ESP_ADC_CAL_VAL_EFUSE_TP;
+}
+
+uint32_t esp_adc_cal_raw_to_voltage(uint32_t raw, const esp_adc_cal_characteristics_t* chars) {
+    return (raw * chars->coeff_a + 2047) / 4095 + chars->coeff_b;
+}
+
+// OTA: two app partitions in HostDevice::otaImage
+
+namespace {
+    const uint8_t ESP_IMAGE_HEADER_MAGIC = 0xE9;
+    const esp_ota_handle_t OTA_HANDLE = 1;
+
+    const esp_partition_t OTA_PARTITIONS[2] = {
+        {0x10000, 0x140000, "app0"},
+        {0x150000, 0x140000, "app1"},
+    };
+
+    int otaIndex(const esp_partition_t* partition) {
+        for (int i = 0; i < 2; i++) {
+            if (partition == &OTA_PARTITIONS[i]) {
+                return i;
+            }
+        }
+        return -1;
+    }
+}
+
+const esp_partition_t* esp_ota_get_running_partition() {
+    return &OTA_PARTITIONS[HostDevice::current().runningOta];
+}
+
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start) {
+    int from = start ? otaIndex(start) : HostDevice::current().runningOta;
+    return from < 0 ? nullptr : &OTA_PARTITIONS[1 - from];
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t offset, void* dst, size_t size) {
+    int index = otaIndex(partition);
+    if (index < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (offset + size > partition->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    const std::string& image = HostDevice::current().otaImage[index];
+    size_t stored = offset < image.size() ? std::min(size, image.size() - offset) : 0;
+    memcpy(dst, image.data() + offset, stored);
+    memset((uint8_t*)dst + stored, 0xFF, size - stored);
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t* partition, size_t imageSize, esp_ota_handle_t* handle) {
+    HostDevice& device = HostDevice::current();
+    int index = otaIndex(partition);
+    if (index < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (index == device.runningOta) {
+        return ESP_ERR_OTA_PARTITION_CONFLICT;
+    }
+    if (imageSize > partition->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    device.otaImage[index].clear();   // Erased
+    device.otaWriting = index;
+    *handle = OTA_HANDLE;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void* data, size_t size) {
+    HostDevice& device = HostDevice::current();
+    if (handle != OTA_HANDLE || device.otaWriting < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::string& image = device.otaImage[device.otaWriting];
+    if (image.size() + size > OTA_PARTITIONS[device.otaWriting].size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    image.append((const char*)data, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle) {
+    HostDevice& device = HostDevice::current();
+    if (handle != OTA_HANDLE || device.otaWriting < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const std::string& image = device.otaImage[device.otaWriting];
+    device.otaWriting = -1;
+    if (image.empty() || (uint8_t)image[0] != ESP_IMAGE_HEADER_MAGIC) {
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle) {
+    HostDevice& device = HostDevice::current();
+    if (handle != OTA_HANDLE || device.otaWriting < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    device.otaWriting = -1;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition) {
+    int index = otaIndex(partition);
+    if (index < 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    HostDevice::current().bootOta = index;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_get_state_partition(const esp_partition_t* partition, esp_ota_img_states_t* state) {
+    (void)partition;
+    *state = ESP_OTA_IMG_VALID;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_mark_app_valid_cancel_rollback() {
+    return ESP_OK;
+}
+
+int esp_ota_get_app_elf_sha256(char* dst, size_t size) {
+    // A fixed "image hash" so firmware URLs are stable
+    const char* sha = "686f737462756c64";
+    size_t length = strlen(sha) < size - 1 ? strlen(sha) : size - 1;
+    memcpy(dst, sha, length);
+    dst[length] = '\0';
+    return (int)length;
+}
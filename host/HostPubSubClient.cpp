@@ -0,0 +1,265 @@
+// MQTT 3.1.1 client with PubSubClient's interface, over WiFiClient
+#include "PubSubClient.h"
+#include <string.h>
+#include <chrono>
+
+namespace {
+    const uint8_t CONNECT = 0x10;
+    const uint8_t CONNACK = 0x20;
+    const uint8_t PUBLISH = 0x30;
+    const uint8_t PUBACK = 0x40;
+    const uint8_t SUBSCRIBE = 0x82;   // Reserved flags 0010
+    const uint8_t PINGREQ = 0xC0;
+    const uint8_t PINGRESP = 0xD0;
+    const uint8_t DISCONNECT = 0xE0;
+
+    uint64_t steadyMs() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void appendU16(std::vector<uint8_t>& out, uint16_t value) {
+        out.push_back((uint8_t)(value >> 8));
+        out.push_back((uint8_t)value);
+    }
+
+    void appendString(std::vector<uint8_t>& out, const char* text) {
+        size_t length = strlen(text);
+        appendU16(out, (uint16_t)length);
+        out.insert(out.end(), text, text + length);
+    }
+}
+
+PubSubClient& PubSubClient::setServer(const char* serverDomain, uint16_t serverPort) {
+    domain = serverDomain;
+    port = serverPort;
+    return *this;
+}
+
+PubSubClient& PubSubClient::setCallback(Callback messageCallback) {
+    callback = messageCallback;
+    return *this;
+}
+
+PubSubClient& PubSubClient::setKeepAlive(uint16_t seconds) {
+    keepAliveS = seconds;
+    return *this;
+}
+
+bool PubSubClient::setBufferSize(uint16_t size) {
+    if (size == 0) {
+        return false;
+    }
+    bufferSize = size;
+    return true;
+}
+
+bool PubSubClient::connect(const char* id, const char* user, const char* pass, const char* willTopic,
+                           uint8_t willQos, bool willRetain, const char* willMessage, bool cleanSession) {
+    if (connected()) {
+        return true;
+    }
+    if (!client->connect(domain.c_str(), port)) {
+        connectionState = MQTT_CONNECT_FAILED;
+        return false;
+    }
+
+    std::vector<uint8_t> body;
+    appendString(body, "MQTT");
+    body.push_back(4);   // Protocol level 3.1.1
+    uint8_t flags = cleanSession ? 0x02 : 0x00;
+    if (willTopic) {
+        flags |= 0x04 | (uint8_t)(willQos << 3) | (willRetain ? 0x20 : 0x00);
+    }
+    if (user) {
+        flags |= 0x80;
+    }
+    if (pass) {
+        flags |= 0x40;
+    }
+    body.push_back(flags);
+    appendU16(body, keepAliveS);
+    appendString(body, id);
+    if (willTopic) {
+        appendString(body, willTopic);
+        appendString(body, willMessage ? willMessage : "");
+    }
+    if (user) {
+        appendString(body, user);
+    }
+    if (pass) {
+        appendString(body, pass);
+    }
+
+    uint8_t header;
+    if (!send(CONNECT, body) || !readPacket(header)) {
+        connectionState = MQTT_CONNECTION_TIMEOUT;
+        client->stop();
+        return false;
+    }
+    if ((header & 0xF0) != CONNACK || packet.size() < 2 || packet[1] != 0) {
+        connectionState = (header & 0xF0) == CONNACK && packet.size() >= 2 ? packet[1] : MQTT_CONNECT_FAILED;
+        client->stop();
+        return false;
+    }
+    pingOutstanding = false;
+    connectionState = MQTT_CONNECTED;
+    return true;
+}
+
+void PubSubClient::disconnect() {
+    if (client->connected()) {
+        send(DISCONNECT, {});
+    }
+    connectionState = MQTT_DISCONNECTED;
+    client->stop();
+}
+
+bool PubSubClient::publish(const char* topic, const char* payload, bool retained) {
+    return publish(topic, (const uint8_t*)payload, (unsigned int)strlen(payload), retained);
+}
+
+bool PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained) {
+    if (!connected() || MQTT_MAX_HEADER_SIZE + 2 + strlen(topic) + length > bufferSize) {
+        return false;
+    }
+    std::vector<uint8_t> body;
+    appendString(body, topic);
+    body.insert(body.end(), payload, payload + length);
+    return send(PUBLISH | (retained ? 0x01 : 0x00), body);
+}
+
+bool PubSubClient::subscribe(const char* topic, uint8_t qos) {
+    if (qos > 1 || !connected()) {
+        return false;
+    }
+    std::vector<uint8_t> body;
+    appendU16(body, messageId());
+    appendString(body, topic);
+    body.push_back(qos);
+    return send(SUBSCRIBE, body);
+}
+
+bool PubSubClient::loop() {
+    if (!connected()) {
+        return false;
+    }
+    uint64_t now = steadyMs();
+    uint64_t keepAliveMs = (uint64_t)keepAliveS * 1000;
+    if (now - lastInMs > keepAliveMs || now - lastOutMs > keepAliveMs) {
+        if (pingOutstanding) {
+            connectionState = MQTT_CONNECTION_TIMEOUT;
+            client->stop();
+            return false;
+        }
+        send(PINGREQ, {});
+        lastInMs = now;
+        pingOutstanding = true;
+    }
+    uint8_t header;
+    if (client->available() && readPacket(header)) {
+        handlePacket(header);
+    }
+    return connected();
+}
+
+bool PubSubClient::connected() {
+    if (!client->connected()) {
+        if (connectionState == MQTT_CONNECTED) {
+            connectionState = MQTT_CONNECTION_LOST;
+            client->stop();
+        }
+        return false;
+    }
+    return connectionState == MQTT_CONNECTED;
+}
+
+bool PubSubClient::send(uint8_t header, const std::vector<uint8_t>& body) {
+    std::vector<uint8_t> out;
+    out.push_back(header);
+    size_t length = body.size();
+    do {
+        uint8_t digit = length % 128;
+        length /= 128;
+        out.push_back(digit | (length > 0 ? 0x80 : 0x00));
+    } while (length > 0);
+    out.insert(out.end(), body.begin(), body.end());
+    if (out.size() > bufferSize) {
+        return false;
+    }
+    lastOutMs = steadyMs();
+    return client->write(out.data(), out.size()) == out.size();
+}
+
+bool PubSubClient::readByte(uint8_t& byte) {
+    uint64_t deadline = steadyMs() + MQTT_SOCKET_TIMEOUT * 1000;
+    while (!client->available()) {
+        if (!client->connected() || steadyMs() > deadline) {
+            return false;
+        }
+    }
+    byte = (uint8_t)client->read();
+    return true;
+}
+
+bool PubSubClient::readPacket(uint8_t& header) {
+    uint8_t byte;
+    if (!readByte(header)) {
+        return false;
+    }
+    size_t length = 0;
+    int shift = 0;
+    do {
+        if (!readByte(byte)) {
+            return false;
+        }
+        length |= (size_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    packet.resize(length);
+    for (size_t i = 0; i < length; i++) {
+        if (!readByte(packet[i])) {
+            return false;
+        }
+    }
+    lastInMs = steadyMs();
+    // Like the library, a packet too big for the buffer is read and dropped
+    return length + MQTT_MAX_HEADER_SIZE <= bufferSize;
+}
+
+void PubSubClient::handlePacket(uint8_t header) {
+    switch (header & 0xF0) {
+        case PUBLISH: {
+            if (packet.size() < 2) {
+                return;
+            }
+            size_t topicLength = ((size_t)packet[0] << 8) | packet[1];
+            uint8_t qos = (header >> 1) & 0x03;
+            size_t offset = 2 + topicLength + (qos > 0 ? 2 : 0);
+            if (offset > packet.size()) {
+                return;
+            }
+            std::string topic((const char*)&packet[2], topicLength);
+            if (callback) {
+                callback(&topic[0], packet.data() + offset, (unsigned int)(packet.size() - offset));
+            }
+            if (qos == 1) {
+                send(PUBACK, {packet[2 + topicLength], packet[3 + topicLength]});
+            }
+            break;
+        }
+        case PINGREQ:
+            send(PINGRESP, {});
+            break;
+        case PINGRESP:
+            pingOutstanding = false;
+            break;
+    }
+}
+
+uint16_t PubSubClient::messageId() {
+    uint16_t id = nextMessageId;
+    nextMessageId = nextMessageId == 0xFFFF ? 1 : nextMessageId + 1;
+    return id;
+}
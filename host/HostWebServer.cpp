@@ -0,0 +1,362 @@
+// WebServer and DNSServer over POSIX sockets on 127.0.0.1
+#include "WebServer.h"
+#include "DNSServer.h"
+#include "HostDevice.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <string>
+
+namespace {
+    const int LISTEN_BACKLOG = 16;
+    const int RECEIVE_TIMEOUT_S = 2;
+    const size_t MAX_REQUEST_BYTES = 64 * 1024;
+    const size_t DNS_MAX_PACKET = 512;
+    const size_t DNS_HEADER_SIZE = 12;
+    const uint32_t DNS_TTL_S = 60;
+
+    // Binds to the loopback address; port 0 takes any free port
+    int openSocket(int type, int port, std::atomic<int>& bound) {
+        int fd = socket(AF_INET, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons((uint16_t)port);
+        if (bind(fd, (sockaddr*)&address, sizeof(address)) < 0 ||
+            (type == SOCK_STREAM && listen(fd, LISTEN_BACKLOG) < 0)) {
+            close(fd);
+            return -1;
+        }
+        socklen_t length = sizeof(address);
+        getsockname(fd, (sockaddr*)&address, &length);
+        bound = ntohs(address.sin_port);
+        return fd;
+    }
+
+    bool sendAll(int fd, const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t sent = ::send(fd, data, size, MSG_NOSIGNAL);
+            if (sent <= 0) {
+                return false;
+            }
+            data += sent;
+            size -= (size_t)sent;
+        }
+        return true;
+    }
+
+    const char* reasonPhrase(int code) {
+        switch (code) {
+            case 200: return "OK";
+            case 202: return "Accepted";
+            case 204: return "No Content";
+            case 302: return "Found";
+            case 400: return "Bad Request";
+            case 404: return "Not Found";
+            case 500: return "Internal Server Error";
+            case 503: return "Service Unavailable";
+            default: return "";
+        }
+    }
+
+    HTTPMethod parseMethod(const std::string& name) {
+        if (name == "POST") return HTTP_POST;
+        if (name == "HEAD") return HTTP_HEAD;
+        if (name == "PUT") return HTTP_PUT;
+        if (name == "PATCH") return HTTP_PATCH;
+        if (name == "DELETE") return HTTP_DELETE;
+        if (name == "OPTIONS") return HTTP_OPTIONS;
+        return HTTP_GET;
+    }
+
+    std::string urlDecode(const std::string& text) {
+        std::string decoded;
+        for (size_t i = 0; i < text.size(); i++) {
+            if (text[i] == '+') {
+                decoded += ' ';
+            } else if (text[i] == '%' && i + 2 < text.size() && isxdigit((unsigned char)text[i + 1]) &&
+                       isxdigit((unsigned char)text[i + 2])) {
+                decoded += (char)strtol(text.substr(i + 1, 2).c_str(), nullptr, 16);
+                i += 2;
+            } else {
+                decoded += text[i];
+            }
+        }
+        return decoded;
+    }
+
+    // Value of a header in the raw header block, case-insensitive name
+    std::string headerValue(const std::string& headers, const char* name) {
+        size_t nameLength = strlen(name);
+        size_t position = 0;
+        while ((position = headers.find("\r\n", position)) != std::string::npos) {
+            position += 2;
+            if (strncasecmp(headers.c_str() + position, name, nameLength) == 0 &&
+                headers[position + nameLength] == ':') {
+                size_t start = headers.find_first_not_of(' ', position + nameLength + 1);
+                size_t end = headers.find("\r\n", position);
+                return start < end ? headers.substr(start, end - start) : std::string();
+            }
+        }
+        return std::string();
+    }
+}
+
+// WebServer
+
+void WebServer::begin() {
+    if (listenFd >= 0) {
+        return;
+    }
+    HostDevice& device = HostDevice::current();
+    if (device.httpPort < 0) {
+        return;
+    }
+    listenFd = openSocket(SOCK_STREAM, device.httpPort, device.boundHttpPort);
+    if (listenFd < 0) {
+        fprintf(stderr, "WebServer: can't listen on port %d (device port %d)\n", device.httpPort, port);
+    }
+}
+
+void WebServer::stop() {
+    if (listenFd >= 0) {
+        close(listenFd);
+        listenFd = -1;
+    }
+}
+
+void WebServer::handleClient() {
+    if (listenFd < 0) {
+        return;
+    }
+    clientFd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (clientFd < 0) {
+        return;
+    }
+    timeval timeout = {RECEIVE_TIMEOUT_S, 0};
+    setsockopt(clientFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    responded = false;
+    args.clear();
+    pendingHeaders = "";
+    if (readRequest()) {
+        bool handled = false;
+        for (const Route& route : routes) {
+            if (route.uri == requestUri && (route.method == HTTP_ANY || route.method == requestMethod)) {
+                route.handler();
+                handled = true;
+                break;
+            }
+        }
+        if (!handled) {
+            if (notFound) {
+                notFound();
+            } else {
+                send(404, "text/plain", "Not found: " + requestUri);
+            }
+        }
+        if (!responded) {
+            send(500, "text/plain", "No response");
+        }
+    }
+    close(clientFd);
+    clientFd = -1;
+}
+
+bool WebServer::readRequest() {
+    std::string request;
+    char chunk[2048];
+    size_t headerEnd;
+    while ((headerEnd = request.find("\r\n\r\n")) == std::string::npos) {
+        ssize_t received = recv(clientFd, chunk, sizeof(chunk), 0);
+        if (received <= 0 || request.size() > MAX_REQUEST_BYTES) {
+            return false;
+        }
+        request.append(chunk, (size_t)received);
+    }
+
+    size_t lineEnd = request.find("\r\n");
+    std::string line = request.substr(0, lineEnd);
+    size_t methodEnd = line.find(' ');
+    size_t targetEnd = line.find(' ', methodEnd + 1);
+    if (methodEnd == std::string::npos || targetEnd == std::string::npos) {
+        return false;
+    }
+    requestMethod = parseMethod(line.substr(0, methodEnd));
+    std::string target = line.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+    size_t query = target.find('?');
+    requestUri = urlDecode(target.substr(0, query)).c_str();
+    if (query != std::string::npos) {
+        parseArgs(target.substr(query + 1));
+    }
+
+    std::string headers = request.substr(lineEnd, headerEnd - lineEnd + 2);
+    size_t contentLength = strtoul(headerValue(headers, "Content-Length").c_str(), nullptr, 10);
+    if (contentLength > MAX_REQUEST_BYTES) {
+        return false;
+    }
+    std::string body = request.substr(headerEnd + 4);
+    while (body.size() < contentLength) {
+        ssize_t received = recv(clientFd, chunk, sizeof(chunk), 0);
+        if (received <= 0) {
+            return false;
+        }
+        body.append(chunk, (size_t)received);
+    }
+    body.resize(contentLength);
+
+    if (headerValue(headers, "Content-Type").compare(0, 33, "application/x-www-form-urlencoded") == 0) {
+        parseArgs(body);
+    } else if (!body.empty()) {
+        args.push_back({"plain", body.c_str()});
+    }
+    return true;
+}
+
+void WebServer::parseArgs(const std::string& encoded) {
+    size_t start = 0;
+    while (start < encoded.size()) {
+        size_t end = encoded.find('&', start);
+        if (end == std::string::npos) {
+            end = encoded.size();
+        }
+        std::string pair = encoded.substr(start, end - start);
+        size_t equals = pair.find('=');
+        if (!pair.empty()) {
+            args.push_back({urlDecode(pair.substr(0, equals)).c_str(),
+                            equals == std::string::npos ? "" : urlDecode(pair.substr(equals + 1)).c_str()});
+        }
+        start = end + 1;
+    }
+}
+
+void WebServer::send(int code, const char* contentType, const String& content) {
+    if (clientFd < 0 || responded) {
+        return;
+    }
+    responded = true;
+    String head = "HTTP/1.1 " + String(code) + " " + reasonPhrase(code) + "\r\n" +
+                  "Content-Type: " + contentType + "\r\n" +
+                  "Content-Length: " + String(content.length()) + "\r\n" +
+                  "Connection: close\r\n";
+    if (cors) {
+        head += "Access-Control-Allow-Origin: *\r\n";
+    }
+    head += pendingHeaders;
+    head += "\r\n";
+    pendingHeaders = "";
+    if (sendAll(clientFd, head.c_str(), head.length()) && requestMethod != HTTP_HEAD) {
+        sendAll(clientFd, content.c_str(), content.length());
+    }
+}
+
+void WebServer::sendHeader(const String& name, const String& value, bool first) {
+    String line = name + ": " + value + "\r\n";
+    if (first) {
+        pendingHeaders = line + pendingHeaders;
+    } else {
+        pendingHeaders += line;
+    }
+}
+
+bool WebServer::hasArg(const String& name) const {
+    for (const auto& entry : args) {
+        if (entry.first == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+String WebServer::arg(const String& name) const {
+    for (const auto& entry : args) {
+        if (entry.first == name) {
+            return entry.second;
+        }
+    }
+    return String();
+}
+
+// DNSServer
+
+bool DNSServer::start(uint16_t port, const String& domainName, const IPAddress& resolvedIP) {
+    domain = domainName;
+    address = resolvedIP;
+    HostDevice& device = HostDevice::current();
+    if (fd >= 0 || device.dnsPort < 0) {
+        return true;
+    }
+    fd = openSocket(SOCK_DGRAM, device.dnsPort, device.boundDnsPort);
+    if (fd < 0) {
+        fprintf(stderr, "DNSServer: can't bind port %d (device port %u)\n", device.dnsPort, port);
+        return false;
+    }
+    return true;
+}
+
+void DNSServer::processNextRequest() {
+    if (fd < 0) {
+        return;
+    }
+    uint8_t packet[DNS_MAX_PACKET + 16];
+    sockaddr_in client = {};
+    socklen_t clientLength = sizeof(client);
+    ssize_t length = recvfrom(fd, packet, DNS_MAX_PACKET, 0, (sockaddr*)&client, &clientLength);
+    if (length < (ssize_t)DNS_HEADER_SIZE || (packet[2] & 0x80) || packet[4] != 0 || packet[5] != 1) {
+        return;   // Not a query with exactly one question
+    }
+
+    // Question name as dotted text, and where the question ends
+    std::string name;
+    size_t position = DNS_HEADER_SIZE;
+    while (position < (size_t)length && packet[position] != 0) {
+        size_t labelLength = packet[position];
+        if (labelLength > 63 || position + 1 + labelLength >= (size_t)length) {
+            return;
+        }
+        if (!name.empty()) {
+            name += '.';
+        }
+        name.append((const char*)packet + position + 1, labelLength);
+        position += 1 + labelLength;
+    }
+    size_t questionEnd = position + 5;   // Terminating zero, type, class
+    if (questionEnd > (size_t)length) {
+        return;
+    }
+
+    bool match = domain == "*" || strcasecmp(name.c_str(), domain.c_str()) == 0;
+    packet[2] = 0x80 | (packet[2] & 0x01);   // Response, keep recursion desired
+    packet[3] = match ? 0 : (uint8_t)errorReplyCode;
+    packet[6] = 0;
+    packet[7] = match ? 1 : 0;
+    memset(packet + 8, 0, 4);
+    size_t replyLength = questionEnd;
+    if (match) {
+        const uint8_t answer[] = {
+            0xC0, 0x0C,                 // Name: pointer to the question
+            0x00, 0x01, 0x00, 0x01,     // Type A, class IN
+            0, 0, 0, (uint8_t)DNS_TTL_S,
+            0x00, 0x04,
+            address[0], address[1], address[2], address[3],
+        };
+        memcpy(packet + replyLength, answer, sizeof(answer));
+        replyLength += sizeof(answer);
+    }
+    sendto(fd, packet, replyLength, 0, (sockaddr*)&client, clientLength);
+}
+
+void DNSServer::stop() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
@@ -0,0 +1,239 @@
+// WiFi radio model on top of HostDevice, and WiFiClient over POSIX sockets
+#include "WiFi.h"
+#include "ESPmDNS.h"
+#include "HostDevice.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <string>
+
+WiFiClass WiFi;
+MDNSResponder MDNS;
+
+bool WiFiClass::mode(wifi_mode_t mode) {
+    HostDevice::current().setWifiMode(mode);
+    return true;
+}
+
+wifi_mode_t WiFiClass::getMode() {
+    return (wifi_mode_t)HostDevice::current().wifiMode;
+}
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* password) {
+    (void)ssid;
+    (void)password;
+    HostDevice& device = HostDevice::current();
+    if (device.wifiMode == WIFI_OFF) {
+        device.setWifiMode(WIFI_STA);
+    }
+    device.associating = true;
+    device.associatedAtUs = device.nowUs() + (uint64_t)device.associationMs * 1000;
+    device.associations++;
+    return status();
+}
+
+wl_status_t WiFiClass::status() {
+    HostDevice& device = HostDevice::current();
+    if (device.wifiConnected()) {
+        return WL_CONNECTED;
+    }
+    return device.associating ? WL_DISCONNECTED : WL_IDLE_STATUS;
+}
+
+bool WiFiClass::disconnect(bool wifiOff) {
+    HostDevice& device = HostDevice::current();
+    device.associating = false;
+    if (wifiOff) {
+        device.setWifiMode(WIFI_OFF);
+    }
+    return true;
+}
+
+bool WiFiClass::softAP(const char* ssid, const char* password) {
+    (void)ssid;
+    (void)password;
+    HostDevice& device = HostDevice::current();
+    device.setWifiMode(device.wifiMode | WIFI_AP);
+    return true;
+}
+
+bool WiFiClass::softAPConfig(IPAddress local, IPAddress gateway, IPAddress subnet) {
+    (void)local;
+    (void)gateway;
+    (void)subnet;
+    return true;
+}
+
+IPAddress WiFiClass::localIP() {
+    return status() == WL_CONNECTED ? IPAddress(127, 0, 0, 1) : IPAddress();
+}
+
+IPAddress WiFiClass::softAPIP() {
+    return IPAddress(192, 168, 4, 1);
+}
+
+int8_t WiFiClass::RSSI() {
+    return status() == WL_CONNECTED ? -55 : 0;
+}
+
+String WiFiClass::macAddress() {
+    char text[18];
+    uint64_t mac = HostDevice::current().efuseMac;
+    snprintf(text, sizeof(text), "%02X:%02X:%02X:%02X:%02X:%02X",
+             (unsigned)(mac & 0xFF), (unsigned)((mac >> 8) & 0xFF), (unsigned)((mac >> 16) & 0xFF),
+             (unsigned)((mac >> 24) & 0xFF), (unsigned)((mac >> 32) & 0xFF), (unsigned)((mac >> 40) & 0xFF));
+    return String(text);
+}
+
+// WiFiClient
+
+namespace {
+    const int CONNECT_TIMEOUT_MS = 3000;   // WIFI_CLIENT_DEF_CONN_TIMEOUT_MS
+    const int AVAILABLE_WAIT_MS = 1;       // available() waits as long as the delay(1) callers poll with
+}
+
+int WiFiClient::connect(const char* host, uint16_t port) {
+    (void)host;
+    (void)port;
+    HostDevice& device = HostDevice::current();
+    if (!device.wifiConnected() || device.brokerPort < 0) {
+        return 0;
+    }
+    return connectTo(device.serverHost, device.brokerPort, CONNECT_TIMEOUT_MS) ? 1 : 0;
+}
+
+bool WiFiClient::connectTo(const std::string& host, int port, int timeoutMs) {
+    stop();
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* address = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &address) != 0) {
+        return false;
+    }
+    int socketFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int result = socketFd < 0 ? -1 : ::connect(socketFd, address->ai_addr, address->ai_addrlen);
+    freeaddrinfo(address);
+    if (result < 0 && socketFd >= 0 && errno == EINPROGRESS) {
+        pollfd pending = {socketFd, POLLOUT, 0};
+        int error = ETIMEDOUT;
+        socklen_t length = sizeof(error);
+        if (poll(&pending, 1, timeoutMs) == 1) {
+            getsockopt(socketFd, SOL_SOCKET, SO_ERROR, &error, &length);
+        }
+        result = error == 0 ? 0 : -1;
+    }
+    if (result < 0) {
+        if (socketFd >= 0) {
+            close(socketFd);
+        }
+        return false;
+    }
+
+    // Blocking from here on, with the timeout for every read and write
+    fcntl(socketFd, F_SETFL, fcntl(socketFd, F_GETFL) & ~O_NONBLOCK);
+    timeval limit = {timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+    setsockopt(socketFd, SOL_SOCKET, SO_RCVTIMEO, &limit, sizeof(limit));
+    setsockopt(socketFd, SOL_SOCKET, SO_SNDTIMEO, &limit, sizeof(limit));
+    fd = socketFd;
+    closed = false;
+    buffered.clear();
+    device = &HostDevice::current();
+    return true;
+}
+
+bool WiFiClient::fill(int waitMs) {
+    if (fd < 0 || closed) {
+        return false;
+    }
+    pollfd ready = {fd, POLLIN, 0};
+    if (poll(&ready, 1, waitMs) != 1) {
+        return false;
+    }
+    char chunk[2048];
+    ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+    if (received <= 0) {
+        closed = true;
+        return false;
+    }
+    device->tcpBytesReceived += (uint64_t)received;
+    buffered.append(chunk, (size_t)received);
+    return true;
+}
+
+void WiFiClient::receive(int length, int waitMs) {
+    while ((length < 0 || buffered.size() < (size_t)length) && fill(waitMs)) {
+    }
+}
+
+int WiFiClient::available() {
+    if (buffered.empty() && connected()) {
+        fill(AVAILABLE_WAIT_MS);
+    }
+    return (int)buffered.size();
+}
+
+int WiFiClient::read() {
+    if (buffered.empty() && !fill(0)) {
+        return -1;
+    }
+    int c = (uint8_t)buffered[0];
+    buffered.erase(0, 1);
+    return c;
+}
+
+size_t WiFiClient::readBytes(uint8_t* buffer, size_t length) {
+    size_t count = 0;
+    while (count < length) {
+        int c = read();
+        if (c < 0) {
+            break;
+        }
+        buffer[count++] = (uint8_t)c;
+    }
+    return count;
+}
+
+size_t WiFiClient::write(const uint8_t* buffer, size_t length) {
+    size_t written = 0;
+    while (fd >= 0 && written < length) {
+        ssize_t sent = send(fd, buffer + written, length - written, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            break;
+        }
+        written += (size_t)sent;
+    }
+    if (device) {
+        device->tcpBytesSent += written;
+    }
+    return written;
+}
+
+bool WiFiClient::connected() {
+    if (fd < 0) {
+        return false;
+    }
+    if (!device->wifiConnected()) {
+        stop();   // The radio went off under the connection
+        return false;
+    }
+    if (buffered.empty()) {
+        fill(0);
+    }
+    return !buffered.empty() || !closed;
+}
+
+void WiFiClient::stop() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    closed = false;
+    buffered.clear();
+    device = nullptr;
+}
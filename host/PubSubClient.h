@@ -0,0 +1,59 @@
+#pragma once
+#include "WiFi.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+#define MQTT_CONNECTION_TIMEOUT (-4)
+#define MQTT_CONNECTION_LOST (-3)
+#define MQTT_CONNECT_FAILED (-2)
+#define MQTT_DISCONNECTED (-1)
+#define MQTT_CONNECTED 0
+#define MQTT_MAX_HEADER_SIZE 5
+#define MQTT_SOCKET_TIMEOUT 15
+
+// The PubSubClient 2.8 calls MqttTransport makes, speaking MQTT 3.1.1 over a
+// host WiFiClient. Like the library it publishes at QoS 0, subscribes at up
+// to QoS 1 and acks QoS 1 deliveries, handles one packet per loop(), and
+// refuses packets that don't fit setBufferSize(). Waits for the broker are
+// real time, so they work on a device with a virtual clock.
+class PubSubClient {
+public:
+    typedef std::function<void(char* topic, uint8_t* payload, unsigned int length)> Callback;
+
+    explicit PubSubClient(WiFiClient& client) : client(&client) {}
+    PubSubClient& setServer(const char* domain, uint16_t port);
+    PubSubClient& setCallback(Callback callback);
+    PubSubClient& setKeepAlive(uint16_t keepAliveS);
+    bool setBufferSize(uint16_t size);
+    bool connect(const char* id, const char* user, const char* pass, const char* willTopic, uint8_t willQos,
+                 bool willRetain, const char* willMessage, bool cleanSession = true);
+    bool connect(const char* id) { return connect(id, nullptr, nullptr, nullptr, 0, false, nullptr); }
+    void disconnect();
+    bool publish(const char* topic, const char* payload, bool retained = false);
+    bool publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained = false);
+    bool subscribe(const char* topic, uint8_t qos = 0);
+    bool loop();
+    bool connected();
+    int state() const { return connectionState; }
+
+private:
+    WiFiClient* client;
+    std::string domain;
+    uint16_t port = 1883;
+    Callback callback;
+    uint16_t keepAliveS = 15;
+    size_t bufferSize = 256;
+    std::vector<uint8_t> packet;   // Body of the last packet read
+    uint16_t nextMessageId = 1;
+    uint64_t lastOutMs = 0;
+    uint64_t lastInMs = 0;
+    bool pingOutstanding = false;
+    int connectionState = MQTT_DISCONNECTED;
+
+    bool send(uint8_t header, const std::vector<uint8_t>& body);
+    bool readByte(uint8_t& byte);
+    bool readPacket(uint8_t& header);
+    void handlePacket(uint8_t header);
+    uint16_t messageId();
+};
@@ -0,0 +1,237 @@
+#include "WString.h"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+    // Digits of value in base, most significant first
+    void formatUnsigned(char* out, unsigned long long value, unsigned char base) {
+        char digits[66];
+        int count = 0;
+        if (base < 2 || base > 36) {
+            base = 10;
+        }
+        do {
+            int digit = (int)(value % base);
+            digits[count++] = (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+            value /= base;
+        } while (value);
+        for (int i = 0; i < count; i++) {
+            out[i] = digits[count - 1 - i];
+        }
+        out[count] = '\0';
+    }
+
+    void formatSigned(char* out, long long value, unsigned char base) {
+        if (value < 0 && base == 10) {
+            out[0] = '-';
+            formatUnsigned(out + 1, 0ULL - (unsigned long long)value, base);
+        } else {
+            formatUnsigned(out, (unsigned long long)value, base);
+        }
+    }
+}
+
+String::String(const char* text) {
+    assign(text ? text : "", text ? (unsigned int)strlen(text) : 0);
+}
+
+String::String(const String& other) {
+    assign(other.c_str(), other.len);
+}
+
+String::String(String&& other) noexcept : buffer(other.buffer), capacity(other.capacity), len(other.len) {
+    other.buffer = nullptr;
+    other.capacity = 0;
+    other.len = 0;
+}
+
+String::String(char c) {
+    assign(&c, 1);
+}
+
+String::String(int value, unsigned char base) : String((long long)value, base) {}
+String::String(unsigned int value, unsigned char base) : String((unsigned long long)value, base) {}
+String::String(long value, unsigned char base) : String((long long)value, base) {}
+String::String(unsigned long value, unsigned char base) : String((unsigned long long)value, base) {}
+
+String::String(long long value, unsigned char base) {
+    char text[68];
+    formatSigned(text, value, base);
+    assign(text, (unsigned int)strlen(text));
+}
+
+String::String(unsigned long long value, unsigned char base) {
+    char text[68];
+    formatUnsigned(text, value, base);
+    assign(text, (unsigned int)strlen(text));
+}
+
+String::String(float value, unsigned int decimals) : String((double)value, decimals) {}
+
+String::String(double value, unsigned int decimals) {
+    char text[64];
+    snprintf(text, sizeof(text), "%.*f", (int)decimals, value);
+    assign(text, (unsigned int)strlen(text));
+}
+
+String::~String() {
+    free(buffer);
+}
+
+String& String::operator=(const String& other) {
+    if (this != &other) {
+        assign(other.c_str(), other.len);
+    }
+    return *this;
+}
+
+String& String::operator=(String&& other) noexcept {
+    if (this != &other) {
+        free(buffer);
+        buffer = other.buffer;
+        capacity = other.capacity;
+        len = other.len;
+        other.buffer = nullptr;
+        other.capacity = 0;
+        other.len = 0;
+    }
+    return *this;
+}
+
+String& String::operator=(const char* text) {
+    assign(text ? text : "", text ? (unsigned int)strlen(text) : 0);
+    return *this;
+}
+
+bool String::reserve(unsigned int size) {
+    if (buffer && capacity >= size) {
+        return true;
+    }
+    char* grown = (char*)realloc(buffer, size + 1);
+    if (!grown) {
+        return false;
+    }
+    if (!buffer) {
+        grown[0] = '\0';
+    }
+    buffer = grown;
+    capacity = size;
+    return true;
+}
+
+void String::assign(const char* text, unsigned int length) {
+    if (!reserve(length)) {
+        return;
+    }
+    memmove(buffer, text, length);
+    buffer[length] = '\0';
+    len = length;
+}
+
+bool String::concat(const char* text, unsigned int length) {
+    if (!text) {
+        return false;
+    }
+    if (length == 0) {
+        return reserve(len);
+    }
+    // text may point into this string
+    if (buffer && text >= buffer && text < buffer + len) {
+        String copy(*this);
+        return concat(copy.c_str() + (text - buffer), length);
+    }
+    if (!reserve(len + length)) {
+        return false;
+    }
+    memcpy(buffer + len, text, length);
+    len += length;
+    buffer[len] = '\0';
+    return true;
+}
+
+bool String::concat(const char* text) {
+    return text && concat(text, (unsigned int)strlen(text));
+}
+
+bool String::equals(const char* text) const {
+    return strcmp(c_str(), text ? text : "") == 0;
+}
+
+bool String::startsWith(const char* prefix) const {
+    return strncmp(c_str(), prefix, strlen(prefix)) == 0;
+}
+
+int String::indexOf(char c, unsigned int from) const {
+    if (from >= len) {
+        return -1;
+    }
+    const char* found = strchr(buffer + from, c);
+    return found ? (int)(found - buffer) : -1;
+}
+
+int String::indexOf(const char* text, unsigned int from) const {
+    if (from >= len) {
+        return -1;
+    }
+    const char* found = strstr(buffer + from, text);
+    return found ? (int)(found - buffer) : -1;
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+    if (to > len) {
+        to = len;
+    }
+    String result;
+    if (from < to) {
+        result.assign(buffer + from, to - from);
+    }
+    return result;
+}
+
+void String::trim() {
+    unsigned int start = 0;
+    while (start < len && isspace((unsigned char)buffer[start])) {
+        start++;
+    }
+    unsigned int end = len;
+    while (end > start && isspace((unsigned char)buffer[end - 1])) {
+        end--;
+    }
+    if (start > 0 || end < len) {
+        assign(buffer + start, end - start);
+    }
+}
+
+long String::toInt() const {
+    return strtol(c_str(), nullptr, 10);
+}
+
+float String::toFloat() const {
+    return strtof(c_str(), nullptr);
+}
+
+String operator+(const String& left, const String& right) {
+    String result(left);
+    result += right;
+    return result;
+}
+
+String operator+(const String& left, const char* right) {
+    String result(left);
+    result += right;
+    return result;
+}
+
+String operator+(const char* left, const String& right) {
+    String result(left);
+    result += right;
+    return result;
+}
+
+String operator+(const String& left, char right) {
+    String result(left);
+    result += right;
+    return result;
+}
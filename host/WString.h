@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Heap string like the core's: its buffer comes from malloc()/realloc(), so
+// the MEM_STATS malloc wrappers count it the same way as on the device.
+class String {
+public:
+    String(const char* text = "");
+    String(const String& other);
+    String(String&& other) noexcept;
+    explicit String(char c);
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(long long value, unsigned char base = 10);
+    explicit String(unsigned long long value, unsigned char base = 10);
+    explicit String(float value, unsigned int decimals = 2);
+    explicit String(double value, unsigned int decimals = 2);
+    ~String();
+
+    String& operator=(const String& other);
+    String& operator=(String&& other) noexcept;
+    String& operator=(const char* text);
+
+    bool reserve(unsigned int size);
+    unsigned int length() const { return len; }
+    bool isEmpty() const { return len == 0; }
+    const char* c_str() const { return buffer ? buffer : ""; }
+    char operator[](unsigned int index) const { return index < len ? buffer[index] : 0; }
+
+    bool concat(const char* text, unsigned int length);
+    bool concat(const char* text);
+    bool concat(const String& other) { return concat(other.c_str(), other.len); }
+    bool concat(char c) { return concat(&c, 1); }
+    String& operator+=(const String& other) { concat(other); return *this; }
+    String& operator+=(const char* text) { concat(text); return *this; }
+    String& operator+=(char c) { concat(c); return *this; }
+    String& operator+=(int value) { concat(String(value)); return *this; }
+    String& operator+=(unsigned int value) { concat(String(value)); return *this; }
+    String& operator+=(long value) { concat(String(value)); return *this; }
+    String& operator+=(unsigned long value) { concat(String(value)); return *this; }
+
+    bool equals(const char* text) const;
+    bool operator==(const String& other) const { return equals(other.c_str()); }
+    bool operator==(const char* text) const { return equals(text); }
+    bool operator!=(const String& other) const { return !equals(other.c_str()); }
+    bool operator!=(const char* text) const { return !equals(text); }
+    bool startsWith(const char* prefix) const;
+    int indexOf(char c, unsigned int from = 0) const;
+    int indexOf(const char* text, unsigned int from = 0) const;
+    String substring(unsigned int from, unsigned int to = 0xFFFFFFFF) const;
+    void trim();
+
+    long toInt() const;
+    float toFloat() const;
+
+private:
+    char* buffer = nullptr;
+    unsigned int capacity = 0;
+    unsigned int len = 0;
+
+    void assign(const char* text, unsigned int length);
+};
+
+String operator+(const String& left, const String& right);
+String operator+(const String& left, const char* right);
+String operator+(const char* left, const String& right);
+String operator+(const String& left, char right);
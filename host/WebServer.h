@@ -0,0 +1,89 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "WiFi.h"
+
+typedef enum {
+    HTTP_ANY,
+    HTTP_GET,
+    HTTP_HEAD,
+    HTTP_POST,
+    HTTP_PUT,
+    HTTP_PATCH,
+    HTTP_DELETE,
+    HTTP_OPTIONS
+} HTTPMethod;
+
+typedef enum {
+    UPLOAD_FILE_START,
+    UPLOAD_FILE_WRITE,
+    UPLOAD_FILE_END,
+    UPLOAD_FILE_ABORTED
+} HTTPUploadStatus;
+
+struct HTTPUpload {
+    HTTPUploadStatus status;
+    String filename;
+    String name;
+    String type;
+    size_t totalSize;
+    size_t currentSize;
+    uint8_t buf[1436];
+};
+
+// Serves the routes over a POSIX socket on 127.0.0.1:HostDevice::httpPort,
+// one connection per handleClient() call like the ESP32 WebServer. Requests
+// are HTTP/1.x with Connection: close; query and urlencoded body parameters
+// both show up as args, and any other body as arg("plain").
+class WebServer {
+public:
+    typedef std::function<void()> Handler;
+
+    explicit WebServer(int port = 80) : port(port) {}
+    ~WebServer() { stop(); }
+    void begin();
+    void stop();
+    void enableCORS(bool enable = true) { cors = enable; }
+    void on(const String& uri, Handler handler) { on(uri, HTTP_ANY, handler); }
+    void on(const String& uri, HTTPMethod method, Handler handler) { routes.push_back({uri, method, handler}); }
+    void on(const String& uri, HTTPMethod method, Handler handler, Handler upload) {
+        (void)upload;
+        on(uri, method, handler);
+    }
+    void onNotFound(Handler handler) { notFound = handler; }
+    void handleClient();
+
+    void send(int code, const char* contentType, const String& content);
+    void sendHeader(const String& name, const String& value, bool first = false);
+    bool hasArg(const String& name) const;
+    String arg(const String& name) const;
+    HTTPMethod method() const { return requestMethod; }
+    String uri() const { return requestUri; }
+    HTTPUpload& upload() { return currentUpload; }
+
+private:
+    struct Route {
+        String uri;
+        HTTPMethod method;
+        Handler handler;
+    };
+
+    int port;
+    std::vector<Route> routes;
+    Handler notFound;
+    HTTPUpload currentUpload;
+    bool cors = false;
+
+    int listenFd = -1;
+    int clientFd = -1;
+    bool responded = false;
+    HTTPMethod requestMethod = HTTP_GET;
+    String requestUri;
+    std::vector<std::pair<String, String>> args;
+    String pendingHeaders;
+
+    bool readRequest();
+    void parseArgs(const std::string& encoded);
+};
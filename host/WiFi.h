@@ -0,0 +1,73 @@
+#pragma once
+#include "Arduino.h"
+#include <string>
+
+typedef enum {
+    WIFI_OFF,
+    WIFI_STA,
+    WIFI_AP,
+    WIFI_AP_STA
+} wifi_mode_t;
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+// Radio state of the current device (HostDevice::wifiMode, apReachable, associationMs)
+class WiFiClass {
+public:
+    bool mode(wifi_mode_t mode);
+    wifi_mode_t getMode();
+    wl_status_t begin(const char* ssid, const char* password = nullptr);
+    wl_status_t status();
+    bool disconnect(bool wifiOff = false);
+    bool softAP(const char* ssid, const char* password = nullptr);
+    bool softAPConfig(IPAddress local, IPAddress gateway, IPAddress subnet);
+    IPAddress localIP();
+    IPAddress softAPIP();
+    int8_t RSSI();
+    String macAddress();
+};
+
+extern WiFiClass WiFi;
+
+struct HostDevice;
+
+// TCP over a POSIX socket. connect() goes to the HostDevice's serverHost at
+// brokerPort whatever host it names, and only while the radio is associated.
+// The connection drops (the peer sees it close) once the radio that opened
+// it goes off. HTTPClient streams its responses through one of these too.
+class WiFiClient {
+public:
+    WiFiClient() = default;
+    WiFiClient(const WiFiClient&) = delete;
+    WiFiClient& operator=(const WiFiClient&) = delete;
+    ~WiFiClient() { stop(); }
+    int available();
+    int read();
+    size_t readBytes(uint8_t* buffer, size_t length);
+    size_t write(const uint8_t* buffer, size_t length);
+    size_t write(uint8_t byte) { return write(&byte, 1); }
+    int connect(const char* host, uint16_t port);
+    bool connected();
+    void stop();
+    void setTimeout(unsigned long timeoutMs) { (void)timeoutMs; }
+
+    // Host side, for HTTPClient
+    int fd = -1;
+    std::string buffered;   // Received, not yet read
+    // Blocking connect with timeoutMs for it and every read and write after
+    bool connectTo(const std::string& host, int port, int timeoutMs);
+    // Reads until length bytes are buffered (-1: until the peer closes) or
+    // nothing arrives for waitMs
+    void receive(int length, int waitMs);
+
+private:
+    bool closed = false;
+    HostDevice* device = nullptr;   // Whose radio carries the connection
+    bool fill(int waitMs);
+};
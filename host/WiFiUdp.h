@@ -0,0 +1,10 @@
+#pragma once
+#include "WiFi.h"
+
+// Datagrams go nowhere on the host
+class WiFiUDP {
+public:
+    int beginPacket(const char* host, uint16_t port) { (void)host; (void)port; return 1; }
+    size_t write(const uint8_t* buffer, size_t size) { (void)buffer; return size; }
+    int endPacket() { return 1; }
+};
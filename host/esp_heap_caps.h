@@ -0,0 +1,9 @@
+#pragma once
+#include <cstddef>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DEFAULT (1 << 12)
+
+// Usable size of a malloc() block, from the host allocator
+size_t heap_caps_get_allocated_size(void* ptr);
+void heap_caps_free(void* ptr);
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "esp_err.h"
+#include "esp_partition.h"
+
+// Two app partitions, app0 and app1, whose contents are
+// HostDevice::otaImage. esp_ota_end() checks the image magic byte like the
+// real one checks the image header.
+typedef uint32_t esp_ota_handle_t;
+
+typedef enum {
+    ESP_OTA_IMG_NEW,
+    ESP_OTA_IMG_PENDING_VERIFY,
+    ESP_OTA_IMG_VALID,
+    ESP_OTA_IMG_INVALID,
+    ESP_OTA_IMG_ABORTED,
+    ESP_OTA_IMG_UNDEFINED = -1
+} esp_ota_img_states_t;
+
+const esp_partition_t* esp_ota_get_running_partition();
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start);
+esp_err_t esp_ota_begin(const esp_partition_t* partition, size_t imageSize, esp_ota_handle_t* handle);
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void* data, size_t size);
+esp_err_t esp_ota_end(esp_ota_handle_t handle);
+esp_err_t esp_ota_abort(esp_ota_handle_t handle);
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition);
+esp_err_t esp_ota_get_state_partition(const esp_partition_t* partition, esp_ota_img_states_t* state);
+esp_err_t esp_ota_mark_app_valid_cancel_rollback();
+int esp_ota_get_app_elf_sha256(char* dst, size_t size);
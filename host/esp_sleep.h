@@ -0,0 +1,7 @@
+#pragma once
+#include <cstdint>
+#include "esp_err.h"
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t timeUs);
+// Advances the device clock to the wakeup (or really sleeps on a real-time clock)
+esp_err_t esp_light_sleep_start();
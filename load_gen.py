@@ -0,0 +1,121 @@
+# load_gen.py
+# Drives a lamp's /api/status and /api/control with concurrent clients and
+# reports throughput, tail latency, heap use, control-loop deadline misses and
+# the load shedding level (from /api/loop), for increasing numbers of clients.
+#
+#   python load_gen.py                          -> smartlamp.local, 1/2/4/8 clients, 10 s each
+#   python load_gen.py 192.168.68.50 --clients 1,4,16 --seconds 30
+#
+# The first level that shows deadline misses is roughly the request rate the
+# control loop can't absorb.
+import json
+import random
+import sys
+import threading
+import time
+import urllib.error
+import urllib.parse
+import urllib.request
+
+TIMEOUT_S = 5
+CONTROL_SHARE = 0.25    # Fraction of requests that go to /api/control
+
+
+def request(url, data=None):
+    body = urllib.parse.urlencode(data).encode() if data is not None else None
+    with urllib.request.urlopen(url, data=body, timeout=TIMEOUT_S) as response:
+        return response.read()
+
+
+def client(base, stop, latencies, errors, lock):
+    rng = random.Random()
+    while not stop.is_set():
+        start = time.perf_counter()
+        try:
+            if rng.random() < CONTROL_SHARE:
+                request(base + '/api/control', {'brightness': rng.randint(10, 90)})
+            else:
+                request(base + '/api/status')
+            elapsed = time.perf_counter() - start
+            with lock:
+                latencies.append(elapsed)
+        except (urllib.error.URLError, OSError):
+            with lock:
+                errors[0] += 1
+
+
+def percentile(values, fraction):
+    if not values:
+        return float('nan')
+    ordered = sorted(values)
+    return ordered[min(int(len(ordered) * fraction), len(ordered) - 1)]
+
+
+def run_level(base, clients, seconds):
+    request(base + '/api/loop?reset=1')
+    time.sleep(0.5)  # Let the loop task apply the reset
+
+    stop = threading.Event()
+    latencies, errors, lock = [], [0], threading.Lock()
+    threads = [threading.Thread(target=client, args=(base, stop, latencies, errors, lock))
+               for _ in range(clients)]
+    for thread in threads:
+        thread.start()
+    time.sleep(seconds)
+    stop.set()
+    for thread in threads:
+        thread.join()
+
+    loop = json.loads(request(base + '/api/loop'))
+    return {
+        'clients': clients,
+        'rate': len(latencies) / seconds,
+        'p50': percentile(latencies, 0.50) * 1000,
+        'p99': percentile(latencies, 0.99) * 1000,
+        'max': max(latencies) * 1000 if latencies else float('nan'),
+        'errors': errors[0],
+        'misses': loop['deadlineMisses'],
+        'overruns': loop.get('overruns', 0),
+        'shed': loop.get('shedLevel', '-'),
+        'blame': loop.get('blame', {}),
+        'late99': loop['latenessP99Us'] / 1000,
+        'heap': loop['freeHeap'],
+        'minHeap': loop['minFreeHeap'],
+    }
+
+
+def main(argv):
+    host, levels, seconds = 'smartlamp.local', [1, 2, 4, 8], 10
+    args = iter(argv)
+    for arg in args:
+        if arg == '--clients':
+            levels = [int(n) for n in next(args).split(',')]
+        elif arg == '--seconds':
+            seconds = float(next(args))
+        else:
+            host = arg
+    base = f'http://{host}'
+
+    print(f'{"clients":>7} {"req/s":>7} {"p50 ms":>7} {"p99 ms":>7} {"max ms":>7} {"errors":>6} '
+          f'{"misses":>6} {"overrun":>7} {"late p99":>8} {"heap":>7} {"min heap":>8}  shedding')
+    first_miss = None
+    for clients in levels:
+        r = run_level(base, clients, seconds)
+        print(f'{r["clients"]:>7} {r["rate"]:>7.1f} {r["p50"]:>7.1f} {r["p99"]:>7.1f} {r["max"]:>7.1f} '
+              f'{r["errors"]:>6} {r["misses"]:>6} {r["overruns"]:>7} {r["late99"]:>6.1f}ms {r["heap"]:>7} '
+              f'{r["minHeap"]:>8}  {r["shed"]}')
+        if r['misses'] and first_miss is None:
+            first_miss = r
+    if first_miss:
+        print(f'Control loop starts missing deadlines at ~{first_miss["rate"]:.0f} req/s '
+              f'({first_miss["clients"]} clients)')
+        blamed = sorted(((n, k) for k, n in first_miss['blame'].items() if n), reverse=True)
+        if blamed:
+            print('Blamed on: ' + ', '.join(f'{k} {n}' for n, k in blamed))
+    else:
+        print('No deadline misses at these load levels')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
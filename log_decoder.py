@@ -0,0 +1,89 @@
+# log_decoder.py
+# Receives DeferredLog records over UDP (firmware built with DEFERRED_LOG_UDP=true)
+# and rebuilds the log text.
+import re
+import socket
+import struct
+import sys
+
+FRAME_FORMAT = 0xD0  # id:u16, length:u8, format bytes
+FRAME_RECORD = 0xA0  # timestamp:u32, id:u16, wordCount:u8, args:u32[], textLength:u8, text
+
+SPEC_PATTERN = re.compile(r'%(?:%|[-+ #0]*\d*(?:\.\d+)?([hl]*)([diuxXcsfeEgGp]))')
+
+
+def format_record(fmt, words, text=b''):
+    """Apply a C format string to the raw 32-bit argument words.
+
+    long long takes two words (long is 32 bits on the lamp); a %s word is
+    the offset of the copied string in the record's text.
+    """
+    args = iter(words)
+
+    def replace(match):
+        conversion = match.group(2)
+        if conversion is None:
+            return '%'
+        word = next(args, 0)
+        spec = re.sub('[hl]', '', match.group(0))
+        if conversion in 'feEgG':
+            return spec % struct.unpack('<f', struct.pack('<I', word))[0]
+        if conversion in 's':
+            end = text.find(b'\0', word)
+            return spec % text[word:end if end >= 0 else len(text)].decode('utf-8', 'replace')
+        if conversion == 'p':
+            return f'0x{word:08x}'
+        if conversion == 'c':
+            return spec % chr(word & 0xFF)
+        bits = 32
+        if match.group(1).count('l') >= 2:
+            word |= next(args, 0) << 32
+            bits = 64
+        if conversion in 'di':
+            if word >= 1 << (bits - 1):
+                word -= 1 << bits
+            return spec % word
+        if conversion == 'u':
+            return spec.replace('u', 'd') % word
+        return spec % word
+
+    return SPEC_PATTERN.sub(replace, fmt)
+
+
+def decode_packet(packet, formats, source):
+    if not packet:
+        return None
+
+    if packet[0] == FRAME_FORMAT:
+        format_id, length = struct.unpack_from('<HB', packet, 1)
+        formats[(source, format_id)] = packet[4:4 + length].decode('utf-8', 'replace')
+        return None
+
+    if packet[0] == FRAME_RECORD:
+        timestamp, format_id, word_count = struct.unpack_from('<IHB', packet, 1)
+        words = struct.unpack_from(f'<{word_count}I', packet, 8)
+        text_start = 8 + word_count * 4
+        text = packet[text_start + 1:text_start + 1 + packet[text_start]] if len(packet) > text_start else b''
+        fmt = formats.get((source, format_id))
+        if fmt is None:
+            return f'[{timestamp:>10} ms] <unknown format {format_id}> {words}'
+        return f'[{timestamp:>10} ms] ' + format_record(fmt, words, text).rstrip('\n')
+
+    return None
+
+
+def main(port=5001):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(('0.0.0.0', port))
+    print(f'Listening for lamp logs on UDP port {port}')
+
+    formats = {}
+    while True:
+        packet, (source, _) = sock.recvfrom(512)
+        line = decode_packet(packet, formats, source)
+        if line is not None:
+            print(f'{source}: {line}')
+
+
+if __name__ == '__main__':
+    main(int(sys.argv[1]) if len(sys.argv) > 1 else 5001)
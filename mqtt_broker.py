@@ -0,0 +1,461 @@
+# mqtt_broker.py
+# Minimal MQTT 3.1.1 broker standing in for a real one (e.g. mosquitto) when
+# testing the TELEMETRY_MQTT builds (src/network/MqttTransport.cpp). Telemetry
+# batches are written to lamp_data/<device_id>.csv in the same format as
+# data_server.py, and wire bytes per report are printed for every session.
+#
+#   python mqtt_broker.py                 -> listen on 1883; type "<device_id> <0-100>" to set a lamp's brightness
+#   python mqtt_broker.py --port 0 --data-dir /tmp/lamp_data   -> any free port, printed at start
+#   python mqtt_broker.py --selftest      -> fake lamp against the broker, plus per-report overhead vs HTTP POST
+#
+# Supports what the lamp uses: persistent sessions (clean session off), QoS 0
+# and 1, retained messages, wills and keepalive pings. No auth, no QoS 2.
+import csv
+import json
+import os
+import socket
+import socketserver
+import struct
+import sys
+import tempfile
+import threading
+import time
+from collections import OrderedDict
+from datetime import datetime
+
+CONNECT, CONNACK, PUBLISH, PUBACK = 1, 2, 3, 4
+SUBSCRIBE, SUBACK, PINGREQ, PINGRESP, DISCONNECT = 8, 9, 12, 13, 14
+
+TCP_IP_HEADER = 40      # IPv4 + TCP without options, per segment
+MSS = 1436              # What the ESP32's lwIP negotiates on a typical LAN
+
+
+def encode_length(n):
+    out = bytearray()
+    while True:
+        byte, n = n % 128, n // 128
+        out.append(byte | (0x80 if n else 0))
+        if not n:
+            return bytes(out)
+
+
+def encode_string(s):
+    data = s.encode() if isinstance(s, str) else s
+    return struct.pack('>H', len(data)) + data
+
+
+def packet(kind, flags, body):
+    return bytes([kind << 4 | flags]) + encode_length(len(body)) + body
+
+
+def read_packet(sock):
+    """Returns (kind, flags, body, wire_bytes) or None when the peer closed."""
+    first = sock.recv(1)
+    if not first:
+        return None
+    length, shift, header = 0, 0, 1
+    while True:
+        byte = sock.recv(1)
+        if not byte:
+            return None
+        header += 1
+        length += (byte[0] & 0x7F) << shift
+        shift += 7
+        if not byte[0] & 0x80:
+            break
+    body = b''
+    while len(body) < length:
+        chunk = sock.recv(length - len(body))
+        if not chunk:
+            return None
+        body += chunk
+    return first[0] >> 4, first[0] & 0x0F, body, header + length
+
+
+def read_string(body, offset):
+    (length,) = struct.unpack_from('>H', body, offset)
+    return body[offset + 2:offset + 2 + length], offset + 2 + length
+
+
+def topic_matches(pattern, topic):
+    p, t = pattern.split('/'), topic.split('/')
+    for i, part in enumerate(p):
+        if part == '#':
+            return True
+        if i >= len(t) or (part != '+' and part != t[i]):
+            return False
+    return len(p) == len(t)
+
+
+class Session:
+    def __init__(self):
+        self.subscriptions = {}     # topic filter -> granted QoS
+        self.inflight = OrderedDict()   # packet id -> (topic, payload), QoS 1 not yet acked
+        self.next_id = 1
+        self.handler = None
+        self.will = None
+        self.clean = True
+
+
+class Broker:
+    def __init__(self, data_dir='lamp_data', quiet=False):
+        self.data_dir = data_dir
+        self.quiet = quiet
+        self.lock = threading.RLock()
+        self.sessions = {}
+        self.retained = {}
+        self.stats = []     # (client_id, reports, wire bytes) per closed session
+
+    def log(self, message):
+        if not self.quiet:
+            print(message, flush=True)
+
+    def publish(self, topic, payload, qos=0, retain=False):
+        with self.lock:
+            if retain:
+                self.retained[topic] = payload
+            for session in self.sessions.values():
+                granted = max((q for f, q in session.subscriptions.items() if topic_matches(f, topic)), default=None)
+                if granted is not None:
+                    self.deliver(session, topic, payload, min(qos, granted))
+        if topic.endswith('/telemetry'):
+            return self.store(payload)
+        return 0
+
+    def deliver(self, session, topic, payload, qos):
+        if qos == 0:
+            if session.handler:
+                session.handler.send(packet(PUBLISH, 0, encode_string(topic) + payload))
+            return
+        packet_id = session.next_id
+        session.next_id = session.next_id % 65535 + 1
+        session.inflight[packet_id] = (topic, payload)
+        if session.handler:
+            session.handler.send_inflight(packet_id, topic, payload)
+
+    def store(self, payload):
+        try:
+            reports = json.loads(payload)
+        except ValueError:
+            self.log(f'Ignoring malformed telemetry: {payload[:60]!r}')
+            return 0
+        if isinstance(reports, dict):
+            reports = [reports]
+        os.makedirs(self.data_dir, exist_ok=True)
+        for report in reports:
+            filename = os.path.join(self.data_dir, f'{report["device_id"]}.csv')
+            file_exists = os.path.isfile(filename)
+            with open(filename, 'a', newline='') as f:
+                writer = csv.DictWriter(f, fieldnames=['timestamp', 'device_id', 'voltage', 'position'])
+                if not file_exists:
+                    writer.writeheader()
+                writer.writerow({'timestamp': datetime.now().isoformat(), 'device_id': report['device_id'],
+                                 'voltage': report['voltage'], 'position': report['position']})
+        return len(reports)
+
+
+class ClientHandler(socketserver.BaseRequestHandler):
+    def setup(self):
+        self.send_lock = threading.Lock()
+        self.client_id = None
+        self.session = None
+        self.keepalive = 0
+        self.wire_bytes = 0
+        self.reports = 0
+
+    def send(self, data):
+        with self.send_lock:
+            self.wire_bytes += len(data)
+            self.request.sendall(data)
+
+    def send_inflight(self, packet_id, topic, payload):
+        self.send(packet(PUBLISH, 0x02, encode_string(topic) + struct.pack('>H', packet_id) + payload))
+
+    def handle(self):
+        broker = self.server.broker
+        clean_exit = False
+        try:
+            while True:
+                if self.keepalive:
+                    self.request.settimeout(self.keepalive * 1.5)
+                received = read_packet(self.request)
+                if received is None:
+                    break
+                kind, flags, body, size = received
+                self.wire_bytes += size
+                if kind == CONNECT:
+                    self.on_connect(body)
+                elif kind == PUBLISH:
+                    self.on_publish(flags, body)
+                elif kind == PUBACK:
+                    with broker.lock:
+                        self.session.inflight.pop(struct.unpack('>H', body)[0], None)
+                elif kind == SUBSCRIBE:
+                    self.on_subscribe(body)
+                elif kind == PINGREQ:
+                    self.send(packet(PINGRESP, 0, b''))
+                elif kind == DISCONNECT:
+                    clean_exit = True
+                    break
+        except (socket.timeout, ConnectionError, OSError):
+            pass
+        finally:
+            self.close(clean_exit)
+
+    def on_connect(self, body):
+        broker = self.server.broker
+        _, offset = read_string(body, 0)
+        _, connect_flags, self.keepalive = struct.unpack_from('>BBH', body, offset)
+        client_id, offset = read_string(body, offset + 4)
+        self.client_id = client_id.decode()
+        will = None
+        if connect_flags & 0x04:
+            will_topic, offset = read_string(body, offset)
+            will_message, offset = read_string(body, offset)
+            will = (will_topic.decode(), will_message, (connect_flags >> 3) & 3, bool(connect_flags & 0x20))
+        clean = bool(connect_flags & 0x02)
+
+        with broker.lock:
+            present = self.client_id in broker.sessions and not clean
+            if not present:
+                broker.sessions[self.client_id] = Session()
+            self.session = broker.sessions[self.client_id]
+            self.session.handler = self
+            self.session.will = will
+            self.session.clean = clean
+            self.send(packet(CONNACK, 0, bytes([1 if present else 0, 0])))
+            # Persistent session: resend whatever the client missed while it was away
+            for packet_id, (topic, payload) in self.session.inflight.items():
+                self.send_inflight(packet_id, topic, payload)
+        broker.log(f'{self.client_id} connected ({"clean" if clean else "persistent"} session'
+                   f'{", resumed" if present else ""}, keepalive {self.keepalive}s)')
+
+    def on_publish(self, flags, body):
+        qos, retain = (flags >> 1) & 3, bool(flags & 1)
+        topic, offset = read_string(body, 0)
+        if qos:
+            packet_id = body[offset:offset + 2]
+            offset += 2
+            self.send(packet(PUBACK, 0, packet_id))
+        self.reports += self.server.broker.publish(topic.decode(), body[offset:], qos, retain)
+
+    def on_subscribe(self, body):
+        broker = self.server.broker
+        packet_id, offset, granted = body[:2], 2, []
+        while offset < len(body):
+            topic, offset = read_string(body, offset)
+            qos = min(body[offset], 1)
+            offset += 1
+            granted.append(qos)
+            with broker.lock:
+                self.session.subscriptions[topic.decode()] = qos
+                retained = [(t, p) for t, p in broker.retained.items() if topic_matches(topic.decode(), t)]
+            for t, p in retained:
+                broker.deliver(self.session, t, p, qos)
+        self.send(packet(SUBACK, 0, packet_id + bytes(granted)))
+
+    def close(self, clean_exit):
+        broker = self.server.broker
+        if self.session is None:
+            return
+        with broker.lock:
+            if self.session.handler is self:
+                self.session.handler = None
+                if self.session.clean:
+                    broker.sessions.pop(self.client_id, None)
+            will = None if clean_exit else self.session.will
+        if will:
+            broker.publish(will[0], will[1], will[2], will[3])
+        broker.stats.append((self.client_id, self.reports, self.wire_bytes))
+        per_report = f', {self.wire_bytes / self.reports:.0f} B/report' if self.reports else ''
+        broker.log(f'{self.client_id} {"disconnected" if clean_exit else "dropped"}: '
+                   f'{self.reports} reports, {self.wire_bytes} bytes{per_report}')
+
+
+class Server(socketserver.ThreadingTCPServer):
+    allow_reuse_address = True
+    daemon_threads = True
+
+    def __init__(self, port, broker):
+        super().__init__(('0.0.0.0', port), ClientHandler)
+        self.broker = broker
+
+
+def start(port, broker):
+    server = Server(port, broker)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    return server
+
+
+# --- Self test: a fake lamp doing what MqttTransport does -------------------
+
+class FakeLamp:
+    def __init__(self, port, device_id):
+        self.device_id = device_id
+        self.sock = socket.create_connection(('127.0.0.1', port), timeout=2)
+        self.sent = 0
+
+    def send(self, data):
+        self.sent += len(data)
+        self.sock.sendall(data)
+
+    def connect(self):
+        status = f'lamp/{self.device_id}/status'
+        body = (encode_string('MQTT') + bytes([4, 0x04 | 0x08 | 0x20]) + struct.pack('>H', 60) +
+                encode_string(f'lamp-{self.device_id}') + encode_string(status) + encode_string('offline'))
+        self.send(packet(CONNECT, 0, body))
+        kind, _, body, _ = read_packet(self.sock)
+        assert kind == CONNACK and body[1] == 0, 'connection refused'
+        self.send(packet(SUBSCRIBE, 2, b'\x00\x01' + encode_string(f'lamp/{self.device_id}/brightness') + b'\x01'))
+        self.send(packet(PUBLISH, 1, encode_string(status) + b'online'))
+        return body[0] == 1
+
+    def receive(self, timeout=0.5):
+        """Brightness commands that arrive within timeout, acking QoS 1 like PubSubClient."""
+        commands = []
+        self.sock.settimeout(timeout)
+        try:
+            while True:
+                received = read_packet(self.sock)
+                if received is None:
+                    break
+                kind, flags, body, _ = received
+                if kind == PUBLISH:
+                    topic, offset = read_string(body, 0)
+                    if flags & 0x06:
+                        self.send(packet(PUBACK, 0, body[offset:offset + 2]))
+                        offset += 2
+                    if topic.endswith(b'/brightness'):
+                        commands.append(float(body[offset:]))
+        except socket.timeout:
+            pass
+        self.sock.settimeout(2)
+        return commands
+
+    def publish_batch(self, reports):
+        payload = ('[' + ','.join(reports) + ']').encode()
+        self.send(packet(PUBLISH, 0, encode_string(f'lamp/{self.device_id}/telemetry') + payload))
+
+    def disconnect(self):
+        self.send(packet(PUBLISH, 1, encode_string(f'lamp/{self.device_id}/status') + b'offline'))
+        self.send(packet(DISCONNECT, 0, b''))
+        self.sock.close()
+
+
+def report(device_id, i):
+    # Same format as LampController::getMonitoringData()
+    return f'{{"device_id":"{device_id}","voltage":{11.4 - i * 0.01:.2f},"position":{50 + i:.1f}}}'
+
+
+def tcp_overhead(sent, received, connection=True):
+    """IP/TCP header bytes: data segments each way, their ACKs, and optionally handshake + teardown."""
+    segments = -(-sent // MSS) + -(-received // MSS)
+    segments *= 2   # Each data segment is acked
+    if connection:
+        segments += 3 + 4
+    return segments * TCP_IP_HEADER
+
+
+def http_exchange(report_body):
+    """Bytes of one data_server.py POST as HTTPClient sends it, and Flask's reply."""
+    request = ('POST /api/log HTTP/1.1\r\nHost: 192.168.68.109:4999\r\nUser-Agent: ESP32HTTPClient\r\n'
+               'Connection: close\r\nAccept-Encoding: identity;q=1,chunked;q=0.1,*;q=0\r\n'
+               f'Content-Type: application/json\r\nContent-Length: {len(report_body)}\r\n\r\n{report_body}')
+    reply_body = '{"message":"Data logged successfully","status":"success"}\n'
+    reply = ('HTTP/1.1 200 OK\r\nServer: Werkzeug/3.0.1 Python/3.11.6\r\n'
+             'Date: Sat, 18 Oct 2026 12:00:00 GMT\r\nContent-Type: application/json\r\n'
+             f'Content-Length: {len(reply_body)}\r\nConnection: close\r\n\r\n{reply_body}')
+    return len(request), len(reply)
+
+
+def selftest():
+    device_id = '0000A1B2C3D4E5F6'
+    batch_size = 6      # LampConfig::MQTT_BATCH_SIZE
+    failures = []
+
+    with tempfile.TemporaryDirectory() as data_dir:
+        broker = Broker(data_dir, quiet=True)
+        server = start(0, broker)
+        port = server.server_address[1]
+
+        # First connect creates the persistent session and its subscription
+        lamp = FakeLamp(port, device_id)
+        lamp.connect()
+        lamp.disconnect()
+
+        # A command sent while the lamp's radio is off is held for it
+        broker.publish(f'lamp/{device_id}/brightness', b'40', qos=1)
+
+        lamp = FakeLamp(port, device_id)
+        resumed = lamp.connect()
+        commands = lamp.receive()
+        lamp.publish_batch([report(device_id, i) for i in range(batch_size)])
+        lamp.disconnect()
+        time.sleep(0.2)
+
+        if not resumed:
+            failures.append('session was not resumed')
+        if commands != [40.0]:
+            failures.append(f'expected the offline brightness command, got {commands}')
+        with open(os.path.join(data_dir, f'{device_id}.csv')) as f:
+            rows = list(csv.DictReader(f))
+        if len(rows) != batch_size:
+            failures.append(f'expected {batch_size} rows in the CSV, got {len(rows)}')
+        if broker.retained.get(f'lamp/{device_id}/status') != b'offline':
+            failures.append('status topic not left at offline')
+        server.shutdown()
+        server.server_close()
+
+        client_id, reports, window_bytes = broker.stats[-1]
+
+    # Per-report bytes: the HTTP path opens a connection per report; the MQTT
+    # logging build opens one per batch (connect, subscribe, status, publish,
+    # disconnect); an always-on MQTT session pays only the publish.
+    sample = report(device_id, 0)
+    http_sent, http_received = http_exchange(sample)
+    http = http_sent + http_received + tcp_overhead(http_sent, http_received)
+
+    mqtt_window = window_bytes + tcp_overhead(window_bytes // 2, window_bytes // 2)
+    publish = len(packet(PUBLISH, 0, encode_string(f'lamp/{device_id}/telemetry') +
+                         ('[' + ','.join([sample] * batch_size) + ']').encode()))
+    mqtt_session = publish + tcp_overhead(publish, 0, connection=False)
+
+    print(f'report payload                      {len(sample):4d} B')
+    print(f'HTTP POST per report                {http:4d} B  ({http_sent} request, {http_received} reply, '
+          f'{http - http_sent - http_received} TCP/IP)')
+    print(f'MQTT, radio up per batch of {batch_size}       {mqtt_window / batch_size:4.0f} B  '
+          f'({window_bytes} B measured + TCP/IP per window)')
+    print(f'MQTT, session already open          {mqtt_session / batch_size:4.0f} B')
+
+    for failure in failures:
+        print(f'FAILED: {failure}')
+    if not failures:
+        print('Broker self test passed')
+    return 1 if failures else 0
+
+
+def main(argv):
+    if '--selftest' in argv:
+        return selftest()
+    port = 1883
+    if '--port' in argv:
+        port = int(argv[argv.index('--port') + 1])
+    data_dir = 'lamp_data'
+    if '--data-dir' in argv:
+        data_dir = argv[argv.index('--data-dir') + 1]
+
+    broker = Broker(data_dir)
+    server = start(port, broker)
+    print(f'MQTT broker on port {server.server_address[1]}; enter "<device_id> <brightness>" to send a command',
+          flush=True)
+    for line in sys.stdin:
+        parts = line.split()
+        if len(parts) != 2:
+            print('usage: <device_id> <0-100>')
+            continue
+        broker.publish(f'lamp/{parts[0]}/brightness', parts[1].encode(), qos=1)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
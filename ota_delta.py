@@ -0,0 +1,168 @@
+# ota_delta.py
+# Builds and applies the binary deltas consumed by DeltaOta on the lamp.
+#
+#   python ota_delta.py make old.bin new.bin        -> firmware/deltas/<old elf sha>.ldp
+#   python ota_delta.py apply old.bin patch.ldp out.bin
+#   python ota_delta.py bench old.bin new.bin       -> patch size and apply throughput
+#
+# old.bin must be exactly the image running on the lamp (.pio/build/<env>/firmware.bin).
+import hashlib
+import os
+import struct
+import sys
+import time
+
+MAGIC = b'LDP1'
+OP_END = 0x00
+OP_COPY = 0x01
+OP_INSERT = 0x02
+
+BLOCK = 16          # Minimum match length worth a COPY op
+INDEX_STEP = 4      # Index every 4th source offset; matches are extended backwards
+
+# esp_image_header_t (24) + first segment header (8) + offset of elf_sha256 in esp_app_desc_t
+APP_DESC_ELF_SHA_OFFSET = 24 + 8 + 144
+
+
+def elf_sha_prefix(image):
+    """The 16 hex chars the lamp reports from esp_ota_get_app_elf_sha256()."""
+    return image[APP_DESC_ELF_SHA_OFFSET:APP_DESC_ELF_SHA_OFFSET + 8].hex()
+
+
+def make_patch(source, target):
+    index = {}
+    for offset in range(0, len(source) - BLOCK + 1, INDEX_STEP):
+        index.setdefault(source[offset:offset + BLOCK], offset)
+
+    ops = []
+    literal_start = 0
+    position = 0
+    while position <= len(target) - BLOCK:
+        src = index.get(target[position:position + BLOCK])
+        if src is None:
+            position += 1
+            continue
+
+        # Extend the match backwards into the pending literal, then forwards
+        start, src_start = position, src
+        while start > literal_start and src_start > 0 and target[start - 1] == source[src_start - 1]:
+            start -= 1
+            src_start -= 1
+        end, src_end = position + BLOCK, src + BLOCK
+        while end < len(target) and src_end < len(source) and target[end] == source[src_end]:
+            end += 1
+            src_end += 1
+
+        if start > literal_start:
+            ops.append((OP_INSERT, target[literal_start:start]))
+        ops.append((OP_COPY, src_start, end - start))
+        literal_start = position = end
+
+    if literal_start < len(target):
+        ops.append((OP_INSERT, target[literal_start:]))
+
+    patch = bytearray(MAGIC)
+    patch += struct.pack('<II', len(source), len(target))
+    patch += hashlib.sha256(source).digest()
+    patch += hashlib.sha256(target).digest()
+    for op in ops:
+        if op[0] == OP_COPY:
+            patch += struct.pack('<BII', OP_COPY, op[1], op[2])
+        else:
+            patch += struct.pack('<BI', OP_INSERT, len(op[1]))
+            patch += op[1]
+    patch.append(OP_END)
+    return bytes(patch)
+
+
+def apply_patch(source, patch):
+    """Reference implementation of DeltaOta::write()/finish()."""
+    if patch[:4] != MAGIC:
+        raise ValueError('bad header')
+    source_size, target_size = struct.unpack_from('<II', patch, 4)
+    source_sha, target_sha = patch[12:44], patch[44:76]
+    if len(source) < source_size or hashlib.sha256(source[:source_size]).digest() != source_sha:
+        raise ValueError('wrong base image')
+
+    out = bytearray()
+    position = 76
+    while True:
+        op = patch[position]
+        if op == OP_END:
+            break
+        if op == OP_COPY:
+            offset, length = struct.unpack_from('<II', patch, position + 1)
+            if offset + length > source_size:
+                raise ValueError('bad patch')
+            out += source[offset:offset + length]
+            position += 9
+        elif op == OP_INSERT:
+            (length,) = struct.unpack_from('<I', patch, position + 1)
+            out += patch[position + 5:position + 5 + length]
+            position += 5 + length
+        else:
+            raise ValueError('bad patch')
+
+    if len(out) != target_size or hashlib.sha256(out).digest() != target_sha:
+        raise ValueError('verify failed')
+    return bytes(out)
+
+
+def read(path):
+    with open(path, 'rb') as f:
+        return f.read()
+
+
+def main(argv):
+    if len(argv) >= 3 and argv[0] == 'make':
+        source, target = read(argv[1]), read(argv[2])
+        out_path = argv[3] if len(argv) > 3 else os.path.join(
+            'firmware', 'deltas', f'{elf_sha_prefix(source)}.ldp')
+        os.makedirs(os.path.dirname(out_path) or '.', exist_ok=True)
+        patch = make_patch(source, target)
+        with open(out_path, 'wb') as f:
+            f.write(patch)
+        print(f'{out_path}: {len(patch)} bytes ({len(patch) / len(target) * 100:.1f}% of full image)')
+
+    elif len(argv) == 4 and argv[0] == 'apply':
+        target = apply_patch(read(argv[1]), read(argv[2]))
+        with open(argv[3], 'wb') as f:
+            f.write(target)
+        print(f'{argv[3]}: {len(target)} bytes, verified')
+
+    elif len(argv) == 3 and argv[0] == 'bench':
+        source, target = read(argv[1]), read(argv[2])
+        start = time.perf_counter()
+        patch = make_patch(source, target)
+        diff_time = time.perf_counter() - start
+
+        start = time.perf_counter()
+        apply_patch(source, patch)
+        apply_time = time.perf_counter() - start
+
+        copied = 0
+        position = 76
+        while patch[position] != OP_END:
+            if patch[position] == OP_COPY:
+                copied += struct.unpack_from('<I', patch, position + 5)[0]
+                position += 9
+            else:
+                position += 5 + struct.unpack_from('<I', patch, position + 1)[0]
+
+        print(f'target image:    {len(target)} bytes')
+        print(f'patch:           {len(patch)} bytes ({len(patch) / len(target) * 100:.1f}%)')
+        print(f'copied from old: {copied / len(target) * 100:.1f}% of target')
+        print(f'diff time:       {diff_time:.2f} s')
+        print(f'apply:           {len(target) / apply_time / 1e6:.1f} MB/s (host reference)')
+
+    else:
+        print('usage: ota_delta.py make|apply|bench ...')
+        print('  make old.bin new.bin [out.ldp]')
+        print('  apply old.bin patch.ldp out.bin')
+        print('  bench old.bin new.bin')
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,146 @@
+# program_preview.py
+# Compiles a brightness program the way the lamp does
+# (src/lamp/BrightnessProgram.cpp) and shows the result before you upload it:
+# the segments, the level over time, how far the straight pieces stray from
+# the exact curves, and how often the lamp has to wake up to run it.
+#
+#   python program_preview.py "start=0&delay=25200&steps=1800:100:exp"     -> sunrise in 7 hours
+#   python program_preview.py "delay=1740&steps=60:0" --upload smartlamp.local
+#
+# --upload POSTs the same arguments to /api/program once it compiles. With
+# radio=off in the query the lamp turns its radio off until the program has
+# ended; the light sleep shown below needs the radio off.
+import math
+import sys
+import urllib.parse
+import urllib.request
+
+# Mirror of LampConfig
+MAX_ANALOG = 1023
+PROGRAM_MAX_SEGMENTS = 64
+PROGRAM_CURVE_PIECES = 16
+PROGRAM_EXP_CURVE_K = 4.0
+PROGRAM_MAX_STEP_S = 86400
+PROGRAM_MAX_DELAY_S = 604800
+PROGRAM_LIGHT_SLEEP_MAX_MS = 500
+FAST_MS, SLOW_MS = 10, 100
+
+CURVES = {
+    'lin': lambda x: x,
+    'ease': lambda x: x * x * (3 - 2 * x),
+    'exp': lambda x: (math.exp(PROGRAM_EXP_CURVE_K * x) - 1) / (math.exp(PROGRAM_EXP_CURVE_K) - 1),
+}
+
+
+def to_value(percent):
+    return int(percent / 100 * MAX_ANALOG * 64 + 0.5)
+
+
+def compile_program(steps, start, delay_s):
+    """Segments (duration ms, from, to) in knob units * 64, and the exact level function."""
+    if not 0 <= start <= 100:
+        raise ValueError('start must be 0-100')
+    if delay_s > PROGRAM_MAX_DELAY_S:
+        raise ValueError('delay too long')
+    segments, exact = [], []
+    level = start
+    if delay_s > 0:
+        segments.append((delay_s * 1000, to_value(level), to_value(level)))
+        exact.append((delay_s * 1000, lambda x, l=level: l))
+    for step in filter(None, steps.split(',')):
+        parts = step.split(':')
+        seconds, target = float(parts[0]), float(parts[1])
+        curve = parts[2] if len(parts) > 2 else 'lin'
+        if not 0 < seconds <= PROGRAM_MAX_STEP_S:
+            raise ValueError('bad step duration')
+        if not 0 <= target <= 100:
+            raise ValueError('bad step level')
+        if curve not in CURVES:
+            raise ValueError('unknown curve')
+        shape = CURVES[curve]
+        duration = int(seconds * 1000)
+        pieces = 1 if curve == 'lin' else PROGRAM_CURVE_PIECES
+        for i in range(pieces):
+            piece_ms = duration * (i + 1) // pieces - duration * i // pieces
+            segments.append((piece_ms, to_value(level + (target - level) * shape(i / pieces)),
+                             to_value(level + (target - level) * shape((i + 1) / pieces))))
+        exact.append((duration, lambda x, l=level, t=target, s=shape: l + (t - l) * s(x)))
+        level = target
+    if len(segments) > PROGRAM_MAX_SEGMENTS:
+        raise ValueError('too many segments')
+    if not segments:
+        raise ValueError('no steps')
+    return segments, exact
+
+
+def level_at(pieces, t_ms, exact=False):
+    """Percent at t_ms into the program, from the compiled segments or the exact steps."""
+    for duration, *rest in pieces:
+        if t_ms < duration:
+            if exact:
+                return rest[0](t_ms / duration)
+            start, end = rest
+            return (start + (end - start) * t_ms / duration) / 64 / MAX_ANALOG * 100
+        t_ms -= duration
+    return None
+
+
+def wakes(segments):
+    """Loop passes needed, and the time spent in light sleep, mirroring LampController::updateProgram()."""
+    passes = dark_ms = 0
+    for duration, start, end in segments:
+        if start == end:
+            if start == 0:
+                # getLightSleepMs(): capped sleeps, each followed by a normal pass
+                cycles = math.ceil(duration / (PROGRAM_LIGHT_SLEEP_MAX_MS + SLOW_MS))
+                passes += 2 * cycles
+                dark_ms += min(cycles * PROGRAM_LIGHT_SLEEP_MAX_MS, duration)
+            else:
+                passes += math.ceil(duration / SLOW_MS)
+        else:
+            per_step = duration * 64 / abs(end - start)
+            passes += math.ceil(duration / min(max(per_step, FAST_MS), SLOW_MS))
+    return passes, dark_ms
+
+
+def main(argv):
+    upload = None
+    if '--upload' in argv:
+        i = argv.index('--upload')
+        upload = argv[i + 1]
+        argv = argv[:i] + argv[i + 2:]
+    if not argv:
+        print(__doc__ or 'usage: program_preview.py "<query>" [--upload host]')
+        return 2
+    query = dict(urllib.parse.parse_qsl(argv[0]))
+    try:
+        segments, exact = compile_program(query.get('steps', ''), float(query.get('start', 0)),
+                                          int(query.get('delay', 0)))
+    except (ValueError, IndexError) as e:
+        print(f'error: {e}')
+        return 1
+
+    total = sum(d for d, _, _ in segments)
+    print(f'{len(segments)} segments, {total / 1000:.0f} s')
+    samples = 24
+    worst = 0.0
+    for i in range(samples + 1):
+        t = min(total * i // samples, total - 1)
+        compiled, ideal = level_at(segments, t), level_at(exact, t, exact=True)
+        print(f'  {t / 1000:>8.0f} s  {compiled:>6.2f}%  {"#" * int(compiled / 2.5)}')
+    for t in range(0, total, max(total // 20000, 1)):
+        worst = max(worst, abs(level_at(segments, t) - level_at(exact, t, exact=True)))
+    passes, dark_ms = wakes(segments)
+    print(f'max deviation from the exact curves {worst:.2f}%')
+    print(f'{passes} loop passes instead of {total // FAST_MS} at a fixed 10 ms; '
+          f'{dark_ms / 1000:.0f} s in light sleep')
+
+    if upload:
+        body = urllib.parse.urlencode(query).encode()
+        with urllib.request.urlopen(f'http://{upload}/api/program', data=body, timeout=5) as response:
+            print(response.read().decode())
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,31 @@
+# board_size.py
+# PlatformIO post script: prints flash and static RAM use of the firmware
+# after every build, so the board environments can be compared side by side.
+#
+#   pio run        -> one "size:" line per environment
+Import("env")
+
+import subprocess
+
+# Section prefixes of the ESP32 / ESP32-C3 linker scripts
+FLASH_SECTIONS = (".flash.", ".iram0.", ".dram0.data", ".rtc.text", ".rtc.data")
+RAM_SECTIONS = (".dram0.", ".iram0.", ".noinit", ".rtc.")
+
+
+def report_size(source, target, env):
+    output = subprocess.run([env.subst("$SIZETOOL"), "-A", str(target[0])],
+                            capture_output=True, text=True).stdout
+    flash = ram = 0
+    for line in output.splitlines():
+        parts = line.split()
+        if len(parts) < 2 or not parts[1].isdigit():
+            continue
+        name, size = parts[0], int(parts[1])
+        if name.startswith(FLASH_SECTIONS):
+            flash += size
+        if name.startswith(RAM_SECTIONS):
+            ram += size
+    print(f"size: {env['PIOENV']:<22} flash {flash:>8} bytes  static RAM {ram:>7} bytes")
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", report_size)
@@ -0,0 +1,71 @@
+// Runs the firmware (src/main.cpp) as a host process: setup() once, then
+// loop() forever, on HostDevice with the web server on a local port.
+//
+//   pio run -e host_lamp
+//   .pio/build/host_lamp/program --port 8080 --knob 0.5 --pack 11.1
+//   python load_gen.py 127.0.0.1:8080
+//
+// --setup starts without stored WiFi credentials, so the lamp comes up in
+// access point mode with the captive portal DNS on --dns-port.
+#include <Arduino.h>
+#include <string.h>
+#include "HostDevice.h"
+#include "config/Config.h"
+
+void setup();
+void loop();
+
+namespace {
+    void usage() {
+        fprintf(stderr, "usage: program [--port N] [--dns-port N] [--knob 0-1] [--pack volts] [--setup]\n");
+        exit(2);
+    }
+}
+
+int main(int argc, char** argv) {
+    HostDevice& device = HostDevice::current();
+    device.httpPort = 8080;
+    device.dnsPort = 5353;
+    float knob = 0.0f;
+    float packVolts = 11.1f;
+    bool setupMode = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char* option = argv[i];
+        if (strcmp(option, "--setup") == 0) {
+            setupMode = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage();
+        }
+        const char* value = argv[++i];
+        if (strcmp(option, "--port") == 0) {
+            device.httpPort = atoi(value);
+        } else if (strcmp(option, "--dns-port") == 0) {
+            device.dnsPort = atoi(value);
+        } else if (strcmp(option, "--knob") == 0) {
+            knob = strtof(value, nullptr);
+        } else if (strcmp(option, "--pack") == 0) {
+            packVolts = strtof(value, nullptr);
+        } else {
+            usage();
+        }
+    }
+
+    if (!setupMode) {
+        // Credentials as the setup page would have saved them
+        WiFiConfig config = {};
+        strncpy(config.ssid, "host", sizeof(config.ssid) - 1);
+        config.configured = true;
+        memcpy(device.eeprom, &config, sizeof(config));
+    }
+    device.setKnob(Board::DIMMER_ANALOG_PIN, knob);
+    device.setPackVoltage(Board::VOLTAGE_PIN, packVolts, LampConfig::VOLTAGE_DIVIDER_RATIO);
+
+    setup();
+    fprintf(stderr, "Lamp on http://127.0.0.1:%d\n", device.httpPort);
+    for (;;) {
+        loop();
+    }
+}
@@ -0,0 +1,152 @@
+// Runs a fleet of data-logging lamps against the logging server, for sizing
+// the backend. Every lamp is the real firmware (LampController and
+// NetworkManager from src/) on its own HostDevice with a virtual clock, and
+// its reports are real HTTP requests over POSIX sockets. The lamps are run
+// an epoch at a time on a work-stealing thread pool.
+//
+//   pio run -e host_fleet
+//   .pio/build/host_fleet/program --lamps 100 --minutes 10          -> http://127.0.0.1:4999, real time
+//   .pio/build/host_fleet/program --lamps 1000 --hours 24 --speed 0 -> as fast as the lamps run
+//
+// --speed 10 runs ten virtual seconds per real second, so the request rate
+// the server sees is multiplied by 10. Virtual time starts at --start-hour
+// (18:00 by default), when the evening sessions begin.
+#include <Arduino.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "VirtualLamp.h"
+#include "WorkStealingPool.h"
+
+namespace {
+    const uint64_t EPOCH_MS = 1000;   // Virtual time every lamp runs between pool rounds
+
+    struct Options {
+        int lamps = 100;
+        double durationS = 0.0;
+        double speed = 1.0;
+        std::string serverHost = "127.0.0.1";
+        int serverPort = LampConfig::DEFAULT_LOGGING_SERVER_PORT;
+        int workers = (int)std::max(1u, std::thread::hardware_concurrency());
+        uint32_t seed = 1;
+        float startHour = 18.0f;
+    };
+
+    void usage() {
+        fprintf(stderr, "usage: program [--lamps N] [--minutes M | --hours H] [--speed S] [--server http://host:port]\n"
+                        "               [--workers N] [--seed N] [--start-hour H]\n");
+        exit(2);
+    }
+
+    void parseServer(const char* url, Options& options) {
+        std::string text = url;
+        size_t scheme = text.find("://");
+        if (scheme != std::string::npos) {
+            text = text.substr(scheme + 3);
+        }
+        text = text.substr(0, text.find('/'));
+        size_t colon = text.rfind(':');
+        options.serverHost = text.substr(0, colon);
+        options.serverPort = colon == std::string::npos ? 80 : atoi(text.c_str() + colon + 1);
+    }
+
+    double percentileMs(std::vector<uint32_t>& values, double fraction) {
+        if (values.empty()) {
+            return 0.0;
+        }
+        size_t index = std::min(values.size() - 1, (size_t)(values.size() * fraction));
+        std::nth_element(values.begin(), values.begin() + index, values.end());
+        return values[index] / 1000.0;
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        const char* option = argv[i];
+        if (i + 1 >= argc) {
+            usage();
+        }
+        const char* value = argv[++i];
+        if (strcmp(option, "--lamps") == 0) {
+            options.lamps = atoi(value);
+        } else if (strcmp(option, "--minutes") == 0) {
+            options.durationS += atof(value) * 60;
+        } else if (strcmp(option, "--hours") == 0) {
+            options.durationS += atof(value) * 3600;
+        } else if (strcmp(option, "--speed") == 0) {
+            options.speed = atof(value);
+        } else if (strcmp(option, "--server") == 0) {
+            parseServer(value, options);
+        } else if (strcmp(option, "--workers") == 0) {
+            options.workers = std::max(1, atoi(value));
+        } else if (strcmp(option, "--seed") == 0) {
+            options.seed = (uint32_t)atoi(value);
+        } else if (strcmp(option, "--start-hour") == 0) {
+            options.startHour = strtof(value, nullptr);
+        } else {
+            usage();
+        }
+    }
+    if (options.durationS <= 0) {
+        options.durationS = 600;
+    }
+    uint64_t durationMs = (uint64_t)(options.durationS * 1000);
+
+    // Lamps boot at random phases of their reporting interval
+    auto start = std::chrono::steady_clock::now();
+    std::mt19937 rng(options.seed);
+    std::uniform_int_distribution<uint64_t> bootAt(0, LampConfig::REPORTING_INTERVAL_MS);
+    std::vector<std::unique_ptr<VirtualLamp>> lamps;
+    for (int i = 0; i < options.lamps; i++) {
+        lamps.emplace_back(new VirtualLamp(i, rng(), options.serverHost, options.serverPort, bootAt(rng),
+                                           options.startHour));
+    }
+
+    WorkStealingPool pool(options.workers);
+    for (uint64_t fleetMs = EPOCH_MS; fleetMs < durationMs + EPOCH_MS; fleetMs += EPOCH_MS) {
+        uint64_t epochEnd = std::min(fleetMs, durationMs);
+        for (auto& lamp : lamps) {
+            VirtualLamp* virtualLamp = lamp.get();
+            pool.submit([virtualLamp, epochEnd]() { virtualLamp->runUntil(epochEnd); });
+        }
+        pool.wait();
+        if (options.speed > 0) {
+            std::this_thread::sleep_until(start + std::chrono::microseconds((uint64_t)(epochEnd * 1000 / options.speed)));
+        }
+    }
+    double elapsedS = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    VirtualLamp::Stats total;
+    for (auto& lamp : lamps) {
+        const VirtualLamp::Stats& stats = lamp->stats();
+        total.reportsDue += stats.reportsDue;
+        total.posts += stats.posts;
+        total.postErrors += stats.postErrors;
+        total.firmwareChecks += stats.firmwareChecks;
+        total.wifiTimeouts += stats.wifiTimeouts;
+        total.radioOnUs += stats.radioOnUs;
+        total.consumedMah += stats.consumedMah;
+        total.latencyUs.insert(total.latencyUs.end(), stats.latencyUs.begin(), stats.latencyUs.end());
+    }
+    double lampHours = options.lamps * options.durationS / 3600;
+    double realS = options.speed > 0 ? options.durationS / options.speed : elapsedS;
+    printf("%d lamps, %.2f virtual hours in %.1f s real (%d workers, %llu steals)\n", options.lamps,
+           options.durationS / 3600, elapsedS, pool.size(), (unsigned long long)pool.steals());
+    printf("  reports due       %u\n", total.reportsDue);
+    printf("  POSTs             %u  (%.1f/s at the server)\n", total.posts, total.posts / realS);
+    printf("  firmware checks   %u\n", total.firmwareChecks);
+    printf("  WiFi timeouts     %u\n", total.wifiTimeouts);
+    printf("  HTTP errors       %u\n", total.postErrors);
+    printf("  latency p50 %.1f ms, p99 %.1f ms, max %.1f ms\n", percentileMs(total.latencyUs, 0.5),
+           percentileMs(total.latencyUs, 0.99), percentileMs(total.latencyUs, 1.0));
+    printf("  per lamp-hour     %.0f s radio on, %.1f mAh\n", total.radioOnUs / 1e6 / lampHours,
+           total.consumedMah / lampHours);
+    return 0;
+}
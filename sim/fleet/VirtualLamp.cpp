@@ -0,0 +1,156 @@
+#include "VirtualLamp.h"
+#include <math.h>
+
+namespace {
+    const float PACK_RESISTANCE_OHMS = 0.15f;
+    const float EMPTY_VOLTS = 9.6f;   // The owner recharges below this
+    const uint64_t MS_PER_HOUR = 3600000;
+
+    // 3S LiPo open-circuit voltage against state of charge
+    const float OCV[][2] = {{0.0f, 9.0f}, {0.05f, 9.9f}, {0.1f, 10.5f}, {0.2f, 10.9f},
+                            {0.4f, 11.2f}, {0.6f, 11.5f}, {0.8f, 11.9f}, {1.0f, 12.6f}};
+
+    float openCircuitVolts(float soc) {
+        const int points = sizeof(OCV) / sizeof(OCV[0]);
+        for (int i = 1; i < points; i++) {
+            if (soc <= OCV[i][0]) {
+                float t = (soc - OCV[i - 1][0]) / (OCV[i][0] - OCV[i - 1][0]);
+                return OCV[i - 1][1] + t * (OCV[i][1] - OCV[i - 1][1]);
+            }
+        }
+        return OCV[points - 1][1];
+    }
+}
+
+VirtualLamp::VirtualLamp(int index, uint32_t seed, const std::string& serverHost, int serverPort,
+                         uint64_t bootAtMs, float startHour)
+    : rng(seed), bootAtMs(bootAtMs), startHour(startHour) {
+    eveningStart = std::normal_distribution<float>(19.0f, 1.0f)(rng);
+    sessionHours = std::max(0.5f, std::normal_distribution<float>(3.0f, 1.0f)(rng));
+    usageChance = std::uniform_real_distribution<float>(0.5f, 0.95f)(rng);
+    stateOfCharge = std::uniform_real_distribution<float>(0.3f, 1.0f)(rng);
+    connectMedianMs = std::lognormal_distribution<float>(logf(2500.0f), 0.4f)(rng);
+    const float failureRates[] = {0.01f, 0.02f, 0.05f, 0.3f};
+    wifiFailureRate = failureRates[std::uniform_int_distribution<int>(0, 3)(rng)];
+
+    device.useVirtualClock();
+    device.serialMuted = true;
+    device.efuseMac = 0xF1EE70000000ULL + (uint64_t)index;
+    device.serverHost = serverHost;
+    device.serverPort = serverPort;
+    device.onRestart = []() {};   // A firmware update lands; the lamp carries on as it was
+    device.onHttpRequest = [this](const char* method, int code, uint64_t realUs) {
+        totals.latencyUs.push_back((uint32_t)std::min<uint64_t>(realUs, UINT32_MAX));
+        if (strcmp(method, "POST") != 0) {
+            totals.firmwareChecks++;
+            return;
+        }
+        totals.posts++;
+        totals.postErrors += code >= 200 && code < 300 ? 0 : 1;
+    };
+    // Credentials as the setup page would have saved them
+    WiFiConfig config = {};
+    strncpy(config.ssid, "fleet", sizeof(config.ssid) - 1);
+    config.configured = true;
+    memcpy(device.eeprom, &config, sizeof(config));
+
+    HostDevice::select(&device);
+    drawAssociation();
+    updatePack(bootAtMs);
+    lamp.begin();
+    network.begin();
+    HostDevice::select(nullptr);
+}
+
+float VirtualLamp::knobAt(uint64_t fleetMs) {
+    float hours = startHour + (float)fleetMs / MS_PER_HOUR;
+    int day = (int)(hours / 24.0f);
+    if (day != sessionDay) {
+        // Tonight's session, if the lamp gets used at all
+        sessionDay = day;
+        sessionStart = sessionEnd = 0.0f;
+        if (std::uniform_real_distribution<float>(0.0f, 1.0f)(rng) < usageChance) {
+            sessionStart = eveningStart + std::normal_distribution<float>(0.0f, 0.5f)(rng);
+            sessionEnd = sessionStart + sessionHours;
+            sessionKnob = std::uniform_real_distribution<float>(0.3f, 1.0f)(rng);
+        }
+    }
+    float hourOfDay = hours - day * 24.0f;
+    return hourOfDay >= sessionStart && hourOfDay < sessionEnd ? sessionKnob : 0.0f;
+}
+
+void VirtualLamp::updatePack(uint64_t fleetMs) {
+    uint64_t consumedUaMs = energy.read().consumedUaMs;
+    stateOfCharge -= (float)(consumedUaMs - accountedUaMs) / 3.6e9f / LampConfig::PACK_CAPACITY_MAH;
+    accountedUaMs = consumedUaMs;
+    float loadAmps = EnergyModel::currentUa(getCpuFrequencyMhz(), lamp.getSleepTime(), WiFi.getMode() != WIFI_OFF,
+                                            lamp.getPwmDuty()) / 1e6f;
+    float volts = openCircuitVolts(std::max(stateOfCharge, 0.0f)) - loadAmps * PACK_RESISTANCE_OHMS;
+    if (volts < EMPTY_VOLTS) {
+        stateOfCharge = 1.0f;
+        volts = openCircuitVolts(stateOfCharge) - loadAmps * PACK_RESISTANCE_OHMS;
+    }
+    device.setPackVoltage(Board::VOLTAGE_PIN, volts, LampConfig::VOLTAGE_DIVIDER_RATIO);
+    device.setKnob(Board::DIMMER_ANALOG_PIN, knobAt(fleetMs));
+}
+
+void VirtualLamp::drawAssociation() {
+    if (device.associations != usedAssociations) {
+        // WiFi.begin() took the last draw; without the access point it times out
+        usedAssociations = device.associations;
+        totals.wifiTimeouts += device.apReachable ? 0 : 1;
+        associationDrawn = false;
+    }
+    // Only while the radio is off, so an attempt under way keeps its draw
+    if (!associationDrawn && WiFi.getMode() == WIFI_OFF) {
+        device.associationMs = (uint32_t)std::lognormal_distribution<float>(logf(connectMedianMs), 0.2f)(rng);
+        device.apReachable = std::uniform_real_distribution<float>(0.0f, 1.0f)(rng) >= wifiFailureRate;
+        associationDrawn = true;
+    }
+}
+
+// loop() in src/main.cpp, less the debug output
+void VirtualLamp::pass() {
+    loopStats.beginIteration(micros());
+    lamp.suspendAnimations(shedder.sheds(ShedLevel::SUSPEND_ANIMATIONS));
+    lamp.update();
+    governor.update();
+    lamp.checkTouchStatus();
+    unsigned long now = millis();
+    if (energy.due(now)) {
+        energy.sample(now, getCpuFrequencyMhz(), lamp.getSleepTime(), WiFi.getMode() != WIFI_OFF,
+                      lamp.getPwmDuty());
+    }
+    loopStats.endIteration(micros(), lamp.getSleepTime());
+    shedder.update(loopStats.lastPassMissed(), millis());
+}
+
+void VirtualLamp::runUntil(uint64_t fleetMs) {
+    if (fleetMs <= bootAtMs) {
+        return;
+    }
+    HostDevice::select(&device);
+    uint64_t targetMs = fleetMs - bootAtMs;
+    while (millis() < targetMs) {
+        uint64_t now = millis();
+        if (now >= lampWakeMs) {
+            updatePack(bootAtMs + now);
+            pass();
+            lampWakeMs = now + lamp.getSleepTime();
+        }
+        // The network task wakes every NETWORK_TASK_INTERVAL_MS; with the
+        // radio off it only has work after a pass queued a report
+        drawAssociation();
+        network.service();
+        uint64_t next = WiFi.getMode() != WIFI_OFF ? std::min<uint64_t>(lampWakeMs, millis() + LampConfig::NETWORK_TASK_INTERVAL_MS)
+                                                   : lampWakeMs;
+        next = std::min<uint64_t>(std::max<uint64_t>(next, millis() + 1), targetMs);
+        if (next > millis()) {
+            device.advanceMs(next - millis());
+        }
+    }
+    totals.reportsDue = lamp.getStatus().reportSequence;
+    totals.radioOnUs = device.totalRadioOnUs();
+    totals.consumedMah = (float)energy.read().consumedUaMs / 3.6e9f;
+    HostDevice::select(nullptr);
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <random>
+#include <string>
+#include <vector>
+#include "HostDevice.h"
+#include "network/NetworkManager.h"
+
+// One data-logging lamp of the fleet: the firmware's LampController and
+// NetworkManager on a HostDevice of its own, with a virtual clock. An
+// owner turns the knob for an evening session most days; the 3S pack
+// drains by what EnergyModel charges and is recharged once it is flat.
+// Each association attempt takes a drawn time and may never succeed,
+// so WIFI_TIMEOUT_MS and the retry backoff play out as on a real lamp.
+//
+// runUntil() may be called from any thread, one call at a time.
+class VirtualLamp {
+public:
+    struct Stats {
+        uint32_t reportsDue = 0;
+        uint32_t posts = 0;
+        uint32_t postErrors = 0;        // Refused, timed out or not 2xx
+        uint32_t firmwareChecks = 0;
+        uint32_t wifiTimeouts = 0;
+        uint64_t radioOnUs = 0;
+        float consumedMah = 0.0f;
+        std::vector<uint32_t> latencyUs;   // Real time of every request
+    };
+
+    // Boots bootAtMs into the fleet's run; startHour is the time of day the run starts at
+    VirtualLamp(int index, uint32_t seed, const std::string& serverHost, int serverPort,
+                uint64_t bootAtMs, float startHour);
+    void runUntil(uint64_t fleetMs);
+    const Stats& stats() const { return totals; }
+
+private:
+    HostDevice device;
+    LampController lamp;
+    CpuGovernor governor{lamp};
+    LoopStats loopStats;
+    LoadShedder shedder;
+    EnergyModel energy;
+    NetworkManager network{lamp, governor, loopStats, shedder, energy};
+
+    std::mt19937 rng;
+    uint64_t bootAtMs;
+    float startHour;
+    uint64_t lampWakeMs = 0;
+
+    // Owner and pack
+    float eveningStart;
+    float sessionHours;
+    float usageChance;
+    int sessionDay = -1;
+    float sessionStart = 0.0f;
+    float sessionEnd = 0.0f;
+    float sessionKnob = 0.0f;
+    float stateOfCharge;
+    uint64_t accountedUaMs = 0;
+
+    // WiFi: the next association attempt, drawn while the radio is off
+    float connectMedianMs;
+    float wifiFailureRate;
+    bool associationDrawn = false;
+    uint32_t usedAssociations = 0;
+
+    Stats totals;
+
+    float knobAt(uint64_t fleetMs);
+    void updatePack(uint64_t fleetMs);
+    void drawAssociation();
+    void pass();
+};
@@ -0,0 +1,85 @@
+#include "WorkStealingPool.h"
+
+WorkStealingPool::WorkStealingPool(int workerCount) {
+    for (int i = 0; i < workerCount; i++) {
+        workers.emplace_back(new Worker());
+    }
+    for (int i = 0; i < workerCount; i++) {
+        threads.emplace_back([this, i]() { run(i); });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::submit(std::function<void()> task) {
+    pending++;
+    Worker& worker = *workers[nextWorker++ % workers.size()];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        queued++;
+    }
+    wake.notify_one();
+}
+
+void WorkStealingPool::wait() {
+    std::unique_lock<std::mutex> lock(idleMutex);
+    finished.wait(lock, [this]() { return pending.load() == 0; });
+}
+
+bool WorkStealingPool::take(int self, std::function<void()>& task) {
+    int count = (int)workers.size();
+    for (int i = 0; i < count; i++) {
+        Worker& worker = *workers[(self + i) % count];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.tasks.empty()) {
+            continue;
+        }
+        // Own work newest first, while it is still warm in cache; steal the oldest
+        if (i == 0) {
+            task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+        } else {
+            task = std::move(worker.tasks.front());
+            worker.tasks.pop_front();
+            stolen++;
+        }
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::run(int self) {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(idleMutex);
+            wake.wait(lock, [this]() { return stopping || queued > 0; });
+            if (stopping) {
+                return;
+            }
+            queued--;
+        }
+        // queued counted this task in, so one is there to take
+        std::function<void()> task;
+        while (!take(self, task)) {
+            std::this_thread::yield();
+        }
+        task();
+        if (--pending == 0) {
+            std::lock_guard<std::mutex> lock(idleMutex);
+            finished.notify_all();
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads, each with its own task deque. submit() deals
+// tasks out round-robin; a worker takes its newest task first and, when its
+// deque is empty, steals the oldest from another. A lamp stuck on a slow
+// HTTP request then holds up one worker, not the rest of its share.
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(int workerCount);
+    ~WorkStealingPool();
+
+    void submit(std::function<void()> task);
+    void wait();   // Until every submitted task has finished
+    int size() const { return (int)workers.size(); }
+    uint64_t steals() const { return stolen.load(); }
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::mutex idleMutex;
+    std::condition_variable wake;       // Tasks queued or stopping
+    std::condition_variable finished;   // pending reached zero
+    int queued = 0;                     // Submitted, not yet taken; under idleMutex
+    std::atomic<int> pending{0};        // Submitted, not yet finished
+    std::atomic<uint64_t> stolen{0};
+    unsigned nextWorker = 0;
+    bool stopping = false;
+
+    bool take(int self, std::function<void()>& task);
+    void run(int self);
+};
@@ -0,0 +1,134 @@
+#pragma once
+#include <Arduino.h>
+
+// One traits struct per PCB. Everything that differs between boards lives
+// here as a compile-time constant, so code that depends on a capability the
+// board doesn't have is never instantiated. Select the board with one build
+// flag: -D BOARD_C3_V1, -D BOARD_C3_V2 or -D BOARD_ESP32_DEV.
+
+// What an output string emits; drives the colour temperature mix in OutputStage
+enum class ChannelKind : uint8_t {
+    WHITE,          // Fixed white, follows brightness only
+    WARM_WHITE,     // Warm end of the CCT range
+    COOL_WHITE,     // Cool end of the CCT range
+    RED,            // RGB(W) tint channels
+    GREEN,
+    BLUE
+};
+
+struct OutputChannel {
+    int pin;
+    ChannelKind kind;
+    float exponent;   // Dimming curve, duty = gain * level^exponent
+    float gain;       // Full-scale duty, < 1 to balance strings of different efficacy
+};
+
+struct BoardC3V1 {
+    static const char* name() { return "ESP32-C3 PCB v1"; }
+
+    static const int DIMMER_ANALOG_PIN = 0;
+    static const int VOLTAGE_PIN = 1;
+    static const int PWM_PIN = 10;
+    static const int LED_R = 21;
+    static const int LED_G = 20;
+    static const int LED_B = 10;
+    static const int ONBOARD_LED_PIN = 8;
+    static const int TOUCH_PIN = -1;
+
+    // we know that 9765 and 12 bit works well ish. (very good resolution, but slightly audible)
+    // 19531 and 11 bit looks good enough and is very quiet.
+    static const int PWM_FREQ = 19531;
+    static const int PWM_RESOLUTION = 11;
+
+    static const bool HAS_TOUCH = false;     // C3 has no touch peripheral
+    static const int ADC_RESOLUTION = 10;
+    static const int LEDC_CHANNELS = 6;
+
+    // Lamp output strings, in LEDC channel order
+    static const int OUTPUT_COUNT = 1;
+    static const OutputChannel* outputs() {
+        static const OutputChannel channels[OUTPUT_COUNT] = {{PWM_PIN, ChannelKind::WHITE, 3.0f, 1.0f}};
+        return channels;
+    }
+
+    // Unused pins pulled down at boot to stop them floating
+    static const int IDLE_PIN_COUNT = 11;
+    static const int* idlePins() {
+        static const int pins[IDLE_PIN_COUNT] = {2, 3, 4, 5, 6, 7, 8, 9, 10, 20, 21};
+        return pins;
+    }
+};
+
+struct BoardC3V2 : BoardC3V1 {
+    static const char* name() { return "ESP32-C3 PCB v2"; }
+
+    static const int PWM_PIN = 7;
+    static const int LED_R = 5;    // moved from 21 to 5
+    static const int LED_G = 4;    // moved from 20 to 4
+
+    static const OutputChannel* outputs() {
+        static const OutputChannel channels[OUTPUT_COUNT] = {{PWM_PIN, ChannelKind::WHITE, 3.0f, 1.0f}};
+        return channels;
+    }
+};
+
+struct BoardEsp32Dev {
+    static const char* name() { return "ESP32 DevKit"; }
+
+    static const int DIMMER_ANALOG_PIN = 34;
+    static const int VOLTAGE_PIN = 35;
+    static const int PWM_PIN = 13;
+    static const int LED_R = 2;
+    static const int LED_G = 25;
+    static const int LED_B = 26;
+    static const int ONBOARD_LED_PIN = -1;   // Shares GPIO 2 with LED_R
+    static const int TOUCH_PIN = 0;          // T1
+
+    static const int PWM_FREQ = 10000;
+    static const int PWM_RESOLUTION = 13;
+
+    static const bool HAS_TOUCH = true;
+    static const int ADC_RESOLUTION = 10;
+    static const int LEDC_CHANNELS = 16;
+
+    static const int OUTPUT_COUNT = 1;
+    static const OutputChannel* outputs() {
+        static const OutputChannel channels[OUTPUT_COUNT] = {{PWM_PIN, ChannelKind::WHITE, 3.0f, 1.0f}};
+        return channels;
+    }
+
+    // GPIO 6-11 are the flash bus on the classic ESP32 and must not be touched
+    static const int IDLE_PIN_COUNT = 6;
+    static const int* idlePins() {
+        static const int pins[IDLE_PIN_COUNT] = {4, 5, 14, 15, 16, 17};
+        return pins;
+    }
+};
+
+#if defined(BOARD_ESP32_DEV)
+typedef BoardEsp32Dev Board;
+#elif defined(BOARD_C3_V2)
+typedef BoardC3V2 Board;
+#else
+typedef BoardC3V1 Board;
+#endif
+
+// Touch input, compiled down to nothing on boards without the peripheral.
+// touchRead() is only declared by the core on chips that have touch, which
+// is why the call depends on the board type.
+template <bool HasTouch, typename B = Board>
+struct TouchInput {
+    static const bool AVAILABLE = true;
+    static int read() { return touchRead(B::TOUCH_PIN); }
+    // isr runs while the reading is below threshold; calling again moves the threshold
+    static void attachInterrupt(void (*isr)(), uint16_t threshold) { touchAttachInterrupt(B::TOUCH_PIN, isr, threshold); }
+};
+
+template <typename B>
+struct TouchInput<false, B> {
+    static const bool AVAILABLE = false;
+    static int read() { return 0; }
+    static void attachInterrupt(void (*)(), uint16_t) {}
+};
+
+typedef TouchInput<Board::HAS_TOUCH> BoardTouch;
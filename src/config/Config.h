@@ -1,4 +1,5 @@
 #pragma once
+#include "BoardTraits.h"
 
 struct WiFiConfig {
     char ssid[32];
@@ -7,59 +8,85 @@ struct WiFiConfig {
 };
 
 struct LampConfig {
-    // Use build flags for pin configuration
-    static const int DIMMER_ANALOG_PIN = BOARD_DIMMER_ANALOG_PIN;
-    static const int VOLTAGE_PIN = BOARD_VOLTAGE_PIN;
-    static const int PWM_PIN = BOARD_PWM_PIN;
-    static const int LED_R = BOARD_LED_R_PIN;
-    static const int LED_G = BOARD_LED_G_PIN;
-    static const int LED_B = BOARD_LED_B_PIN;
+    // Pins and peripheral capabilities come from the selected board
+    static const int DIMMER_ANALOG_PIN = Board::DIMMER_ANALOG_PIN;
+    static const int VOLTAGE_PIN = Board::VOLTAGE_PIN;
+    static const int PWM_PIN = Board::PWM_PIN;
+    static const int LED_R = Board::LED_R;
+    static const int LED_G = Board::LED_G;
+    static const int LED_B = Board::LED_B;
+    // The v1 PCB routes the blue status LED trace to the lamp output pin
+    static const bool LED_B_SHARES_OUTPUT = Board::LED_B == Board::PWM_PIN;
     // For backward compatibility
     static const int STATUS_LED = LED_R;
 
-    static const int ONBOARD_LED_PIN = 8;
-    
-    #if SUPPORT_TOUCH
-    static const int TOUCH_PIN = BOARD_TOUCH_PIN;
-    static const int TOUCH_THRESHOLD = 40;
+    static const int ONBOARD_LED_PIN = Board::ONBOARD_LED_PIN;
+
+    static const int TOUCH_PIN = Board::TOUCH_PIN;
+
+    // Touch gestures (see src/lamp/TouchGestures.h), boards with HAS_TOUCH only
+    static constexpr float TOUCH_TRIGGER_RATIO = 0.7f;      // Touched below 70% of the untouched baseline
+    static constexpr float TOUCH_BASELINE_ALPHA = 0.05f;    // Baseline drift filter, per idle sample
+    static const unsigned long TOUCH_BASELINE_INTERVAL_MS = 1000;  // Idle sampling for the baseline
+    static const unsigned long TOUCH_POLL_MS = 20;          // Sampling while a touch is in progress
+    static const unsigned long TOUCH_MIN_PRESS_MS = 40;     // Shorter presses are noise
+    static const unsigned long TOUCH_DOUBLE_TAP_MS = 300;   // Longest gap between the taps of a double tap
+    static const unsigned long TOUCH_LONG_PRESS_MS = 600;
+    static constexpr float TOUCH_DIM_PER_S = 40.0f;         // Brightness change (%) per second while held
+    static constexpr float TOUCH_DIM_MIN = 2.0f;            // Holding doesn't dim below this (%)
+
+    // PWM channels. A channel pair (0/1, 2/3, ...) shares an LEDC timer.
+    // PWM_FREQ_JITTER hops the outputs' timers, so then the status LED
+    // starts on the next pair instead of sharing the first output's timer.
+    #ifndef PWM_FREQ_JITTER
+    #define PWM_FREQ_JITTER false                    // Hop the PWM frequency to spread the audible tone
     #endif
-
-    // PWM channels
     static const int PWM_CHANNEL = 0;        // Main lamp PWM
-    static const int RGB_R_CHANNEL = 1;      // Red LED PWM
-    static const int RGB_G_CHANNEL = 2;      // Green LED PWM  
-    static const int RGB_B_CHANNEL = 3;      // Blue LED PWM
+    static const int RGB_R_CHANNEL = PWM_FREQ_JITTER ? (Board::OUTPUT_COUNT + 1) / 2 * 2 : 1;  // Red LED PWM
+    static const int RGB_G_CHANNEL = RGB_R_CHANNEL + 1;   // Green LED PWM
+    static const int RGB_B_CHANNEL = RGB_R_CHANNEL + 2;   // Blue LED PWM
     
     // RGB LED brightness control (30% of full brightness)
     static constexpr float RGB_BRIGHTNESS_SCALE = 0.20f;
     
-    #if defined(BOARD_ESP32_C3)
-    // we know that 9765 and 12 bit works well ish. (very good resolution, but slightly audible)
-    // 19531 and 11 bit looks good enough and is very quiet.
-    static const int PWM_FREQ = 19531;      // Lower frequency for C3
-    static const int PWM_RESOLUTION = 11;   // Lower resolution for C3
-    static const int MAX_PWM = 2047;        // 2^11 - 1
-    #else
-    static const int PWM_FREQ = 10000;      // Original ESP32 frequency
-    static const int PWM_RESOLUTION = 13;   // Original ESP32 resolution
-    static const int MAX_PWM = 8191;        // 2^13 - 1
-    #endif
-
-    static const int ADC_RESOLUTION = 10;
-    static const int MAX_ANALOG = 1023;     // 10-bit
+    // Lamp output channels (see src/lamp/OutputStage.h). The first uses
+    // PWM_CHANNEL, the rest follow the status LED channels (or, with
+    // PWM_FREQ_JITTER, the first).
+    static const int MAX_OUTPUT_CHANNELS = 4;
+    static const int OUTPUT_CURVE_POINTS = 65;       // Per-channel dimming curve lookup table
+    static const int CCT_WARM_K = 2700;              // Colour temperature of the warm string
+    static const int CCT_COOL_K = 6500;              // Colour temperature of the cool string
+    static const int CCT_DEFAULT_K = 4000;
+    static constexpr float RGBW_TINT_SCALE = 0.3f;   // How much RGB is mixed into W for a CCT
+
+    static const int PWM_FREQ = Board::PWM_FREQ;
+    static const int PWM_RESOLUTION = Board::PWM_RESOLUTION;
+    static const int MAX_PWM = (1 << PWM_RESOLUTION) - 1;
+
+    // PWM phase planning (see src/lamp/PwmPlanner.h)
+    static const bool PWM_PHASE_STAGGER = true;      // Spread channel on-times across the period
+    static const int PWM_JITTER_PERCENT = 4;         // Hop within +-4% of PWM_FREQ
+    static const unsigned long PWM_JITTER_HOP_MS = 20;
+
+    static const int ADC_RESOLUTION = Board::ADC_RESOLUTION;
+    static const int MAX_ANALOG = (1 << ADC_RESOLUTION) - 1;
     static constexpr float ALPHA = 0.1f;    // Filter constant
     static constexpr float EXP_FACTOR = 3.0f; // Exponential mapping factor
 
     // Battery voltage monitoring
     static constexpr float R_UP = 10000.0f;    // 10kΩ
     static constexpr float R_DOWN = 3000.0f;   // 3kΩ
-    static constexpr float VOLTAGE_REFERENCE = 3.3f;  // ESP32 reference voltage
     static constexpr float VOLTAGE_DIVIDER_RATIO = (R_UP + R_DOWN) / R_DOWN;
     static constexpr float VOLTAGE_ALPHA = 0.1f;  // Voltage filter constant
-    
-    // Calibrated based on actual measurements
-    static constexpr float VOLTAGE_SCALE = 1;  // 1.1/1.3 ≈ 0.846
-    static constexpr float VOLTAGE_OFFSET = 0;   // No offset needed if scale is correct
+
+    // ADC calibration (see src/lamp/AdcCalibration.h)
+    static const int ADC_DEFAULT_VREF_MV = 1100;    // Used when the chip has no eFuse calibration
+    static const int ADC_CAL_SEGMENT_BITS = 5;      // 32 linear segments across the ADC range
+    static const int ADC_CAL_EEPROM_ADDR = 128;     // Stored two-point calibration, after WiFiConfig
+    static const int ADC_CAL_MIN_SPAN_MV = 1000;    // Calibration points closer than this are rejected
+    static const int ADC_CAL_SAMPLES = 16;          // Readings averaged for a calibration point
+    static const int ADC_CAL_MAX_MV = 15000;        // Meter readings above this are refused (a full 3S pack is 12.6 V)
+    static const unsigned long ADC_CAL_REPLY_MS = 500;  // /api/calibrate waits this long for the lamp to take the point
 
     // Battery status thresholds (per cell) - 3-cell LiPo
     static constexpr float BATTERY_LOW_THRESHOLD = 3.4f;      // Red LED
@@ -94,6 +121,20 @@ struct LampConfig {
     static constexpr const char* DEFAULT_LOGGING_SERVER_IP = "192.168.68.109";
     static constexpr int DEFAULT_LOGGING_SERVER_PORT = 4999;
 
+    // MQTT telemetry instead of one HTTP POST per report (see src/network/MqttTransport.h)
+    #ifndef TELEMETRY_MQTT
+    #define TELEMETRY_MQTT false
+    #endif
+    static constexpr const char* MQTT_BROKER_IP = DEFAULT_LOGGING_SERVER_IP;
+    static const int MQTT_PORT = 1883;
+    static const int MQTT_KEEPALIVE_S = 60;
+    static const int MQTT_QUEUE_SIZE = 32;            // Reports held while offline, oldest dropped when full
+    static const int MQTT_SAMPLE_SIZE = 96;           // Bytes per queued report
+    static const int MQTT_BATCH_SIZE = 6;             // Reports per publish, and per radio-on window when logging
+    static const int MQTT_BUFFER_SIZE = 768;          // PubSubClient packet buffer, must fit one batch
+    static const unsigned long MQTT_RETRY_MS = 5000;
+    static const unsigned long MQTT_COMMAND_WAIT_MS = 500;  // Collect queued commands before the radio goes off
+
     // Development mode configuration
     #ifndef DEV_MODE
     #define DEV_MODE false
@@ -105,6 +146,87 @@ struct LampConfig {
     static constexpr const char* DEV_WIFI_PASSWORD = "Otto&Bobbi";  // Replace with your WiFi password
     #endif
 
+    // Power / energy model (see src/power/EnergyModel.h)
+    // These are rough bench estimates for the C3 boards, all referred to the pack side.
+    static const int CPU_FREQ_MHZ = 10;                       // Idle clock, applied in configurePowerSaving()
+    static const uint32_t CPU_ACTIVE_BASE_UA = 2000;          // Core running, clock-independent part
+    static const uint32_t CPU_ACTIVE_UA_PER_MHZ = 130;        // ~23mA at 160MHz, ~3.3mA at 10MHz
+    static const uint32_t CPU_IDLE_BASE_UA = 1500;            // Idle task (WFI) during delay()
+    static const uint32_t CPU_IDLE_UA_PER_MHZ = 60;
+    static const uint32_t WIFI_ACTIVE_UA = 80000;             // Average while associated / transferring
+    static const uint32_t LED_FULL_DUTY_UA = 1500000;         // LED string current at 100% PWM
+    static const unsigned long LOOP_WORK_CYCLES = 40000;      // CPU cycles spent in one loop() pass
+    static const unsigned long TELEMETRY_WIFI_ON_MS = 4000;   // Connect + POST per report
+    static const uint32_t PACK_CAPACITY_MAH = 4400;           // Typical 3S pack
+    static const unsigned long ENERGY_SAMPLE_MS = 1000;       // Runtime charge accounting interval
+
+    // CPU frequency governor (see src/power/CpuGovernor.h)
+    static const int CPU_FREQ_FADE_MHZ = 40;          // Indicator animations / fades
+    static const int CPU_FREQ_NETWORK_MHZ = 80;       // Minimum while the radio is on
+    static const int CPU_FREQ_BURST_MHZ = 160;        // Association, bursts of HTTP requests
+    static const unsigned long CPU_BOOST_HOLD_MS = 2000;  // Stay boosted this long after the last demand
+    static const int CPU_BURST_REQUEST_COUNT = 3;     // Requests within the hold window that count as a burst
+
+    // Network task (see NetworkManager::startTask())
+    static const int COMMAND_QUEUE_SIZE = 8;             // Must be a power of two
+    static const int NETWORK_TASK_STACK_SIZE = 8192;
+    static const int NETWORK_TASK_PRIORITY = 1;          // Same as the Arduino loop task
+    static const unsigned long NETWORK_TASK_INTERVAL_MS = 10;
+
+    // Deferred logging (see src/util/DeferredLog.h)
+    #ifndef DEFERRED_LOG_UDP
+    #define DEFERRED_LOG_UDP false   // Send binary records to log_decoder.py instead of Serial
+    #endif
+    static const int LOG_BUFFER_SIZE = 64;      // Records held until the loop is idle
+    static const int LOG_MAX_FORMATS = 64;      // Distinct LOG_DEFERRED call sites
+    static const int LOG_DRAIN_PER_LOOP = 8;    // Records formatted per loop() pass
+    static const int LOG_STRING_BYTES = 32;     // Copied %s text per record, all strings together
+    static const int LOG_UDP_PORT = 5001;
+
+    // Delta OTA updates (see src/network/DeltaOta.h)
+    static const unsigned long OTA_CHECK_INTERVAL_MS = 21600000;  // Check every 6 hours while the radio is up
+    static const unsigned long OTA_STREAM_TIMEOUT_MS = 10000;     // Give up if the download stalls
+    static const unsigned long OTA_CONFIRM_AFTER_MS = 30000;      // Uptime before a new image is confirmed
+
+    // Control loop timing (see src/diag/LoopStats.h)
+    static const unsigned long LOOP_DEADLINE_SLACK_MS = 5;   // A pass starting later than this is a miss
+    static const unsigned long LOOP_BUDGET_MS = 10;          // A pass working longer than this is an overrun
+
+    // Load shedding while the loop misses deadlines (see src/diag/LoadShedder.h)
+    static const unsigned long SHED_WINDOW_MS = 1000;        // Misses are counted per window
+    static const int SHED_RAISE_MISSES = 3;                  // Misses in a window that shed one more level
+    static const int SHED_RECOVER_WINDOWS = 5;               // Clean windows in a row before one level comes back
+    static const unsigned long SHED_SERVER_INTERVAL_MS = 100;        // handleClient() interval while throttled
+    static const unsigned long SHED_MAX_TELEMETRY_DEFER_MS = 300000; // A report goes out after this anyway
+
+    // Brightness programs: sunrises, timers (see src/lamp/BrightnessProgram.h)
+    static const int PROGRAM_MAX_SEGMENTS = 64;
+    static const int PROGRAM_CURVE_PIECES = 16;                    // Straight lines per curved step
+    static constexpr float PROGRAM_EXP_CURVE_K = 4.0f;             // Steepness of the exp curve
+    static const uint32_t PROGRAM_MAX_STEP_S = 86400;
+    static const uint32_t PROGRAM_MAX_DELAY_S = 604800;            // A week
+    static const unsigned long PROGRAM_LIGHT_SLEEP_MAX_MS = 500;   // Knob and touch pad are read between sleeps
+
+    // Output restore after a warm reset (see src/lamp/WarmBoot.h)
+    static const bool WARM_BOOT_RESTORE = true;
+    static const int WARM_BOOT_MAX_RESTORES = 3;             // Back-to-back restores before a cold start instead
+    static const unsigned long WARM_BOOT_STABLE_MS = 10000;  // Uptime after which a restore counts as good
+
+    // Per-subsystem allocation counting (see src/diag/MemStats.h); needs the
+    // malloc wrapper linker flags from the mem_stats environment
+    #ifndef MEM_STATS
+    #define MEM_STATS false
+    #endif
+
+    // Scale the duty with pack voltage so a knob position gives the same light
+    // for the whole discharge (see src/lamp/LumenCompensationTable.h). Output is
+    // matched to 11.1V, so a full pack no longer gives its extra top-end light.
+    static const bool LUMEN_COMPENSATION = true;
+
+    // Low-battery derating (see src/lamp/DeratingPolicy.h, bands in DeratingPolicy.cpp)
+    static constexpr float DERATE_HYSTERESIS_V = 0.3f;  // Recovery needed before the cap rises again
+    static constexpr float DERATE_SLEW_PER_S = 0.02f;   // Cap changes by at most 2% of full output per second
+
     // Add these parameters for the low voltage warning
     static constexpr float LOW_VOLTAGE_THRESHOLD = 9.9f;  // Voltage threshold for 3-cell LiPo (3.3V * 3 cells)
     static const unsigned long VOLTAGE_CHECK_INTERVAL_MS = 30000;  // Check voltage every 30 seconds
@@ -0,0 +1,45 @@
+#include "LoadShedder.h"
+#include "../util/DeferredLog.h"
+
+void LoadShedder::update(bool missed, unsigned long nowMs) {
+    if (missed) {
+        windowMisses++;
+    }
+    if (nowMs - windowStart < LampConfig::SHED_WINDOW_MS) {
+        return;
+    }
+
+    uint8_t current = level.load();
+    stats.msAtLevel[current] += nowMs - windowStart;
+    if (windowMisses >= LampConfig::SHED_RAISE_MISSES) {
+        cleanWindows = 0;
+        if (current < (uint8_t)ShedLevel::COUNT - 1) {
+            current++;
+            stats.raises++;
+            LOG_DEFERRED("Loop missed %d deadlines in %lu ms, shedding: %s\n",
+                         windowMisses, (unsigned long)LampConfig::SHED_WINDOW_MS, levelName((ShedLevel)current));
+        }
+    } else if (windowMisses > 0) {
+        cleanWindows = 0;
+    } else if (current > (uint8_t)ShedLevel::NONE && ++cleanWindows >= LampConfig::SHED_RECOVER_WINDOWS) {
+        cleanWindows = 0;
+        current--;
+        LOG_DEFERRED("Loop back on time, shedding: %s\n", levelName((ShedLevel)current));
+    }
+    level.store(current);
+    stats.level = current;
+    snapshot.publish(stats);
+
+    windowStart = nowMs;
+    windowMisses = 0;
+}
+
+const char* LoadShedder::levelName(ShedLevel level) {
+    switch (level) {
+        case ShedLevel::NONE: return "none";
+        case ShedLevel::DEFER_TELEMETRY: return "deferTelemetry";
+        case ShedLevel::THROTTLE_SERVER: return "throttleServer";
+        case ShedLevel::SUSPEND_ANIMATIONS: return "suspendAnimations";
+        default: return "?";
+    }
+}
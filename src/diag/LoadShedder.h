@@ -0,0 +1,46 @@
+#pragma once
+#include "../config/Config.h"
+#include "../util/DoubleBuffer.h"
+#include <atomic>
+#include <cstdint>
+
+// Non-critical work given up, in order, while the control loop misses deadlines
+enum class ShedLevel : uint8_t {
+    NONE,
+    DEFER_TELEMETRY,        // Reports wait (up to SHED_MAX_TELEMETRY_DEFER_MS)
+    THROTTLE_SERVER,        // handleClient() every SHED_SERVER_INTERVAL_MS
+    SUSPEND_ANIMATIONS,     // Status LED holds its current frame
+    COUNT
+};
+
+// Decides how much to shed from the deadline misses and overruns LoopStats
+// sees. Misses are counted per SHED_WINDOW_MS; a window with
+// SHED_RAISE_MISSES or more sheds one more level, and SHED_RECOVER_WINDOWS
+// clean windows in a row restore one. The PWM output is never shed: it is
+// written at the start of every pass whatever the level.
+//
+// update() runs on the loop task; the level can be read from any task.
+// test/test_load_shedder runs it against simulated network stalls.
+class LoadShedder {
+public:
+    struct Snapshot {
+        uint8_t level;
+        uint32_t raises;
+        uint32_t msAtLevel[(int)ShedLevel::COUNT];
+    };
+
+    void update(bool missed, unsigned long nowMs);
+    ShedLevel getLevel() const { return (ShedLevel)level.load(); }
+    // True while work at this level (or a lower one) is being shed
+    bool sheds(ShedLevel work) const { return level.load() >= (uint8_t)work; }
+    Snapshot read() const { return snapshot.read(); }
+    static const char* levelName(ShedLevel level);
+
+private:
+    std::atomic<uint8_t> level{(uint8_t)ShedLevel::NONE};
+    Snapshot stats = {};
+    DoubleBuffer<Snapshot> snapshot;
+    unsigned long windowStart = 0;
+    int windowMisses = 0;
+    int cleanWindows = 0;
+};
@@ -0,0 +1,108 @@
+#include "LoopStats.h"
+
+LoopStats::Activity::Activity(LoopStats& stats, LoopSubsystem subsystem)
+    : stats(stats), previous(stats.networkActivity.load()) {
+    stats.networkActivity.store((uint8_t)subsystem);
+}
+
+LoopStats::Activity::~Activity() {
+    stats.lastNetworkActivity.store(stats.networkActivity.load());
+    stats.lastNetworkActivityEndUs.store(micros());
+    stats.networkActivity.store(previous);
+}
+
+void LoopStats::beginIteration(uint32_t nowUs) {
+    if (resetRequested.exchange(false)) {
+        current = {};
+    }
+
+    lastMissed = false;
+    if (started) {
+        uint32_t lateness = (int32_t)(nowUs - expectedStartUs) > 0 ? nowUs - expectedStartUs : 0;
+        int bucket = 0;
+        while (bucket < BUCKETS - 1 && (lateness >> (bucket + 1)) != 0) {
+            bucket++;
+        }
+        current.lateness[bucket]++;
+        current.maxLatenessUs = max(current.maxLatenessUs, lateness);
+        if (lateness > LampConfig::LOOP_DEADLINE_SLACK_MS * 1000) {
+            current.deadlineMisses++;
+            current.blame[(int)networkCause(expectedStartUs)]++;
+            lastMissed = true;
+        }
+    }
+    started = true;
+    iterationStartUs = nowUs;
+    lastChargeUs = nowUs;
+    memset(passUs, 0, sizeof(passUs));
+}
+
+void LoopStats::charge(LoopSubsystem subsystem, uint32_t nowUs) {
+    passUs[(int)subsystem] += nowUs - lastChargeUs;
+    lastChargeUs = nowUs;
+}
+
+void LoopStats::endIteration(uint32_t nowUs, unsigned long sleepMs) {
+    uint32_t workUs = nowUs - iterationStartUs;
+    current.iterations++;
+    current.maxWorkUs = max(current.maxWorkUs, workUs);
+    if (workUs > LampConfig::LOOP_BUDGET_MS * 1000) {
+        // Preempted by the network task, or our own work was too slow
+        LoopSubsystem cause = networkCause(iterationStartUs);
+        if (cause == LoopSubsystem::OTHER) {
+            int longest = 0;
+            for (int i = 1; i < (int)LoopSubsystem::COUNT; i++) {
+                if (passUs[i] > passUs[longest]) {
+                    longest = i;
+                }
+            }
+            cause = (LoopSubsystem)longest;
+        }
+        current.overruns++;
+        current.blame[(int)cause]++;
+        lastMissed = true;
+    }
+    expectedStartUs = nowUs + sleepMs * 1000;
+    snapshot.publish(current);
+}
+
+LoopSubsystem LoopStats::networkCause(uint32_t sinceUs) const {
+    uint8_t activity = networkActivity.load();
+    if (activity != (uint8_t)LoopSubsystem::OTHER) {
+        return (LoopSubsystem)activity;
+    }
+    if ((int32_t)(lastNetworkActivityEndUs.load() - sinceUs) > 0) {
+        return (LoopSubsystem)lastNetworkActivity.load();
+    }
+    return LoopSubsystem::OTHER;
+}
+
+uint32_t LoopStats::latenessPercentileUs(const Snapshot& stats, float fraction) {
+    uint32_t total = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        total += stats.lateness[i];
+    }
+    uint32_t target = (uint32_t)(total * fraction);
+    uint32_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += stats.lateness[i];
+        if (seen > target) {
+            return (2UL << i) - 1;
+        }
+    }
+    return (2UL << (BUCKETS - 1)) - 1;
+}
+
+const char* LoopStats::subsystemName(LoopSubsystem subsystem) {
+    switch (subsystem) {
+        case LoopSubsystem::LAMP: return "lamp";
+        case LoopSubsystem::TOUCH: return "touch";
+        case LoopSubsystem::LOGGING: return "logging";
+        case LoopSubsystem::HOUSEKEEPING: return "housekeeping";
+        case LoopSubsystem::WEB_SERVER: return "webServer";
+        case LoopSubsystem::WIFI_CONNECT: return "wifiConnect";
+        case LoopSubsystem::TELEMETRY: return "telemetry";
+        case LoopSubsystem::OTA: return "ota";
+        default: return "other";
+    }
+}
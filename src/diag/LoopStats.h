@@ -0,0 +1,88 @@
+#pragma once
+#include "../config/Config.h"
+#include "../util/DoubleBuffer.h"
+#include <atomic>
+#include <cstdint>
+#include <Arduino.h>
+
+// What a late or overlong control loop pass is blamed on
+enum class LoopSubsystem : uint8_t {
+    LAMP,           // lamp.update(): inputs, PWM, status LED
+    TOUCH,
+    LOGGING,        // DeferredLog::drain() and the periodic reports
+    HOUSEKEEPING,   // Governor, energy model, memory sampling
+    WEB_SERVER,     // Network task: handleClient()
+    WIFI_CONNECT,   // Network task: tryConnect()
+    TELEMETRY,      // Network task: reports to the logging server / broker
+    OTA,            // Network task: firmware download
+    OTHER,          // Nothing of ours was running: WiFi driver, system tasks
+    COUNT
+};
+
+// Timing of the control loop: how long each pass takes and how late it
+// starts relative to the sleep it asked for. A pass that starts more than
+// LOOP_DEADLINE_SLACK_MS late is a deadline miss, e.g. because the network
+// task held the CPU serving requests; a pass whose work takes longer than
+// LOOP_BUDGET_MS is an overrun. Each of them is blamed on a subsystem: the
+// network task's current Activity if it was busy at the time, otherwise
+// the loop subsystem that took longest in the pass. Written by the loop
+// task, read by any task through a snapshot; load_gen.py reads it over
+// /api/loop.
+class LoopStats {
+public:
+    // Lateness histogram, bucket i counts [2^i, 2^(i+1)) us (bucket 0 also holds 0)
+    static const int BUCKETS = 20;
+
+    struct Snapshot {
+        uint32_t iterations;
+        uint32_t deadlineMisses;
+        uint32_t overruns;
+        uint32_t maxWorkUs;
+        uint32_t maxLatenessUs;
+        uint32_t lateness[BUCKETS];
+        uint32_t blame[(int)LoopSubsystem::COUNT];  // Misses and overruns per subsystem
+    };
+
+    // Marks what the network task is doing while in scope (network task only)
+    class Activity {
+    public:
+        Activity(LoopStats& stats, LoopSubsystem subsystem);
+        ~Activity();
+    private:
+        LoopStats& stats;
+        uint8_t previous;
+    };
+
+    void beginIteration(uint32_t nowUs);
+    // Charges the time since the previous charge (or the start of the pass) to a loop subsystem
+    void charge(LoopSubsystem subsystem, uint32_t nowUs);
+    void endIteration(uint32_t nowUs, unsigned long sleepMs);
+    // The pass that just ended started late or overran; feeds LoadShedder
+    bool lastPassMissed() const { return lastMissed; }
+    Snapshot read() const { return snapshot.read(); }
+    void requestReset() { resetRequested.store(true); }  // Any task
+
+    // Upper bound of the bucket holding the given fraction (0-1) of passes
+    static uint32_t latenessPercentileUs(const Snapshot& stats, float fraction);
+    static const char* subsystemName(LoopSubsystem subsystem);
+
+private:
+    Snapshot current = {};
+    DoubleBuffer<Snapshot> snapshot;
+    std::atomic<bool> resetRequested{false};
+    uint32_t iterationStartUs = 0;
+    uint32_t expectedStartUs = 0;
+    uint32_t lastChargeUs = 0;
+    uint32_t passUs[(int)LoopSubsystem::COUNT] = {};
+    bool started = false;
+    bool lastMissed = false;
+
+    // Set by Activity on the network task. The two are written separately,
+    // so a blame can occasionally go to the neighbouring activity.
+    std::atomic<uint8_t> networkActivity{(uint8_t)LoopSubsystem::OTHER};
+    std::atomic<uint8_t> lastNetworkActivity{(uint8_t)LoopSubsystem::OTHER};
+    std::atomic<uint32_t> lastNetworkActivityEndUs{0};
+
+    // The network activity that was running at some point since sinceUs, or OTHER
+    LoopSubsystem networkCause(uint32_t sinceUs) const;
+};
@@ -0,0 +1,213 @@
+#include "MemStats.h"
+#include <esp_heap_caps.h>
+
+MemStats::TaskEntry MemStats::tasks[MemStats::MAX_TASKS];
+int MemStats::taskCount = 0;
+MemStats::TagCounters MemStats::counters[(int)MemTag::COUNT];
+uint32_t MemStats::lastLoopAllocations = 0;
+uint32_t MemStats::loopAllocations = 0;
+uint32_t MemStats::maxLoopAllocations = 0;
+
+namespace {
+    portMUX_TYPE memMux = portMUX_INITIALIZER_UNLOCKED;
+}
+
+void MemStats::registerTask(MemTag tag, const char* name) {
+    portENTER_CRITICAL(&memMux);
+    if (taskCount < MAX_TASKS) {
+        tasks[taskCount].handle = xTaskGetCurrentTaskHandle();
+        tasks[taskCount].name = name;
+        tasks[taskCount].tag = tag;
+        taskCount++;
+    }
+    portEXIT_CRITICAL(&memMux);
+}
+
+int MemStats::findTask(TaskHandle_t handle) {
+    for (int i = 0; i < taskCount; i++) {
+        if (tasks[i].handle == handle) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Call with memMux held
+MemTag MemStats::tagOf(TaskHandle_t task) {
+    int slot = findTask(task);
+    return slot >= 0 ? tasks[slot].tag : MemTag::OTHER;
+}
+
+// The task table is read by the malloc wrappers of every task, so the tag
+// only changes under the same mux
+MemStats::Scope::Scope(MemTag tag) : slot(-1), previous(MemTag::OTHER) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    portENTER_CRITICAL(&memMux);
+    slot = findTask(self);
+    if (slot >= 0) {
+        previous = tasks[slot].tag;
+        tasks[slot].tag = tag;
+    }
+    portEXIT_CRITICAL(&memMux);
+}
+
+MemStats::Scope::~Scope() {
+    if (slot >= 0) {
+        portENTER_CRITICAL(&memMux);
+        tasks[slot].tag = previous;
+        portEXIT_CRITICAL(&memMux);
+    }
+}
+
+void MemStats::recordAlloc(size_t bytes) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    portENTER_CRITICAL(&memMux);
+    TagCounters& c = counters[(int)tagOf(self)];
+    c.allocations++;
+    c.netBytes += bytes;
+    if (c.netBytes > c.peakBytes) {
+        c.peakBytes = c.netBytes;
+    }
+    portEXIT_CRITICAL(&memMux);
+}
+
+void MemStats::recordFree(size_t bytes) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    portENTER_CRITICAL(&memMux);
+    TagCounters& c = counters[(int)tagOf(self)];
+    c.frees++;
+    c.netBytes -= bytes;
+    portEXIT_CRITICAL(&memMux);
+}
+
+void MemStats::sampleLoop() {
+    uint32_t allocations = read(MemTag::LAMP).allocations;
+    loopAllocations = allocations - lastLoopAllocations;
+    lastLoopAllocations = allocations;
+    maxLoopAllocations = max(maxLoopAllocations, loopAllocations);
+}
+
+MemStats::TagCounters MemStats::read(MemTag tag) {
+    portENTER_CRITICAL(&memMux);
+    TagCounters copy = counters[(int)tag];
+    portEXIT_CRITICAL(&memMux);
+    return copy;
+}
+
+const char* MemStats::tagName(MemTag tag) {
+    switch (tag) {
+        case MemTag::OTHER: return "other";
+        case MemTag::LAMP: return "lamp";
+        case MemTag::NETWORK: return "network";
+        case MemTag::TELEMETRY: return "telemetry";
+        case MemTag::OTA: return "ota";
+        default: return "?";
+    }
+}
+
+void MemStats::printReport() {
+    uint32_t freeHeap = ESP.getFreeHeap();
+    uint32_t largestBlock = ESP.getMaxAllocHeap();
+    Serial.printf("Heap: %lu free, %lu min free, %lu largest block (%lu%% fragmented)\n",
+                  (unsigned long)freeHeap, (unsigned long)ESP.getMinFreeHeap(),
+                  (unsigned long)largestBlock,
+                  freeHeap ? (unsigned long)(100 - largestBlock * 100 / freeHeap) : 0UL);
+    for (int i = 0; i < taskCount; i++) {
+        Serial.printf("  stack %-10s %lu bytes unused\n", tasks[i].name,
+                      (unsigned long)uxTaskGetStackHighWaterMark(tasks[i].handle));
+    }
+    #if MEM_STATS
+    Serial.printf("  allocations per loop: %lu (max %lu)\n",
+                  (unsigned long)loopAllocations, (unsigned long)maxLoopAllocations);
+    for (int i = 0; i < (int)MemTag::COUNT; i++) {
+        const TagCounters& c = counters[i];
+        Serial.printf("  %-10s %8lu allocs %8lu frees %7ld bytes held (peak %ld)\n",
+                      tagName((MemTag)i), (unsigned long)c.allocations, (unsigned long)c.frees,
+                      (long)c.netBytes, (long)c.peakBytes);
+    }
+    #endif
+}
+
+String MemStats::json() {
+    uint32_t freeHeap = ESP.getFreeHeap();
+    String result = "{\"freeHeap\":" + String(freeHeap) +
+                    ",\"minFreeHeap\":" + String(ESP.getMinFreeHeap()) +
+                    ",\"largestFreeBlock\":" + String(ESP.getMaxAllocHeap()) +
+                    ",\"stacks\":{";
+    for (int i = 0; i < taskCount; i++) {
+        if (i > 0) {
+            result += ",";
+        }
+        result += "\"" + String(tasks[i].name) + "\":" +
+                  String((unsigned long)uxTaskGetStackHighWaterMark(tasks[i].handle));
+    }
+    result += "}";
+
+    #if MEM_STATS
+    result += ",\"allocationsPerLoop\":" + String(loopAllocations) +
+              ",\"maxAllocationsPerLoop\":" + String(maxLoopAllocations) +
+              ",\"subsystems\":{";
+    for (int i = 0; i < (int)MemTag::COUNT; i++) {
+        const TagCounters& c = counters[i];
+        if (i > 0) {
+            result += ",";
+        }
+        result += "\"" + String(tagName((MemTag)i)) + "\":{\"allocations\":" + String(c.allocations) +
+                  ",\"frees\":" + String(c.frees) +
+                  ",\"netBytes\":" + String((long)c.netBytes) +
+                  ",\"peakBytes\":" + String((long)c.peakBytes) + "}";
+    }
+    result += "}";
+    #endif
+
+    return result + "}";
+}
+
+#if MEM_STATS
+// Linked in with -Wl,--wrap=malloc,--wrap=free,--wrap=realloc,--wrap=calloc.
+// Sizes come from the heap itself, so blocks carry no extra header and
+// memory allocated here can still be released with heap_caps_free().
+extern "C" {
+void* __real_malloc(size_t size);
+void __real_free(void* ptr);
+void* __real_realloc(void* ptr, size_t size);
+void* __real_calloc(size_t count, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    void* ptr = __real_malloc(size);
+    if (ptr) {
+        MemStats::recordAlloc(heap_caps_get_allocated_size(ptr));
+    }
+    return ptr;
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    void* ptr = __real_calloc(count, size);
+    if (ptr) {
+        MemStats::recordAlloc(heap_caps_get_allocated_size(ptr));
+    }
+    return ptr;
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    size_t oldSize = ptr ? heap_caps_get_allocated_size(ptr) : 0;
+    void* result = __real_realloc(ptr, size);
+    if (result || size == 0) {
+        if (ptr) {
+            MemStats::recordFree(oldSize);
+        }
+        if (result) {
+            MemStats::recordAlloc(heap_caps_get_allocated_size(result));
+        }
+    }
+    return result;
+}
+
+void __wrap_free(void* ptr) {
+    if (ptr) {
+        MemStats::recordFree(heap_caps_get_allocated_size(ptr));
+    }
+    __real_free(ptr);
+}
+}
+#endif
@@ -0,0 +1,77 @@
+#pragma once
+#include "../config/Config.h"
+#include <cstdint>
+#include <Arduino.h>
+
+// Subsystems heap allocations are charged to
+enum class MemTag : uint8_t {
+    OTHER,       // Framework, WiFi stack, anything before setup()
+    LAMP,        // Loop task
+    NETWORK,     // Network task: web server, config, mDNS
+    TELEMETRY,   // Monitoring reports
+    OTA,         // Firmware update download
+    COUNT
+};
+
+// Heap, stack and fragmentation accounting. Heap totals, the low-water
+// mark, the largest free block and per-task stack watermarks are always
+// available. With MEM_STATS=1 (which needs the linker to wrap malloc, see
+// the mem_stats environment) every allocation and free is also counted
+// against the subsystem of the task that made it, so String churn or a
+// leak shows up per subsystem and per loop iteration in a soak test. Host
+// builds get the same numbers, with the heap figures following the process
+// heap (host/HostDevice.h).
+//
+// A block freed by a different subsystem than allocated it is credited to
+// the one that freed it; the net bytes of a subsystem that only hands
+// buffers on can go negative.
+class MemStats {
+public:
+    struct TagCounters {
+        uint32_t allocations;
+        uint32_t frees;
+        int32_t netBytes;
+        int32_t peakBytes;
+    };
+
+    // Charge the calling task's allocations to a subsystem
+    static void registerTask(MemTag tag, const char* name);
+
+    // Charges allocations to another subsystem while in scope (calling task only)
+    class Scope {
+    public:
+        explicit Scope(MemTag tag);
+        ~Scope();
+    private:
+        int slot;
+        MemTag previous;
+    };
+
+    static void sampleLoop();   // Once per loop() pass, on the loop task
+    static TagCounters read(MemTag tag);
+    static void printReport();
+    static String json();
+
+    // Called by the malloc wrappers
+    static void recordAlloc(size_t bytes);
+    static void recordFree(size_t bytes);
+
+private:
+    struct TaskEntry {
+        TaskHandle_t handle;
+        const char* name;
+        MemTag tag;          // Under memMux, like the counters
+    };
+
+    static const int MAX_TASKS = 4;
+    static TaskEntry tasks[MAX_TASKS];
+    static int taskCount;
+    static TagCounters counters[(int)MemTag::COUNT];
+    static uint32_t lastLoopAllocations;
+    static uint32_t loopAllocations;
+    static uint32_t maxLoopAllocations;
+
+    static int findTask(TaskHandle_t handle);
+    static MemTag tagOf(TaskHandle_t task);
+    static const char* tagName(MemTag tag);
+};
@@ -0,0 +1,145 @@
+#include "AdcCalibration.h"
+#include "../util/DeferredLog.h"
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <esp_adc_cal.h>
+
+namespace {
+const uint32_t STORED_MAGIC = 0xADC0CA12;
+const uint32_t PENDING_MAGIC = 0xADC0CA01;
+const int EEPROM_SIZE = 512;    // Same emulated EEPROM as the WiFi config
+const int ADC_BITS = 12;        // The characterisation is for raw 12-bit readings
+}
+
+static_assert(sizeof(WiFiConfig) <= LampConfig::ADC_CAL_EEPROM_ADDR, "calibration would overlap the WiFi config");
+
+
+void AdcCalibration::begin() {
+    characterise();
+    load();
+    build();
+    Serial.printf("ADC calibration: %s, full scale %umV\n", describe(), (unsigned)table[SEGMENTS]);
+}
+
+void AdcCalibration::characterise() {
+    esp_adc_cal_characteristics_t characteristics;
+    esp_adc_cal_value_t value = esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12,
+                                                         LampConfig::ADC_DEFAULT_VREF_MV, &characteristics);
+    switch (value) {
+        case ESP_ADC_CAL_VAL_EFUSE_VREF:
+            source = Source::EFUSE_VREF;
+            break;
+        case ESP_ADC_CAL_VAL_DEFAULT_VREF:
+            source = Source::DEFAULT_VREF;
+            break;
+        default:
+            source = Source::EFUSE_TWO_POINT;
+            break;
+    }
+
+    // Characterised curve, divider included, at the segment ends
+    for (int i = 0; i <= SEGMENTS; i++) {
+        uint32_t raw = (uint32_t)(i << SEGMENT_SHIFT) << (ADC_BITS - LampConfig::ADC_RESOLUTION);
+        if (raw > (1u << ADC_BITS) - 1) {
+            raw = (1u << ADC_BITS) - 1;
+        }
+        uint32_t pinMv = esp_adc_cal_raw_to_voltage(raw, &characteristics);
+        table[i] = (uint16_t)(pinMv * LampConfig::VOLTAGE_DIVIDER_RATIO + 0.5f);
+    }
+}
+
+void AdcCalibration::build() {
+    if (!stored.valid) {
+        return;
+    }
+    // Map the characterised values through the line between the two points
+    int32_t e0 = toMillivolts(stored.raw[0]);
+    int32_t e1 = toMillivolts(stored.raw[1]);
+    if (e1 <= e0) {
+        stored.valid = false;
+        return;
+    }
+    int32_t m0 = stored.packMv[0];
+    int32_t m1 = stored.packMv[1];
+    for (int i = 0; i <= SEGMENTS; i++) {
+        int32_t mv = m0 + (table[i] - e0) * (m1 - m0) / (e1 - e0);
+        table[i] = (uint16_t)constrain(mv, (int32_t)0, (int32_t)UINT16_MAX);
+    }
+}
+
+AdcCalibration::PointResult AdcCalibration::addPoint(int raw, uint16_t packMv) {
+    if (pending.raw < 0) {
+        pending = {PENDING_MAGIC, (int16_t)raw, packMv};
+        savePending();
+        LOG_DEFERRED("ADC calibration point: raw %d = %umV, waiting for a second point\n", raw, (unsigned)packMv);
+        return PointResult::PENDING;
+    }
+    if (abs((int)packMv - (int)pending.packMv) < LampConfig::ADC_CAL_MIN_SPAN_MV || raw == pending.raw ||
+        (raw > pending.raw) != (packMv > pending.packMv)) {
+        LOG_DEFERRED("ADC calibration point rejected: raw %d = %umV against raw %d = %umV\n", raw, (unsigned)packMv,
+                     (int)pending.raw, (unsigned)pending.packMv);
+        return PointResult::REJECTED;
+    }
+
+    int low = raw < pending.raw ? 0 : 1;
+    stored.magic = STORED_MAGIC;
+    stored.raw[low] = raw;
+    stored.packMv[low] = packMv;
+    stored.raw[1 - low] = pending.raw;
+    stored.packMv[1 - low] = pending.packMv;
+    stored.valid = true;
+    pending = {0, -1, 0};
+
+    // The table still holds the previous correction; start from the eFuse curve again
+    characterise();
+    build();
+    save();
+    savePending();
+    LOG_DEFERRED("ADC calibration saved: raw %d = %umV, raw %d = %umV\n",
+                 (int)stored.raw[0], (unsigned)stored.packMv[0], (int)stored.raw[1], (unsigned)stored.packMv[1]);
+    return PointResult::COMPLETED;
+}
+
+void AdcCalibration::clear() {
+    stored = {};
+    pending = {0, -1, 0};
+    save();
+    savePending();
+    characterise();
+}
+
+const char* AdcCalibration::describe() const {
+    switch (source) {
+        case Source::EFUSE_VREF:
+            return stored.valid ? "efuse-vref+2pt" : "efuse-vref";
+        case Source::EFUSE_TWO_POINT:
+            return stored.valid ? "efuse-tp+2pt" : "efuse-tp";
+        default:
+            return stored.valid ? "default+2pt" : "default";
+    }
+}
+
+void AdcCalibration::load() {
+    EEPROM.begin(EEPROM_SIZE);
+    EEPROM.get(LampConfig::ADC_CAL_EEPROM_ADDR, stored);
+    if (stored.magic != STORED_MAGIC) {
+        stored = {};
+    }
+    EEPROM.get(PENDING_ADDR, pending);
+    if (pending.magic != PENDING_MAGIC || pending.raw < 0 || pending.raw > LampConfig::MAX_ANALOG) {
+        pending = {0, -1, 0};
+    }
+}
+
+void AdcCalibration::save() {
+    EEPROM.begin(EEPROM_SIZE);
+    EEPROM.put(LampConfig::ADC_CAL_EEPROM_ADDR, stored);
+    EEPROM.commit();
+}
+
+void AdcCalibration::savePending() {
+    static_assert(PENDING_ADDR + sizeof(StoredPending) <= EEPROM_SIZE, "calibration would not fit in EEPROM");
+    EEPROM.begin(EEPROM_SIZE);
+    EEPROM.put(PENDING_ADDR, pending);
+    EEPROM.commit();
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include "../config/Config.h"
+#include <cstdint>
+
+// Converts raw readings of the battery sense pin to pack millivolts.
+//
+// The ADC is far from linear at 11 dB attenuation, and its gain varies
+// from chip to chip. begin() characterises it once from the chip's eFuse
+// calibration (or the default reference if the chip has none). A two-point
+// calibration against a meter, stored in EEPROM, is applied on top. The
+// result, divider included, goes into a table of 2^ADC_CAL_SEGMENT_BITS
+// linear segments. Each reading is then one lookup and an integer
+// interpolation, with no float math on the loop.
+class AdcCalibration {
+public:
+    enum class Source : uint8_t {
+        DEFAULT_VREF,
+        EFUSE_VREF,         // Reference voltage burned at the factory
+        EFUSE_TWO_POINT     // Two-point readings burned at the factory
+    };
+
+    // Once at boot, after the ADC resolution and attenuation are set
+    void begin();
+
+    // Pack voltage in mV for a reading at ADC_RESOLUTION
+    uint16_t toMillivolts(int raw) const {
+        if (raw < 0) raw = 0;
+        if (raw > LampConfig::MAX_ANALOG) raw = LampConfig::MAX_ANALOG;
+        int segment = raw >> SEGMENT_SHIFT;
+        int offset = raw & ((1 << SEGMENT_SHIFT) - 1);
+        int span = table[segment + 1] - table[segment];
+        return table[segment] + ((span * offset) >> SEGMENT_SHIFT);
+    }
+
+    enum class PointResult : uint8_t {
+        PENDING,        // Kept as the first point, waiting for the second
+        COMPLETED,      // Calibration built from both points and saved
+        REJECTED        // Too close to the first point, or on the wrong side of it
+    };
+
+    // Two-point calibration: the pack voltage measured with a meter while
+    // the ADC read raw. The first point is saved too, so a reboot between
+    // the two readings keeps it. The second must be ADC_CAL_MIN_SPAN_MV
+    // away and higher in both raw and mV, or lower in both; a rejected
+    // second point leaves the first one waiting.
+    PointResult addPoint(int raw, uint16_t packMv);
+    // Back to the eFuse characterisation alone, pending point dropped
+    void clear();
+
+    bool isCorrected() const { return stored.valid; }
+    Source getSource() const { return source; }
+    // e.g. "efuse-tp+2pt", for the status JSON
+    const char* describe() const;
+
+private:
+    static const int SEGMENTS = 1 << LampConfig::ADC_CAL_SEGMENT_BITS;
+    static const int SEGMENT_SHIFT = LampConfig::ADC_RESOLUTION - LampConfig::ADC_CAL_SEGMENT_BITS;
+
+    // Layout in EEPROM
+    struct StoredPoints {
+        uint32_t magic;
+        int16_t raw[2];
+        uint16_t packMv[2];
+        bool valid;
+    };
+    // First point of a calibration in progress, stored after StoredPoints
+    // with its own magic so calibrations saved before it still load
+    struct StoredPending {
+        uint32_t magic;
+        int16_t raw;            // -1 = none
+        uint16_t packMv;
+    };
+    static const int PENDING_ADDR = LampConfig::ADC_CAL_EEPROM_ADDR + (int)sizeof(StoredPoints);
+
+    Source source = Source::DEFAULT_VREF;
+    StoredPoints stored = {};
+    StoredPending pending = {0, -1, 0};
+    uint16_t table[SEGMENTS + 1] = {};
+
+    void characterise();    // Fills the table from eFuse alone
+    void build();           // Applies the stored points to it
+    void load();
+    void save();
+    void savePending();
+};
@@ -0,0 +1,175 @@
+#include "BrightnessProgram.h"
+#include <Arduino.h>
+#include <climits>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Segment values are knob units << 6 in a uint16_t: 10-bit ADC at most
+static_assert((uint32_t)LampConfig::MAX_ANALOG * 64 <= UINT16_MAX, "knob units << 6 must fit a segment value");
+
+namespace {
+uint16_t toValue(float percent) {
+    return (uint16_t)(percent / 100.0f * LampConfig::MAX_ANALOG * 64.0f + 0.5f);
+}
+
+bool append(CompiledProgram& program, uint32_t durationMs, uint16_t from, uint16_t to) {
+    if (program.count >= LampConfig::PROGRAM_MAX_SEGMENTS) {
+        return false;
+    }
+    program.segments[program.count++] = {durationMs, from, to};
+    return true;
+}
+}
+
+float BrightnessProgram::shape(Curve curve, float x) {
+    switch (curve) {
+        case Curve::EASE:
+            return x * x * (3.0f - 2.0f * x);
+        case Curve::EXP:
+            return (expf(LampConfig::PROGRAM_EXP_CURVE_K * x) - 1.0f) /
+                   (expf(LampConfig::PROGRAM_EXP_CURVE_K) - 1.0f);
+        default:
+            return x;
+    }
+}
+
+const char* BrightnessProgram::compile(const char* steps, float startPercent, uint32_t delayS,
+                                       CompiledProgram& program) {
+    program.count = 0;
+    if (startPercent < 0.0f || startPercent > 100.0f) {
+        return "start must be 0-100";
+    }
+    if (delayS > LampConfig::PROGRAM_MAX_DELAY_S) {
+        return "delay too long";
+    }
+    float level = startPercent;
+    if (delayS > 0 && !append(program, delayS * 1000, toValue(level), toValue(level))) {
+        return "too many segments";
+    }
+
+    const char* p = steps;
+    while (*p) {
+        char* end;
+        float seconds = strtof(p, &end);
+        if (end == p || *end != ':' || seconds <= 0.0f || seconds > LampConfig::PROGRAM_MAX_STEP_S) {
+            return "bad step duration";
+        }
+        p = end + 1;
+        float target = strtof(p, &end);
+        if (end == p || target < 0.0f || target > 100.0f) {
+            return "bad step level";
+        }
+        p = end;
+
+        Curve curve = Curve::LINEAR;
+        if (*p == ':') {
+            p++;
+            if (strncmp(p, "lin", 3) == 0) {
+                p += 3;
+            } else if (strncmp(p, "ease", 4) == 0) {
+                curve = Curve::EASE;
+                p += 4;
+            } else if (strncmp(p, "exp", 3) == 0) {
+                curve = Curve::EXP;
+                p += 3;
+            } else {
+                return "unknown curve";
+            }
+        }
+        if (*p == ',') {
+            p++;
+        } else if (*p != '\0') {
+            return "expected ','";
+        }
+
+        // A curve becomes PROGRAM_CURVE_PIECES straight lines
+        uint32_t durationMs = (uint32_t)(seconds * 1000.0f);
+        int pieces = curve == Curve::LINEAR ? 1 : LampConfig::PROGRAM_CURVE_PIECES;
+        for (int i = 0; i < pieces; i++) {
+            float x0 = (float)i / pieces;
+            float x1 = (float)(i + 1) / pieces;
+            uint32_t pieceMs = (uint32_t)((uint64_t)durationMs * (i + 1) / pieces - (uint64_t)durationMs * i / pieces);
+            if (!append(program, pieceMs,
+                        toValue(level + (target - level) * shape(curve, x0)),
+                        toValue(level + (target - level) * shape(curve, x1)))) {
+                return "too many segments";
+            }
+        }
+        level = target;
+    }
+    return program.count > 0 ? nullptr : "no steps";
+}
+
+void BrightnessProgram::start(const CompiledProgram& compiled, unsigned long now) {
+    program = compiled;
+    index = 0;
+    segmentStart = now;
+    running = program.count > 0;
+    if (running) {
+        enterSegment();
+    }
+}
+
+void BrightnessProgram::enterSegment() {
+    const ProgramSegment& segment = program.segments[index];
+    int32_t delta = (int32_t)segment.to - (int32_t)segment.from;
+    uint32_t duration = segment.durationMs > 0 ? segment.durationMs : 1;
+    slope = ((int64_t)delta << 16) / duration;
+    msPerStep = delta != 0 ? ((uint64_t)duration << VALUE_SHIFT) / abs(delta) : 0;
+}
+
+bool BrightnessProgram::update(unsigned long now, float& value) {
+    if (!running) {
+        return false;
+    }
+    // Catch up on every boundary passed while asleep
+    bool advanced = false;
+    while (index < program.count && now - segmentStart >= program.segments[index].durationMs) {
+        segmentStart += program.segments[index].durationMs;
+        index++;
+        advanced = true;
+    }
+    if (index >= program.count) {
+        running = false;
+        value = (float)program.segments[program.count - 1].to / (1 << VALUE_SHIFT);
+        return true;
+    }
+    if (advanced) {
+        enterSegment();
+    }
+
+    const ProgramSegment& segment = program.segments[index];
+    int32_t current = segment.from + (int32_t)((slope * (int64_t)(now - segmentStart)) >> 16);
+    value = (float)current / (1 << VALUE_SHIFT);
+    return true;
+}
+
+unsigned long BrightnessProgram::msUntilChange(unsigned long now) const {
+    if (!running) {
+        return ULONG_MAX;
+    }
+    unsigned long elapsed = now - segmentStart;
+    unsigned long left = program.segments[index].durationMs > elapsed
+                         ? program.segments[index].durationMs - elapsed : 0;
+    return msPerStep > 0 && msPerStep < left ? msPerStep : left;
+}
+
+unsigned long BrightnessProgram::darkMsRemaining(unsigned long now) const {
+    if (!running || program.segments[index].from != 0 || program.segments[index].to != 0) {
+        return 0;
+    }
+    return msUntilChange(now);
+}
+
+uint64_t BrightnessProgram::msRemaining(unsigned long now) const {
+    if (!running) {
+        return 0;
+    }
+    uint64_t total = 0;
+    for (int i = index; i < program.count; i++) {
+        total += program.segments[i].durationMs;
+    }
+    unsigned long elapsed = now - segmentStart;
+    return total > elapsed ? total - elapsed : 0;
+}
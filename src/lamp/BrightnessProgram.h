@@ -0,0 +1,71 @@
+#pragma once
+#include "../config/Config.h"
+#include <cstdint>
+
+// Straight line in knob units (0-MAX_ANALOG) * 64 over durationMs
+struct ProgramSegment {
+    uint32_t durationMs;
+    uint16_t from;
+    uint16_t to;
+};
+
+struct CompiledProgram {
+    uint8_t count;
+    ProgramSegment segments[LampConfig::PROGRAM_MAX_SEGMENTS];
+};
+
+// On-device brightness programs: sunrise ramps, sunsets, auto-off timers.
+//
+// compile() turns a schedule into straight segments once, on the network
+// task: "steps" is a comma-separated list of <seconds>:<level %>[:<curve>]
+// ramps from the previous level. Curves are lin (default), ease
+// (smoothstep) and exp (slow start, for sunrises). The curved ones are cut
+// into PROGRAM_CURVE_PIECES lines, so no curve math runs per tick.
+//
+//   start=0&delay=25200&steps=1800:100:exp    sunrise in 7 hours
+//   delay=1740&steps=60:0                     off in 30 minutes
+//
+// The loop task evaluates the current segment in fixed point and moves to
+// the next one when its time is up, however long it slept in between.
+// msUntilChange() tells the loop how long it can sleep before the output
+// needs to move, so a dark wait before a sunrise can be spent in light sleep.
+class BrightnessProgram {
+public:
+    enum class Curve : uint8_t {
+        LINEAR,
+        EASE,
+        EXP
+    };
+
+    // startPercent: level during the delay and where the first ramp starts.
+    // Returns nullptr or a description of what's wrong with the schedule.
+    static const char* compile(const char* steps, float startPercent, uint32_t delayS,
+                               CompiledProgram& program);
+
+    void start(const CompiledProgram& compiled, unsigned long now);
+    void stop() { running = false; }
+    bool isRunning() const { return running; }
+
+    // Knob units (0-MAX_ANALOG) at now; false once stopped. When the last
+    // segment ends the program stops and its final level is kept.
+    bool update(unsigned long now, float& value);
+    // Time until the output moves by one knob unit or the next segment starts
+    unsigned long msUntilChange(unsigned long now) const;
+    // Time left in a segment that holds the output dark, 0 if not in one
+    unsigned long darkMsRemaining(unsigned long now) const;
+    // Until the end of the last segment; 64 full segments overflow 32 bits
+    uint64_t msRemaining(unsigned long now) const;
+
+private:
+    static const int VALUE_SHIFT = 6;   // Segment values are knob units << 6
+
+    CompiledProgram program = {};
+    bool running = false;
+    uint8_t index = 0;
+    unsigned long segmentStart = 0;
+    int64_t slope = 0;                  // Value units per ms, Q16
+    unsigned long msPerStep = 0;        // Per knob unit, 0 for a flat segment
+
+    void enterSegment();
+    static float shape(Curve curve, float x);
+};
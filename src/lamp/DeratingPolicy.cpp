@@ -0,0 +1,62 @@
+#include "DeratingPolicy.h"
+#include <Arduino.h>
+
+namespace {
+    struct Band {
+        float voltage;   // Pack voltage
+        float cap;       // Maximum output at that voltage, 0-1
+    };
+
+    // Highest voltage first; full output above the first band, the last
+    // cap holds below the last band.
+    const Band BANDS[] = {
+        {11.0f, 1.00f},
+        {10.6f, 0.80f},
+        {10.2f, 0.60f},
+        { 9.9f, 0.40f},   // LOW_VOLTAGE_THRESHOLD
+        { 9.6f, 0.25f},
+    };
+    const int BAND_COUNT = sizeof(BANDS) / sizeof(BANDS[0]);
+}
+
+float DeratingPolicy::capForVoltage(float packVoltage) {
+    if (packVoltage >= BANDS[0].voltage) {
+        return BANDS[0].cap;
+    }
+    for (int i = 1; i < BAND_COUNT; i++) {
+        if (packVoltage >= BANDS[i].voltage) {
+            const Band& upper = BANDS[i - 1];
+            const Band& lower = BANDS[i];
+            float t = (packVoltage - lower.voltage) / (upper.voltage - lower.voltage);
+            return lower.cap + (upper.cap - lower.cap) * t;
+        }
+    }
+    return BANDS[BAND_COUNT - 1].cap;
+}
+
+uint32_t DeratingPolicy::update(float packVoltage, unsigned long now) {
+    if (!started) {
+        // Start at the cap the first reading calls for instead of slewing
+        // down from full output, unless restore() carried one over
+        started = true;
+        lastUpdateTime = now;
+        if (trackedVoltage == 0.0f) {
+            trackedVoltage = packVoltage;
+            cap = overridden ? 1.0f : capForVoltage(packVoltage);
+        }
+    }
+
+    if (packVoltage < trackedVoltage) {
+        trackedVoltage = packVoltage;
+    } else if (packVoltage > trackedVoltage + LampConfig::DERATE_HYSTERESIS_V) {
+        trackedVoltage = packVoltage - LampConfig::DERATE_HYSTERESIS_V;
+    }
+
+    float target = overridden ? 1.0f : capForVoltage(trackedVoltage);
+
+    float maxStep = LampConfig::DERATE_SLEW_PER_S * (now - lastUpdateTime) / 1000.0f;
+    lastUpdateTime = now;
+    cap += constrain(target - cap, -maxStep, maxStep);
+
+    return (uint32_t)(cap * 65536.0f + 0.5f);
+}
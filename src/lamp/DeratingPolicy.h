@@ -0,0 +1,35 @@
+#pragma once
+#include "../config/Config.h"
+#include <cstdint>
+
+// Caps the lamp's maximum output as the pack voltage falls, to stretch the
+// last part of the discharge. The cap is interpolated between the voltage
+// bands in DeratingPolicy.cpp. The voltage it is taken from follows drops
+// immediately but only rises once the pack has recovered DERATE_HYSTERESIS_V,
+// so the sag relief from derating doesn't lift the cap straight back up.
+// The cap itself moves at most DERATE_SLEW_PER_S, so changes are gradual;
+// only the first reading sets it directly. test/test_derating_replay runs
+// the lamp_data discharge traces through it.
+class DeratingPolicy {
+public:
+    // Returns the output cap as a Q16 fraction (65536 = no derating)
+    uint32_t update(float packVoltage, unsigned long now);
+    void setOverride(bool enabled) { overridden = enabled; }
+    bool isOverridden() const { return overridden; }
+    float getCap() const { return cap; }
+    float getTrackedVoltage() const { return trackedVoltage; }
+    // Picks up where the previous run left off after a warm reset
+    void restore(float voltage, float outputCap) {
+        trackedVoltage = voltage;
+        cap = outputCap;
+    }
+
+    static float capForVoltage(float packVoltage);
+
+private:
+    float trackedVoltage = 0.0f;
+    float cap = 1.0f;
+    bool overridden = false;
+    bool started = false;
+    unsigned long lastUpdateTime = 0;
+};
@@ -1,17 +1,45 @@
 #include "LampController.h"
 #include <Arduino.h>
 #include <math.h>
+#include "../util/DeferredLog.h"
+#include "LumenCompensationTable.h"
 
 LampController::LampController() {}
 
+bool LampController::restoreOutput() {
+    RetainedState state;
+    if (!WarmBoot::restore(state)) {
+        return false;
+    }
+    warmBoot = true;
+    filteredValue = state.filteredValue;
+    batteryVoltage = state.batteryVoltage;
+    lastPotValue = state.lastPotValue;
+    mode = state.remoteMode ? ControlMode::REMOTE : ControlMode::POTENTIOMETER;
+    derating.restore(state.trackedVoltage, state.outputCap);
+
+    output.begin();
+    output.setCct(state.cct);
+    output.setLimit((uint32_t)(state.outputCap * 65536.0f + 0.5f));
+    output.setSupplyGain(state.supplyGain);
+    uint32_t level = output.render((int)(filteredValue + 1));
+    pwmValue = level * (float)LampConfig::MAX_PWM / 65536.0f;
+    timeToLightUs = micros();
+    return true;
+}
+
 void LampController::begin() {
-    // Configure RGB LED pins as outputs and set them LOW BEFORE PWM setup
+    // Configure RGB LED pins as outputs and set them LOW BEFORE PWM setup.
+    // On the v1 board the blue pin is the lamp output, which restoreOutput()
+    // may already be driving, so it is left to the output stage.
     pinMode(LampConfig::LED_R, OUTPUT);
     pinMode(LampConfig::LED_G, OUTPUT);
-    pinMode(LampConfig::LED_B, OUTPUT);
     digitalWrite(LampConfig::LED_R, LOW);
     digitalWrite(LampConfig::LED_G, LOW);
-    digitalWrite(LampConfig::LED_B, LOW);
+    if (!LampConfig::LED_B_SHARES_OUTPUT) {
+        pinMode(LampConfig::LED_B, OUTPUT);
+        digitalWrite(LampConfig::LED_B, LOW);
+    }
     
     // Initialize RGB status LED PWM channels
     ledcSetup(LampConfig::RGB_R_CHANNEL, LampConfig::PWM_FREQ, LampConfig::PWM_RESOLUTION);
@@ -25,34 +53,45 @@ void LampController::begin() {
     
     ledcAttachPin(LampConfig::LED_R, LampConfig::RGB_R_CHANNEL);
     ledcAttachPin(LampConfig::LED_G, LampConfig::RGB_G_CHANNEL);
-    ledcAttachPin(LampConfig::LED_B, LampConfig::RGB_B_CHANNEL);
-    
-    setStatusLedColor(false, false, false);  // Ensure all LEDs are off
+    if (!LampConfig::LED_B_SHARES_OUTPUT) {
+        ledcAttachPin(LampConfig::LED_B, LampConfig::RGB_B_CHANNEL);
+    }
     
     analogReadResolution(LampConfig::ADC_RESOLUTION);
     analogSetAttenuation(ADC_11db);
     
-    ledcSetup(LampConfig::PWM_CHANNEL, 
-              LampConfig::PWM_FREQ, 
-              LampConfig::PWM_RESOLUTION);
-    ledcAttachPin(LampConfig::PWM_PIN, LampConfig::PWM_CHANNEL);
+    // Already running if restoreOutput() brought the light back, but the
+    // status LED setup above shares LEDC timers with it, so take those back
+    // without touching the duties
+    if (warmBoot) {
+        output.reattach();
+    } else {
+        output.begin();
+    }
     
     // Configure voltage monitoring pin
     analogSetPinAttenuation(LampConfig::VOLTAGE_PIN, ADC_11db);
-
+    adcCalibration.begin();
     
     // Initialize voltage reading before any checks are performed
-    // Take multiple readings to stabilize the value
-    for (int i = 0; i < 10; i++) {
-        updateBatteryVoltage();
-        delay(10);
+    // Take multiple readings to stabilize the value. After a warm reset the
+    // saved estimate is used and the filter in update() catches up from there.
+    if (!warmBoot) {
+        for (int i = 0; i < 10; i++) {
+            updateBatteryVoltage();
+            delay(10);
+        }
     }
     
-    Serial.printf("Initial battery voltage: %.2fV\n", batteryVoltage);
+    Serial.printf("%s battery voltage: %.2fV\n", warmBoot ? "Restored" : "Initial", batteryVoltage);
     
     // turn off the onboard led
-    pinMode(LampConfig::ONBOARD_LED_PIN, OUTPUT);
-    digitalWrite(LampConfig::ONBOARD_LED_PIN, HIGH);
+    if (LampConfig::ONBOARD_LED_PIN >= 0) {
+        pinMode(LampConfig::ONBOARD_LED_PIN, OUTPUT);
+        digitalWrite(LampConfig::ONBOARD_LED_PIN, HIGH);
+    }
+
+    beginTouch();
 
     // Get ESP32-C3 unique hardware ID (chip ID)
     esp_serial_number = ESP.getEfuseMac();
@@ -63,6 +102,8 @@ void LampController::begin() {
 
 void LampController::update() {
     static int printCounter = 0;
+    processCommands();
+
     int rawValue = analogRead(LampConfig::DIMMER_ANALOG_PIN);
     
     switch(mode) {
@@ -74,50 +115,55 @@ void LampController::update() {
             handleRemoteMode(rawValue);
             break;
     }
+    updateProgram();
     
     // Always update main PWM output (never block it)
-    pwmValue = mapExponential(filteredValue+1, LampConfig::EXP_FACTOR);
-    ledcWrite(LampConfig::PWM_CHANNEL, (int)pwmValue);
+    uint32_t level = output.render((int)(filteredValue + 1));
+    pwmValue = level * (float)LampConfig::MAX_PWM / 65536.0f;
+    // A cold boot is ready to light at its first render, whatever the knob
+    // says; waiting for isActive() would time the user, not the boot
+    if (timeToLightUs == 0) {
+        timeToLightUs = micros();
+        LOG_DEFERRED("Time to light: %lu us (cold boot)\n", (unsigned long)timeToLightUs);
+    }
     
-    // Update battery indicator animation if active (runs in parallel)
-    if (indicatorState != BatteryIndicatorState::IDLE) {
-        updateBatteryIndicator();
+    output.hopFrequency(millis());
+
+    // Status LED animation (runs in parallel, constant cost per frame)
+    if (!animationsSuspended) {
+        statusLed.update(millis());
     }
 
     updateBatteryVoltage();
+    output.setLimit(derating.update(batteryVoltage, millis()));
+    if (LampConfig::LUMEN_COMPENSATION) {
+        output.setSupplyGain(LumenCompensationTable::gainFor(batteryVoltage));
+    }
 
     // Check low voltage warning
     checkLowVoltageWarning();
 
     #if SERIAL_DEBUG
     // Print only every 10th cycle with consistent formatting
+    // Formatting is deferred to DeferredLog::drain() so it doesn't skew loop timing
     if (++printCounter >= 10) {
-        char pwmStr[6];
-        char voltStr[6];
-        char rawPwmStr[6];
-        char filteredValueStr[6];
-
-        snprintf(pwmStr, sizeof(pwmStr), "%04.1f", (pwmValue / LampConfig::MAX_PWM) * 100.0f);
-        snprintf(voltStr, sizeof(voltStr), "%04.2f", batteryVoltage);
-        snprintf(rawPwmStr, sizeof(rawPwmStr), "%04d", (int)pwmValue);
-        snprintf(filteredValueStr, sizeof(filteredValueStr), "%04d", (int)filteredValue);
-        #if SUPPORT_TOUCH
-        int touchValue = touchRead(LampConfig::TOUCH_PIN);
-        Serial.printf("Input: %04d, PWM: %s%%, Voltage: %sV, Touch: %d\n", 
-                rawValue,
-                pwmStr,
-                voltStr,
-                touchValue
-        );
-        #else
-        Serial.printf("Input: %04d, PWM: %s%%, Raw PWM: %s, Filtered: %s, Voltage: %sV\n", 
-                rawValue,
-                pwmStr,
-                rawPwmStr,
-                filteredValueStr,
-                voltStr
-        );
-        #endif
+        if (BoardTouch::AVAILABLE) {
+            LOG_DEFERRED("Input: %04d, PWM: %04.1f%%, Voltage: %04.2fV, Touch: %d/%d\n", 
+                    rawValue,
+                    (pwmValue / LampConfig::MAX_PWM) * 100.0f,
+                    batteryVoltage,
+                    touchValue,
+                    (int)touchThreshold
+            );
+        } else {
+            LOG_DEFERRED("Input: %04d, PWM: %04.1f%%, Raw PWM: %04d, Filtered: %04d, Voltage: %04.2fV\n", 
+                    rawValue,
+                    (pwmValue / LampConfig::MAX_PWM) * 100.0f,
+                    (int)pwmValue,
+                    (int)filteredValue,
+                    batteryVoltage
+            );
+        }
         
         printCounter = 0;
     }
@@ -130,20 +176,106 @@ void LampController::update() {
         // Check if it's also time to report data
         if (shouldReportData()) {
             lastReportTime = millis();
-            dataReadyToSend = true;
+            reportSequence++;
         }
     }
     #endif
+
+    publishStatus();
+    saveRetainedState();
 }
 
-bool LampController::isActive() const {
-    return pwmValue > (LampConfig::MAX_PWM * 0.001f); // 0.1% threshold
+void LampController::processCommands() {
+    LampCommand command;
+    while (commandQueue.pop(command)) {
+        switch (command.type) {
+            case LampCommand::Type::SET_BRIGHTNESS:
+                setRemoteValue(command.value);
+                break;
+            case LampCommand::Type::SET_CCT:
+                output.setCct((int)command.value);
+                break;
+            case LampCommand::Type::SET_DERATING_OVERRIDE:
+                derating.setOverride(command.value != 0.0f);
+                break;
+            case LampCommand::Type::START_PROGRAM:
+                program.start(pendingProgram.read(), millis());
+                programsStarted++;
+                mode = ControlMode::REMOTE;
+                lastPotValue = analogRead(LampConfig::DIMMER_ANALOG_PIN);
+                LOG_DEFERRED("Program started, %lu s\n", (unsigned long)(program.msRemaining(millis()) / 1000));
+                break;
+            case LampCommand::Type::STOP_PROGRAM:
+                program.stop();
+                break;
+            case LampCommand::Type::CALIBRATE_VOLTAGE:
+                calibrateVoltage(command.value);
+                break;
+            case LampCommand::Type::CLEAR_CALIBRATION:
+                adcCalibration.clear();
+                break;
+            case LampCommand::Type::SHOW_PATTERN:
+                statusLed.play((StatusPattern)(int)command.value);
+                break;
+            case LampCommand::Type::SET_BACKGROUND:
+                statusLed.setBackground((StatusPattern)(int)command.value);
+                break;
+            case LampCommand::Type::CLEAR_BACKGROUND:
+                statusLed.clearBackground();
+                break;
+        }
+    }
+}
+
+void LampController::publishStatus() {
+    LampStatus status;
+    status.brightness = (filteredValue / LampConfig::MAX_ANALOG) * 100.0f;
+    status.batteryVoltage = batteryVoltage;
+    status.pwmDuty = getPwmDuty();
+    status.cct = output.getCct();
+    status.outputCap = derating.getCap();
+    status.deratingOverride = derating.isOverridden();
+    status.adcCalibration = adcCalibration.describe();
+    status.warmBoot = warmBoot;
+    status.timeToLightUs = timeToLightUs;
+    status.reportSequence = reportSequence;
+    status.programRunning = program.isRunning();
+    status.programRemainingS = (uint32_t)(program.msRemaining(millis()) / 1000);
+    status.programsStarted = programsStarted;
+    status.calibrationPoints = calibrationPoints;
+    status.calibrationResult = calibrationResult;
+    statusSnapshot.publish(status);
 }
 
-float LampController::mapExponential(int input, float exponent) {
-    float normalized = static_cast<float>(input) / LampConfig::MAX_ANALOG;
-    float exponential = pow(normalized, exponent);
-    return exponential * LampConfig::MAX_PWM;
+void LampController::saveRetainedState() {
+    RetainedState state;
+    state.filteredValue = filteredValue;
+    state.batteryVoltage = batteryVoltage;
+    state.trackedVoltage = derating.getTrackedVoltage();
+    state.outputCap = derating.getCap();
+    state.supplyGain = output.getSupplyGain();
+    state.cct = output.getCct();
+    state.lastPotValue = lastPotValue;
+    state.remoteMode = mode == ControlMode::REMOTE;
+    WarmBoot::save(state, millis());
+}
+
+void LampController::reconfigureClocks() {
+    // Re-derive the LEDC timer dividers from the new APB clock
+    ledcSetup(LampConfig::RGB_R_CHANNEL, LampConfig::PWM_FREQ, LampConfig::PWM_RESOLUTION);
+    ledcSetup(LampConfig::RGB_G_CHANNEL, LampConfig::PWM_FREQ, LampConfig::PWM_RESOLUTION);
+    ledcSetup(LampConfig::RGB_B_CHANNEL, LampConfig::PWM_FREQ, LampConfig::PWM_RESOLUTION);
+
+    // Restore duties; the status LED rewrites its own on the next frame
+    output.reconfigure();
+    statusLed.refresh();
+
+    analogReadResolution(LampConfig::ADC_RESOLUTION);
+    analogSetAttenuation(ADC_11db);
+}
+
+bool LampController::isActive() const {
+    return pwmValue > (LampConfig::MAX_PWM * 0.001f); // 0.1% threshold
 }
 
 void LampController::updateTimings(int rawValue) {
@@ -178,6 +310,8 @@ void LampController::handleRemoteMode(int rawValue) {
 }
 
 void LampController::setRemoteValue(float percentage) {
+    // Any manual setting takes over from a running program
+    program.stop();
     // Convert percentage (0-100) to filtered value range (0-MAX_ANALOG)
     float targetValue = (percentage / 100.0f) * LampConfig::MAX_ANALOG;
     filteredValue = targetValue;  // Set initial value
@@ -188,66 +322,215 @@ void LampController::setRemoteValue(float percentage) {
 void LampController::updateBatteryVoltage() {
     int rawVoltage = analogRead(LampConfig::VOLTAGE_PIN);
     
-    // Convert ADC reading to voltage
-    float pinVoltage = (rawVoltage * LampConfig::VOLTAGE_REFERENCE) / LampConfig::MAX_ANALOG;
-    
-    // Calculate actual battery voltage using voltage divider formula
-    float newVoltage = pinVoltage * LampConfig::VOLTAGE_DIVIDER_RATIO;
+    // One table lookup covers the ADC curve, the divider and the calibration
+    float newVoltage = adcCalibration.toMillivolts(rawVoltage) * 0.001f;
     
-    // Apply calibration correction
-    newVoltage = newVoltage * LampConfig::VOLTAGE_SCALE + LampConfig::VOLTAGE_OFFSET;
-    
-    // Apply alpha filter
+    // Apply alpha filter, seeded with the first reading so the derating
+    // policy doesn't see a pack ramping up from 0V at boot
+    if (batteryVoltage == 0.0f) {
+        batteryVoltage = newVoltage;
+        return;
+    }
     batteryVoltage = (LampConfig::VOLTAGE_ALPHA * newVoltage) + 
                      ((1 - LampConfig::VOLTAGE_ALPHA) * batteryVoltage);
 }
 
+bool LampController::loadProgram(const CompiledProgram& compiled) {
+    pendingProgram.publish(compiled);
+    return postCommand({LampCommand::Type::START_PROGRAM, 0});
+}
+
+void LampController::updateProgram() {
+    // Turning the knob switched back to potentiometer mode: the user takes over
+    if (program.isRunning() && mode != ControlMode::REMOTE) {
+        program.stop();
+    }
+    unsigned long now = millis();
+    float value;
+    if (program.isRunning() && program.update(now, value)) {
+        filteredValue = value;
+        if (!program.isRunning()) {
+            LOG_DEFERRED("Program finished at %.1f%%\n", filteredValue / LampConfig::MAX_ANALOG * 100.0f);
+        }
+    }
+    if (program.isRunning()) {
+        // Wake up when the output next has to move, within the fast and slow mode intervals
+        sleepTime = (int)constrain(program.msUntilChange(now), 10UL, 100UL);
+        programPacesLoop = true;
+    } else if (programPacesLoop) {
+        // Finished or stopped: back to the cadence the knob would have set
+        sleepTime = inSlowMode ? 100 : 10;
+        programPacesLoop = false;
+    }
+}
+
+int LampController::getSleepTime() const {
+    // A touch is followed every TOUCH_POLL_MS, which the slow loop can't do
+    if (isTouchInProgress()) {
+        return 10;
+    }
+    return sleepTime;
+}
+
+bool LampController::isTouchInProgress() const {
+    return touchPending || !touchGestures.isIdle();
+}
+
+unsigned long LampController::getLightSleepMs() const {
+    // Only with nothing to show: LEDC stops in light sleep
+    if (isActive() || statusLed.isActive() || isTouchInProgress()) {
+        return 0;
+    }
+    // Only a timer wakes the chip, so sleep in short steps: the knob and
+    // touch pad are read between them and can still take over
+    return min(program.darkMsRemaining(millis()), (unsigned long)LampConfig::PROGRAM_LIGHT_SLEEP_MAX_MS);
+}
+
+void LampController::calibrateVoltage(float measured) {
+    calibrationPoints++;
+    // Also keeps the conversion to uint16_t mV defined
+    if (!(measured > 0.0f && measured * 1000.0f <= LampConfig::ADC_CAL_MAX_MV)) {
+        calibrationResult = AdcCalibration::PointResult::REJECTED;
+        return;
+    }
+    // Average out the noise; a meter reading is only as good as the ADC reading it's paired with
+    int sum = 0;
+    for (int i = 0; i < LampConfig::ADC_CAL_SAMPLES; i++) {
+        sum += analogRead(LampConfig::VOLTAGE_PIN);
+    }
+    int raw = (sum + LampConfig::ADC_CAL_SAMPLES / 2) / LampConfig::ADC_CAL_SAMPLES;
+    calibrationResult = adcCalibration.addPoint(raw, (uint16_t)(measured * 1000.0f + 0.5f));
+    if (calibrationResult == AdcCalibration::PointResult::COMPLETED) {
+        // Jump to the corrected value instead of filtering towards it
+        batteryVoltage = adcCalibration.toMillivolts(raw) * 0.001f;
+    }
+}
+
+std::atomic<bool> LampController::touchPending{false};
+std::atomic<unsigned long> LampController::touchInterruptTime{0};
+
+void IRAM_ATTR LampController::onTouchInterrupt() {
+    // Runs again on every pad measurement while held; keep the first one
+    if (!touchPending) {
+        touchInterruptTime = millis();
+        touchPending = true;
+    }
+}
+
+void LampController::beginTouch() {
+    if (!BoardTouch::AVAILABLE) {
+        return;
+    }
+    // Seed the baseline from a few untouched readings
+    int sum = 0;
+    for (int i = 0; i < 4; i++) {
+        sum += BoardTouch::read();
+    }
+    touchBaseline.seed(sum / 4);
+    touchThreshold = touchBaseline.threshold();
+    BoardTouch::attachInterrupt(onTouchInterrupt, touchThreshold);
+    lastTouchSample = millis();
+}
+
 void LampController::checkTouchStatus() {
-    #if SUPPORT_TOUCH
-    int touchValue = touchRead(LampConfig::TOUCH_PIN);
-    
-    // Only trigger if lamp is off and touch is detected
-    if (touchValue < LampConfig::TOUCH_THRESHOLD && !isActive()) {
-        showBatteryStatus();
+    // Folds away entirely on boards without touch
+    if (!BoardTouch::AVAILABLE) {
+        return;
     }
+    unsigned long now = millis();
+
+    if (touchGestures.isIdle() && !touchPending) {
+        // Nothing touched: sample now and then so the baseline follows
+        // humidity and temperature, and move the interrupt threshold with it
+        if (now - lastTouchSample < LampConfig::TOUCH_BASELINE_INTERVAL_MS) {
+            return;
+        }
+        lastTouchSample = now;
+        touchValue = BoardTouch::read();
+        #if SERIAL_DEBUG
+        LOG_DEFERRED("Touch trace %lu %d\n", now, touchValue);
+        #endif
+        if (!touchBaseline.isTouched(touchValue)) {
+            touchBaseline.update(touchValue);
+        }
+        if (touchBaseline.threshold() != touchThreshold) {
+            touchThreshold = touchBaseline.threshold();
+            BoardTouch::attachInterrupt(onTouchInterrupt, touchThreshold);
+        }
+        return;
+    }
+
+    // A touch is in progress; follow it until the gesture is resolved
+    unsigned long elapsed = now - lastTouchSample;
+    if (!touchGestures.isIdle() && elapsed < LampConfig::TOUCH_POLL_MS) {
+        return;
+    }
+    if (touchPending.exchange(false)) {
+        // The press began when the interrupt fired, up to a slow loop pass
+        // ago. One that fired after now was read is as good as now.
+        unsigned long touchedAt = touchInterruptTime;
+        touchGestures.touchedAt((long)(now - touchedAt) < 0 ? now : touchedAt);
+    }
+    lastTouchSample = now;
+    touchValue = BoardTouch::read();
+    #if SERIAL_DEBUG
+    LOG_DEFERRED("Touch trace %lu %d\n", now, touchValue);   // Replayable by test/test_touch_gestures
     #endif
+    handleGesture(touchGestures.update(touchBaseline.isTouched(touchValue), now), elapsed);
 }
 
+void LampController::handleGesture(TouchGesture gesture, unsigned long elapsed) {
+    float brightness = filteredValue / LampConfig::MAX_ANALOG * 100.0f;
+    switch (gesture) {
+        case TouchGesture::TAP:
+            showBatteryStatus();
+            break;
 
-// Helper to set RGB LED color with PWM control
-void LampController::setStatusLedColor(bool red, bool green, bool blue) {
-    // Calculate PWM values with 30% brightness scaling
-    int redValue = red ? (int)(LampConfig::MAX_PWM * LampConfig::RGB_BRIGHTNESS_SCALE) : 0;
-    int greenValue = green ? (int)(LampConfig::MAX_PWM * LampConfig::RGB_BRIGHTNESS_SCALE) : 0;
-    int blueValue = blue ? (int)(LampConfig::MAX_PWM * LampConfig::RGB_BRIGHTNESS_SCALE) : 0;
-    
-    // Set PWM values for each channel
-    ledcWrite(LampConfig::RGB_R_CHANNEL, redValue);
-    ledcWrite(LampConfig::RGB_G_CHANNEL, greenValue);
-    ledcWrite(LampConfig::RGB_B_CHANNEL, blueValue);
+        case TouchGesture::DOUBLE_TAP:
+            // On/off, coming back at the level it was switched off at
+            if (isActive()) {
+                touchRestoreLevel = brightness;
+                setRemoteValue(0.0f);
+            } else {
+                setRemoteValue(touchRestoreLevel);
+            }
+            break;
+
+        case TouchGesture::HOLD_START:
+            // Each hold reverses the last one, except at either end of the range
+            touchDimDirection = -touchDimDirection;
+            if (brightness <= LampConfig::TOUCH_DIM_MIN) {
+                touchDimDirection = 1.0f;
+            } else if (brightness >= 100.0f) {
+                touchDimDirection = -1.0f;
+            }
+            break;
+
+        case TouchGesture::HOLDING: {
+            float step = LampConfig::TOUCH_DIM_PER_S * min(elapsed, 100UL) / 1000.0f;
+            setRemoteValue(constrain(brightness + touchDimDirection * step, (float)LampConfig::TOUCH_DIM_MIN, 100.0f));
+            break;
+        }
+
+        case TouchGesture::HOLD_END:
+        case TouchGesture::NONE:
+            break;
+    }
 }
 
 void LampController::showBatteryStatus() {
-    // Calculate voltage per cell for 3-cell LiPo
-    float cellVoltage = batteryVoltage / LampConfig::BATTERY_CELLS;
-    
-    // Start the battery indicator animation (color will be set in updateBatteryIndicator)
-    indicatorState = BatteryIndicatorState::RAMP_UP;
-    animationStartTime = millis();
-    currentFlash = 0;
-    totalFlashes = 1;  // Single flash for battery status
-    indicatorBrightness = 0.0f;
+    statusLed.play(StatusPattern::BATTERY_LEVEL, batteryColor());
 }
 
-int LampController::calculateRequiredFlashes() const {
-    float cellVoltage = batteryVoltage / LampConfig::BATTERY_CELLS;  // 3-cell LiPo
+uint32_t LampController::batteryColor() const {
+    float cellVoltage = batteryVoltage / LampConfig::BATTERY_CELLS;
     
     if (cellVoltage < LampConfig::BATTERY_LOW_THRESHOLD) {
-        return 1;  // Red - Low battery
+        return 0xFF0000;  // Red
     } else if (cellVoltage < LampConfig::BATTERY_MEDIUM_THRESHOLD) {
-        return 2;  // Yellow - Medium battery
+        return 0xFFFF00;  // Yellow
     }
-    return 3;  // Green - Good battery
+    return 0x00FF00;  // Green
 }
 
 uint64_t LampController::getSerialNumber() const { return esp_serial_number; }
@@ -261,14 +544,14 @@ bool LampController::shouldReportData() const {
     return millis() - lastReportTime >= LampConfig::REPORTING_INTERVAL_MS;
 }
 
-String LampController::getMonitoringData() const {
+String LampController::getMonitoringData(const LampStatus& status) const {
     // Format: JSON with device ID, voltage, and potentiometer position
     char buffer[128];
     snprintf(buffer, sizeof(buffer), 
              "{\"device_id\":\"%016llX\",\"voltage\":%.2f,\"position\":%.1f}", 
-             esp_serial_number,
-             batteryVoltage,
-             (filteredValue / LampConfig::MAX_ANALOG) * 100.0f);
+             (unsigned long long)esp_serial_number,
+             status.batteryVoltage,
+             status.brightness);
     return String(buffer);
 }
 #endif
@@ -287,6 +570,9 @@ void LampController::checkLowVoltageWarning() {
         updateBatteryVoltage();
         
         showBatteryStatus();
+        if (batteryVoltage < LampConfig::LOW_VOLTAGE_THRESHOLD) {
+            statusLed.play(StatusPattern::LOW_VOLTAGE);
+        }
     }
     
     // Update previous state for next cycle
@@ -299,67 +585,4 @@ void LampController::checkLowVoltageWarning() {
         lastVoltageCheckTime = currentTime;
         updateBatteryVoltage();
     }
-} 
-
-void LampController::updateBatteryIndicator() {
-    unsigned long currentTime = millis();
-    unsigned long elapsed = currentTime - animationStartTime;
-    
-    switch (indicatorState) {
-        case BatteryIndicatorState::RAMP_UP:
-            if (elapsed >= LampConfig::RAMP_DURATION_MS) {
-                // Ramp up complete, switch to ramp down
-                indicatorState = BatteryIndicatorState::RAMP_DOWN;
-                animationStartTime = currentTime;
-            } else {
-                // Continue ramping up with exponential curve
-                float progress = (float)elapsed / LampConfig::RAMP_DURATION_MS;
-                indicatorBrightness = pow(progress, LampConfig::EXP_FACTOR);
-            }
-            break;
-            
-        case BatteryIndicatorState::RAMP_DOWN:
-            if (elapsed >= LampConfig::RAMP_DURATION_MS) {
-                // Animation complete, return to idle
-                indicatorState = BatteryIndicatorState::IDLE;
-                setStatusLedColor(false, false, false);
-                return;  // Exit early to prevent overwriting the LED states
-            } else {
-                // Continue ramping down with exponential curve
-                float progress = (float)elapsed / LampConfig::RAMP_DURATION_MS;
-                indicatorBrightness = pow(1.0f - progress, LampConfig::EXP_FACTOR);
-            }
-            break;
-            
-        default:
-            indicatorState = BatteryIndicatorState::IDLE;
-            break;
-    }
-    
-    // Apply the calculated brightness to the RGB LEDs
-    if (indicatorState != BatteryIndicatorState::IDLE) {
-        // Get the current color state and apply brightness
-        float cellVoltage = batteryVoltage / LampConfig::BATTERY_CELLS;
-        bool red = false, green = false, blue = false;
-        
-        if (cellVoltage < LampConfig::BATTERY_LOW_THRESHOLD) {
-            red = true;  // Red LED
-        } else if (cellVoltage < LampConfig::BATTERY_MEDIUM_THRESHOLD) {
-            red = true; green = true;  // Yellow LED
-        } else {
-            green = true;  // Green LED
-        }
-        
-        // Calculate PWM values with exponential brightness scaling
-        int redValue = red ? (int)(LampConfig::MAX_PWM * LampConfig::RGB_BRIGHTNESS_SCALE * indicatorBrightness) : 0;
-        int greenValue = green ? (int)(LampConfig::MAX_PWM * LampConfig::RGB_BRIGHTNESS_SCALE * indicatorBrightness) : 0;
-        int blueValue = blue ? (int)(LampConfig::MAX_PWM * LampConfig::RGB_BRIGHTNESS_SCALE * indicatorBrightness) : 0;
-
-        Serial.printf("Red: %d, Green: %d, Blue: %d\n", redValue, greenValue, blueValue);
-        
-        // Set PWM values for each channel
-        ledcWrite(LampConfig::RGB_R_CHANNEL, redValue);
-        ledcWrite(LampConfig::RGB_G_CHANNEL, greenValue);
-        ledcWrite(LampConfig::RGB_B_CHANNEL, blueValue);
-    }
-} 
\ No newline at end of file
+}
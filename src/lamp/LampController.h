@@ -2,8 +2,57 @@
 #include "../config/Config.h"
 #include <cstdint>
 #include <Arduino.h>
+#include "../util/SpscQueue.h"
+#include "../util/DoubleBuffer.h"
+#include "StatusLedAnimator.h"
+#include "OutputStage.h"
+#include "DeratingPolicy.h"
+#include "WarmBoot.h"
+#include "TouchGestures.h"
+#include "AdcCalibration.h"
+#include "BrightnessProgram.h"
+#include <atomic>
+
+// Sent from the network task to the lamp, applied at the start of update()
+struct LampCommand {
+    enum class Type : uint8_t {
+        SET_BRIGHTNESS,     // value: 0-100%
+        SET_CCT,            // value: colour temperature in kelvin
+        SET_DERATING_OVERRIDE, // value: 1 = full output on a low battery, 0 = derate
+        CALIBRATE_VOLTAGE,  // value: pack voltage measured with a meter right now
+        CLEAR_CALIBRATION,
+        START_PROGRAM,      // Runs the program passed to loadProgram()
+        STOP_PROGRAM,
+        SHOW_PATTERN,       // value: StatusPattern, played once
+        SET_BACKGROUND,     // value: StatusPattern, looped while idle
+        CLEAR_BACKGROUND
+    };
+    Type type;
+    float value;
+};
+
+// Published by the lamp at the end of every update() for other tasks to read
+struct LampStatus {
+    float brightness;        // 0-100%
+    float batteryVoltage;
+    float pwmDuty;           // 0-1
+    int cct;                 // Colour temperature in kelvin
+    float outputCap;         // 0-1, below 1 while derating on a low battery
+    bool deratingOverride;
+    const char* adcCalibration; // AdcCalibration::describe()
+    bool warmBoot;           // Output was restored after a warm reset
+    uint32_t timeToLightUs;  // From app start to the restore, or the first render after a cold boot; 0 = not yet
+    uint32_t reportSequence; // Incremented each time monitoring data is due
+    bool programRunning;
+    uint32_t programRemainingS;
+    uint32_t programsStarted;   // Incremented each time a program is started
+    uint32_t calibrationPoints; // Incremented each time a CALIBRATE_VOLTAGE is applied
+    AdcCalibration::PointResult calibrationResult;   // Of the latest one
+};
 
 class LampController {
+    friend class Benchmarks;   // test/test_benchmarks
+
 public:
     enum class ControlMode {
         POTENTIOMETER,
@@ -11,20 +60,40 @@ public:
     };
 
     LampController();
+    // First thing in setup(): after a warm reset, redraws the saved output
+    // and returns true; begin() then skips the slow start-up steps
+    bool restoreOutput();
     void begin();
     void update();
     bool isActive() const;
-    int getSleepTime() const { return sleepTime; }
+    // loop() delay; the fast 10 ms while a touch is pending or in progress
+    int getSleepTime() const;
+    // While a program holds the lamp dark: how long loop() may light sleep, else 0
+    unsigned long getLightSleepMs() const;
     bool canDeepSleep() const { return inSlowMode && !isActive(); }
     float getCurrentValue() const { return filteredValue; }
+    float getPwmDuty() const { return pwmValue / LampConfig::MAX_PWM; }
     void setRemoteValue(float percentage);
+
+    // Thread-safe interface for the network task
+    bool postCommand(const LampCommand& command) { return commandQueue.push(command); }
+    // Queues all of commands or none, e.g. a CCT and a brightness from one request
+    bool postCommands(const LampCommand* commands, size_t count) { return commandQueue.push(commands, count); }
+    // Hands a compiled program over and starts it on the next update()
+    bool loadProgram(const CompiledProgram& compiled);
+    LampStatus getStatus() const { return statusSnapshot.read(); }
     float getBatteryVoltage() const { return batteryVoltage; }
+    uint32_t getTimeToLightUs() const { return timeToLightUs; }
+    // Cheap while nothing is touched; samples the pad only after the touch
+    // interrupt fired and while a gesture is in progress
     void checkTouchStatus();
+    bool isFading() const { return statusLed.isActive(); }
+    // Load shedding: the status LED holds its current frame; the main output is unaffected
+    void suspendAnimations(bool suspended) { animationsSuspended = suspended; }
+    void reconfigureClocks();
     uint64_t getSerialNumber() const;
 #if DATA_LOGGING_ENABLED
-    String getMonitoringData() const;
-    bool isDataReadyToSend() const { return dataReadyToSend; }
-    void clearDataReadyFlag() { dataReadyToSend = false; }
+    String getMonitoringData(const LampStatus& status) const;
 #endif
 
 private:
@@ -37,35 +106,40 @@ private:
     unsigned long lastChangeTime = 0;
     bool inSlowMode = false;
     uint64_t esp_serial_number = 0;
+    SpscQueue<LampCommand, LampConfig::COMMAND_QUEUE_SIZE> commandQueue;
+    DoubleBuffer<LampStatus> statusSnapshot;
+    uint32_t reportSequence = 0;
+    void processCommands();
+    void publishStatus();
+    bool warmBoot = false;
+    uint32_t timeToLightUs = 0;
+    void saveRetainedState();
     static const unsigned long SLOW_MODE_TIMEOUT = 5000;
     
-    float mapExponential(int input, float exponent);
     void updateTimings(int rawValue);
     void handlePotentiometerMode(int rawValue);
     void handleRemoteMode(int rawValue);
     float batteryVoltage = 0.0f;
     void updateBatteryVoltage();
+    uint32_t calibrationPoints = 0;
+    AdcCalibration::PointResult calibrationResult = AdcCalibration::PointResult::PENDING;
+    void calibrateVoltage(float measured);
     void showBatteryStatus();
-    int calculateRequiredFlashes() const;
-
-    enum class BatteryIndicatorState {
-        IDLE,
-        RAMP_UP,
-        RAMP_DOWN,
-        PAUSE
-    };
+    uint32_t batteryColor() const;
 
-    BatteryIndicatorState indicatorState = BatteryIndicatorState::IDLE;
-    unsigned long animationStartTime = 0;
-    int currentFlash = 0;
-    int totalFlashes = 0;
-    float indicatorBrightness = 0.0f;
-    
-    void updateBatteryIndicator();
+    OutputStage output;
+    DeratingPolicy derating;
+    AdcCalibration adcCalibration;
+    StatusLedAnimator statusLed;
+    BrightnessProgram program;
+    DoubleBuffer<CompiledProgram> pendingProgram;
+    uint32_t programsStarted = 0;
+    bool programPacesLoop = false;   // sleepTime follows the program, not the knob
+    void updateProgram();
+    bool animationsSuspended = false;
 #if DATA_LOGGING_ENABLED
     unsigned long lastLogTime = 0;
     unsigned long lastReportTime = 0;
-    bool dataReadyToSend = false;
     bool shouldLogData() const;
     bool shouldReportData() const;
 #endif
@@ -92,5 +166,17 @@ private:
     static constexpr float ON_THRESHOLD = 0.003f;   // 0.3% threshold to consider lamp "on"
     static constexpr float OFF_THRESHOLD = 0.001f;  // 0.1% threshold to consider lamp "off"
 
-    void setStatusLedColor(bool red, bool green, bool blue);
+    TouchBaseline touchBaseline;
+    TouchGestures touchGestures;
+    uint16_t touchThreshold = 0;       // Threshold the interrupt is armed with
+    int touchValue = 0;                // Last pad reading
+    unsigned long lastTouchSample = 0;
+    float touchRestoreLevel = 50.0f;   // Brightness (%) a double tap turns the lamp back on at
+    float touchDimDirection = 1.0f;     // Flipped at the start of each hold, so the first one dims
+    static std::atomic<bool> touchPending;
+    static std::atomic<unsigned long> touchInterruptTime;   // millis() when touchPending was set
+    static void onTouchInterrupt();
+    bool isTouchInProgress() const;
+    void beginTouch();
+    void handleGesture(TouchGesture gesture, unsigned long elapsed);
 }; 
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+
+// Duty gain (Q12, 4096 = 1.0) that keeps the light output of the LED string
+// at what it gives at 11.1V, for pack voltages from 9.6V to 12.8V in 0.1V
+// steps. Generated by the last cell of research/craft_curve.ipynb from the
+// series-resistor driver model (V_F = 9.0V, gain limited to 2.5); regenerate
+// it there if the LED string changes.
+namespace LumenCompensationTable {
+
+const int VOLTAGE_MIN_MV = 9600;
+const int VOLTAGE_STEP_MV = 100;
+const int POINTS = 33;
+
+const uint16_t GAIN[POINTS] = {
+    10240, 10240, 10240, 9557, 8602, 7820, 7168, 6617, 6144, 5734, 5376,
+    5060, 4779, 4527, 4301, 4096, 3910, 3740, 3584, 3441, 3308, 3186,
+    3072, 2966, 2867, 2775, 2688, 2607, 2530, 2458, 2389, 2325, 2264,
+};
+
+// Interpolated gain for a pack voltage; clamps outside the table
+inline uint32_t gainFor(float packVoltage) {
+    int millivolts = (int)(packVoltage * 1000.0f) - VOLTAGE_MIN_MV;
+    if (millivolts <= 0) {
+        return GAIN[0];
+    }
+    int index = millivolts / VOLTAGE_STEP_MV;
+    if (index >= POINTS - 1) {
+        return GAIN[POINTS - 1];
+    }
+    int fraction = millivolts % VOLTAGE_STEP_MV;
+    return GAIN[index] + (GAIN[index + 1] - GAIN[index]) * fraction / VOLTAGE_STEP_MV;
+}
+
+}  // namespace LumenCompensationTable
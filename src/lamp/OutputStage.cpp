@@ -0,0 +1,206 @@
+#include "OutputStage.h"
+#include <math.h>
+#include "../util/LedcBatch.h"
+#include "PwmPlanner.h"
+
+// Blackbody-ish RGB for a few colour temperatures, used to tint RGBW fixtures
+struct TintPoint {
+    int kelvin;
+    uint8_t rgb[3];
+};
+
+static const TintPoint TINT_TABLE[] = {
+    {2700, {255, 169, 87}},
+    {4000, {255, 209, 163}},
+    {5000, {255, 228, 206}},
+    {6500, {255, 249, 253}},
+};
+static const int TINT_POINTS = sizeof(TINT_TABLE) / sizeof(TINT_TABLE[0]);
+
+uint8_t OutputStage::ledcChannel(int output) {
+    // Output 0 keeps the original lamp channel. The rest go after the status
+    // LED, or with PWM_FREQ_JITTER straight after output 0 so that only
+    // outputs sit on the timers that hop.
+    if (PWM_FREQ_JITTER) {
+        return LampConfig::PWM_CHANNEL + output;
+    }
+    return output == 0 ? LampConfig::PWM_CHANNEL : LampConfig::RGB_B_CHANNEL + output;
+}
+
+void OutputStage::begin() {
+    const OutputChannel* outputs = Board::outputs();
+    for (int i = 0; i < CHANNEL_COUNT; i++) {
+        channels[i] = ledcChannel(i);
+        ledcSetup(channels[i], LampConfig::PWM_FREQ, LampConfig::PWM_RESOLUTION);
+        ledcWrite(channels[i], 0);
+        ledcAttachPin(outputs[i].pin, channels[i]);
+        duties[i] = 0;
+        lastDuties[i] = 0;
+        buildCurve(curves[1 + i], outputs[i].exponent, outputs[i].gain);
+    }
+    buildCurve(curves[0], LampConfig::EXP_FACTOR, 1.0f);
+    setCct(cct);
+    LedcBatch::alignTimers(channels, CHANNEL_COUNT);
+}
+
+void OutputStage::reconfigure() {
+    for (int i = 0; i < CHANNEL_COUNT; i++) {
+        ledcSetup(channels[i], pwmFreq, LampConfig::PWM_RESOLUTION);
+        lastDuties[i] = UINT32_MAX;
+    }
+    LedcBatch::alignTimers(channels, CHANNEL_COUNT);
+    writeDuties();
+}
+
+void OutputStage::reattach() {
+    const OutputChannel* outputs = Board::outputs();
+    for (int i = 0; i < CHANNEL_COUNT; i++) {
+        ledcAttachPin(outputs[i].pin, channels[i]);
+    }
+    reconfigure();
+}
+
+void OutputStage::hopFrequency(unsigned long now) {
+    #if PWM_FREQ_JITTER
+    if (now - lastHopTime < LampConfig::PWM_JITTER_HOP_MS) {
+        return;
+    }
+    lastHopTime = now;
+
+    // Pseudo-random hop within +-PWM_JITTER_PERCENT, so the switching tone
+    // becomes a spread of frequencies instead of one audible whine
+    jitterState = jitterState * 1664525UL + 1013904223UL;
+    uint32_t span = LampConfig::PWM_FREQ * LampConfig::PWM_JITTER_PERCENT / 100;
+    pwmFreq = LampConfig::PWM_FREQ - span + (jitterState >> 16) % (2 * span + 1);
+
+    for (int i = 0; i < CHANNEL_COUNT; i++) {
+        ledcChangeFrequency(channels[i], pwmFreq, LampConfig::PWM_RESOLUTION);
+    }
+    LedcBatch::alignTimers(channels, CHANNEL_COUNT);
+    #else
+    (void)now;
+    #endif
+}
+
+void OutputStage::buildCurve(uint32_t* curve, float exponent, float gain) {
+    for (int i = 0; i <= CURVE_SEGMENTS; i++) {
+        float level = (float)i / CURVE_SEGMENTS;
+        curve[i] = (uint32_t)(gain * powf(level, exponent) * 65536.0f + 0.5f);
+    }
+}
+
+uint32_t OutputStage::render(int input) {
+    input = constrain(input, 0, (int)LampConfig::MAX_ANALOG);
+
+    // Position on the curves: segment index and 8-bit fraction
+    uint32_t position = (uint32_t)input * (CURVE_SEGMENTS << 8) / LampConfig::MAX_ANALOG;
+    if (position > positionLimit) {
+        position = positionLimit;
+    }
+    uint32_t segment = position >> 8;
+    uint32_t fraction = position & 0xFF;
+    if (segment >= (uint32_t)CURVE_SEGMENTS) {
+        segment = CURVE_SEGMENTS - 1;
+        fraction = 256;
+    }
+
+    const uint32_t* master = curves[0];
+    uint32_t masterLevel = master[segment] + (((master[segment + 1] - master[segment]) * fraction) >> 8);
+
+    // Supply compensation may lift the output up to the limit but not past
+    // it, or a derated lamp would be driven back to full duty
+    uint32_t gain = supplyGain;
+    if (masterLevel > 0) {
+        gain = min(gain, (uint32_t)(((uint64_t)limit << 12) / masterLevel));
+    }
+
+    for (int i = 0; i < CHANNEL_COUNT; i++) {
+        const uint32_t* curve = curves[1 + i];
+        uint32_t level = curve[segment] + (((curve[segment + 1] - curve[segment]) * fraction) >> 8);
+        uint32_t mixed = (level * weights[i]) >> 15;
+        mixed = min((mixed * gain) >> 12, (uint32_t)65536);
+        duties[i] = (mixed * LampConfig::MAX_PWM + 0x8000) >> 16;
+    }
+    writeDuties();
+
+    return masterLevel;
+}
+
+void OutputStage::setLimit(uint32_t level) {
+    if (level == limit) {
+        return;
+    }
+    limit = level;
+
+    // Invert the master curve to find the position it reaches the limit at
+    const uint32_t* master = curves[0];
+    if (level >= master[CURVE_SEGMENTS]) {
+        positionLimit = CURVE_SEGMENTS << 8;
+        return;
+    }
+    uint32_t segment = 0;
+    while (master[segment + 1] <= level) {
+        segment++;
+    }
+    uint32_t span = master[segment + 1] - master[segment];
+    positionLimit = (segment << 8) + ((level - master[segment]) << 8) / span;
+}
+
+void OutputStage::writeDuties() {
+    bool changed = false;
+    for (int i = 0; i < CHANNEL_COUNT; i++) {
+        if (duties[i] != lastDuties[i]) {
+            changed = true;
+            lastDuties[i] = duties[i];
+        }
+    }
+    if (changed) {
+        PwmPlanner::plan(duties, hpoints, CHANNEL_COUNT, 0);
+        LedcBatch::write(channels, duties, hpoints, CHANNEL_COUNT);
+    }
+}
+
+void OutputStage::setCct(int kelvin) {
+    cct = constrain(kelvin, (int)LampConfig::CCT_WARM_K, (int)LampConfig::CCT_COOL_K);
+
+    // Warm and cool weights sum to one so the light output stays the same
+    // across the CCT range
+    float cool = (float)(cct - LampConfig::CCT_WARM_K) /
+                 (LampConfig::CCT_COOL_K - LampConfig::CCT_WARM_K);
+
+    const OutputChannel* outputs = Board::outputs();
+    for (int i = 0; i < CHANNEL_COUNT; i++) {
+        float weight = 1.0f;
+        switch (outputs[i].kind) {
+            case ChannelKind::WHITE:
+                break;
+            case ChannelKind::WARM_WHITE:
+                weight = 1.0f - cool;
+                break;
+            case ChannelKind::COOL_WHITE:
+                weight = cool;
+                break;
+            case ChannelKind::RED:
+                weight = tint(cct, 0) * LampConfig::RGBW_TINT_SCALE;
+                break;
+            case ChannelKind::GREEN:
+                weight = tint(cct, 1) * LampConfig::RGBW_TINT_SCALE;
+                break;
+            case ChannelKind::BLUE:
+                weight = tint(cct, 2) * LampConfig::RGBW_TINT_SCALE;
+                break;
+        }
+        weights[i] = (uint32_t)(weight * WEIGHT_ONE + 0.5f);
+    }
+}
+
+float OutputStage::tint(int kelvin, int component) {
+    int upper = 1;
+    while (upper < TINT_POINTS - 1 && TINT_TABLE[upper].kelvin < kelvin) {
+        upper++;
+    }
+    const TintPoint& a = TINT_TABLE[upper - 1];
+    const TintPoint& b = TINT_TABLE[upper];
+    float t = constrain((float)(kelvin - a.kelvin) / (b.kelvin - a.kelvin), 0.0f, 1.0f);
+    return (a.rgb[component] + (b.rgb[component] - a.rgb[component]) * t) / 255.0f;
+}
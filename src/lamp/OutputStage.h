@@ -0,0 +1,61 @@
+#pragma once
+#include "../config/Config.h"
+#include <cstdint>
+#include <Arduino.h>
+
+// Drives the board's lamp output strings (Board::outputs()): a single white
+// string, warm + cool white, or RGBW. Each tick the brightness goes through
+// every channel's dimming curve lookup table, is scaled by that channel's
+// colour temperature weight, and all duties are latched in the same PWM
+// period. The per-tick pass is integer only; floats are used only when the
+// curves are built and when the colour temperature changes.
+class OutputStage {
+public:
+    void begin();
+    void reconfigure();   // Re-setup LEDC after a clock change and rewrite all duties
+    void reattach();      // Reclaim the output pins and timers after other LEDC setup
+    void hopFrequency(unsigned long now);  // Spread-spectrum step, no-op unless PWM_FREQ_JITTER
+
+    // input: 0-MAX_ANALOG brightness. Returns the master level (Q16, 0-65536),
+    // i.e. the duty fraction a single white string would get for this input.
+    uint32_t render(int input);
+    void setCct(int kelvin);
+    int getCct() const { return cct; }
+    // Caps the master level (Q16); channels are limited at the same knob position
+    void setLimit(uint32_t level);
+    // Duty multiplier (Q12) applied after mixing, for supply voltage
+    // compensation. It never takes the master level past setLimit().
+    void setSupplyGain(uint32_t gain) { supplyGain = gain; }
+    uint32_t getSupplyGain() const { return supplyGain; }
+
+    static uint8_t ledcChannel(int output);
+
+private:
+    static const int CHANNEL_COUNT = Board::OUTPUT_COUNT;
+    static const int CURVE_SEGMENTS = LampConfig::OUTPUT_CURVE_POINTS - 1;
+    static const int WEIGHT_ONE = 1 << 15;
+
+    static_assert(CHANNEL_COUNT <= LampConfig::MAX_OUTPUT_CHANNELS, "Too many output channels");
+    static_assert(CHANNEL_COUNT + 3 <= Board::LEDC_CHANNELS, "Not enough LEDC channels for the outputs and the status LED");
+    static_assert(!PWM_FREQ_JITTER || LampConfig::RGB_B_CHANNEL < Board::LEDC_CHANNELS,
+                  "Not enough LEDC channels to keep the status LED off the jittered timers");
+
+    // curves[0] is the master curve, curves[1 + i] belongs to output i. Q16 duty.
+    uint32_t curves[CHANNEL_COUNT + 1][LampConfig::OUTPUT_CURVE_POINTS];
+    uint32_t weights[CHANNEL_COUNT];       // Q15 colour temperature mix
+    uint8_t channels[CHANNEL_COUNT];
+    uint32_t duties[CHANNEL_COUNT];
+    uint32_t lastDuties[CHANNEL_COUNT];
+    uint32_t hpoints[CHANNEL_COUNT];       // Phase offsets from PwmPlanner
+    uint32_t limit = 65536;
+    uint32_t supplyGain = 1 << 12;
+    uint32_t positionLimit = CURVE_SEGMENTS << 8;   // Curve position (Q8) where the master reaches limit
+    int cct = LampConfig::CCT_DEFAULT_K;
+    uint32_t pwmFreq = LampConfig::PWM_FREQ;
+    unsigned long lastHopTime = 0;
+    uint32_t jitterState = 1;
+
+    void buildCurve(uint32_t* curve, float exponent, float gain);
+    void writeDuties();
+    static float tint(int kelvin, int component);
+};
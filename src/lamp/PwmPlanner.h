@@ -0,0 +1,31 @@
+#pragma once
+#include "../config/Config.h"
+#include <cstdint>
+
+// Chooses per-channel phase offsets (LEDC hpoint) so channels sharing a PWM
+// period turn on one after another instead of all at the start of the
+// period. That lowers the peak supply current, and with it the battery sag
+// seen on VOLTAGE_PIN. Each channel starts where the previous one ended; a
+// channel that would run past the end of the period is pulled back to end
+// exactly there, since on-times don't wrap. test/test_pwm_planner models the
+// resulting supply current.
+namespace PwmPlanner {
+
+inline void plan(const uint32_t* duties, uint32_t* hpoints, int count, uint32_t startOffset) {
+    const uint32_t period = 1UL << LampConfig::PWM_RESOLUTION;
+    uint32_t position = startOffset;
+    for (int i = 0; i < count; i++) {
+        if (!LampConfig::PWM_PHASE_STAGGER) {
+            hpoints[i] = 0;
+            continue;
+        }
+        uint32_t start = position % period;
+        if (start + duties[i] > period) {
+            start = period - duties[i];
+        }
+        hpoints[i] = start;
+        position = start + duties[i];
+    }
+}
+
+}  // namespace PwmPlanner
@@ -0,0 +1,231 @@
+#include "StatusLedAnimator.h"
+#include "../util/LedcBatch.h"
+#include "PwmPlanner.h"
+
+namespace {
+    typedef StatusLedAnimator::Keyframe Keyframe;
+    const uint32_t PC = StatusLedAnimator::PATTERN_COLOR;
+
+    // level^EXP_FACTOR (3) in Q16, so ramps look linear to the eye
+    const uint16_t BRIGHTNESS_CURVE[256] = {
+        0, 0, 0, 0, 0, 0, 1, 1, 2, 3, 4, 5,
+        7, 9, 11, 13, 16, 19, 23, 27, 32, 37, 42, 48,
+        55, 62, 69, 78, 87, 96, 107, 118, 130, 142, 155, 169,
+        184, 200, 217, 234, 253, 272, 293, 314, 337, 360, 385, 410,
+        437, 465, 494, 524, 556, 588, 622, 658, 694, 732, 771, 812,
+        854, 897, 942, 988, 1036, 1085, 1136, 1189, 1243, 1298, 1356, 1415,
+        1475, 1538, 1602, 1667, 1735, 1804, 1876, 1949, 2024, 2100, 2179, 2260,
+        2343, 2427, 2514, 2603, 2693, 2786, 2881, 2978, 3078, 3179, 3283, 3389,
+        3497, 3607, 3720, 3835, 3952, 4072, 4194, 4319, 4446, 4575, 4707, 4842,
+        4979, 5118, 5261, 5405, 5553, 5703, 5856, 6011, 6169, 6330, 6494, 6660,
+        6830, 7002, 7177, 7355, 7536, 7719, 7906, 8096, 8289, 8484, 8683, 8885,
+        9090, 9298, 9510, 9724, 9942, 10163, 10387, 10614, 10845, 11079, 11317, 11557,
+        11802, 12049, 12300, 12555, 12813, 13074, 13339, 13608, 13880, 14156, 14435, 14718,
+        15005, 15295, 15589, 15887, 16189, 16494, 16803, 17117, 17433, 17754, 18079, 18408,
+        18740, 19077, 19418, 19762, 20111, 20464, 20821, 21182, 21547, 21917, 22290, 22668,
+        23050, 23436, 23827, 24222, 24621, 25025, 25433, 25845, 26262, 26683, 27109, 27539,
+        27974, 28413, 28857, 29306, 29759, 30217, 30680, 31147, 31619, 32095, 32577, 33063,
+        33554, 34050, 34551, 35056, 35567, 36082, 36602, 37128, 37658, 38194, 38734, 39280,
+        39830, 40386, 40947, 41513, 42084, 42661, 43243, 43830, 44422, 45019, 45622, 46231,
+        46844, 47463, 48088, 48718, 49353, 49994, 50641, 51293, 51950, 52614, 53282, 53957,
+        54637, 55323, 56014, 56712, 57415, 58123, 58838, 59558, 60285, 61017, 61755, 62499,
+        63249, 64005, 64767, 65535,
+    };
+
+    const uint32_t MAX_LED_DUTY = (uint32_t)(LampConfig::MAX_PWM * LampConfig::RGB_BRIGHTNESS_SCALE);
+
+    const Keyframe BATTERY_FRAMES[] = {
+        {0, PC, 0},
+        {LampConfig::RAMP_DURATION_MS, PC, 255},
+        {LampConfig::RAMP_DURATION_MS, PC, 0},
+    };
+    const Keyframe LOW_VOLTAGE_FRAMES[] = {
+        {0, 0xFF0000, 0},
+        {800, 0xFF0000, 255},
+        {800, 0xFF0000, 0},
+    };
+    const Keyframe AP_MODE_FRAMES[] = {
+        {0, 0x0000FF, 255},
+        {250, 0x0000FF, 255},
+        {0, 0x0000FF, 0},
+        {750, 0x0000FF, 0},
+    };
+    const Keyframe CONNECTING_FRAMES[] = {
+        {0, 0x0000FF, 64},
+        {600, 0x00FFFF, 255},
+        {600, 0x0000FF, 64},
+    };
+    const Keyframe UPLOADING_FRAMES[] = {
+        {0, 0xFF00FF, 255},
+        {80, 0xFF00FF, 255},
+        {0, 0xFF00FF, 0},
+        {80, 0xFF00FF, 0},
+    };
+
+    struct PatternDef {
+        const Keyframe* frames;
+        uint8_t count;
+        uint8_t repeats;  // Plays when queued; the background pattern always loops
+    };
+
+    #define PATTERN(frames, repeats) {frames, sizeof(frames) / sizeof(frames[0]), repeats}
+    const PatternDef PATTERNS[(int)StatusPattern::COUNT] = {
+        PATTERN(BATTERY_FRAMES, 1),
+        PATTERN(LOW_VOLTAGE_FRAMES, 3),
+        PATTERN(AP_MODE_FRAMES, 1),
+        PATTERN(CONNECTING_FRAMES, 1),
+        PATTERN(UPLOADING_FRAMES, 2),
+    };
+    #undef PATTERN
+
+    uint8_t blend(uint8_t from, uint8_t to, uint32_t t) {
+        return (uint8_t)(from + (((int32_t)to - from) * (int32_t)t >> 8));
+    }
+}
+
+bool StatusLedAnimator::play(StatusPattern pattern, uint32_t color) {
+    if (queueCount >= QUEUE_SIZE || pattern >= StatusPattern::COUNT) {
+        return false;
+    }
+    queue[(queueHead + queueCount) % QUEUE_SIZE] = {pattern, color};
+    queueCount++;
+
+    // One-shot patterns take over from the background straight away
+    if (currentIsBackground) {
+        playing = false;
+    }
+    return true;
+}
+
+void StatusLedAnimator::setBackground(StatusPattern pattern, uint32_t color) {
+    background = {pattern, color};
+    if (!playing || currentIsBackground) {
+        playing = false;  // Restart with the new background on the next frame
+    }
+}
+
+void StatusLedAnimator::clearBackground() {
+    background.pattern = StatusPattern::COUNT;
+    if (currentIsBackground) {
+        playing = false;
+        writeLed(0, 0);
+    }
+}
+
+bool StatusLedAnimator::startNext(unsigned long now) {
+    if (queueCount > 0) {
+        Playback next = queue[queueHead];
+        queueHead = (queueHead + 1) % QUEUE_SIZE;
+        queueCount--;
+        start(next, false, now);
+        return true;
+    }
+    if (background.pattern < StatusPattern::COUNT) {
+        start(background, true, now);
+        return true;
+    }
+    return false;
+}
+
+void StatusLedAnimator::start(const Playback& playback, bool isBackground, unsigned long now) {
+    current = playback;
+    currentIsBackground = isBackground;
+    playing = true;
+    frameIndex = 0;
+    repeatsLeft = PATTERNS[(int)playback.pattern].repeats;
+    frameStartTime = now;
+    fromColor = 0;
+    fromLevel = 0;
+}
+
+uint32_t StatusLedAnimator::resolveColor(uint32_t color) const {
+    return color == PATTERN_COLOR ? current.color : color;
+}
+
+void StatusLedAnimator::update(unsigned long now) {
+    if (!playing && !startNext(now)) {
+        return;
+    }
+
+    // Only zero-length keyframes and pattern ends loop here, so this is bounded
+    for (;;) {
+        const PatternDef& def = PATTERNS[(int)current.pattern];
+        const Keyframe& frame = def.frames[frameIndex];
+        uint32_t toColor = resolveColor(frame.color);
+        unsigned long elapsed = now - frameStartTime;
+
+        if (elapsed < frame.durationMs) {
+            uint32_t t = (elapsed << 8) / frame.durationMs;  // 0-255
+            uint32_t color = ((uint32_t)blend(fromColor >> 16, toColor >> 16, t) << 16) |
+                             ((uint32_t)blend(fromColor >> 8, toColor >> 8, t) << 8) |
+                             blend(fromColor, toColor, t);
+            writeLed(color, blend(fromLevel, frame.level, t));
+            return;
+        }
+
+        // Keyframe finished
+        fromColor = toColor;
+        fromLevel = frame.level;
+        frameStartTime = now;
+        if (++frameIndex < def.count) {
+            continue;
+        }
+
+        frameIndex = 0;
+        if (currentIsBackground) {
+            if (queueCount == 0) {
+                continue;  // Loop the background
+            }
+        } else if (--repeatsLeft > 0) {
+            continue;
+        }
+
+        // Pattern finished
+        if (!startNext(now)) {
+            playing = false;
+            writeLed(0, 0);
+            return;
+        }
+    }
+}
+
+void StatusLedAnimator::refresh() {
+    for (int i = 0; i < 3; i++) {
+        lastDuty[i] = UINT32_MAX;
+    }
+    if (!playing) {
+        writeLed(0, 0);
+    }
+}
+
+void StatusLedAnimator::writeLed(uint32_t color, uint8_t level) {
+    static const uint8_t channels[3] = {
+        LampConfig::RGB_R_CHANNEL, LampConfig::RGB_G_CHANNEL, LampConfig::RGB_B_CHANNEL
+    };
+
+    if (LampConfig::LED_B_SHARES_OUTPUT) {
+        // No blue LED: show blue (AP mode, connecting) on green instead
+        uint32_t green = max((color >> 8) & 0xFF, color & 0xFF);
+        color = (color & 0xFF0000) | (green << 8);
+    }
+
+    uint32_t brightness = BRIGHTNESS_CURVE[level];
+    uint32_t duties[3];
+    bool changed = false;
+    for (int i = 0; i < 3; i++) {
+        uint32_t component = (color >> (16 - 8 * i)) & 0xFF;
+        component += component >> 7;  // 0-255 -> 0-256
+        duties[i] = ((component * brightness) >> 8) * MAX_LED_DUTY >> 16;
+        if (duties[i] != lastDuty[i]) {
+            lastDuty[i] = duties[i];
+            changed = true;
+        }
+    }
+    // Latch all three together so colour blends don't tear, phased half a
+    // period away from the lamp's first output channel
+    if (changed) {
+        uint32_t hpoints[3];
+        PwmPlanner::plan(duties, hpoints, 3, 1UL << (LampConfig::PWM_RESOLUTION - 1));
+        LedcBatch::write(channels, duties, hpoints, 3);
+    }
+}
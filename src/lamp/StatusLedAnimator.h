@@ -0,0 +1,64 @@
+#pragma once
+#include "../config/Config.h"
+#include <cstdint>
+#include <Arduino.h>
+
+enum class StatusPattern : uint8_t {
+    BATTERY_LEVEL,   // Single ramp in the battery colour
+    LOW_VOLTAGE,     // Slow red pulses
+    AP_MODE,         // Blue blink while waiting for WiFi setup
+    CONNECTING,      // Blue/cyan breathing during association
+    UPLOADING,       // Short magenta flicker per telemetry upload
+    COUNT
+};
+
+// Keyframe animation engine for the RGB status LED. Colour and level are
+// blended linearly in fixed point between keyframes, and the level goes
+// through a precomputed brightness curve, so each frame costs the same.
+class StatusLedAnimator {
+public:
+    // Colour value meaning "the colour passed to play()"
+    static const uint32_t PATTERN_COLOR = 0xFF000000;
+
+    struct Keyframe {
+        uint16_t durationMs;  // Time to blend from the previous keyframe to this one
+        uint32_t color;       // 0xRRGGBB or PATTERN_COLOR
+        uint8_t level;        // 0-255, mapped through the brightness curve
+    };
+
+    // One-shot patterns are queued and play in order; the background
+    // pattern loops whenever the queue is empty.
+    bool play(StatusPattern pattern, uint32_t color = 0);
+    void setBackground(StatusPattern pattern, uint32_t color = 0);
+    void clearBackground();
+    void update(unsigned long now);
+    void refresh();  // Rewrite the LED on the next frame, e.g. after a clock change
+    bool isActive() const { return playing; }
+
+private:
+    struct Playback {
+        StatusPattern pattern;
+        uint32_t color;
+    };
+
+    static const int QUEUE_SIZE = 4;
+    Playback queue[QUEUE_SIZE];
+    int queueHead = 0;
+    int queueCount = 0;
+
+    Playback background = {StatusPattern::COUNT, 0};
+    Playback current = {StatusPattern::COUNT, 0};
+    bool playing = false;
+    bool currentIsBackground = false;
+    uint8_t frameIndex = 0;
+    uint8_t repeatsLeft = 0;
+    unsigned long frameStartTime = 0;
+    uint32_t fromColor = 0;
+    uint8_t fromLevel = 0;
+    uint32_t lastDuty[3] = {UINT32_MAX, UINT32_MAX, UINT32_MAX};
+
+    bool startNext(unsigned long now);
+    void start(const Playback& playback, bool isBackground, unsigned long now);
+    uint32_t resolveColor(uint32_t color) const;
+    void writeLed(uint32_t color, uint8_t level);
+};
@@ -0,0 +1,56 @@
+#include "TouchGestures.h"
+
+TouchGesture TouchGestures::update(bool touched, unsigned long now) {
+    switch (state) {
+        case State::IDLE:
+            if (touched) {
+                state = State::PRESSED;
+                pressTime = now;
+            }
+            break;
+
+        case State::PRESSED:
+        case State::SECOND_PRESS:
+            if (touched) {
+                if (now - pressTime >= LampConfig::TOUCH_LONG_PRESS_MS) {
+                    // A tap followed by a hold is still a hold
+                    state = State::HOLDING;
+                    return TouchGesture::HOLD_START;
+                }
+            } else if (now - pressTime < LampConfig::TOUCH_MIN_PRESS_MS) {
+                // Too short to be a finger; a first tap before it still counts
+                state = state == State::SECOND_PRESS ? State::RELEASED : State::IDLE;
+            } else if (state == State::SECOND_PRESS) {
+                state = State::IDLE;
+                return TouchGesture::DOUBLE_TAP;
+            } else {
+                state = State::RELEASED;
+                releaseTime = now;
+            }
+            break;
+
+        case State::RELEASED:
+            if (touched) {
+                state = State::SECOND_PRESS;
+                pressTime = now;
+            } else if (now - releaseTime >= LampConfig::TOUCH_DOUBLE_TAP_MS) {
+                state = State::IDLE;
+                return TouchGesture::TAP;
+            }
+            break;
+
+        case State::HOLDING:
+            if (touched) {
+                return TouchGesture::HOLDING;
+            }
+            state = State::IDLE;
+            return TouchGesture::HOLD_END;
+    }
+    return TouchGesture::NONE;
+}
+
+void TouchGestures::touchedAt(unsigned long time) {
+    if (state == State::IDLE || state == State::RELEASED) {
+        update(true, time);
+    }
+}
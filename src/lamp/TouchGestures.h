@@ -0,0 +1,53 @@
+#pragma once
+#include "../config/Config.h"
+#include <cstdint>
+
+// Untouched reading of the touch pad, following slow drift from humidity
+// and temperature. A reading below TOUCH_TRIGGER_RATIO of the baseline
+// counts as touched; touched readings never move the baseline.
+class TouchBaseline {
+public:
+    void seed(int raw) { baseline = (float)raw; }
+    void update(int raw) { baseline += (raw - baseline) * LampConfig::TOUCH_BASELINE_ALPHA; }
+    bool isTouched(int raw) const { return raw < threshold(); }
+    uint16_t threshold() const { return (uint16_t)(baseline * LampConfig::TOUCH_TRIGGER_RATIO); }
+    float value() const { return baseline; }
+
+private:
+    float baseline = 0.0f;
+};
+
+enum class TouchGesture : uint8_t {
+    NONE,
+    TAP,
+    DOUBLE_TAP,
+    HOLD_START,     // Pressed for TOUCH_LONG_PRESS_MS
+    HOLDING,        // Every poll while the hold lasts
+    HOLD_END
+};
+
+// Turns touched / not touched samples into gestures. Plain state machine,
+// no hardware access; test/test_touch_gestures replays recorded traces through it.
+class TouchGestures {
+public:
+    TouchGesture update(bool touched, unsigned long now);
+    // The touch interrupt saw the pad touched at this time. A press starts
+    // there rather than at the next poll, so its length is right and a tap
+    // that is over before the poll still counts.
+    void touchedAt(unsigned long time);
+    // Nothing in progress: no polling needed until the next touch interrupt
+    bool isIdle() const { return state == State::IDLE; }
+
+private:
+    enum class State {
+        IDLE,
+        PRESSED,
+        RELEASED,       // After a tap, waiting to see if a second one follows
+        SECOND_PRESS,
+        HOLDING
+    };
+
+    State state = State::IDLE;
+    unsigned long pressTime = 0;
+    unsigned long releaseTime = 0;
+};
@@ -0,0 +1,93 @@
+#include "WarmBoot.h"
+#include <Arduino.h>
+#include <esp_system.h>
+#include <atomic>
+
+namespace {
+    const uint32_t MAGIC = 0x4C414D50;   // "LAMP"
+
+    struct Record {
+        uint32_t magic;
+        uint8_t restores;      // Back-to-back restores without a stable run in between
+        RetainedState state;
+        uint32_t checksum;
+    };
+
+    // Not touched by the startup code, so it still holds the last save after a warm reset
+    RTC_NOINIT_ATTR Record record;
+
+    // Restores in a row including this boot, carried into every save until the run is stable
+    uint8_t restoresThisBoot = 0;
+
+    uint32_t checksum(const Record& r) {
+        // FNV-1a over everything between the magic and the checksum
+        const uint8_t* bytes = (const uint8_t*)&r.restores;
+        const uint8_t* end = (const uint8_t*)&r.checksum;
+        uint32_t hash = 2166136261UL;
+        while (bytes < end) {
+            hash = (hash ^ *bytes++) * 16777619UL;
+        }
+        return hash;
+    }
+}
+
+bool WarmBoot::isWarmReset() {
+    switch (esp_reset_reason()) {
+        case ESP_RST_SW:
+        case ESP_RST_PANIC:
+        case ESP_RST_INT_WDT:
+        case ESP_RST_TASK_WDT:
+        case ESP_RST_WDT:
+        case ESP_RST_BROWNOUT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+const char* WarmBoot::resetReasonName() {
+    switch (esp_reset_reason()) {
+        case ESP_RST_POWERON: return "power-on";
+        case ESP_RST_EXT: return "external";
+        case ESP_RST_SW: return "software";
+        case ESP_RST_PANIC: return "panic";
+        case ESP_RST_INT_WDT:
+        case ESP_RST_TASK_WDT:
+        case ESP_RST_WDT: return "watchdog";
+        case ESP_RST_DEEPSLEEP: return "deep sleep";
+        case ESP_RST_BROWNOUT: return "brownout";
+        default: return "unknown";
+    }
+}
+
+bool WarmBoot::restore(RetainedState& state) {
+    if (!LampConfig::WARM_BOOT_RESTORE || !isWarmReset()) {
+        return false;
+    }
+    if (record.magic != MAGIC || record.checksum != checksum(record)) {
+        return false;
+    }
+    if (record.restores >= LampConfig::WARM_BOOT_MAX_RESTORES) {
+        // Restoring keeps ending in another reset; start from dark this time
+        record.magic = 0;
+        return false;
+    }
+    restoresThisBoot = record.restores + 1;
+    state = record.state;
+    return true;
+}
+
+void WarmBoot::save(const RetainedState& state, unsigned long uptimeMs) {
+    if (restoresThisBoot != 0 && uptimeMs >= LampConfig::WARM_BOOT_STABLE_MS) {
+        restoresThisBoot = 0;
+    }
+    // Invalidate first so a reset part way through leaves no half-written state;
+    // the fences stop the compiler from moving the magic stores
+    record.magic = 0;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    record.restores = restoresThisBoot;
+    record.state = state;
+    record.checksum = checksum(record);
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    record.magic = MAGIC;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "../config/Config.h"
+#include <cstdint>
+
+// The lamp state needed to redraw the output exactly as it was
+struct RetainedState {
+    float filteredValue;
+    float batteryVoltage;
+    float trackedVoltage;     // DeratingPolicy
+    float outputCap;          // DeratingPolicy, 0-1
+    uint32_t supplyGain;      // OutputStage, Q12
+    int32_t cct;
+    int32_t lastPotValue;
+    uint8_t remoteMode;
+};
+
+// Keeps RetainedState in RTC memory, which survives every reset except
+// power-on. After a brownout, watchdog, panic or software reset setup()
+// redraws the saved output within a few milliseconds instead of going
+// dark and fading up from zero, and the slow start-up work is skipped.
+//
+// save() runs every loop pass. A magic word and checksum reject the random
+// contents RTC memory has after power-on and a reset in the middle of a
+// save. If the lamp resets again within WARM_BOOT_STABLE_MS of a restore,
+// which a brownout at full load would do, the restore is abandoned after
+// WARM_BOOT_MAX_RESTORES attempts and the next boot starts cold.
+class WarmBoot {
+public:
+    // True if this is a warm reset with a valid saved state
+    static bool restore(RetainedState& state);
+    static void save(const RetainedState& state, unsigned long uptimeMs);
+    static bool isWarmReset();
+    static const char* resetReasonName();
+};
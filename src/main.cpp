@@ -1,10 +1,22 @@
 #include "lamp/LampController.h"
 #include "network/NetworkManager.h"
+#include "power/EnergyModel.h"
+#include "power/CpuGovernor.h"
+#include "util/DeferredLog.h"
+#include "network/DeltaOta.h"
+#include "diag/LoopStats.h"
+#include "diag/LoadShedder.h"
+#include <esp_sleep.h>
+#include "diag/MemStats.h"
 
 const bool WIPE_EEPROM = false;  // Set to true when you want to wipe EEPROM
 
 LampController lamp;
-NetworkManager network(lamp);
+CpuGovernor governor(lamp);
+LoopStats loopStats;
+LoadShedder shedder;
+EnergyModel energy;
+NetworkManager network(lamp, governor, loopStats, shedder, energy);
 
 void wipeEEPROM() {
     EEPROM.begin(512);
@@ -23,7 +35,8 @@ void configurePowerSaving() {
     // Disable Bluetooth
     btStop();
     
-    setCpuFrequencyMhz(10);  // Options: 160, 80, 40, 20, 10 MHz
+    // Start at the idle clock; the governor boosts it when needed
+    governor.begin();  // Options: 160, 80, 40, 20, 10 MHz
     
     #if SERIAL_DEBUG
     Serial.println("Power saving configuration applied:");
@@ -34,19 +47,25 @@ void configurePowerSaving() {
 }
 
 void zeroOutPins() {
-    const int pins[] = {2, 3, 4, 5, 6, 7, 8, 9, 10, 20, 21};
-    const int numPins = sizeof(pins) / sizeof(pins[0]);
-    for (int i = 0; i < numPins; i++) {
+    const int* pins = Board::idlePins();
+    for (int i = 0; i < Board::IDLE_PIN_COUNT; i++) {
         pinMode(pins[i], INPUT_PULLDOWN);
     }
 }
 
 void setup() {
+    MemStats::registerTask(MemTag::LAMP, "loop");
     zeroOutPins();
+    // After a brownout or watchdog reset, put the light back before anything slow
+    bool warmBoot = lamp.restoreOutput();
     #if SERIAL_DEBUG
     Serial.begin(115200);
-    while (!Serial && (millis() < 3000)) delay(10);
-    Serial.println("ESP32-C3 Starting up..."); 
+    // Only a cold boot waits for the USB host; a restored lamp carries on
+    while (!warmBoot && !Serial && (millis() < 3000)) delay(10);
+    Serial.printf("%s starting up after %s reset...\n", Board::name(), WarmBoot::resetReasonName());
+    if (warmBoot) {
+        Serial.printf("Output restored, time to light: %lu us\n", (unsigned long)lamp.getTimeToLightUs());
+    }
     #endif
 
     // RGB LED initialization is now handled in LampController::begin()
@@ -59,30 +78,66 @@ void setup() {
     configurePowerSaving();
     
     lamp.begin();
+
+    #if REMOTE_CONTROL_ENABLED || DATA_LOGGING_ENABLED
+    // WebServer and HTTPClient block; run them in their own task so they never stall PWM updates
+    network.startTask();
+    #endif
 }
 
 void loop() {
+    loopStats.beginIteration(micros());
+    lamp.suspendAnimations(shedder.sheds(ShedLevel::SUSPEND_ANIMATIONS));
     lamp.update();
-    
-    #if REMOTE_CONTROL_ENABLED && DATA_LOGGING_ENABLED
-    // Support both features
-    network.update();  // Process web server requests
-    
-    // Handle data logging when needed
-    if (lamp.isDataReadyToSend()) {
-        network.sendMonitoringData();
+    loopStats.charge(LoopSubsystem::LAMP, micros());
+    governor.update();
+    loopStats.charge(LoopSubsystem::HOUSEKEEPING, micros());
+    lamp.checkTouchStatus();
+    loopStats.charge(LoopSubsystem::TOUCH, micros());
+    DeltaOta::confirmBootIfHealthy();
+
+    unsigned long now = millis();
+    if (energy.due(now)) {
+        energy.sample(now, getCpuFrequencyMhz(), lamp.getSleepTime(),
+                      WiFi.getMode() != WIFI_OFF, lamp.getPwmDuty());
     }
-    #elif REMOTE_CONTROL_ENABLED
-    // Only remote control
-    network.update();
-    #elif DATA_LOGGING_ENABLED
-    // Only data logging
-    if (lamp.isDataReadyToSend()) {
-        network.update();
-        network.sendMonitoringData();
+
+    loopStats.charge(LoopSubsystem::HOUSEKEEPING, micros());
+
+    #if SERIAL_DEBUG
+    static unsigned long lastStatsTime = 0;
+    if (now - lastStatsTime >= 60000) {
+        lastStatsTime = now;
+        governor.printStats();
+        MemStats::printReport();
+        EnergyModel::Snapshot charge = energy.read();
+        Serial.printf("Energy: %.1f mAh used, %.2f mA average, %.0f h left\n",
+                      EnergyModel::consumedMah(charge), EnergyModel::averageCurrentMa(charge),
+                      EnergyModel::remainingHours(charge));
     }
+
+    // Format queued log records now that the time-critical work is done
+    DeferredLog::drain();
+    loopStats.charge(LoopSubsystem::LOGGING, micros());
     #endif
-    
-    lamp.checkTouchStatus();
-    delay(lamp.getSleepTime());
+
+    MemStats::sampleLoop();
+    loopStats.charge(LoopSubsystem::HOUSEKEEPING, micros());
+
+    // A program holding the lamp dark (e.g. before a sunrise) light-sleeps
+    // in steps of up to PROGRAM_LIGHT_SLEEP_MAX_MS, reading the knob between
+    // them. Every other pass delays normally so the network task gets to run.
+    static bool sleptLast = false;
+    unsigned long sleepMs = lamp.getSleepTime();
+    unsigned long lightSleepMs = WiFi.getMode() == WIFI_OFF && !sleptLast ? lamp.getLightSleepMs() : 0;
+    bool lightSleep = lightSleepMs > sleepMs;
+    sleptLast = lightSleep;
+    loopStats.endIteration(micros(), lightSleep ? lightSleepMs : sleepMs);
+    shedder.update(loopStats.lastPassMissed(), millis());
+    if (lightSleep) {
+        esp_sleep_enable_timer_wakeup((uint64_t)lightSleepMs * 1000);
+        esp_light_sleep_start();
+    } else {
+        delay(sleepMs);
+    }
 }
\ No newline at end of file
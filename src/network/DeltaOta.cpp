@@ -0,0 +1,300 @@
+#include "DeltaOta.h"
+#include "../util/DeferredLog.h"
+
+namespace {
+    const uint8_t OP_END = 0x00;
+    const uint8_t OP_COPY = 0x01;
+    const uint8_t OP_INSERT = 0x02;
+
+    size_t opSize(uint8_t opcode) {
+        switch (opcode) {
+            case OP_END: return 1;
+            case OP_INSERT: return 5;
+            case OP_COPY: return 9;
+            default: return 0;
+        }
+    }
+}
+
+// Keep the new image in PENDING_VERIFY after boot instead of the Arduino
+// core confirming it straight away; see DeltaOta::confirmBootIfHealthy().
+extern "C" bool verifyRollbackLater() {
+    return true;
+}
+
+uint32_t DeltaOta::readU32(const uint8_t* bytes) {
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) |
+           ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+DeltaOta::Result DeltaOta::begin() {
+    sourcePartition = esp_ota_get_running_partition();
+    targetPartition = esp_ota_get_next_update_partition(nullptr);
+    if (!sourcePartition || !targetPartition) {
+        state = State::FAILED;
+        return fail(Result::FLASH_ERROR);
+    }
+    state = State::HEADER;
+    filled = 0;
+    written = 0;
+    outFilled = 0;
+    otaHandle = 0;
+    return Result::IN_PROGRESS;
+}
+
+DeltaOta::Result DeltaOta::fail(Result result) {
+    if (otaHandle) {
+        esp_ota_abort(otaHandle);
+        otaHandle = 0;
+        mbedtls_sha256_free(&targetHash);
+    }
+    state = State::FAILED;
+    failure = result;
+    LOG_DEFERRED("Delta OTA failed: %s\n", resultName(result));
+    return result;
+}
+
+void DeltaOta::abort() {
+    if (state != State::FAILED && state != State::DONE) {
+        fail(Result::BAD_PATCH);
+    }
+}
+
+bool DeltaOta::hashSource(uint8_t digest[32]) {
+    mbedtls_sha256_context sourceHash;
+    mbedtls_sha256_init(&sourceHash);
+    mbedtls_sha256_starts(&sourceHash, 0);
+    for (uint32_t offset = 0; offset < sourceSize; offset += WORK_BUFFER_SIZE) {
+        uint32_t chunk = min((uint32_t)WORK_BUFFER_SIZE, sourceSize - offset);
+        if (esp_partition_read(sourcePartition, offset, workBuffer, chunk) != ESP_OK) {
+            mbedtls_sha256_free(&sourceHash);
+            return false;
+        }
+        mbedtls_sha256_update(&sourceHash, workBuffer, chunk);
+    }
+    mbedtls_sha256_finish(&sourceHash, digest);
+    mbedtls_sha256_free(&sourceHash);
+    return true;
+}
+
+DeltaOta::Result DeltaOta::startImage() {
+    if (memcmp(header, "LDP1", 4) != 0) {
+        return fail(Result::BAD_HEADER);
+    }
+    sourceSize = readU32(&header[4]);
+    targetSize = readU32(&header[8]);
+    if (sourceSize > sourcePartition->size || targetSize > targetPartition->size) {
+        return fail(Result::BAD_HEADER);
+    }
+
+    uint8_t digest[32];
+    if (!hashSource(digest)) {
+        return fail(Result::FLASH_ERROR);
+    }
+    if (memcmp(digest, &header[12], 32) != 0) {
+        return fail(Result::WRONG_BASE);
+    }
+
+    if (esp_ota_begin(targetPartition, targetSize, &otaHandle) != ESP_OK) {
+        otaHandle = 0;
+        return fail(Result::FLASH_ERROR);
+    }
+    mbedtls_sha256_init(&targetHash);
+    mbedtls_sha256_starts(&targetHash, 0);
+
+    LOG_DEFERRED("Delta OTA: %lu -> %lu bytes\n", sourceSize, targetSize);
+    state = State::OP;
+    filled = 0;
+    return Result::IN_PROGRESS;
+}
+
+DeltaOta::Result DeltaOta::write(const uint8_t* data, size_t length) {
+    while (length > 0 && state != State::FAILED) {
+        switch (state) {
+            case State::HEADER: {
+                size_t take = min(length, HEADER_SIZE - filled);
+                memcpy(&header[filled], data, take);
+                filled += take;
+                data += take;
+                length -= take;
+                if (filled == HEADER_SIZE) {
+                    startImage();
+                }
+                break;
+            }
+
+            case State::OP: {
+                op[filled++] = *data++;
+                length--;
+                size_t needed = opSize(op[0]);
+                if (needed == 0) {
+                    return fail(Result::BAD_PATCH);
+                }
+                if (filled == needed) {
+                    filled = 0;
+                    runOp();
+                }
+                break;
+            }
+
+            case State::INSERT_DATA: {
+                size_t take = min((size_t)remaining, length);
+                Result result = output(data, take);
+                if (result != Result::IN_PROGRESS) {
+                    return result;
+                }
+                data += take;
+                length -= take;
+                remaining -= take;
+                if (remaining == 0) {
+                    state = State::OP;
+                }
+                break;
+            }
+
+            case State::DONE:
+                return fail(Result::BAD_PATCH);  // Trailing bytes after END
+
+            case State::FAILED:
+                break;
+        }
+    }
+    return state == State::FAILED ? failure : Result::IN_PROGRESS;
+}
+
+DeltaOta::Result DeltaOta::runOp() {
+    switch (op[0]) {
+        case OP_END:
+            state = State::DONE;
+            return Result::IN_PROGRESS;
+
+        case OP_COPY:
+            return copySource(readU32(&op[1]), readU32(&op[5]));
+
+        case OP_INSERT:
+            remaining = readU32(&op[1]);
+            state = remaining > 0 ? State::INSERT_DATA : State::OP;
+            return Result::IN_PROGRESS;
+    }
+    return fail(Result::BAD_PATCH);
+}
+
+DeltaOta::Result DeltaOta::copySource(uint32_t offset, uint32_t length) {
+    if (offset + length > sourceSize || offset + length < offset) {
+        return fail(Result::BAD_PATCH);
+    }
+    while (length > 0) {
+        uint32_t chunk = min((uint32_t)WORK_BUFFER_SIZE, length);
+        if (esp_partition_read(sourcePartition, offset, workBuffer, chunk) != ESP_OK) {
+            return fail(Result::FLASH_ERROR);
+        }
+        Result result = output(workBuffer, chunk);
+        if (result != Result::IN_PROGRESS) {
+            return result;
+        }
+        offset += chunk;
+        length -= chunk;
+    }
+    return Result::IN_PROGRESS;
+}
+
+DeltaOta::Result DeltaOta::output(const uint8_t* data, size_t length) {
+    if (written + outFilled + length > targetSize) {
+        return fail(Result::BAD_PATCH);
+    }
+    while (length > 0) {
+        size_t take = min(length, WORK_BUFFER_SIZE - outFilled);
+        memcpy(&outBuffer[outFilled], data, take);
+        outFilled += take;
+        data += take;
+        length -= take;
+        if (outFilled == WORK_BUFFER_SIZE) {
+            Result result = flushOutput();
+            if (result != Result::IN_PROGRESS) {
+                return result;
+            }
+        }
+    }
+    return Result::IN_PROGRESS;
+}
+
+DeltaOta::Result DeltaOta::flushOutput() {
+    if (outFilled == 0) {
+        return Result::IN_PROGRESS;
+    }
+    if (esp_ota_write(otaHandle, outBuffer, outFilled) != ESP_OK) {
+        return fail(Result::FLASH_ERROR);
+    }
+    mbedtls_sha256_update(&targetHash, outBuffer, outFilled);
+    written += outFilled;
+    outFilled = 0;
+    return Result::IN_PROGRESS;
+}
+
+DeltaOta::Result DeltaOta::finish() {
+    if (state == State::FAILED) {
+        return failure;
+    }
+    if (state != State::DONE) {
+        return fail(Result::BAD_PATCH);  // Truncated download
+    }
+    Result result = flushOutput();
+    if (result != Result::IN_PROGRESS) {
+        return result;
+    }
+    if (written != targetSize) {
+        return fail(Result::BAD_PATCH);
+    }
+
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&targetHash, digest);
+    if (memcmp(digest, &header[44], 32) != 0) {
+        return fail(Result::VERIFY_FAILED);
+    }
+    mbedtls_sha256_free(&targetHash);
+
+    // esp_ota_end() also checks the image header and its own checksum
+    esp_err_t err = esp_ota_end(otaHandle);
+    otaHandle = 0;
+    if (err != ESP_OK) {
+        state = State::FAILED;
+        failure = Result::VERIFY_FAILED;
+        return failure;
+    }
+    if (esp_ota_set_boot_partition(targetPartition) != ESP_OK) {
+        state = State::FAILED;
+        failure = Result::FLASH_ERROR;
+        return failure;
+    }
+    LOG_DEFERRED("Delta OTA: new image verified, %lu bytes\n", written);
+    return Result::OK;
+}
+
+void DeltaOta::confirmBootIfHealthy() {
+    static bool checked = false;
+    if (checked || millis() < LampConfig::OTA_CONFIRM_AFTER_MS) {
+        return;
+    }
+    checked = true;
+
+    esp_ota_img_states_t otaState;
+    const esp_partition_t* running = esp_ota_get_running_partition();
+    if (esp_ota_get_state_partition(running, &otaState) == ESP_OK &&
+        otaState == ESP_OTA_IMG_PENDING_VERIFY) {
+        esp_ota_mark_app_valid_cancel_rollback();
+        LOG_DEFERRED("Delta OTA: new image confirmed\n");
+    }
+}
+
+const char* DeltaOta::resultName(Result result) {
+    switch (result) {
+        case Result::IN_PROGRESS: return "in progress";
+        case Result::OK: return "ok";
+        case Result::BAD_HEADER: return "bad header";
+        case Result::WRONG_BASE: return "wrong base image";
+        case Result::BAD_PATCH: return "bad patch";
+        case Result::FLASH_ERROR: return "flash error";
+        case Result::VERIFY_FAILED: return "verify failed";
+    }
+    return "unknown";
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include "../config/Config.h"
+#include <cstdint>
+#include <Arduino.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <mbedtls/sha256.h>
+
+// Streams a binary delta against the running image into the inactive OTA
+// partition. RAM use is bounded by a few small buffers regardless of image size.
+//
+// Patch format (little endian, produced by ota_delta.py):
+//   header: "LDP1", sourceSize:u32, targetSize:u32, sourceSha256[32], targetSha256[32]
+//   ops:    0x01 COPY   srcOffset:u32 length:u32
+//           0x02 INSERT length:u32 data[length]
+//           0x00 END
+class DeltaOta {
+public:
+    enum class Result {
+        IN_PROGRESS,
+        OK,
+        BAD_HEADER,
+        WRONG_BASE,     // Patch was made against a different running image
+        BAD_PATCH,
+        FLASH_ERROR,
+        VERIFY_FAILED
+    };
+
+    Result begin();
+    Result write(const uint8_t* data, size_t length);
+    Result finish();    // Verify and select the new image for the next boot
+    void abort();
+    static const char* resultName(Result result);
+
+    // A freshly updated image stays pending until it has run long enough;
+    // if it resets before that the bootloader rolls back.
+    static void confirmBootIfHealthy();
+
+private:
+    enum class State {
+        HEADER,
+        OP,
+        INSERT_DATA,
+        DONE,
+        FAILED
+    };
+
+    static const size_t HEADER_SIZE = 4 + 4 + 4 + 32 + 32;
+    static const size_t OP_MAX_SIZE = 9;
+    static const size_t WORK_BUFFER_SIZE = 256;
+
+    State state = State::FAILED;
+    Result failure = Result::BAD_PATCH;
+    uint8_t header[HEADER_SIZE];
+    uint8_t op[OP_MAX_SIZE];
+    size_t filled = 0;         // Bytes collected in header[] or op[]
+    uint32_t sourceSize = 0;
+    uint32_t targetSize = 0;
+    uint32_t written = 0;
+    uint32_t remaining = 0;    // Bytes left in the current INSERT op
+
+    const esp_partition_t* sourcePartition = nullptr;
+    const esp_partition_t* targetPartition = nullptr;
+    esp_ota_handle_t otaHandle = 0;
+    mbedtls_sha256_context targetHash;
+
+    uint8_t workBuffer[WORK_BUFFER_SIZE];
+    uint8_t outBuffer[WORK_BUFFER_SIZE];
+    size_t outFilled = 0;
+
+    Result startImage();
+    Result runOp();
+    Result copySource(uint32_t offset, uint32_t length);
+    Result output(const uint8_t* data, size_t length);
+    Result flushOutput();
+    Result fail(Result result);
+    bool hashSource(uint8_t digest[32]);
+    static uint32_t readU32(const uint8_t* bytes);
+};
@@ -0,0 +1,149 @@
+#include "MqttTransport.h"
+#include "../util/DeferredLog.h"
+
+#if TELEMETRY_MQTT
+
+// Fixed header + topic length + topic, on top of the JSON array
+static_assert(LampConfig::MQTT_BATCH_SIZE * LampConfig::MQTT_SAMPLE_SIZE + 2 + 5 + 2 + 40 <= LampConfig::MQTT_BUFFER_SIZE,
+              "MQTT_BUFFER_SIZE can't hold a full batch");
+
+MqttTransport::MqttTransport() : client(wifiClient) {}
+
+void MqttTransport::begin(LampController& lampCtrl) {
+    lamp = &lampCtrl;
+    char id[17];
+    snprintf(id, sizeof(id), "%016llX", (unsigned long long)lamp->getSerialNumber());
+    snprintf(clientId, sizeof(clientId), "lamp-%s", id);
+    snprintf(telemetryTopic, sizeof(telemetryTopic), "lamp/%s/telemetry", id);
+    snprintf(brightnessTopic, sizeof(brightnessTopic), "lamp/%s/brightness", id);
+    snprintf(statusTopic, sizeof(statusTopic), "lamp/%s/status", id);
+
+    client.setServer(LampConfig::MQTT_BROKER_IP, LampConfig::MQTT_PORT);
+    client.setKeepAlive(LampConfig::MQTT_KEEPALIVE_S);
+    client.setBufferSize(LampConfig::MQTT_BUFFER_SIZE);
+    client.setCallback([this](char* topic, uint8_t* payload, unsigned int length) {
+        handleMessage(topic, payload, length);
+    });
+}
+
+bool MqttTransport::connect() {
+    lastAttempt = millis();
+    // cleanSession = false keeps our subscription and queued QoS 1 commands on the broker
+    if (!client.connect(clientId, nullptr, nullptr, statusTopic, 1, true, "offline", false)) {
+        LOG_DEFERRED("MQTT connect failed, state %d\n", client.state());
+        return false;
+    }
+    client.subscribe(brightnessTopic, 1);
+    client.publish(statusTopic, "online", true);
+    LOG_DEFERRED("MQTT connected as %s\n", clientId);
+    return true;
+}
+
+bool MqttTransport::loop() {
+    if (WiFi.status() != WL_CONNECTED) {
+        return false;
+    }
+    if (!client.connected()) {
+        if (lastAttempt != 0 && millis() - lastAttempt < LampConfig::MQTT_RETRY_MS) {
+            return false;
+        }
+        if (!connect()) {
+            return false;
+        }
+    }
+    client.loop();
+    if (count > 0) {
+        flush();
+    }
+    return true;
+}
+
+void MqttTransport::enqueue(const String& report) {
+    if (report.length() >= (unsigned int)LampConfig::MQTT_SAMPLE_SIZE) {
+        dropped++;
+        return;
+    }
+    if (count == LampConfig::MQTT_QUEUE_SIZE) {
+        // Offline for too long: keep the newest reports
+        head = (head + 1) % LampConfig::MQTT_QUEUE_SIZE;
+        count--;
+        dropped++;
+    }
+    int slot = (head + count) % LampConfig::MQTT_QUEUE_SIZE;
+    memcpy(queue[slot], report.c_str(), report.length());
+    lengths[slot] = report.length();
+    count++;
+}
+
+bool MqttTransport::publishBatch(int reports) {
+    char payload[LampConfig::MQTT_BATCH_SIZE * LampConfig::MQTT_SAMPLE_SIZE + 2];
+    size_t length = 0;
+    payload[length++] = '[';
+    for (int i = 0; i < reports; i++) {
+        int slot = (head + i) % LampConfig::MQTT_QUEUE_SIZE;
+        if (i > 0) {
+            payload[length++] = ',';
+        }
+        memcpy(payload + length, queue[slot], lengths[slot]);
+        length += lengths[slot];
+    }
+    payload[length++] = ']';
+    return client.publish(telemetryTopic, (const uint8_t*)payload, length);
+}
+
+bool MqttTransport::flush() {
+    if (!client.connected()) {
+        return false;
+    }
+    if (count > 0) {
+        lamp->postCommand({LampCommand::Type::SHOW_PATTERN, (float)StatusPattern::UPLOADING});
+    }
+    while (count > 0) {
+        int reports = min(count, (int)LampConfig::MQTT_BATCH_SIZE);
+        if (!publishBatch(reports)) {
+            LOG_DEFERRED("MQTT publish failed, %d reports still queued\n", count);
+            return false;
+        }
+        LOG_DEFERRED("MQTT published %d reports\n", reports);
+        head = (head + reports) % LampConfig::MQTT_QUEUE_SIZE;
+        count -= reports;
+    }
+    return true;
+}
+
+void MqttTransport::waitForCommands(unsigned long ms) {
+    unsigned long start = millis();
+    while (client.connected() && millis() - start < ms) {
+        client.loop();
+        vTaskDelay(pdMS_TO_TICKS(LampConfig::NETWORK_TASK_INTERVAL_MS));
+    }
+}
+
+void MqttTransport::disconnect() {
+    // A clean DISCONNECT doesn't trigger the will and leaves the session on the broker
+    if (client.connected()) {
+        client.publish(statusTopic, "offline", true);
+        client.disconnect();
+    }
+}
+
+void MqttTransport::handleMessage(char* topic, uint8_t* payload, unsigned int length) {
+    if (strcmp(topic, brightnessTopic) != 0) {
+        return;
+    }
+    char text[8];
+    length = min(length, (unsigned int)sizeof(text) - 1);
+    memcpy(text, payload, length);
+    text[length] = '\0';
+
+    char* end;
+    float brightness = strtof(text, &end);
+    if (end == text || brightness < 0 || brightness > 100) {
+        LOG_DEFERRED("MQTT ignoring brightness payload (%u bytes)\n", length);
+        return;
+    }
+    if (!lamp->postCommand({LampCommand::Type::SET_BRIGHTNESS, brightness})) {
+        LOG_DEFERRED("MQTT brightness dropped, command queue full\n");
+    }
+}
+#endif
@@ -0,0 +1,53 @@
+#pragma once
+#include "../config/Config.h"
+#if TELEMETRY_MQTT   // PubSubClient is only in lib_deps of the MQTT envs
+#include "../lamp/LampController.h"
+#include <Arduino.h>
+#include <WiFi.h>
+#include <PubSubClient.h>
+
+// Telemetry and brightness commands over one MQTT session, used instead of an
+// HTTP POST per report when TELEMETRY_MQTT is set.
+//
+// Topics (<id> is the 16 digit serial number):
+//   lamp/<id>/telemetry   JSON array of monitoring reports, one publish per batch
+//   lamp/<id>/brightness  0-100, subscribed at QoS 1 and posted as SET_BRIGHTNESS
+//   lamp/<id>/status      "online" / "offline", retained; also the will if the session drops
+//
+// Reports are queued in a ring buffer while there is no session and sent in
+// batches once there is. The session is persistent (clean session off), so a
+// brightness command sent while the radio was off is delivered on the next
+// connect. Only the network task uses this.
+class MqttTransport {
+public:
+    MqttTransport();
+    void begin(LampController& lampCtrl);
+    bool loop();        // Connects when WiFi is up and services the session; true while connected
+    void enqueue(const String& report);
+    bool batchReady() const { return count >= LampConfig::MQTT_BATCH_SIZE; }
+    bool flush();       // Publishes every queued report; false if a publish failed
+    void waitForCommands(unsigned long ms);
+    void disconnect();
+    uint32_t getDropped() const { return dropped; }
+
+private:
+    WiFiClient wifiClient;
+    PubSubClient client;
+    LampController* lamp = nullptr;
+    char clientId[24];
+    char telemetryTopic[40];
+    char brightnessTopic[40];
+    char statusTopic[40];
+
+    char queue[LampConfig::MQTT_QUEUE_SIZE][LampConfig::MQTT_SAMPLE_SIZE];
+    uint8_t lengths[LampConfig::MQTT_QUEUE_SIZE];
+    int head = 0;       // Oldest queued report
+    int count = 0;
+    uint32_t dropped = 0;
+    unsigned long lastAttempt = 0;
+
+    bool connect();
+    bool publishBatch(int reports);
+    void handleMessage(char* topic, uint8_t* payload, unsigned int length);
+};
+#endif
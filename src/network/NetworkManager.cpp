@@ -1,6 +1,11 @@
 #include "NetworkManager.h"
+#include "DeltaOta.h"
+#include "../util/DeferredLog.h"
+#include "../diag/MemStats.h"
 
-NetworkManager::NetworkManager(LampController& lampCtrl) : lamp(&lampCtrl) {}
+NetworkManager::NetworkManager(LampController& lampCtrl, CpuGovernor& cpuGovernor, LoopStats& stats,
+                               LoadShedder& loadShedder, EnergyModel& energyModel)
+    : lamp(&lampCtrl), governor(&cpuGovernor), loopStats(&stats), shedder(&loadShedder), energy(&energyModel) {}
 
 void NetworkManager::begin() {
     EEPROM.begin(512);
@@ -45,6 +50,10 @@ void NetworkManager::begin() {
     // Basic mode - no network features
     WiFi.mode(WIFI_OFF);
     #endif
+
+    #if TELEMETRY_MQTT
+    mqtt.begin(*lamp);
+    #endif
 }
 
 bool NetworkManager::loadConfig() {
@@ -74,17 +83,23 @@ void NetworkManager::saveConfig(const char* ssid, const char* pass) {
 }
 
 bool NetworkManager::tryConnect(const char* ssid, const char* pass, int timeout) {
+    LoopStats::Activity activity(*loopStats, LoopSubsystem::WIFI_CONNECT);
     Serial.print("Attempting to connect to WiFi SSID: ");
     Serial.println(ssid);
     
+    // Association is slow at the idle clock
+    governor->request(CpuGovernor::Demand::NETWORK);
+    lamp->postCommand({LampCommand::Type::SET_BACKGROUND, (float)StatusPattern::CONNECTING});
     WiFi.begin(ssid, pass);
     int attempts = 0;
     while (WiFi.status() != WL_CONNECTED && attempts < timeout) {
+        governor->request(CpuGovernor::Demand::NETWORK);
         delay(1000);
-        Serial.print(".");
+        LOG_DEFERRED(".");
         attempts++;
     }
-    Serial.println();
+    LOG_DEFERRED("\n");
+    lamp->postCommand({LampCommand::Type::CLEAR_BACKGROUND, 0});
     
     if (WiFi.status() == WL_CONNECTED) {
         Serial.println("Successfully connected to WiFi!");
@@ -103,19 +118,29 @@ void NetworkManager::setupStation() {
     
     // Or manually add CORS headers to each endpoint:
     server.on("/api/status", HTTP_GET, [this]() {
+        governor->request(CpuGovernor::Demand::REQUEST);
         server.sendHeader("Access-Control-Allow-Origin", "*");
         server.sendHeader("Access-Control-Allow-Methods", "GET");
         server.sendHeader("Access-Control-Allow-Headers", "Content-Type");
         
-        float normalizedValue = (lamp->getCurrentValue() / LampConfig::MAX_ANALOG) * 100.0;
-        String json = "{\"brightness\":" + String(normalizedValue, 1) + 
-                     ",\"deviceName\":\"" + deviceName + "\"" +
-                     ",\"batteryVoltage\":" + String(lamp->getBatteryVoltage(), 2) + "}";
-        server.send(200, "application/json", json);
+        server.send(200, "application/json", getStatusJson());
     });
 
     // Add similar headers to other endpoints...
 
+    // Heap, fragmentation, stack watermarks and per-subsystem allocations
+    server.on("/api/memory", HTTP_GET, [this]() {
+        server.send(200, "application/json", MemStats::json());
+    });
+
+    // Control loop timing, for load testing with load_gen.py (?reset=1 clears it)
+    server.on("/api/loop", HTTP_GET, [this]() {
+        server.send(200, "application/json", getLoopJson());
+        if (server.hasArg("reset")) {
+            loopStats->requestReset();
+        }
+    });
+
     server.on("/api/test", HTTP_GET, [this]() {
         server.send(200, "application/json", "{\"status\":\"success\"}");
     });
@@ -123,14 +148,146 @@ void NetworkManager::setupStation() {
     // to chech this is working you can use curl on the command line:
     // curl http://smartlamp.local/api/test
 
+    // Ask the lamp to fetch a delta update from the logging server now
+    server.on("/api/ota", HTTP_POST, [this]() {
+        governor->request(CpuGovernor::Demand::REQUEST);
+        server.send(202, "application/json", "{\"status\":\"checking\"}");
+        if (!checkForUpdate()) {
+            LOG_DEFERRED("No firmware update applied\n");
+        }
+    });
+
+
+    // Software reset; the lamp comes back through the warm boot path (see WarmBoot.h)
+    server.on("/api/restart", HTTP_POST, [this]() {
+        server.send(202, "application/json", "{\"status\":\"restarting\"}");
+        delay(100);  // Let the response go out
+        ESP.restart();
+    });
+
+    // Let the lamp run at full output on a low battery (override=1) or derate again (override=0)
+    server.on("/api/derating", HTTP_POST, [this]() {
+        governor->request(CpuGovernor::Demand::REQUEST);
+        if (!server.hasArg("override")) {
+            server.send(400, "application/json", "{\"error\":\"missing parameters\"}");
+            return;
+        }
+        float enabled = server.arg("override").toInt() != 0 ? 1.0f : 0.0f;
+        if (lamp->postCommand({LampCommand::Type::SET_DERATING_OVERRIDE, enabled})) {
+            server.send(200, "application/json", "{\"status\":\"success\"}");
+        } else {
+            server.send(503, "application/json", "{\"error\":\"busy\"}");
+        }
+    });
+
+    // Two-point battery calibration: post the pack voltage read from a meter
+    // (voltage=12.43) once near full and once near empty; clear=1 drops it.
+    // Answers pending after the first point, completed after the second, and
+    // rejected for a second point too close to the first or on its wrong side.
+    server.on("/api/calibrate", HTTP_POST, [this]() {
+        governor->request(CpuGovernor::Demand::REQUEST);
+        if (server.hasArg("clear")) {
+            bool queued = lamp->postCommand({LampCommand::Type::CLEAR_CALIBRATION, 0});
+            server.send(queued ? 200 : 503, "application/json",
+                        queued ? "{\"status\":\"success\"}" : "{\"error\":\"busy\"}");
+            return;
+        }
+        if (!server.hasArg("voltage")) {
+            server.send(400, "application/json", "{\"error\":\"missing parameters\"}");
+            return;
+        }
+        float measured = server.arg("voltage").toFloat();
+        if (!(measured > 0.0f && measured * 1000.0f <= LampConfig::ADC_CAL_MAX_MV)) {
+            server.send(400, "application/json", "{\"error\":\"voltage out of range\"}");
+            return;
+        }
+        uint32_t points = lamp->getStatus().calibrationPoints;
+        if (!lamp->postCommand({LampCommand::Type::CALIBRATE_VOLTAGE, measured})) {
+            server.send(503, "application/json", "{\"error\":\"busy\"}");
+            return;
+        }
+        // The lamp samples the ADC for the point on its next update()
+        LampStatus status = lamp->getStatus();
+        unsigned long start = millis();
+        while (status.calibrationPoints == points && millis() - start < LampConfig::ADC_CAL_REPLY_MS) {
+            delay(10);
+            status = lamp->getStatus();
+        }
+        if (status.calibrationPoints == points) {
+            server.send(202, "application/json", "{\"status\":\"queued\"}");
+        } else if (status.calibrationResult == AdcCalibration::PointResult::COMPLETED) {
+            server.send(200, "application/json", "{\"status\":\"completed\"}");
+        } else if (status.calibrationResult == AdcCalibration::PointResult::PENDING) {
+            server.send(200, "application/json", "{\"status\":\"pending\"}");
+        } else {
+            server.send(400, "application/json", "{\"error\":\"rejected\"}");
+        }
+    });
+
+    // Upload a brightness program once; it runs on the lamp with no further traffic
+    // (see BrightnessProgram.h for the format). stop=1 cancels it.
+    server.on("/api/program", HTTP_POST, [this]() {
+        governor->request(CpuGovernor::Demand::REQUEST);
+        if (server.hasArg("stop")) {
+            bool queued = lamp->postCommand({LampCommand::Type::STOP_PROGRAM, 0});
+            server.send(queued ? 200 : 503, "application/json",
+                        queued ? "{\"status\":\"success\"}" : "{\"error\":\"busy\"}");
+            return;
+        }
+        if (!server.hasArg("steps")) {
+            server.send(400, "application/json", "{\"error\":\"missing parameters\"}");
+            return;
+        }
+        float start = server.hasArg("start") ? server.arg("start").toFloat() : lamp->getStatus().brightness;
+        long delayS = server.hasArg("delay") ? server.arg("delay").toInt() : 0;
+        CompiledProgram compiled;
+        const char* error = delayS < 0 ? "bad delay"
+                          : BrightnessProgram::compile(server.arg("steps").c_str(), start, (uint32_t)delayS, compiled);
+        if (error) {
+            server.send(400, "application/json", "{\"error\":\"" + String(error) + "\"}");
+        } else if (lamp->loadProgram(compiled)) {
+            // The program needs no traffic: radio=off turns the radio off once this response is out
+            if (server.arg("radio") == "off") {
+                programRadio = ProgramRadio::TURN_OFF;
+                programRadioStarts = lamp->getStatus().programsStarted + 1;
+            }
+            server.send(200, "application/json", "{\"status\":\"success\",\"segments\":" + String(compiled.count) + "}");
+        } else {
+            server.send(503, "application/json", "{\"error\":\"busy\"}");
+        }
+    });
 
     server.on("/api/control", HTTP_POST, [this]() {
+        governor->request(CpuGovernor::Demand::REQUEST);
+        if (!server.hasArg("brightness") && !server.hasArg("cct")) {
+            server.send(400, "application/json", "{\"error\":\"missing parameters\"}");
+            return;
+        }
+
+        // Both arguments are checked, then queued together: a 503 means neither was applied
+        LampCommand commands[2];
+        size_t count = 0;
+        if (server.hasArg("cct")) {
+            float cct = server.arg("cct").toFloat();
+            if (!(cct >= LampConfig::CCT_WARM_K && cct <= LampConfig::CCT_COOL_K)) {
+                server.send(400, "application/json", "{\"error\":\"cct out of range\"}");
+                return;
+            }
+            commands[count++] = {LampCommand::Type::SET_CCT, cct};
+        }
         if (server.hasArg("brightness")) {
             float brightness = server.arg("brightness").toFloat();
-            lamp->setRemoteValue(brightness);
+            if (!(brightness >= 0.0f && brightness <= 100.0f)) {
+                server.send(400, "application/json", "{\"error\":\"brightness out of range\"}");
+                return;
+            }
+            commands[count++] = {LampCommand::Type::SET_BRIGHTNESS, brightness};
+        }
+
+        if (lamp->postCommands(commands, count)) {
             server.send(200, "application/json", "{\"status\":\"success\"}");
         } else {
-            server.send(400, "application/json", "{\"error\":\"missing parameters\"}");
+            server.send(503, "application/json", "{\"error\":\"busy\"}");
         }
     });
 
@@ -141,15 +298,157 @@ void NetworkManager::setupStation() {
     }
 }
 
+String NetworkManager::getStatusJson() const {
+    LampStatus status = lamp->getStatus();
+    EnergyModel::Snapshot charge = energy->read();
+    return "{\"brightness\":" + String(status.brightness, 1) + 
+           ",\"deviceName\":\"" + deviceName + "\"" +
+           ",\"board\":\"" + Board::name() + "\"" +
+           ",\"batteryVoltage\":" + String(status.batteryVoltage, 2) +
+           ",\"adcCalibration\":\"" + (status.adcCalibration ? status.adcCalibration : "") + "\"" +
+           ",\"cct\":" + String(status.cct) +
+           ",\"outputCap\":" + String(status.outputCap, 2) +
+           ",\"deratingOverride\":" + (status.deratingOverride ? "true" : "false") +
+           ",\"resetReason\":\"" + WarmBoot::resetReasonName() + "\"" +
+           ",\"warmBoot\":" + (status.warmBoot ? "true" : "false") +
+           ",\"timeToLightUs\":" + String(status.timeToLightUs) +
+           ",\"programRunning\":" + (status.programRunning ? "true" : "false") +
+           ",\"programRemainingS\":" + String(status.programRemainingS) +
+           ",\"cpuMhz\":" + String(governor->getFrequencyMhz()) +
+           ",\"currentMa\":" + String(charge.currentUa / 1000.0f, 2) +
+           ",\"consumedMah\":" + String(EnergyModel::consumedMah(charge), 1) +
+           ",\"averageMa\":" + String(EnergyModel::averageCurrentMa(charge), 2) +
+           ",\"remainingH\":" + String(EnergyModel::remainingHours(charge), 0) + "}";
+}
+
+String NetworkManager::getLoopJson() const {
+    LoopStats::Snapshot stats = loopStats->read();
+    LoadShedder::Snapshot shed = shedder->read();
+    return "{\"iterations\":" + String(stats.iterations) +
+           ",\"deadlineMisses\":" + String(stats.deadlineMisses) +
+           ",\"maxWorkUs\":" + String(stats.maxWorkUs) +
+           ",\"latenessP50Us\":" + String(LoopStats::latenessPercentileUs(stats, 0.5f)) +
+           ",\"latenessP99Us\":" + String(LoopStats::latenessPercentileUs(stats, 0.99f)) +
+           ",\"maxLatenessUs\":" + String(stats.maxLatenessUs) +
+           ",\"overruns\":" + String(stats.overruns) +
+           ",\"blame\":" + getBlameJson(stats) +
+           ",\"shedLevel\":\"" + LoadShedder::levelName((ShedLevel)shed.level) + "\"" +
+           ",\"shedRaises\":" + String(shed.raises) +
+           ",\"msAtShedLevel\":[" + String(shed.msAtLevel[0]) + "," + String(shed.msAtLevel[1]) + "," +
+           String(shed.msAtLevel[2]) + "," + String(shed.msAtLevel[3]) + "]" +
+           ",\"freeHeap\":" + String(ESP.getFreeHeap()) +
+           ",\"minFreeHeap\":" + String(ESP.getMinFreeHeap()) + "}";
+}
+
+String NetworkManager::getBlameJson(const LoopStats::Snapshot& stats) {
+    String json = "{";
+    for (int i = 0; i < (int)LoopSubsystem::COUNT; i++) {
+        if (i > 0) {
+            json += ",";
+        }
+        json += "\"" + String(LoopStats::subsystemName((LoopSubsystem)i)) + "\":" + String(stats.blame[i]);
+    }
+    return json + "}";
+}
+
 void NetworkManager::handleNotFound() {
     server.send(404, "application/json", "{\"error\":\"not found\"}");
 }
 
 void NetworkManager::update() {
+    LoopStats::Activity activity(*loopStats, LoopSubsystem::WEB_SERVER);
     if (inAPMode) {
         dnsServer.processNextRequest();
     }
     server.handleClient();
+    #if TELEMETRY_MQTT
+    mqtt.loop();  // Holds the session open for as long as WiFi is up
+    #endif
+}
+
+void NetworkManager::startTask() {
+    xTaskCreate(taskEntry, "network", LampConfig::NETWORK_TASK_STACK_SIZE, this,
+                LampConfig::NETWORK_TASK_PRIORITY, &taskHandle);
+}
+
+void NetworkManager::taskEntry(void* param) {
+    static_cast<NetworkManager*>(param)->taskLoop();
+}
+
+void NetworkManager::taskLoop() {
+    // Blocking connects and HTTP calls happen here, off the lamp's loop()
+    MemStats::registerTask(MemTag::NETWORK, "network");
+    begin();
+
+    for (;;) {
+        service();
+        vTaskDelay(pdMS_TO_TICKS(LampConfig::NETWORK_TASK_INTERVAL_MS));
+    }
+}
+
+void NetworkManager::service() {
+    #if REMOTE_CONTROL_ENABLED
+    if (holdRadioForProgram()) {
+        return;
+    }
+    // Process web server requests; less often while the control loop is missing deadlines
+    if (!shedder->sheds(ShedLevel::THROTTLE_SERVER) ||
+        millis() - lastServeTime >= LampConfig::SHED_SERVER_INTERVAL_MS) {
+        lastServeTime = millis();
+        update();
+    }
+    #endif
+
+    #if DATA_LOGGING_ENABLED
+    if (lamp->getStatus().reportSequence != lastReportSequence) {
+        #if !REMOTE_CONTROL_ENABLED
+        update();
+        #endif
+        sendMonitoringData();
+    }
+    #endif
+}
+
+bool NetworkManager::holdRadioForProgram() {
+    switch (programRadio) {
+        case ProgramRadio::ON:
+            return false;
+        case ProgramRadio::TURN_OFF:
+            // The upload's response has gone out
+            LOG_DEFERRED("Radio off while the program runs\n");
+            MDNS.end();
+            WiFi.disconnect(true);
+            WiFi.mode(WIFI_OFF);
+            programRadio = ProgramRadio::OFF;
+            return true;
+        case ProgramRadio::OFF: {
+            // Until the lamp has started the program and it has ended: finished, or the knob took over
+            LampStatus status = lamp->getStatus();
+            if ((int32_t)(status.programsStarted - programRadioStarts) < 0 || status.programRunning) {
+                return true;
+            }
+            unsigned long now = millis();
+            if (connectionFailures > 0 &&
+                now - lastConnectionAttempt < CONNECTION_RETRY_INTERVAL * connectionFailures) {
+                return true;
+            }
+            lastConnectionAttempt = now;
+            if (!tryConnect(wifiConfig.ssid, wifiConfig.password)) {
+                // The access point is gone: radio off again until the backoff runs out
+                connectionFailures++;
+                LOG_DEFERRED("Reconnect failed %d times, next try in %lu s\n", connectionFailures,
+                             (CONNECTION_RETRY_INTERVAL * connectionFailures) / 1000);
+                WiFi.disconnect(true);
+                WiFi.mode(WIFI_OFF);
+                return true;
+            }
+            connectionFailures = 0;
+            setupMDNS();
+            programRadio = ProgramRadio::ON;
+            return false;
+        }
+    }
+    return false;
 }
 
 void NetworkManager::setupAP() {
@@ -158,6 +457,7 @@ void NetworkManager::setupAP() {
     
     IPAddress apIP(192, 168, 4, 1);
     WiFi.softAPConfig(apIP, apIP, IPAddress(255, 255, 255, 0));
+    lamp->postCommand({LampCommand::Type::SET_BACKGROUND, (float)StatusPattern::AP_MODE});
     
     // Configure DNS server to redirect all requests to our IP
     dnsServer.setErrorReplyCode(DNSReplyCode::NoError);
@@ -241,6 +541,71 @@ bool NetworkManager::setupMDNS() {
     return true;
 }
 
+String NetworkManager::getFirmwareUrl() const {
+    char elfSha[17];
+    esp_ota_get_app_elf_sha256(elfSha, sizeof(elfSha));
+    return "http://" + String(LampConfig::DEFAULT_LOGGING_SERVER_IP) +
+           ":" + String(LampConfig::DEFAULT_LOGGING_SERVER_PORT) +
+           "/api/firmware/delta?from=" + String(elfSha);
+}
+
+bool NetworkManager::checkForUpdate() {
+    MemStats::Scope memScope(MemTag::OTA);
+    LoopStats::Activity activity(*loopStats, LoopSubsystem::OTA);
+    lastUpdateCheck = millis();
+    governor->request(CpuGovernor::Demand::NETWORK);
+
+    HTTPClient http;
+    http.begin(getFirmwareUrl());
+    int httpResponseCode = http.GET();
+    if (httpResponseCode != HTTP_CODE_OK) {
+        // 204: no delta for the running image
+        http.end();
+        return false;
+    }
+
+    WiFiClient* stream = http.getStreamPtr();
+    int remaining = http.getSize();  // -1 when the server doesn't send a length
+    DeltaOta ota;
+    DeltaOta::Result result = ota.begin();
+    uint8_t buffer[256];
+    unsigned long lastDataTime = millis();
+
+    while (result == DeltaOta::Result::IN_PROGRESS && http.connected() &&
+           (remaining > 0 || remaining == -1)) {
+        size_t available = stream->available();
+        if (available == 0) {
+            if (millis() - lastDataTime > LampConfig::OTA_STREAM_TIMEOUT_MS) {
+                break;
+            }
+            delay(1);
+            continue;
+        }
+        int count = stream->readBytes(buffer, min(available, sizeof(buffer)));
+        result = ota.write(buffer, count);
+        if (remaining > 0) {
+            remaining -= count;
+        }
+        lastDataTime = millis();
+        governor->request(CpuGovernor::Demand::NETWORK);
+    }
+    http.end();
+
+    if (result == DeltaOta::Result::IN_PROGRESS) {
+        result = ota.finish();
+    }
+    if (result != DeltaOta::Result::OK) {
+        ota.abort();
+        LOG_DEFERRED("Firmware update failed: %s\n", DeltaOta::resultName(result));
+        return false;
+    }
+
+    Serial.println("Firmware updated, restarting...");
+    delay(100);
+    ESP.restart();
+    return true;
+}
+
 #if DATA_LOGGING_ENABLED
 String NetworkManager::getLoggingServerUrl() const {
     return "http://" + String(LampConfig::DEFAULT_LOGGING_SERVER_IP) + 
@@ -253,51 +618,74 @@ bool NetworkManager::sendDataToServer(const String& data) {
     http.begin(url);
     http.addHeader("Content-Type", "application/json");
     
-    Serial.print("Sending data to: ");
-    Serial.println(url);
+    LOG_DEFERRED("Sending data to: http://%s:%d/api/log\n",
+                 LampConfig::DEFAULT_LOGGING_SERVER_IP, LampConfig::DEFAULT_LOGGING_SERVER_PORT);
+    lamp->postCommand({LampCommand::Type::SHOW_PATTERN, (float)StatusPattern::UPLOADING});
     
     int httpResponseCode = http.POST(data);
     
     if (httpResponseCode > 0) {
-        Serial.printf("HTTP Response code: %d\n", httpResponseCode);
-        String response = http.getString();
-        Serial.println(response);
+        LOG_DEFERRED("HTTP Response code: %d\n", httpResponseCode);
         http.end();
         return true;
     } else {
-        Serial.printf("Error code: %d\n", httpResponseCode);
+        LOG_DEFERRED("Error code: %d\n", httpResponseCode);
         http.end();
         return false;
     }
 }
 
 void NetworkManager::enableWiFi() {
-    Serial.println("Enabling WiFi for data transmission...");
+    LOG_DEFERRED("Enabling WiFi for data transmission...\n");
+    governor->request(CpuGovernor::Demand::NETWORK);
     WiFi.mode(WIFI_STA);
     wifiStartTime = millis();
     
     #if DEV_MODE
     // In development mode, always use the hardcoded credentials
-    Serial.println("DEV MODE: Using hardcoded WiFi credentials");
-    Serial.printf("Connecting to %s...\n", LampConfig::DEV_WIFI_SSID);
+    LOG_DEFERRED("DEV MODE: Using hardcoded WiFi credentials\n");
+    LOG_DEFERRED("Connecting to %s...\n", LampConfig::DEV_WIFI_SSID);
     WiFi.begin(LampConfig::DEV_WIFI_SSID, LampConfig::DEV_WIFI_PASSWORD);
     #else
     // Normal mode - use stored credentials
     if (wifiConfig.configured) {
-        Serial.printf("Connecting to %s...\n", wifiConfig.ssid);
+        LOG_DEFERRED("Connecting to %s...\n", wifiConfig.ssid);
         WiFi.begin(wifiConfig.ssid, wifiConfig.password);
     }
     #endif
 }
 
 void NetworkManager::disableWiFi() {
-    Serial.println("Disabling WiFi to save power...");
+    LOG_DEFERRED("Disabling WiFi to save power...\n");
+    #if TELEMETRY_MQTT
+    mqtt.disconnect();
+    #endif
     WiFi.disconnect(true);
     WiFi.mode(WIFI_OFF);
 }
 
 void NetworkManager::sendMonitoringData() {
+    MemStats::Scope memScope(MemTag::TELEMETRY);
+    LoopStats::Activity activity(*loopStats, LoopSubsystem::TELEMETRY);
     unsigned long currentTime = millis();
+
+    #if TELEMETRY_MQTT
+    // Every report is queued; the radio only comes up once there is a batch to send
+    LampStatus latest = lamp->getStatus();
+    if (latest.reportSequence != queuedReportSequence) {
+        queuedReportSequence = latest.reportSequence;
+        mqtt.enqueue(lamp->getMonitoringData(latest));
+    }
+    if (WiFi.getMode() == WIFI_OFF && !mqtt.batchReady()) {
+        lastReportSequence = latest.reportSequence;
+        return;
+    }
+    #endif
+
+    // Shed while the control loop is missing deadlines
+    if (deferTelemetry()) {
+        return;
+    }
     
     // If we've had connection failures, implement a backoff strategy
     if (connectionFailures > 0 && 
@@ -310,23 +698,24 @@ void NetworkManager::sendMonitoringData() {
     if (WiFi.status() != WL_CONNECTED) {
         // If WiFi is off, turn it on and attempt to connect
         if (WiFi.getMode() == WIFI_OFF) {
-            Serial.println("Enabling WiFi for data transmission...");
+            LOG_DEFERRED("Enabling WiFi for data transmission...\n");
+            governor->request(CpuGovernor::Demand::NETWORK);
             WiFi.mode(WIFI_STA);
             
             #if DEV_MODE
             // In development mode, always use the hardcoded credentials
-            Serial.println("DEV MODE: Using hardcoded WiFi credentials");
-            Serial.printf("Connecting to %s...\n", LampConfig::DEV_WIFI_SSID);
+            LOG_DEFERRED("DEV MODE: Using hardcoded WiFi credentials\n");
+            LOG_DEFERRED("Connecting to %s...\n", LampConfig::DEV_WIFI_SSID);
             WiFi.begin(LampConfig::DEV_WIFI_SSID, LampConfig::DEV_WIFI_PASSWORD);
             lastConnectionAttempt = currentTime;
             #else
             // Normal mode - use stored credentials
             if (wifiConfig.configured) {
-                Serial.printf("Connecting to %s...\n", wifiConfig.ssid);
+                LOG_DEFERRED("Connecting to %s...\n", wifiConfig.ssid);
                 WiFi.begin(wifiConfig.ssid, wifiConfig.password);
                 lastConnectionAttempt = currentTime;
             } else {
-                Serial.println("WiFi not configured, cannot connect");
+                LOG_DEFERRED("WiFi not configured, cannot connect\n");
                 connectionFailures++;
                 return;
             }
@@ -335,10 +724,10 @@ void NetworkManager::sendMonitoringData() {
         
         // Check if we've been trying too long for this attempt
         if (currentTime - lastConnectionAttempt > LampConfig::WIFI_TIMEOUT_MS) {
-            Serial.println("WiFi connection attempt timed out");
+            LOG_DEFERRED("WiFi connection attempt timed out\n");
             disableWiFi();
             connectionFailures++; // Increment failure counter for backoff
-            Serial.printf("Connection failures: %d, will retry in %d seconds\n", 
+            LOG_DEFERRED("Connection failures: %d, will retry in %lu seconds\n", 
                          connectionFailures, 
                          (CONNECTION_RETRY_INTERVAL * connectionFailures) / 1000);
             return;
@@ -352,19 +741,54 @@ void NetworkManager::sendMonitoringData() {
     connectionFailures = 0;
     
     // Send the data
-    String data = lamp->getMonitoringData();
-    if (sendDataToServer(data)) {
-        Serial.println("Monitoring data sent successfully");
-        lamp->clearDataReadyFlag();
+    LampStatus status = lamp->getStatus();
+    #if TELEMETRY_MQTT
+    bool sent = mqtt.loop() && mqtt.flush();
+    if (sent) {
+        // Commands published while we were offline arrive right after the connect
+        mqtt.waitForCommands(LampConfig::MQTT_COMMAND_WAIT_MS);
+    }
+    #else
+    String data = lamp->getMonitoringData(status);
+    bool sent = sendDataToServer(data);
+    #endif
+    if (sent) {
+        LOG_DEFERRED("Monitoring data sent successfully\n");
+        lastReportSequence = status.reportSequence;
+
+        // Reuse this radio-on window to look for a firmware update now and then
+        if (lastUpdateCheck == 0 || millis() - lastUpdateCheck >= LampConfig::OTA_CHECK_INTERVAL_MS) {
+            checkForUpdate();
+        }
         disableWiFi();  // Turn off WiFi after successful transmission
     } else {
-        Serial.println("Failed to send monitoring data");
+        LOG_DEFERRED("Failed to send monitoring data\n");
         disableWiFi();  // Turn off WiFi even after failure to prevent battery drain
         // Will try again after backoff
         connectionFailures++;
     }
 }
 
+bool NetworkManager::deferTelemetry() {
+    // A connection attempt that is under way is finished rather than abandoned
+    bool connecting = WiFi.getMode() != WIFI_OFF && WiFi.status() != WL_CONNECTED;
+    if (!shedder->sheds(ShedLevel::DEFER_TELEMETRY) || connecting) {
+        telemetryDeferredSince = 0;
+        return false;
+    }
+    unsigned long now = millis();
+    if (telemetryDeferredSince == 0) {
+        telemetryDeferredSince = now;
+        LOG_DEFERRED("Deferring telemetry while the control loop catches up\n");
+    }
+    if (now - telemetryDeferredSince >= LampConfig::SHED_MAX_TELEMETRY_DEFER_MS) {
+        // Under sustained load a report still goes out now and then
+        telemetryDeferredSince = 0;
+        return false;
+    }
+    return true;
+}
+
 bool NetworkManager::isWifiIdle() {
     return (millis() - lastActivityTime > WIFI_IDLE_TIMEOUT);
 }
@@ -376,7 +800,7 @@ void NetworkManager::handleWifiPowerSaving() {
     }
     
     // If we need to send data, turn WiFi on
-    if (lamp->isDataReadyToSend() && WiFi.getMode() == WIFI_OFF) {
+    if (lamp->getStatus().reportSequence != lastReportSequence && WiFi.getMode() == WIFI_OFF) {
         enableWiFi();
         lastActivityTime = millis();
     }
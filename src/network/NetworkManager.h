@@ -7,13 +7,27 @@
 #include <HTTPClient.h>
 #include "../config/Config.h"
 #include "../lamp/LampController.h"
+#include "../power/CpuGovernor.h"
+#include "../power/EnergyModel.h"
+#include "../diag/LoopStats.h"
+#include "../diag/LoadShedder.h"
+#if TELEMETRY_MQTT
+#include "MqttTransport.h"
+#endif
 
 class NetworkManager {
 public:
-    NetworkManager(LampController& lampCtrl);
+    NetworkManager(LampController& lampCtrl, CpuGovernor& cpuGovernor, LoopStats& stats, LoadShedder& loadShedder,
+                   EnergyModel& energyModel);
     void begin();
     void update();
+    void startTask();
+    void service();   // One pass of the network task, for callers that run it themselves
     bool isConfigured();
+    bool checkForUpdate();
+    String getStatusJson() const;
+    String getLoopJson() const;
+    static String getBlameJson(const LoopStats::Snapshot& stats);
     #if DATA_LOGGING_ENABLED
     void sendMonitoringData();
     #endif
@@ -25,6 +39,19 @@ private:
     bool inAPMode = false;
     WiFiConfig wifiConfig;
     LampController* lamp;
+    CpuGovernor* governor;
+    LoopStats* loopStats;
+    LoadShedder* shedder;
+    EnergyModel* energy;
+    unsigned long lastServeTime = 0;
+    // After a program upload with radio=off the radio stays off until that program has ended
+    enum class ProgramRadio : uint8_t { ON, TURN_OFF, OFF };
+    ProgramRadio programRadio = ProgramRadio::ON;
+    uint32_t programRadioStarts = 0;   // programsStarted once the uploaded program is running
+    bool holdRadioForProgram();        // True while the radio is held off
+    TaskHandle_t taskHandle = nullptr;
+    static void taskEntry(void* param);
+    void taskLoop();
     String deviceName;
     bool setupMDNS();
     void setupAP();
@@ -37,6 +64,8 @@ private:
     void handleControl();
     String getSetupHtml();
     String getControlHtml();
+    String getFirmwareUrl() const;
+    unsigned long lastUpdateCheck = 0;
     bool loadConfig();
     void saveConfig(const char* ssid, const char* pass);
     bool tryConnect(const char* ssid, const char* pass, int timeout = 30);
@@ -45,13 +74,21 @@ private:
     bool sendDataToServer(const String& data);
     void enableWiFi();
     void disableWiFi();
+    bool deferTelemetry();
+    unsigned long telemetryDeferredSince = 0;
     unsigned long wifiStartTime = 0;
+    uint32_t lastReportSequence = 0;
     bool isWifiIdle();
     void handleWifiPowerSaving();
     unsigned long lastActivityTime = 0;
     static const unsigned long WIFI_IDLE_TIMEOUT = 1800000;
+    #endif
+    // Backoff for the telemetry connect and the reconnect after a program
     unsigned long lastConnectionAttempt = 0;
     int connectionFailures = 0;
     static const unsigned long CONNECTION_RETRY_INTERVAL = 60000; // 1 minute between retries
+    #if TELEMETRY_MQTT
+    MqttTransport mqtt;
+    uint32_t queuedReportSequence = 0;
     #endif
 }; 
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include "CpuGovernor.h"
+#include <WiFi.h>
+#include "../util/DeferredLog.h"
+
+const int CpuGovernor::LEVELS_MHZ[CpuGovernor::LEVEL_COUNT] = {10, 20, 40, 80, 160};
+
+CpuGovernor::CpuGovernor(LampController& lampCtrl) : lamp(&lampCtrl) {}
+
+void CpuGovernor::begin() {
+    // Nothing is clocked from APB yet, so no PWM/ADC reconfiguration is needed here
+    setCpuFrequencyMhz(LampConfig::CPU_FREQ_MHZ);
+    currentMhz = getCpuFrequencyMhz();
+    lastAccountTime = millis();
+}
+
+void CpuGovernor::request(Demand demand) {
+    if (demand == Demand::REQUEST) {
+        pendingRequests.fetch_add(1, std::memory_order_relaxed);
+    }
+    pendingDemands.fetch_or(1u << (int)demand, std::memory_order_release);
+}
+
+void CpuGovernor::update() {
+    if (lamp->isFading()) {
+        request(Demand::FADE);
+    }
+
+    int target = targetFrequencyMhz();
+    if (target != currentMhz) {
+        applyFrequency(target);
+    } else {
+        accountTime();
+    }
+}
+
+int CpuGovernor::targetFrequencyMhz() {
+    unsigned long now = millis();
+    for (int i = 0; i < (int)Demand::COUNT; i++) {
+        if (demandActive[i] && now - demandTime[i] > LampConfig::CPU_BOOST_HOLD_MS) {
+            demandActive[i] = false;
+        }
+    }
+    // A burst counts the requests since the REQUEST demand last went quiet
+    if (!demandActive[(int)Demand::REQUEST]) {
+        recentRequests = 0;
+    }
+    uint32_t pending = pendingDemands.exchange(0, std::memory_order_acquire);
+    recentRequests += pendingRequests.exchange(0, std::memory_order_relaxed);
+    for (int i = 0; i < (int)Demand::COUNT; i++) {
+        if (pending & (1u << i)) {
+            demandTime[i] = now;
+            demandActive[i] = true;
+        }
+    }
+
+    int target = LampConfig::CPU_FREQ_MHZ;
+    if (demandActive[(int)Demand::FADE]) {
+        target = max(target, (int)LampConfig::CPU_FREQ_FADE_MHZ);
+    }
+    // The WiFi driver does not run below 80MHz
+    if (WiFi.getMode() != WIFI_OFF || demandActive[(int)Demand::REQUEST]) {
+        target = max(target, (int)LampConfig::CPU_FREQ_NETWORK_MHZ);
+    }
+    if (demandActive[(int)Demand::NETWORK] ||
+        recentRequests >= (uint32_t)LampConfig::CPU_BURST_REQUEST_COUNT) {
+        target = max(target, (int)LampConfig::CPU_FREQ_BURST_MHZ);
+    }
+    return target;
+}
+
+void CpuGovernor::applyFrequency(int mhz) {
+    accountTime();
+
+    // LEDC and ADC are clocked from APB, which follows the CPU clock below 80MHz.
+    // Switch, then re-derive the PWM timers and restore the current duties.
+    if (!setCpuFrequencyMhz(mhz)) {
+        LOG_DEFERRED("CPU governor: failed to switch to %d MHz\n", mhz);
+        return;
+    }
+    lamp->reconfigureClocks();
+
+    LOG_DEFERRED("CPU governor: %d -> %d MHz\n", currentMhz, mhz);
+    currentMhz = mhz;
+    switchCount++;
+}
+
+void CpuGovernor::accountTime() {
+    unsigned long now = millis();
+    int index = levelIndex(currentMhz);
+    if (index >= 0) {
+        timeAtLevelMs[index] += now - lastAccountTime;
+    }
+    lastAccountTime = now;
+}
+
+int CpuGovernor::levelIndex(int mhz) {
+    for (int i = 0; i < LEVEL_COUNT; i++) {
+        if (LEVELS_MHZ[i] == mhz) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+unsigned long CpuGovernor::getTimeAtFrequencyMs(int mhz) const {
+    int index = levelIndex(mhz);
+    return index >= 0 ? timeAtLevelMs[index] : 0;
+}
+
+void CpuGovernor::printStats() const {
+    Serial.printf("CPU governor: %d MHz now, %lu switches\n", currentMhz, switchCount);
+    for (int i = 0; i < LEVEL_COUNT; i++) {
+        Serial.printf("  %3d MHz: %lu ms\n", LEVELS_MHZ[i], timeAtLevelMs[i]);
+    }
+}
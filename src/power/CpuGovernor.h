@@ -0,0 +1,52 @@
+#pragma once
+#include "../config/Config.h"
+#include "../lamp/LampController.h"
+#include <Arduino.h>
+#include <atomic>
+
+// Raises the CPU clock while the network stack, an animation or a burst of
+// requests needs it, and drops back to the idle clock once the loop is quiet.
+class CpuGovernor {
+public:
+    enum class Demand {
+        FADE,       // Indicator animation running
+        NETWORK,    // Radio on / association in progress
+        REQUEST,    // HTTP request served
+        COUNT
+    };
+
+    CpuGovernor(LampController& lampCtrl);
+    void begin();
+    void update();
+
+    // Note a demand; it is held for CPU_BOOST_HOLD_MS after the last call.
+    // Safe from any task: it only sets a bit and counts, update() (loop
+    // task) picks them up and switches the clock.
+    void request(Demand demand);
+
+    int getFrequencyMhz() const { return currentMhz; }
+    unsigned long getTimeAtFrequencyMs(int mhz) const;
+    unsigned long getSwitchCount() const { return switchCount; }
+    void printStats() const;
+
+private:
+    static const int LEVEL_COUNT = 5;
+    static const int LEVELS_MHZ[LEVEL_COUNT];
+
+    LampController* lamp;
+    int currentMhz = LampConfig::CPU_FREQ_MHZ;
+    std::atomic<uint32_t> pendingDemands{0};     // Bit per Demand, set by request()
+    std::atomic<uint32_t> pendingRequests{0};    // REQUEST calls since the last update()
+    // Loop task only
+    unsigned long demandTime[(int)Demand::COUNT] = {};
+    bool demandActive[(int)Demand::COUNT] = {};
+    uint32_t recentRequests = 0;
+    unsigned long timeAtLevelMs[LEVEL_COUNT] = {};
+    unsigned long lastAccountTime = 0;
+    unsigned long switchCount = 0;
+
+    int targetFrequencyMhz();
+    void applyFrequency(int mhz);
+    void accountTime();
+    static int levelIndex(int mhz);
+};
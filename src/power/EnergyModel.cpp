@@ -0,0 +1,126 @@
+#include "EnergyModel.h"
+
+namespace {
+    const uint32_t NOMINAL_PACK_MV = 3700 * LampConfig::BATTERY_CELLS;
+    const float MS_PER_HOUR = 3600000.0f;
+    const float UA_MS_PER_MAH = 1000.0f * MS_PER_HOUR;
+}
+
+uint32_t EnergyModel::cpuCurrentUa(int cpuMhz, int loopSleepMs) {
+    // Time-weighted mix of running one loop pass and idling in delay()
+    uint64_t workUs = LampConfig::LOOP_WORK_CYCLES / (uint32_t)cpuMhz;
+    uint64_t sleepUs = (uint64_t)loopSleepMs * 1000;
+    uint64_t activeUa = LampConfig::CPU_ACTIVE_BASE_UA + LampConfig::CPU_ACTIVE_UA_PER_MHZ * (uint32_t)cpuMhz;
+    uint64_t idleUa = LampConfig::CPU_IDLE_BASE_UA + LampConfig::CPU_IDLE_UA_PER_MHZ * (uint32_t)cpuMhz;
+    return (uint32_t)((activeUa * workUs + idleUa * sleepUs) / (workUs + sleepUs));
+}
+
+uint32_t EnergyModel::dividerCurrentUa() {
+    // The voltage monitoring divider is across the pack permanently
+    return (uint32_t)(NOMINAL_PACK_MV * 1000.0f / (LampConfig::R_UP + LampConfig::R_DOWN) + 0.5f);
+}
+
+uint32_t EnergyModel::currentUa(int cpuMhz, int loopSleepMs, bool wifiOn, float ledDuty) {
+    return cpuCurrentUa(cpuMhz, loopSleepMs) +
+           (wifiOn ? LampConfig::WIFI_ACTIVE_UA : 0) +
+           (uint32_t)(ledDuty * LampConfig::LED_FULL_DUTY_UA) +
+           dividerCurrentUa();
+}
+
+int EnergyModel::networkMhz(int cpuMhz) {
+    // CpuGovernor holds at least the network clock while the radio is on
+    return max(cpuMhz, (int)LampConfig::CPU_FREQ_NETWORK_MHZ);
+}
+
+float EnergyModel::estimateCurrentMa(const PowerProfile& profile) {
+    float wifiFraction = profile.wifiOnSecondsPerHour / 3600.0f;
+    uint32_t radioOffUa = currentUa(profile.cpuMhz, profile.loopSleepMs, false, profile.ledDuty);
+    uint32_t radioOnUa = currentUa(networkMhz(profile.cpuMhz), profile.loopSleepMs, true, profile.ledDuty);
+    return ((1.0f - wifiFraction) * radioOffUa + wifiFraction * radioOnUa) / 1000.0f;
+}
+
+float EnergyModel::estimateLifetimeHours(const PowerProfile& profile) {
+    return LampConfig::PACK_CAPACITY_MAH / estimateCurrentMa(profile);
+}
+
+PowerProfile EnergyModel::profileFor(const char* name, bool remoteControl, bool dataLogging,
+                                     int cpuMhz, int loopSleepMs, float ledDuty) {
+    float wifiOnSeconds = 0.0f;
+    if (remoteControl) {
+        // Web server keeps the radio up permanently
+        wifiOnSeconds = 3600.0f;
+    } else if (dataLogging) {
+        // Radio comes up once per report for connect + POST, or once per batch over MQTT
+        float reportsPerHour = MS_PER_HOUR / LampConfig::REPORTING_INTERVAL_MS;
+        #if TELEMETRY_MQTT
+        reportsPerHour /= LampConfig::MQTT_BATCH_SIZE;
+        #endif
+        wifiOnSeconds = min(3600.0f, reportsPerHour * LampConfig::TELEMETRY_WIFI_ON_MS / 1000.0f);
+    }
+    return PowerProfile{name, cpuMhz, loopSleepMs, wifiOnSeconds, ledDuty};
+}
+
+PowerProfile EnergyModel::buildProfile(float ledDuty) {
+    // Idle lamp sits in slow mode (100ms loop), see LampController::updateTimings()
+    return profileFor("this build", LampConfig::REMOTE_ENABLED, LampConfig::LOGGING_ENABLED,
+                      LampConfig::CPU_FREQ_MHZ, 100, ledDuty);
+}
+
+void EnergyModel::printReport() {
+    const int cpuMhz = LampConfig::CPU_FREQ_MHZ;
+    // The device envs in platformio.ini, with their REMOTE_CONTROL_ENABLED
+    // and DATA_LOGGING_ENABLED flags
+    const PowerProfile profiles[] = {
+        buildProfile(0.0f),
+        profileFor("local_control_pcb_v1", false, false, cpuMhz, 100, 0.0f),
+        profileFor("local_control_pcb_v2", false, false, cpuMhz, 100, 0.0f),
+        profileFor("smart_lamp", true, false, cpuMhz, 100, 0.0f),
+        profileFor("data_logging", false, false, cpuMhz, 100, 0.0f),   // Built with DATA_LOGGING_ENABLED=false
+    };
+    const float duties[] = {0.0f, 0.25f, 1.0f};
+
+    Serial.printf("Energy model (%lu mAh pack):\n", (unsigned long)LampConfig::PACK_CAPACITY_MAH);
+    for (const PowerProfile& base : profiles) {
+        for (float duty : duties) {
+            PowerProfile profile = base;
+            profile.ledDuty = duty;
+            Serial.printf("  %-20s %3d/%3d MHz, WiFi %4.0f s/h, LED %3.0f%%: %7.1f mAh/h, %7.1f h\n",
+                          profile.name,
+                          profile.cpuMhz,
+                          networkMhz(profile.cpuMhz),
+                          profile.wifiOnSecondsPerHour,
+                          duty * 100.0f,
+                          estimateCurrentMa(profile),
+                          estimateLifetimeHours(profile));
+        }
+    }
+}
+
+void EnergyModel::sample(unsigned long now, int cpuMhz, int loopSleepMs, bool wifiOn, float ledDuty) {
+    unsigned long elapsedMs = now - lastSampleTime;
+    lastSampleTime = now;
+
+    totals.currentUa = currentUa(cpuMhz, loopSleepMs, wifiOn, ledDuty);
+    totals.consumedUaMs += (uint64_t)totals.currentUa * elapsedMs;
+    totals.accountedMs += elapsedMs;
+    snapshot.publish(totals);
+}
+
+float EnergyModel::consumedMah(const Snapshot& stats) {
+    return stats.consumedUaMs / UA_MS_PER_MAH;
+}
+
+float EnergyModel::averageCurrentMa(const Snapshot& stats) {
+    if (stats.accountedMs == 0) {
+        return 0.0f;
+    }
+    return (float)(stats.consumedUaMs / stats.accountedMs) / 1000.0f;
+}
+
+float EnergyModel::remainingHours(const Snapshot& stats) {
+    float averageMa = averageCurrentMa(stats);
+    if (averageMa <= 0.0f) {
+        return 0.0f;
+    }
+    return max(0.0f, LampConfig::PACK_CAPACITY_MAH - consumedMah(stats)) / averageMa;
+}
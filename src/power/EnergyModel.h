@@ -0,0 +1,58 @@
+#pragma once
+#include "../config/Config.h"
+#include "../util/DoubleBuffer.h"
+#include <Arduino.h>
+
+// Duty pattern of the firmware, everything the current draw depends on.
+struct PowerProfile {
+    const char* name;
+    int cpuMhz;                  // Idle CPU clock (configurePowerSaving()); radio-on time runs at networkMhz()
+    int loopSleepMs;             // delay() at the end of each loop() pass (sleepTime)
+    float wifiOnSecondsPerHour;  // Radio-on time from remote control / telemetry
+    float ledDuty;               // Main lamp PWM duty, 0..1
+};
+
+// Estimates pack current from the loop's duty pattern, and tracks the
+// charge actually used at runtime with the same model.
+//
+// The runtime counter is an integer charge in uA*ms, sampled from the loop
+// task every ENERGY_SAMPLE_MS. It keeps full resolution for any uptime,
+// where a float mAh total stops taking small steps after a few weeks.
+// Other tasks read it through read() (/api/status).
+// test/test_energy_model prints the estimates and checks them against a budget.
+class EnergyModel {
+public:
+    struct Snapshot {
+        uint64_t consumedUaMs;
+        uint64_t accountedMs;
+        uint32_t currentUa;     // Estimate at the last sample
+    };
+
+    // Static estimates
+    static uint32_t currentUa(int cpuMhz, int loopSleepMs, bool wifiOn, float ledDuty);
+    static float estimateCurrentMa(const PowerProfile& profile);
+    static float estimateLifetimeHours(const PowerProfile& profile);
+    static PowerProfile profileFor(const char* name, bool remoteControl, bool dataLogging,
+                                   int cpuMhz, int loopSleepMs, float ledDuty);
+    static PowerProfile buildProfile(float ledDuty);  // Profile of this firmware build
+    static int networkMhz(int cpuMhz);
+    static void printReport();
+
+    // Runtime accounting. Check due() every loop() pass and only then
+    // gather the inputs for sample().
+    bool due(unsigned long now) const { return now - lastSampleTime >= LampConfig::ENERGY_SAMPLE_MS; }
+    void sample(unsigned long now, int cpuMhz, int loopSleepMs, bool wifiOn, float ledDuty);
+    Snapshot read() const { return snapshot.read(); }
+
+    static float consumedMah(const Snapshot& stats);
+    static float averageCurrentMa(const Snapshot& stats);
+    static float remainingHours(const Snapshot& stats);
+
+private:
+    Snapshot totals = {};
+    DoubleBuffer<Snapshot> snapshot;
+    unsigned long lastSampleTime = 0;
+
+    static uint32_t cpuCurrentUa(int cpuMhz, int loopSleepMs);
+    static uint32_t dividerCurrentUa();
+};
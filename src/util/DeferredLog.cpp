@@ -0,0 +1,203 @@
+#include "DeferredLog.h"
+#include <cstddef>
+#if DEFERRED_LOG_UDP
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#endif
+
+const char* DeferredLog::formats[LampConfig::LOG_MAX_FORMATS];
+uint16_t DeferredLog::formatCount = 0;
+DeferredLog::Record DeferredLog::records[LampConfig::LOG_BUFFER_SIZE];
+uint16_t DeferredLog::head = 0;
+uint16_t DeferredLog::count = 0;
+uint32_t DeferredLog::dropped = 0;
+
+namespace {
+    portMUX_TYPE logMux = portMUX_INITIALIZER_UNLOCKED;
+
+    #if DEFERRED_LOG_UDP
+    // Frame types, see log_decoder.py
+    const uint8_t FRAME_FORMAT = 0xD0;  // id:u16, length:u8, format bytes
+    const uint8_t FRAME_RECORD = 0xA0;  // timestamp:u32, id:u16, wordCount:u8, args:u32[], textLength:u8, text
+
+    WiFiUDP logUdp;
+    uint8_t formatSent[(LampConfig::LOG_MAX_FORMATS + 7) / 8];
+    #endif
+}
+
+uint16_t DeferredLog::registerFormat(const char* format) {
+    // Called once per call site (function-local static initializer)
+    portENTER_CRITICAL(&logMux);
+    uint16_t id = formatCount;
+    if (formatCount < LampConfig::LOG_MAX_FORMATS) {
+        formats[formatCount++] = format;
+    }
+    portEXIT_CRITICAL(&logMux);
+    return id;
+}
+
+void DeferredLog::putText(Record& record, const char* value) {
+    // A full text area leaves its last byte as a terminator: later strings come out empty
+    uint8_t offset = min((int)record.textLength, LampConfig::LOG_STRING_BYTES - 1);
+    const char* source = value ? value : "(null)";
+    size_t length = strnlen(source, LampConfig::LOG_STRING_BYTES - 1 - offset);
+    memcpy(record.text + offset, source, length);
+    record.text[offset + length] = '\0';
+    record.textLength = offset + length + 1;
+    put(record, offset);
+}
+
+void DeferredLog::write(uint16_t formatId, Record& record) {
+    record.timestamp = millis();
+    record.formatId = formatId;
+
+    portENTER_CRITICAL(&logMux);
+    if (count >= LampConfig::LOG_BUFFER_SIZE || formatId >= formatCount) {
+        dropped++;
+        portEXIT_CRITICAL(&logMux);
+        return;
+    }
+    Record& slot = records[(head + count) % LampConfig::LOG_BUFFER_SIZE];
+    // Only the used part of the argument and text areas
+    memcpy(&slot, &record, offsetof(Record, args) + record.wordCount * sizeof(uint32_t));
+    memcpy(slot.text, record.text, record.textLength);
+    count++;
+    portEXIT_CRITICAL(&logMux);
+}
+
+void DeferredLog::drain(int maxRecords) {
+    for (int i = 0; i < maxRecords; i++) {
+        Record record;
+        portENTER_CRITICAL(&logMux);
+        if (count == 0) {
+            portEXIT_CRITICAL(&logMux);
+            return;
+        }
+        record = records[head];
+        head = (head + 1) % LampConfig::LOG_BUFFER_SIZE;
+        count--;
+        portEXIT_CRITICAL(&logMux);
+
+        #if DEFERRED_LOG_UDP
+        if (WiFi.status() == WL_CONNECTED) {
+            sendRecord(record);
+            continue;
+        }
+        #endif
+        printRecord(record);
+    }
+}
+
+void DeferredLog::printRecord(const Record& record) {
+    // Walk the format one conversion at a time, feeding each its stored argument
+    const char* cursor = formats[record.formatId];
+    char spec[16];
+    char text[48];
+    int argIndex = 0;
+
+    while (*cursor) {
+        const char* percent = strchr(cursor, '%');
+        if (!percent) {
+            Serial.print(cursor);
+            break;
+        }
+        if (percent > cursor) {
+            Serial.write((const uint8_t*)cursor, percent - cursor);
+        }
+        if (percent[1] == '%') {
+            Serial.print("%");
+            cursor = percent + 2;
+            continue;
+        }
+
+        // Copy the specification up to and including its conversion character
+        const char* end = percent + 1;
+        while (*end && !strchr("diuxXcsfeEgGp", *end)) {
+            end++;
+        }
+        if (!*end || end - percent + 3 > (int)sizeof(spec)) {
+            Serial.print(percent);
+            break;
+        }
+        // Integers take one word, two for long long and 64-bit longs
+        int longs = 0;
+        int specLength = 0;
+        for (const char* p = percent; p < end; p++) {
+            if (*p == 'l') {
+                longs++;
+            } else if (*p != 'h') {
+                spec[specLength++] = *p;
+            }
+        }
+        bool wide = longs >= 2 || (longs == 1 && sizeof(long) > 4);
+        if (wide) {
+            spec[specLength++] = 'l';
+            spec[specLength++] = 'l';
+        }
+        spec[specLength++] = *end;
+        spec[specLength] = '\0';
+        cursor = end + 1;
+
+        uint32_t word = argIndex < record.wordCount ? record.args[argIndex] : 0;
+        argIndex++;
+
+        switch (*end) {
+            case 'f': case 'e': case 'E': case 'g': case 'G': {
+                float value;
+                memcpy(&value, &word, sizeof(value));
+                snprintf(text, sizeof(text), spec, (double)value);
+                break;
+            }
+            case 's':
+                snprintf(text, sizeof(text), spec, word < record.textLength ? record.text + word : "");
+                break;
+            case 'p':
+                snprintf(text, sizeof(text), spec, (void*)(uintptr_t)word);
+                break;
+            default:
+                if (wide) {
+                    uint32_t high = argIndex < record.wordCount ? record.args[argIndex] : 0;
+                    argIndex++;
+                    snprintf(text, sizeof(text), spec, ((unsigned long long)high << 32) | word);
+                } else {
+                    snprintf(text, sizeof(text), spec, word);
+                }
+                break;
+        }
+        Serial.print(text);
+    }
+}
+
+#if DEFERRED_LOG_UDP
+void DeferredLog::sendRecord(const Record& record) {
+    uint16_t id = record.formatId;
+
+    // Send each format string once so the host decoder can rebuild the text
+    if (!(formatSent[id / 8] & (1 << (id % 8)))) {
+        const char* format = formats[id];
+        uint8_t length = (uint8_t)min(strlen(format), (size_t)255);
+        uint8_t header[4] = {FRAME_FORMAT, (uint8_t)id, (uint8_t)(id >> 8), length};
+        logUdp.beginPacket(LampConfig::DEFAULT_LOGGING_SERVER_IP, LampConfig::LOG_UDP_PORT);
+        logUdp.write(header, sizeof(header));
+        logUdp.write((const uint8_t*)format, length);
+        if (logUdp.endPacket()) {
+            formatSent[id / 8] |= 1 << (id % 8);
+        }
+    }
+
+    uint8_t frame[9 + MAX_WORDS * 4 + LampConfig::LOG_STRING_BYTES];
+    size_t wordBytes = record.wordCount * 4;
+    frame[0] = FRAME_RECORD;
+    memcpy(&frame[1], &record.timestamp, 4);   // Little endian on ESP32
+    memcpy(&frame[5], &record.formatId, 2);
+    frame[7] = record.wordCount;
+    memcpy(&frame[8], record.args, wordBytes);
+    frame[8 + wordBytes] = record.textLength;
+    memcpy(&frame[9 + wordBytes], record.text, record.textLength);
+    logUdp.beginPacket(LampConfig::DEFAULT_LOGGING_SERVER_IP, LampConfig::LOG_UDP_PORT);
+    logUdp.write(frame, 9 + wordBytes + record.textLength);
+    logUdp.endPacket();
+}
+#else
+void DeferredLog::sendRecord(const Record&) {}
+#endif
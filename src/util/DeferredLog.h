@@ -0,0 +1,111 @@
+#pragma once
+#include "../config/Config.h"
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <Arduino.h>
+
+// Tokenized logging. A log call stores the format-string ID and the raw
+// arguments in a RAM ring buffer; formatting happens in drain(), which
+// loop() calls when it is about to sleep.
+//
+// Arguments are stored as 32-bit words: integers (long long and 64-bit
+// longs take two), floats/doubles (stored as float), and strings, which
+// are copied into the record's LOG_STRING_BYTES text area (truncated when
+// it is full). Up to MAX_ARGS arguments per call.
+class DeferredLog {
+public:
+    static const int MAX_ARGS = 6;
+    static const int MAX_WORDS = 8;
+
+    static uint16_t registerFormat(const char* format);
+    static void drain(int maxRecords = LampConfig::LOG_DRAIN_PER_LOOP);
+    static uint32_t getDroppedCount() { return dropped; }
+
+    template <typename... Args>
+    static void log(uint16_t formatId, Args... args) {
+        static_assert(sizeof...(Args) <= MAX_ARGS, "Too many DeferredLog arguments");
+        static_assert(WordCount<Args...>::value <= MAX_WORDS, "DeferredLog arguments too wide");
+        Record record;
+        record.wordCount = 0;
+        record.textLength = 0;
+        pack(record, args...);
+        write(formatId, record);
+    }
+
+private:
+    struct Record {
+        uint32_t timestamp;
+        uint16_t formatId;
+        uint8_t wordCount;
+        uint8_t textLength;
+        uint32_t args[MAX_WORDS];
+        char text[LampConfig::LOG_STRING_BYTES];  // NUL-terminated %s arguments; the arg word is the offset
+    };
+
+    template <typename... Args> struct WordCount;
+
+    static const char* formats[LampConfig::LOG_MAX_FORMATS];
+    static uint16_t formatCount;
+    static Record records[LampConfig::LOG_BUFFER_SIZE];
+    static uint16_t head;
+    static uint16_t count;
+    static uint32_t dropped;
+
+    static void write(uint16_t formatId, Record& record);
+    static void printRecord(const Record& record);
+    static void sendRecord(const Record& record);
+
+    static void put(Record& record, uint32_t word) { record.args[record.wordCount++] = word; }
+    static void put64(Record& record, uint64_t value) {
+        put(record, (uint32_t)value);
+        put(record, (uint32_t)(value >> 32));
+    }
+    static void putText(Record& record, const char* value);
+
+    static void add(Record& record, int value) { put(record, (uint32_t)value); }
+    static void add(Record& record, unsigned int value) { put(record, value); }
+    static void add(Record& record, long value) {
+        if (sizeof(long) > 4) put64(record, (uint64_t)value); else put(record, (uint32_t)value);
+    }
+    static void add(Record& record, unsigned long value) {
+        if (sizeof(long) > 4) put64(record, value); else put(record, (uint32_t)value);
+    }
+    static void add(Record& record, long long value) { put64(record, (uint64_t)value); }
+    static void add(Record& record, unsigned long long value) { put64(record, value); }
+    static void add(Record& record, const char* value) { putText(record, value); }
+    static void add(Record& record, double value) {
+        float narrowed = (float)value;
+        uint32_t word;
+        memcpy(&word, &narrowed, sizeof(word));
+        put(record, word);
+    }
+
+    static void pack(Record&) {}
+    template <typename First, typename... Rest>
+    static void pack(Record& record, First first, Rest... rest) {
+        add(record, first);
+        pack(record, rest...);
+    }
+};
+
+template <>
+struct DeferredLog::WordCount<> {
+    static const int value = 0;
+};
+
+template <typename First, typename... Rest>
+struct DeferredLog::WordCount<First, Rest...> {
+    static const int value = (std::is_integral<First>::value && sizeof(First) > 4 ? 2 : 1) +
+                             WordCount<Rest...>::value;
+};
+
+#if SERIAL_DEBUG
+#define LOG_DEFERRED(format, ...) \
+    do { \
+        static const uint16_t _logFormatId = DeferredLog::registerFormat(format); \
+        DeferredLog::log(_logFormatId, ##__VA_ARGS__); \
+    } while (0)
+#else
+#define LOG_DEFERRED(format, ...) do {} while (0)
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Single-writer snapshot. The writer fills the inactive buffer and flips the
+// version; readers copy the active buffer and retry if a flip raced the copy.
+template <typename T>
+class DoubleBuffer {
+public:
+    void publish(const T& value) {
+        uint32_t next = version.load(std::memory_order_relaxed) + 1;
+        // The previous flip must be visible before this buffer is overwritten,
+        // so a reader still copying it sees the version move and retries
+        std::atomic_thread_fence(std::memory_order_release);
+        buffers[next & 1] = value;
+        version.store(next, std::memory_order_release);
+    }
+
+    T read() const {
+        T copy;
+        uint32_t before;
+        do {
+            before = version.load(std::memory_order_acquire);
+            copy = buffers[before & 1];
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while (version.load(std::memory_order_relaxed) != before);
+        return copy;
+    }
+
+private:
+    T buffers[2] = {};
+    std::atomic<uint32_t> version{0};
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <driver/ledc.h>
+
+// Writes several LEDC duties so they take effect in the same PWM period.
+// ledcWrite() latches each channel as it goes, which lets a colour or CCT
+// change show up one channel at a time; here all duty registers are set
+// first and then latched together. Channel numbers are the Arduino ones
+// (group = channel / 8, timer = (channel / 2) % 4).
+namespace LedcBatch {
+
+inline ledc_mode_t mode(uint8_t channel) { return (ledc_mode_t)(channel / 8); }
+inline ledc_channel_t index(uint8_t channel) { return (ledc_channel_t)(channel % 8); }
+inline ledc_timer_t timer(uint8_t channel) { return (ledc_timer_t)((channel / 2) % 4); }
+
+// hpoint is where in the period each channel turns on (see PwmPlanner.h)
+inline void write(const uint8_t* channels, const uint32_t* duties, const uint32_t* hpoints, int count) {
+    for (int i = 0; i < count; i++) {
+        ledc_set_duty_with_hpoint(mode(channels[i]), index(channels[i]), duties[i], hpoints[i]);
+    }
+    for (int i = 0; i < count; i++) {
+        ledc_update_duty(mode(channels[i]), index(channels[i]));
+    }
+}
+
+// hpoints are relative to each channel's own timer. Channels on different
+// timers only keep their planned phase if the timers count in step, so
+// restart all of them back to back after any (re)configuration.
+inline void alignTimers(const uint8_t* channels, int count) {
+    for (int i = 0; i < count; i++) {
+        ledc_timer_rst(mode(channels[i]), timer(channels[i]));
+    }
+}
+
+}  // namespace LedcBatch
@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+// Lock-free single-producer / single-consumer ring buffer.
+// One task may push() and one other task may pop(); neither ever blocks.
+template <typename T, size_t N>
+class SpscQueue {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+public:
+    bool push(const T& item) {
+        size_t currentHead = head.load(std::memory_order_relaxed);
+        size_t nextHead = (currentHead + 1) & (N - 1);
+        if (nextHead == tail.load(std::memory_order_acquire)) {
+            return false;  // Full
+        }
+        items[currentHead] = item;
+        head.store(nextHead, std::memory_order_release);
+        return true;
+    }
+
+    // All of items or none: the consumer sees them together once there is room for all
+    bool push(const T* items, size_t count) {
+        size_t currentHead = head.load(std::memory_order_relaxed);
+        size_t used = (currentHead - tail.load(std::memory_order_acquire)) & (N - 1);
+        if (used + count > N - 1) {
+            return false;  // Not enough room
+        }
+        for (size_t i = 0; i < count; i++) {
+            this->items[(currentHead + i) & (N - 1)] = items[i];
+        }
+        head.store((currentHead + count) & (N - 1), std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item) {
+        size_t currentTail = tail.load(std::memory_order_relaxed);
+        if (currentTail == head.load(std::memory_order_acquire)) {
+            return false;  // Empty
+        }
+        item = items[currentTail];
+        tail.store((currentTail + 1) & (N - 1), std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire);
+    }
+
+private:
+    T items[N];
+    std::atomic<size_t> head{0};  // Written by the producer only
+    std::atomic<size_t> tail{0};  // Written by the consumer only
+};
@@ -0,0 +1,185 @@
+// AdcCalibration's table and two-point correction against the host's fake
+// eFuse characterisation, and its EEPROM storage (pio test -e native)
+#include <unity.h>
+#include "HostDevice.h"
+#include "lamp/AdcCalibration.h"
+#include <esp_adc_cal.h>
+
+typedef AdcCalibration::PointResult PointResult;
+
+const int TOLERANCE_MV = 5;     // Interpolation and rounding in the table
+const size_t STORED_SIZE = 24;  // Two points, then the pending point
+
+HostDevice* device;
+
+void setUp() {
+    device = new HostDevice();
+    device->serialMuted = true;
+    HostDevice::select(device);
+}
+
+void tearDown() {
+    HostDevice::select(nullptr);
+    delete device;
+}
+
+// The characterised curve for a raw reading, divider included
+int characterisedMv(int raw) {
+    esp_adc_cal_characteristics_t characteristics;
+    esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, LampConfig::ADC_DEFAULT_VREF_MV,
+                             &characteristics);
+    uint32_t raw12 = (uint32_t)raw << (12 - LampConfig::ADC_RESOLUTION);
+    if (raw12 > 4095) {
+        raw12 = 4095;
+    }
+    return (int)(esp_adc_cal_raw_to_voltage(raw12, &characteristics) * LampConfig::VOLTAGE_DIVIDER_RATIO + 0.5f);
+}
+
+void test_table_follows_characterisation() {
+    AdcCalibration calibration;
+    calibration.begin();
+    TEST_ASSERT_FALSE(calibration.isCorrected());
+    TEST_ASSERT_EQUAL_STRING("efuse-tp", calibration.describe());
+    for (int raw = 0; raw <= LampConfig::MAX_ANALOG; raw++) {
+        TEST_ASSERT_INT_WITHIN(TOLERANCE_MV, characterisedMv(raw), calibration.toMillivolts(raw));
+    }
+    TEST_ASSERT_EQUAL(calibration.toMillivolts(0), calibration.toMillivolts(-5));
+    TEST_ASSERT_EQUAL(calibration.toMillivolts(LampConfig::MAX_ANALOG),
+                      calibration.toMillivolts(LampConfig::MAX_ANALOG + 100));
+}
+
+// A meter that reads 3% high with a 200 mV offset
+uint16_t meterMv(int raw) {
+    return (uint16_t)(characterisedMv(raw) * 1.03f + 200);
+}
+
+void checkCorrected(const AdcCalibration& calibration, int lowRaw, int highRaw) {
+    TEST_ASSERT_TRUE(calibration.isCorrected());
+    TEST_ASSERT_EQUAL_STRING("efuse-tp+2pt", calibration.describe());
+    TEST_ASSERT_INT_WITHIN(TOLERANCE_MV, meterMv(lowRaw), calibration.toMillivolts(lowRaw));
+    TEST_ASSERT_INT_WITHIN(TOLERANCE_MV, meterMv(highRaw), calibration.toMillivolts(highRaw));
+    // Between and beyond the points too
+    int middle = (lowRaw + highRaw) / 2;
+    TEST_ASSERT_INT_WITHIN(TOLERANCE_MV, meterMv(middle), calibration.toMillivolts(middle));
+    TEST_ASSERT_INT_WITHIN(TOLERANCE_MV * 2, meterMv(LampConfig::MAX_ANALOG),
+                           calibration.toMillivolts(LampConfig::MAX_ANALOG));
+}
+
+void test_two_points_either_order() {
+    const int lowRaw = 700;
+    const int highRaw = 930;
+    {
+        AdcCalibration calibration;
+        calibration.begin();
+        TEST_ASSERT_EQUAL(PointResult::PENDING, calibration.addPoint(lowRaw, meterMv(lowRaw)));
+        TEST_ASSERT_FALSE(calibration.isCorrected());
+        TEST_ASSERT_EQUAL(PointResult::COMPLETED, calibration.addPoint(highRaw, meterMv(highRaw)));
+        checkCorrected(calibration, lowRaw, highRaw);
+    }
+    {
+        AdcCalibration calibration;
+        calibration.begin();
+        calibration.clear();
+        TEST_ASSERT_EQUAL(PointResult::PENDING, calibration.addPoint(highRaw, meterMv(highRaw)));
+        TEST_ASSERT_EQUAL(PointResult::COMPLETED, calibration.addPoint(lowRaw, meterMv(lowRaw)));
+        checkCorrected(calibration, lowRaw, highRaw);
+    }
+}
+
+void test_rejected_points() {
+    AdcCalibration calibration;
+    calibration.begin();
+    TEST_ASSERT_EQUAL(PointResult::PENDING, calibration.addPoint(900, 12000));
+    // Less than ADC_CAL_MIN_SPAN_MV away
+    TEST_ASSERT_EQUAL(PointResult::REJECTED, calibration.addPoint(850, 12000 - LampConfig::ADC_CAL_MIN_SPAN_MV + 1));
+    // Lower on the meter but higher on the ADC, and the same reading for another voltage
+    TEST_ASSERT_EQUAL(PointResult::REJECTED, calibration.addPoint(950, 10000));
+    TEST_ASSERT_EQUAL(PointResult::REJECTED, calibration.addPoint(900, 10000));
+    TEST_ASSERT_FALSE(calibration.isCorrected());
+
+    // The first point is still waiting
+    TEST_ASSERT_EQUAL(PointResult::COMPLETED, calibration.addPoint(700, 9500));
+    TEST_ASSERT_INT_WITHIN(TOLERANCE_MV, 12000, calibration.toMillivolts(900));
+    TEST_ASSERT_INT_WITHIN(TOLERANCE_MV, 9500, calibration.toMillivolts(700));
+}
+
+void test_clear() {
+    AdcCalibration calibration;
+    calibration.begin();
+    calibration.addPoint(700, meterMv(700));
+    calibration.addPoint(930, meterMv(930));
+    TEST_ASSERT_TRUE(calibration.isCorrected());
+
+    calibration.addPoint(800, 11000);
+    calibration.clear();
+    TEST_ASSERT_FALSE(calibration.isCorrected());
+    TEST_ASSERT_EQUAL_STRING("efuse-tp", calibration.describe());
+    TEST_ASSERT_INT_WITHIN(TOLERANCE_MV, characterisedMv(930), calibration.toMillivolts(930));
+    // The pending point went too: this one starts a new calibration
+    TEST_ASSERT_EQUAL(PointResult::PENDING, calibration.addPoint(700, 9500));
+
+    AdcCalibration rebooted;
+    rebooted.begin();
+    TEST_ASSERT_FALSE(rebooted.isCorrected());
+}
+
+void test_eeprom_round_trip() {
+    {
+        AdcCalibration calibration;
+        calibration.begin();
+        calibration.addPoint(700, meterMv(700));
+        calibration.addPoint(930, meterMv(930));
+    }
+    AdcCalibration rebooted;
+    rebooted.begin();
+    checkCorrected(rebooted, 700, 930);
+
+    // The first point of the next calibration survives a reboot too
+    rebooted.addPoint(930, 12500);
+    AdcCalibration again;
+    again.begin();
+    TEST_ASSERT_EQUAL(PointResult::COMPLETED, again.addPoint(700, 9900));
+    TEST_ASSERT_INT_WITHIN(TOLERANCE_MV, 12500, again.toMillivolts(930));
+
+    // Nothing outside the calibration's bytes was written
+    for (size_t i = 0; i < sizeof(device->eeprom); i++) {
+        if (i < (size_t)LampConfig::ADC_CAL_EEPROM_ADDR || i >= LampConfig::ADC_CAL_EEPROM_ADDR + STORED_SIZE) {
+            TEST_ASSERT_EQUAL(0xFF, device->eeprom[i]);
+        }
+    }
+}
+
+void test_bad_magic_ignored() {
+    {
+        AdcCalibration calibration;
+        calibration.begin();
+        calibration.addPoint(700, meterMv(700));
+        calibration.addPoint(930, meterMv(930));
+        calibration.addPoint(800, 11000);
+    }
+    device->eeprom[LampConfig::ADC_CAL_EEPROM_ADDR] ^= 0x01;
+    device->eeprom[LampConfig::ADC_CAL_EEPROM_ADDR + 16] ^= 0x01;
+    AdcCalibration rebooted;
+    rebooted.begin();
+    TEST_ASSERT_FALSE(rebooted.isCorrected());
+    TEST_ASSERT_INT_WITHIN(TOLERANCE_MV, characterisedMv(930), rebooted.toMillivolts(930));
+    TEST_ASSERT_EQUAL(PointResult::PENDING, rebooted.addPoint(700, 9500));
+
+    // Erased EEPROM
+    memset(device->eeprom, 0xFF, sizeof(device->eeprom));
+    AdcCalibration fresh;
+    fresh.begin();
+    TEST_ASSERT_FALSE(fresh.isCorrected());
+    TEST_ASSERT_EQUAL(PointResult::PENDING, fresh.addPoint(700, 9500));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_table_follows_characterisation);
+    RUN_TEST(test_two_points_either_order);
+    RUN_TEST(test_rejected_points);
+    RUN_TEST(test_clear);
+    RUN_TEST(test_eeprom_round_trip);
+    RUN_TEST(test_bad_magic_ignored);
+    return UNITY_END();
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+
+// Checked-in baseline for test_benchmarks. Time is calibration steps per
+// operation (best of several rounds; one step is an iteration of the xorshift
+// loop in Benchmarks::calibrate(), timed in the same run), allocations and
+// bytes held are counted by MemStats for one operation.
+//
+// To refresh after an intended change, run pio test -e native_bench and
+// paste the table printed under "Baseline for BenchmarkBaseline.h" here.
+struct BenchmarkBaseline {
+    const char* name;
+    uint32_t steps;
+    uint32_t allocations;
+    int32_t heapBytes;
+};
+
+// Median of six runs on a single-core x86-64 container, g++ -O2
+static const BenchmarkBaseline BENCHMARK_BASELINE[] = {
+    {"outputRender", 8, 0, 0},
+    {"potentiometerEma", 21, 0, 0},
+    {"voltageEma", 4, 0, 0},
+    {"monitoringJson", 237, 1, 48},
+    {"statusJson", 3715, 89, 320},
+    {"lampUpdateTick", 240, 0, 0},
+};
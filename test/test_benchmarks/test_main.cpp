@@ -0,0 +1,192 @@
+// Micro-benchmarks for the lamp's hot paths, compared against
+// BenchmarkBaseline.h. Runs in the native_bench env (pio test -e native_bench),
+// which builds with -O2, data logging on and counts allocations through MemStats.
+#include <unity.h>
+#include "HostDevice.h"
+#include "BenchmarkBaseline.h"
+#include "lamp/LampController.h"
+#include "network/NetworkManager.h"
+#include "diag/MemStats.h"
+#include <chrono>
+
+// Time is compared in calibration steps rather than nanoseconds, so a
+// slower or busier machine moves the reference along with the results; it
+// still only fails well past the baseline (plus TIME_SLACK_STEPS for the
+// few-step paths). Allocations and bytes are exact and must not grow.
+const float TIME_TOLERANCE = 2.0f;
+const uint32_t TIME_SLACK_STEPS = 20;
+const int CALIBRATION_STEPS = 100000;
+
+class Benchmarks {
+public:
+    Benchmarks(LampController& lampCtrl, NetworkManager& networkMgr) : lamp(&lampCtrl), network(&networkMgr) {}
+    bool run();
+
+private:
+    struct Result {
+        const char* name;
+        uint32_t ns;
+        uint32_t steps;
+        uint32_t allocations;
+        int32_t heapBytes;
+    };
+
+    static const int ROUNDS = 9;
+    static const int MAX_RESULTS = 8;
+
+    LampController* lamp;
+    NetworkManager* network;
+    String sink;  // Holds String results so their heap use can be measured
+    Result results[MAX_RESULTS];
+    int resultCount = 0;
+    float stepNs = 1.0f;   // Of the last calibrate()
+
+    void calibrate();
+    template <typename Body>
+    void measure(const char* name, int iterations, Body body);
+    bool check(const Result& result) const;
+};
+
+// One step is an iteration of a dependent xorshift, a few cycles on any
+// core; best of ROUNDS like the benchmarks
+void Benchmarks::calibrate() {
+    using namespace std::chrono;
+    uint32_t bestNs = UINT32_MAX;
+    volatile uint32_t result = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        uint32_t x = 2463534242u + round;
+        auto start = steady_clock::now();
+        for (int i = 0; i < CALIBRATION_STEPS; i++) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            __asm__ __volatile__("" : "+r"(x));
+        }
+        bestNs = min(bestNs, (uint32_t)duration_cast<nanoseconds>(steady_clock::now() - start).count());
+        result = x;
+    }
+    (void)result;
+    stepNs = (float)bestNs / CALIBRATION_STEPS;
+}
+
+template <typename Body>
+void Benchmarks::measure(const char* name, int iterations, Body body) {
+    using namespace std::chrono;
+    calibrate();   // Right before, so clock changes between benchmarks cancel out
+    uint32_t bestNs = UINT32_MAX;
+    for (int round = 0; round < ROUNDS; round++) {
+        auto start = steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            body(i);
+        }
+        uint32_t ns = (uint32_t)(duration_cast<nanoseconds>(steady_clock::now() - start).count() / iterations);
+        bestNs = min(bestNs, ns);
+        sink = String();
+    }
+
+    // Allocations made by a single operation, and the bytes its result holds
+    MemStats::TagCounters before = MemStats::read(MemTag::LAMP);
+    body(0);
+    MemStats::TagCounters after = MemStats::read(MemTag::LAMP);
+    sink = String();
+
+    if (resultCount < MAX_RESULTS) {
+        results[resultCount++] = {name, bestNs, (uint32_t)(bestNs / stepNs + 0.5f),
+                                  after.allocations - before.allocations, after.netBytes - before.netBytes};
+    }
+}
+
+bool Benchmarks::check(const Result& result) const {
+    for (const BenchmarkBaseline& baseline : BENCHMARK_BASELINE) {
+        if (strcmp(baseline.name, result.name) != 0) {
+            continue;
+        }
+        bool timeOk = result.steps <= baseline.steps * TIME_TOLERANCE + TIME_SLACK_STEPS;
+        bool heapOk = result.allocations <= baseline.allocations && result.heapBytes <= baseline.heapBytes;
+        printf("  %-18s %7lu ns %7lu steps (baseline %7lu)  %2lu allocs %5ld bytes (baseline %2lu, %5ld)  %s\n",
+               result.name, (unsigned long)result.ns,
+               (unsigned long)result.steps, (unsigned long)baseline.steps,
+               (unsigned long)result.allocations, (long)result.heapBytes,
+               (unsigned long)baseline.allocations, (long)baseline.heapBytes,
+               timeOk && heapOk ? "ok" : "REGRESSION");
+        return timeOk && heapOk;
+    }
+    printf("  %-18s %7lu ns %7lu steps  %2lu allocs %5ld bytes  (no baseline)\n", result.name,
+           (unsigned long)result.ns, (unsigned long)result.steps, (unsigned long)result.allocations,
+           (long)result.heapBytes);
+    return true;
+}
+
+bool Benchmarks::run() {
+    // Keep the lamp state the benchmarks disturb, and put it back afterwards
+    float savedFilteredValue = lamp->filteredValue;
+    float savedBatteryVoltage = lamp->batteryVoltage;
+
+    measure("outputRender", 2000, [&](int i) {
+        lamp->output.render(i & LampConfig::MAX_ANALOG);
+    });
+    measure("potentiometerEma", 2000, [&](int i) {
+        lamp->handlePotentiometerMode(i & LampConfig::MAX_ANALOG);
+    });
+    measure("voltageEma", 500, [&](int) {
+        lamp->updateBatteryVoltage();
+    });
+    measure("monitoringJson", 500, [&](int) {
+        sink = lamp->getMonitoringData(lamp->getStatus());
+    });
+    measure("statusJson", 500, [&](int) {
+        sink = network->getStatusJson();
+    });
+    lamp->filteredValue = savedFilteredValue;
+    measure("lampUpdateTick", 500, [&](int) {
+        lamp->update();
+    });
+
+    lamp->filteredValue = savedFilteredValue;
+    lamp->batteryVoltage = savedBatteryVoltage;
+
+    bool passed = true;
+    printf("Benchmark results:\n");
+    for (int i = 0; i < resultCount; i++) {
+        passed = check(results[i]) && passed;
+    }
+
+    printf("Baseline for BenchmarkBaseline.h:\n");
+    for (int i = 0; i < resultCount; i++) {
+        printf("    {\"%s\", %lu, %lu, %ld},\n", results[i].name, (unsigned long)results[i].steps,
+               (unsigned long)results[i].allocations, (long)results[i].heapBytes);
+    }
+    return passed;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_hot_paths_within_baseline() {
+    TEST_ASSERT_TRUE_MESSAGE(MEM_STATS, "Run in the native_bench env, allocations are not counted otherwise");
+
+    HostDevice device;
+    device.serialMuted = true;
+    device.setKnob(Board::DIMMER_ANALOG_PIN, 0.4f);
+    device.setPackVoltage(Board::VOLTAGE_PIN, 11.5f, LampConfig::VOLTAGE_DIVIDER_RATIO);
+    HostDevice::select(&device);
+    MemStats::registerTask(MemTag::LAMP, "bench");
+
+    LampController lamp;
+    CpuGovernor governor(lamp);
+    LoopStats loopStats;
+    LoadShedder shedder;
+    EnergyModel energy;
+    NetworkManager network(lamp, governor, loopStats, shedder, energy);
+    lamp.begin();
+
+    bool passed = Benchmarks(lamp, network).run();
+    HostDevice::select(nullptr);
+    TEST_ASSERT_TRUE_MESSAGE(passed, "Performance regression, see the table above");
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_hot_paths_within_baseline);
+    return UNITY_END();
+}
@@ -0,0 +1,140 @@
+// Brightness programs on the lamp's loop, on a virtual clock (pio test -e native)
+#include <unity.h>
+#include "HostDevice.h"
+#include "lamp/LampController.h"
+#include <string>
+
+const float KNOB = 0.3f;
+
+HostDevice* device;
+
+void setUp() {
+    device = new HostDevice();
+    device->useVirtualClock();
+    device->serialMuted = true;
+    device->setKnob(Board::DIMMER_ANALOG_PIN, KNOB);
+    device->setPackVoltage(Board::VOLTAGE_PIN, 11.5f, LampConfig::VOLTAGE_DIVIDER_RATIO);
+    HostDevice::select(device);
+}
+
+void tearDown() {
+    HostDevice::select(nullptr);
+    delete device;
+}
+
+// Until the knob filter has caught up and the loop is in slow mode
+void settle(LampController& lamp) {
+    for (int i = 0; i < 1000 && (lamp.getSleepTime() != 100 || lamp.isFading()); i++) {
+        lamp.update();
+        delay(lamp.getSleepTime());
+    }
+    TEST_ASSERT_EQUAL(100, lamp.getSleepTime());
+}
+
+void startProgram(LampController& lamp, const char* steps, float startPercent, uint32_t delayS) {
+    CompiledProgram compiled;
+    TEST_ASSERT_NULL(BrightnessProgram::compile(steps, startPercent, delayS, compiled));
+    TEST_ASSERT_TRUE(lamp.loadProgram(compiled));
+    lamp.update();
+    TEST_ASSERT_TRUE(lamp.getStatus().programRunning);
+}
+
+// One loop pass while the program holds the lamp dark: a light sleep when
+// the lamp allows one, else the normal delay. Adds the light sleep to sleptMs.
+void darkPass(LampController& lamp, uint64_t& sleptMs) {
+    unsigned long sleepMs = lamp.getLightSleepMs();
+    unsigned long delayMs = (unsigned long)lamp.getSleepTime();
+    TEST_ASSERT_TRUE(sleepMs <= LampConfig::PROGRAM_LIGHT_SLEEP_MAX_MS);
+    sleptMs += sleepMs;
+    delay(sleepMs > delayMs ? sleepMs : delayMs);
+    lamp.update();
+}
+
+void test_light_sleep_to_next_segment() {
+    // A sunrise an hour out: the dark wait is slept in capped steps
+    LampController lamp;
+    lamp.begin();
+    settle(lamp);
+    startProgram(lamp, "60:50", 0.0f, 3600);
+    uint64_t sleptMs = 0;
+    for (int i = 0; i < 10000 && lamp.getStatus().brightness == 0.0f; i++) {
+        darkPass(lamp, sleptMs);
+    }
+    TEST_ASSERT_TRUE(sleptMs > 3500000UL && sleptMs <= 3600000UL);
+    TEST_ASSERT_EQUAL(0, (int)lamp.getLightSleepMs());
+    TEST_ASSERT_TRUE(lamp.getStatus().programRunning);
+    for (int i = 0; i < 100; i++) {
+        delay(lamp.getSleepTime());
+        lamp.update();
+    }
+    TEST_ASSERT_TRUE(lamp.getStatus().brightness > 5.0f);
+}
+
+void test_knob_takes_over_during_delay() {
+    // The knob is read between light sleeps, so turning it cancels the wait
+    LampController lamp;
+    lamp.begin();
+    settle(lamp);
+    startProgram(lamp, "60:50", 0.0f, 3600);
+    uint64_t sleptMs = 0;
+    for (int i = 0; i < 20; i++) {
+        darkPass(lamp, sleptMs);
+    }
+    TEST_ASSERT_TRUE(sleptMs > 0);
+    TEST_ASSERT_TRUE(lamp.getStatus().programRunning);
+
+    device->setKnob(Board::DIMMER_ANALOG_PIN, 0.8f);
+    uint64_t movedUs = device->nowUs();
+    for (int i = 0; i < 5 && lamp.getStatus().programRunning; i++) {
+        darkPass(lamp, sleptMs);
+    }
+    TEST_ASSERT_FALSE(lamp.getStatus().programRunning);
+    TEST_ASSERT_TRUE(device->nowUs() - movedUs <= (uint64_t)LampConfig::PROGRAM_LIGHT_SLEEP_MAX_MS * 2000);
+    TEST_ASSERT_EQUAL(0, (int)lamp.getLightSleepMs());
+    for (int i = 0; i < 200; i++) {
+        delay(lamp.getSleepTime());
+        lamp.update();
+    }
+    TEST_ASSERT_TRUE(lamp.getStatus().brightness > 50.0f);
+}
+
+void test_end_restores_cadence() {
+    // The ramp paces the loop; once it ends the lamp goes back to slow mode
+    LampController lamp;
+    lamp.begin();
+    settle(lamp);
+    startProgram(lamp, "2:60", 10.0f, 0);
+    TEST_ASSERT_TRUE(lamp.getSleepTime() < 100);
+    for (int i = 0; i < 1000 && lamp.getStatus().programRunning; i++) {
+        delay(lamp.getSleepTime());
+        lamp.update();
+    }
+    TEST_ASSERT_FALSE(lamp.getStatus().programRunning);
+    TEST_ASSERT_EQUAL(100, lamp.getSleepTime());
+    TEST_ASSERT_EQUAL_UINT32(1, lamp.getStatus().programsStarted);
+}
+
+void test_remaining_past_32_bits() {
+    // 64 day-long steps: longer than 2^32 ms
+    std::string steps;
+    for (int i = 0; i < LampConfig::PROGRAM_MAX_SEGMENTS; i++) {
+        steps += (i ? "," : "") + std::to_string(LampConfig::PROGRAM_MAX_STEP_S) + ":" + std::to_string(i % 2 ? 20 : 40);
+    }
+    CompiledProgram compiled;
+    TEST_ASSERT_NULL(BrightnessProgram::compile(steps.c_str(), 30.0f, 0, compiled));
+    BrightnessProgram program;
+    program.start(compiled, 0);
+    uint64_t totalMs = (uint64_t)LampConfig::PROGRAM_MAX_SEGMENTS * LampConfig::PROGRAM_MAX_STEP_S * 1000;
+    TEST_ASSERT_TRUE(totalMs > UINT32_MAX);
+    TEST_ASSERT_TRUE(program.msRemaining(0) == totalMs);
+    TEST_ASSERT_TRUE(program.msRemaining(1000) == totalMs - 1000);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_light_sleep_to_next_segment);
+    RUN_TEST(test_knob_takes_over_during_delay);
+    RUN_TEST(test_end_restores_cadence);
+    RUN_TEST(test_remaining_past_32_bits);
+    return UNITY_END();
+}
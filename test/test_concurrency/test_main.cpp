@@ -0,0 +1,161 @@
+// Loop task / network task hand-off under real threads (pio test -e native)
+#include <unity.h>
+#include "HostDevice.h"
+#include "util/SpscQueue.h"
+#include "util/DoubleBuffer.h"
+#include "lamp/LampController.h"
+#include "diag/LoopStats.h"
+#include <atomic>
+#include <thread>
+
+void setUp() {}
+void tearDown() {}
+
+void test_spsc_queue_keeps_order() {
+    // Small queue so both sides keep hitting full / empty
+    static SpscQueue<uint32_t, 8> queue;
+    const uint32_t count = 2000000;
+    std::thread producer([]() {
+        for (uint32_t i = 0; i < count; i++) {
+            while (!queue.push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    uint32_t expected = 0;
+    uint32_t outOfOrder = 0;
+    while (expected < count) {
+        uint32_t value;
+        if (!queue.pop(value)) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (value != expected) {
+            outOfOrder++;
+        }
+        expected = value + 1;
+    }
+    producer.join();
+    TEST_ASSERT_EQUAL(0, outOfOrder);
+    TEST_ASSERT_TRUE(queue.empty());
+}
+
+void test_spsc_queue_push_all_or_none() {
+    SpscQueue<uint32_t, 8> queue;
+    const uint32_t pair[2] = {100, 101};
+    for (uint32_t i = 0; i < 6; i++) {
+        TEST_ASSERT_TRUE(queue.push(i));
+    }
+    TEST_ASSERT_FALSE(queue.push(pair, 2));   // One slot left
+    uint32_t value;
+    TEST_ASSERT_TRUE(queue.pop(value));
+    TEST_ASSERT_TRUE(queue.push(pair, 2));
+    for (uint32_t expected : {1u, 2u, 3u, 4u, 5u, 100u, 101u}) {
+        TEST_ASSERT_TRUE(queue.pop(value));
+        TEST_ASSERT_EQUAL_UINT32(expected, value);
+    }
+    TEST_ASSERT_TRUE(queue.empty());
+}
+
+struct Payload {
+    uint32_t sequence;
+    uint32_t words[15];   // Each a function of sequence, so a torn copy shows
+};
+
+void test_double_buffer_never_tears() {
+    static DoubleBuffer<Payload> buffer;
+    static std::atomic<bool> done{false};
+    std::thread writer([]() {
+        Payload payload;
+        for (uint32_t sequence = 1; sequence <= 3000000; sequence++) {
+            payload.sequence = sequence;
+            for (int i = 0; i < 15; i++) {
+                payload.words[i] = sequence * (i + 3);
+            }
+            buffer.publish(payload);
+        }
+        done = true;
+    });
+
+    uint32_t torn = 0;
+    uint32_t backwards = 0;
+    uint32_t reads = 0;
+    uint32_t last = 0;
+    while (!done) {
+        Payload copy = buffer.read();
+        reads++;
+        for (int i = 0; i < 15; i++) {
+            if (copy.words[i] != copy.sequence * (i + 3)) {
+                torn++;
+                break;
+            }
+        }
+        if (copy.sequence < last) {
+            backwards++;
+        }
+        last = copy.sequence;
+    }
+    writer.join();
+    printf("  %u reads\n", reads);
+    TEST_ASSERT_EQUAL(0, torn);
+    TEST_ASSERT_EQUAL(0, backwards);
+}
+
+void test_loop_jitter_under_network_load() {
+    // The control loop runs on the real clock while a network thread posts
+    // commands and reads the status as fast as it can. Neither side takes a
+    // lock, so the loop's timing must not depend on the other thread.
+    HostDevice device;
+    device.serialMuted = true;
+    device.setKnob(Board::DIMMER_ANALOG_PIN, 0.5f);
+    device.setPackVoltage(Board::VOLTAGE_PIN, 11.5f, LampConfig::VOLTAGE_DIVIDER_RATIO);
+    HostDevice::select(&device);
+
+    static LampController* lamp;
+    static std::atomic<bool> stop{false};
+    LampController controller;
+    lamp = &controller;
+    lamp->begin();
+    LoopStats stats;
+
+    std::thread network([&device]() {
+        HostDevice::select(&device);
+        uint32_t n = 0;
+        while (!stop) {
+            lamp->postCommand({LampCommand::Type::SET_BRIGHTNESS, (float)(n++ % 100)});
+            lamp->getStatus();
+            std::this_thread::yield();
+        }
+    });
+
+    const int passes = 400;
+    const unsigned long sleepMs = 5;
+    for (int pass = 0; pass < passes; pass++) {
+        stats.beginIteration(micros());
+        lamp->update();
+        stats.charge(LoopSubsystem::LAMP, micros());
+        stats.endIteration(micros(), sleepMs);
+        delay(sleepMs);
+    }
+    stop = true;
+    network.join();
+    HostDevice::select(nullptr);
+
+    LoopStats::Snapshot result = stats.read();
+    printf("  %u passes, max work %u us, p99 lateness %u us, max lateness %u us, %u misses\n",
+           result.iterations, result.maxWorkUs, LoopStats::latenessPercentileUs(result, 0.99f),
+           result.maxLatenessUs, result.deadlineMisses);
+    TEST_ASSERT_EQUAL(0, result.overruns);
+    // Allow the odd miss from the host scheduler, not a pattern
+    TEST_ASSERT_LESS_OR_EQUAL(passes / 100, result.deadlineMisses);
+    TEST_ASSERT_LESS_OR_EQUAL(LampConfig::LOOP_DEADLINE_SLACK_MS * 1000, LoopStats::latenessPercentileUs(result, 0.99f));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_spsc_queue_keeps_order);
+    RUN_TEST(test_spsc_queue_push_all_or_none);
+    RUN_TEST(test_double_buffer_never_tears);
+    RUN_TEST(test_loop_jitter_under_network_load);
+    return UNITY_END();
+}
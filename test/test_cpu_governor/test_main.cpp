@@ -0,0 +1,121 @@
+// CPU governor frequency selection and cross-task requests (pio test -e native)
+#include <unity.h>
+#include "HostDevice.h"
+#include "power/CpuGovernor.h"
+#include <WiFi.h>
+#include <thread>
+#include <vector>
+
+HostDevice* device;
+LampController* lamp;
+CpuGovernor* governor;
+
+void setUp() {
+    device = new HostDevice();
+    device->useVirtualClock(1000000);
+    HostDevice::select(device);
+    lamp = new LampController();
+    governor = new CpuGovernor(*lamp);
+    governor->begin();
+}
+
+void tearDown() {
+    delete governor;
+    delete lamp;
+    HostDevice::select(nullptr);
+    delete device;
+}
+
+// One loop pass after advancing the clock
+int step(unsigned long ms) {
+    device->advanceMs(ms);
+    governor->update();
+    return governor->getFrequencyMhz();
+}
+
+void test_idle_clock() {
+    TEST_ASSERT_EQUAL(LampConfig::CPU_FREQ_MHZ, step(10));
+    TEST_ASSERT_EQUAL(LampConfig::CPU_FREQ_MHZ, device->cpuMhz);
+    TEST_ASSERT_EQUAL(0, governor->getSwitchCount());
+}
+
+void test_radio_holds_network_clock() {
+    WiFi.mode(WIFI_STA);
+    TEST_ASSERT_EQUAL(LampConfig::CPU_FREQ_NETWORK_MHZ, step(10));
+    // Held for as long as the radio is on, not just the boost window
+    TEST_ASSERT_EQUAL(LampConfig::CPU_FREQ_NETWORK_MHZ, step(LampConfig::CPU_BOOST_HOLD_MS * 5));
+    WiFi.mode(WIFI_OFF);
+    TEST_ASSERT_EQUAL(LampConfig::CPU_FREQ_MHZ, step(10));
+}
+
+void test_demand_held_then_released() {
+    governor->request(CpuGovernor::Demand::FADE);
+    TEST_ASSERT_EQUAL(LampConfig::CPU_FREQ_FADE_MHZ, step(10));
+    TEST_ASSERT_EQUAL(LampConfig::CPU_FREQ_FADE_MHZ, step(LampConfig::CPU_BOOST_HOLD_MS));
+    TEST_ASSERT_EQUAL(LampConfig::CPU_FREQ_MHZ, step(10));
+
+    governor->request(CpuGovernor::Demand::NETWORK);
+    TEST_ASSERT_EQUAL(LampConfig::CPU_FREQ_BURST_MHZ, step(10));
+    TEST_ASSERT_EQUAL(LampConfig::CPU_FREQ_MHZ, step(LampConfig::CPU_BOOST_HOLD_MS + 1));
+}
+
+void test_request_burst() {
+    // Single requests need the network clock; a burst within the hold window boosts
+    governor->request(CpuGovernor::Demand::REQUEST);
+    TEST_ASSERT_EQUAL(LampConfig::CPU_FREQ_NETWORK_MHZ, step(10));
+    for (int i = 1; i < LampConfig::CPU_BURST_REQUEST_COUNT; i++) {
+        governor->request(CpuGovernor::Demand::REQUEST);
+        step(100);
+    }
+    TEST_ASSERT_EQUAL(LampConfig::CPU_FREQ_BURST_MHZ, governor->getFrequencyMhz());
+
+    // After a quiet hold window the count starts over
+    TEST_ASSERT_EQUAL(LampConfig::CPU_FREQ_MHZ, step(LampConfig::CPU_BOOST_HOLD_MS + 1));
+    governor->request(CpuGovernor::Demand::REQUEST);
+    TEST_ASSERT_EQUAL(LampConfig::CPU_FREQ_NETWORK_MHZ, step(10));
+}
+
+void test_time_at_frequency() {
+    step(500);
+    governor->request(CpuGovernor::Demand::FADE);
+    step(0);
+    step(300);
+    TEST_ASSERT_EQUAL(500, governor->getTimeAtFrequencyMs(LampConfig::CPU_FREQ_MHZ));
+    TEST_ASSERT_EQUAL(300, governor->getTimeAtFrequencyMs(LampConfig::CPU_FREQ_FADE_MHZ));
+    TEST_ASSERT_EQUAL(1, governor->getSwitchCount());
+}
+
+void test_requests_from_other_tasks() {
+    // Web server and telemetry tasks call request() while the loop updates;
+    // no request may be lost between them
+    const int threads = 4;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([]() {
+            HostDevice::select(device);
+            for (int i = 0; i < 10000; i++) {
+                governor->request(i & 1 ? CpuGovernor::Demand::REQUEST : CpuGovernor::Demand::FADE);
+            }
+        });
+    }
+    int passes = 0;
+    while (passes < 1000) {
+        governor->update();
+        passes++;
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    TEST_ASSERT_EQUAL(LampConfig::CPU_FREQ_BURST_MHZ, step(1));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_idle_clock);
+    RUN_TEST(test_radio_holds_network_clock);
+    RUN_TEST(test_demand_held_then_released);
+    RUN_TEST(test_request_burst);
+    RUN_TEST(test_time_at_frequency);
+    RUN_TEST(test_requests_from_other_tasks);
+    return UNITY_END();
+}
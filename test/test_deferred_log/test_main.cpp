@@ -0,0 +1,121 @@
+// Deferred log records and their cost against printf (pio test -e native)
+#include <unity.h>
+#include "HostDevice.h"
+#include "util/DeferredLog.h"
+#include <chrono>
+#include <string>
+
+// SERIAL_DEBUG is off in the native env, so the tests call DeferredLog
+// directly instead of through LOG_DEFERRED
+#define LOG_FORMAT(format) []() { static const uint16_t id = DeferredLog::registerFormat(format); return id; }()
+
+std::string output;
+
+void setUp() {
+    DeferredLog::drain(LampConfig::LOG_BUFFER_SIZE);
+    output.clear();
+    HostDevice::current().serialCapture = &output;
+}
+
+void tearDown() {
+    HostDevice::current().serialCapture = nullptr;
+}
+
+std::string drained() {
+    output.clear();
+    DeferredLog::drain(LampConfig::LOG_BUFFER_SIZE);
+    return output;
+}
+
+void test_strings_are_copied() {
+    char name[16] = "HomeNetwork";
+    DeferredLog::log(LOG_FORMAT("Connecting to %s...\n"), (const char*)name);
+    strcpy(name, "overwritten");
+    TEST_ASSERT_EQUAL_STRING("Connecting to HomeNetwork...\n", drained().c_str());
+
+    DeferredLog::log(LOG_FORMAT("%s/%s/%-4s|\n"), "one", (const char*)nullptr, "x");
+    TEST_ASSERT_EQUAL_STRING("one/(null)/x   |\n", drained().c_str());
+}
+
+void test_long_strings_are_truncated() {
+    std::string longText(100, 'a');
+    DeferredLog::log(LOG_FORMAT("[%s][%s][%d]\n"), longText.c_str(), "after", 7);
+    std::string expected = "[" + std::string(LampConfig::LOG_STRING_BYTES - 1, 'a') + "][][7]\n";
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), drained().c_str());
+}
+
+void test_wide_integers() {
+    uint64_t serial = 0x0000A1B2C3D4E5F6ULL;
+    DeferredLog::log(LOG_FORMAT("id %016llX, %llu, %lld\n"),
+                     (unsigned long long)serial, 12345678901234ULL, -9876543210LL);
+    TEST_ASSERT_EQUAL_STRING("id 0000A1B2C3D4E5F6, 12345678901234, -9876543210\n", drained().c_str());
+    DeferredLog::log(LOG_FORMAT("%lu, %ld, %u, %d\n"), 4000000000UL, -5L, 42u, -7);
+    TEST_ASSERT_EQUAL_STRING("4000000000, -5, 42, -7\n", drained().c_str());
+}
+
+void test_mixed_arguments() {
+    DeferredLog::log(LOG_FORMAT("Input: %04d, PWM: %04.1f%%, Voltage: %04.2fV, %c %x\n"),
+                     512, 37.25f, 11.5, 'k', 255);
+    TEST_ASSERT_EQUAL_STRING("Input: 0512, PWM: 37.2%, Voltage: 11.50V, k ff\n", drained().c_str());
+}
+
+void test_full_buffer_drops() {
+    uint32_t before = DeferredLog::getDroppedCount();
+    uint16_t id = LOG_FORMAT("%d\n");
+    for (int i = 0; i < LampConfig::LOG_BUFFER_SIZE + 5; i++) {
+        DeferredLog::log(id, i);
+    }
+    TEST_ASSERT_EQUAL(before + 5, DeferredLog::getDroppedCount());
+    std::string text = drained();
+    TEST_ASSERT_EQUAL(0, text.find("0\n1\n"));
+}
+
+void test_cheaper_than_printf() {
+    // The loop's status line: queueing it (the loop's cost), formatting it
+    // later in drain(), and printf on the spot. The serial port is muted so
+    // only formatting is measured, not output.
+    using namespace std::chrono;
+    HostDevice::current().serialMuted = true;
+    const int batches = 2000;
+    const int batch = LampConfig::LOG_BUFFER_SIZE;
+    uint16_t id = LOG_FORMAT("Input: %04d, PWM: %04.1f%%, Raw PWM: %04d, Filtered: %04d, Voltage: %04.2fV\n");
+
+    nanoseconds logTime(0);
+    nanoseconds drainTime(0);
+    for (int b = 0; b < batches; b++) {
+        auto start = steady_clock::now();
+        for (int i = 0; i < batch; i++) {
+            DeferredLog::log(id, i & 1023, 37.25f, i & 2047, (i >> 1) & 1023, 11.5);
+        }
+        auto logged = steady_clock::now();
+        DeferredLog::drain(batch);
+        drainTime += duration_cast<nanoseconds>(steady_clock::now() - logged);
+        logTime += duration_cast<nanoseconds>(logged - start);
+    }
+
+    const int runs = batches * batch;
+    auto start = steady_clock::now();
+    for (int i = 0; i < runs; i++) {
+        Serial.printf("Input: %04d, PWM: %04.1f%%, Raw PWM: %04d, Filtered: %04d, Voltage: %04.2fV\n",
+                      i & 1023, 37.25f, i & 2047, (i >> 1) & 1023, 11.5);
+    }
+    double printfNs = duration_cast<nanoseconds>(steady_clock::now() - start).count() / (double)runs;
+    HostDevice::current().serialMuted = false;
+
+    double logNs = logTime.count() / (double)runs;
+    double drainNs = drainTime.count() / (double)runs;
+    printf("  status line: %.0f ns to queue, %.0f ns to drain, %.0f ns printf (%.1fx on the loop)\n",
+           logNs, drainNs, printfNs, printfNs / logNs);
+    TEST_ASSERT_LESS_THAN(printfNs, logNs);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_strings_are_copied);
+    RUN_TEST(test_long_strings_are_truncated);
+    RUN_TEST(test_wide_integers);
+    RUN_TEST(test_mixed_arguments);
+    RUN_TEST(test_full_buffer_drops);
+    RUN_TEST(test_cheaper_than_printf);
+    return UNITY_END();
+}
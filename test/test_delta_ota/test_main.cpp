@@ -0,0 +1,155 @@
+// Applies ota_delta.py patches through DeltaOta into the host's OTA
+// partitions (pio test -e native)
+//
+// fixtures/ holds two small synthetic images (0xE9 magic, random bytes with
+// changed, inserted, removed and appended regions) and the patch between
+// them from python ota_delta.py make old.bin new.bin patch.ldp.
+#include <unity.h>
+#include "HostDevice.h"
+#include "network/DeltaOta.h"
+#include <string>
+#include <vector>
+
+const char* const FIXTURE_DIR = "test/test_delta_ota/fixtures/";
+const size_t HEADER_SIZE = 76;
+const size_t TARGET_SHA_OFFSET = 44;
+
+HostDevice* device;
+std::string oldImage;
+std::string newImage;
+std::string patch;
+
+std::string readFixture(const char* name) {
+    std::string data;
+    FILE* file = fopen((std::string(FIXTURE_DIR) + name).c_str(), "rb");
+    if (!file) {
+        return data;
+    }
+    char chunk[4096];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        data.append(chunk, read);
+    }
+    fclose(file);
+    return data;
+}
+
+void setUp() {
+    device = new HostDevice();
+    device->serialMuted = true;
+    device->otaImage[0] = oldImage;
+    HostDevice::select(device);
+}
+
+void tearDown() {
+    HostDevice::select(nullptr);
+    delete device;
+}
+
+// Feeds the patch in chunks that end at each of splits, then the rest
+DeltaOta::Result applyPatch(const std::string& data, const std::vector<size_t>& splits = {}) {
+    DeltaOta ota;
+    DeltaOta::Result result = ota.begin();
+    size_t position = 0;
+    for (size_t split : splits) {
+        if (result != DeltaOta::Result::IN_PROGRESS) {
+            return result;
+        }
+        result = ota.write((const uint8_t*)data.data() + position, split - position);
+        position = split;
+    }
+    if (result == DeltaOta::Result::IN_PROGRESS && position < data.size()) {
+        result = ota.write((const uint8_t*)data.data() + position, data.size() - position);
+    }
+    return result == DeltaOta::Result::IN_PROGRESS ? ota.finish() : result;
+}
+
+void test_fixtures_present() {
+    TEST_ASSERT_TRUE(oldImage.size() > 0);
+    TEST_ASSERT_TRUE(newImage.size() > 0);
+    TEST_ASSERT_TRUE(patch.size() > HEADER_SIZE);
+}
+
+void test_whole_patch() {
+    TEST_ASSERT_EQUAL(DeltaOta::Result::OK, applyPatch(patch));
+    TEST_ASSERT_TRUE(device->otaImage[1] == newImage);
+    TEST_ASSERT_EQUAL(1, device->bootOta);
+    TEST_ASSERT_EQUAL(-1, device->otaWriting);
+}
+
+void test_every_split() {
+    // One split at each byte covers every header field and op boundary
+    for (size_t split = 1; split < patch.size(); split++) {
+        device->otaImage[1].clear();
+        device->bootOta = 0;
+        if (applyPatch(patch, {split}) != DeltaOta::Result::OK || device->otaImage[1] != newImage) {
+            printf("  split at %zu\n", split);
+            TEST_FAIL_MESSAGE("Split patch did not apply");
+        }
+    }
+}
+
+void test_byte_at_a_time() {
+    std::vector<size_t> splits;
+    for (size_t i = 1; i < patch.size(); i++) {
+        splits.push_back(i);
+    }
+    TEST_ASSERT_EQUAL(DeltaOta::Result::OK, applyPatch(patch, splits));
+    TEST_ASSERT_TRUE(device->otaImage[1] == newImage);
+}
+
+void test_wrong_base() {
+    // The lamp runs something other than the patch's source image
+    device->otaImage[0][200] ^= 0x01;
+    TEST_ASSERT_EQUAL(DeltaOta::Result::WRONG_BASE, applyPatch(patch));
+    TEST_ASSERT_EQUAL(0, device->bootOta);
+    TEST_ASSERT_EQUAL(-1, device->otaWriting);
+}
+
+void test_truncated() {
+    // Cut inside the header, inside an INSERT's data and just before END
+    for (size_t length : {HEADER_SIZE / 2, patch.size() / 2, patch.size() - 1}) {
+        device->otaImage[1].clear();
+        TEST_ASSERT_NOT_EQUAL(DeltaOta::Result::OK, applyPatch(patch.substr(0, length)));
+        TEST_ASSERT_EQUAL(0, device->bootOta);
+        TEST_ASSERT_EQUAL(-1, device->otaWriting);
+    }
+}
+
+void test_trailing_bytes() {
+    TEST_ASSERT_EQUAL(DeltaOta::Result::BAD_PATCH, applyPatch(patch + std::string(1, '\0')));
+    TEST_ASSERT_EQUAL(0, device->bootOta);
+    TEST_ASSERT_EQUAL(-1, device->otaWriting);
+}
+
+void test_target_sha_mismatch() {
+    std::string corrupt = patch;
+    corrupt[TARGET_SHA_OFFSET] ^= 0x01;
+    TEST_ASSERT_EQUAL(DeltaOta::Result::VERIFY_FAILED, applyPatch(corrupt));
+    TEST_ASSERT_EQUAL(0, device->bootOta);
+    TEST_ASSERT_EQUAL(-1, device->otaWriting);
+}
+
+void test_bad_magic() {
+    std::string corrupt = patch;
+    corrupt[0] = 'X';
+    TEST_ASSERT_EQUAL(DeltaOta::Result::BAD_HEADER, applyPatch(corrupt));
+}
+
+int main() {
+    oldImage = readFixture("old.bin");
+    newImage = readFixture("new.bin");
+    patch = readFixture("patch.ldp");
+
+    UNITY_BEGIN();
+    RUN_TEST(test_fixtures_present);
+    RUN_TEST(test_whole_patch);
+    RUN_TEST(test_every_split);
+    RUN_TEST(test_byte_at_a_time);
+    RUN_TEST(test_wrong_base);
+    RUN_TEST(test_truncated);
+    RUN_TEST(test_trailing_bytes);
+    RUN_TEST(test_target_sha_mismatch);
+    RUN_TEST(test_bad_magic);
+    return UNITY_END();
+}
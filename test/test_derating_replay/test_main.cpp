@@ -0,0 +1,259 @@
+// Replays the full-brightness discharge traces in lamp_data/ through the
+// low-battery derating policy and reports the runtime gained (pio test -e native)
+//
+// Model: a trace gives pack voltage under full load against time, i.e.
+// against charge drawn at full duty. At a lower duty charge is drawn
+// proportionally slower, and the measured voltage recovers by the IR drop
+// that is no longer there. A run ends when the charge the trace drew before
+// it ended has been used up. With lumen compensation the output stage scales
+// the duty by LumenCompensationTable for the measured voltage, as
+// LampController::update() does.
+#include <unity.h>
+#include "HostDevice.h"
+#include "lamp/DeratingPolicy.h"
+#include "lamp/LumenCompensationTable.h"
+#include "lamp/OutputStage.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+const char* const TRACE_DIR = "lamp_data";
+const float PACK_RESISTANCE_OHMS = 0.15f;   // Cells + wiring
+const float MIN_RUNTIME_GAIN = 0.20f;       // Both traces gain about 28%
+
+const unsigned long STEP_S = 10;
+const double MAX_GAP_S = 30 * 60;
+const double MIN_SEGMENT_S = 60 * 60;
+
+struct Sample {
+    double seconds;   // Since the start of the segment
+    float voltage;
+};
+typedef std::vector<Sample> Trace;
+
+struct Run {
+    double seconds;
+    double light;     // Output-seconds at full duty
+    int capRises;
+    float maxOverCap; // Largest duty above the derating cap
+};
+
+double parseTime(const char* text) {
+    struct tm parts = {};
+    double fraction = 0.0;
+    int second = 0;
+    if (sscanf(text, "%d-%d-%dT%d:%d:%d%lf", &parts.tm_year, &parts.tm_mon, &parts.tm_mday,
+               &parts.tm_hour, &parts.tm_min, &second, &fraction) < 6) {
+        return -1.0;
+    }
+    parts.tm_year -= 1900;
+    parts.tm_mon -= 1;
+    parts.tm_sec = second;
+    return (double)timegm(&parts) + fraction;
+}
+
+// Runs of consecutive full-brightness samples of at least MIN_SEGMENT_S
+std::vector<Trace> dischargeSegments(const std::string& path) {
+    std::vector<Trace> segments;
+    std::vector<std::pair<double, float>> current;
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file) {
+        return segments;
+    }
+
+    auto close = [&]() {
+        if (!current.empty() && current.back().first - current.front().first >= MIN_SEGMENT_S) {
+            Trace trace;
+            for (const auto& sample : current) {
+                trace.push_back({sample.first - current.front().first, sample.second});
+            }
+            segments.push_back(trace);
+        }
+        current.clear();
+    };
+
+    char line[256];
+    double lastTime = -1.0;
+    while (fgets(line, sizeof(line), file)) {
+        char* fields[4];
+        int count = 0;
+        for (char* field = strtok(line, ","); field && count < 4; field = strtok(nullptr, ",")) {
+            fields[count++] = field;
+        }
+        if (count < 4) {
+            continue;
+        }
+        double time = parseTime(fields[0]);
+        float voltage = strtof(fields[2], nullptr);
+        float brightness = strtof(fields[3], nullptr);
+        if (brightness < 99.0f || (lastTime >= 0.0 && time - lastTime > MAX_GAP_S)) {
+            close();
+        }
+        if (brightness >= 99.0f) {
+            current.push_back({time, voltage});
+        }
+        lastTime = time;
+    }
+    close();
+    fclose(file);
+    return segments;
+}
+
+// Trace voltage after chargeS seconds' worth of full-duty charge
+float loadedVoltage(const Trace& trace, double chargeS) {
+    for (size_t i = 1; i < trace.size(); i++) {
+        if (chargeS <= trace[i].seconds) {
+            const Sample& a = trace[i - 1];
+            const Sample& b = trace[i];
+            double span = std::max(b.seconds - a.seconds, 1e-9);
+            return (float)(a.voltage + (b.voltage - a.voltage) * (chargeS - a.seconds) / span);
+        }
+    }
+    return trace.back().voltage;
+}
+
+// Knob at full for the whole trace; the duty is what the output stage writes
+Run replay(const Trace& trace, bool derate, bool compensate) {
+    DeratingPolicy policy;
+    OutputStage output;
+    output.begin();
+    uint8_t channel = OutputStage::ledcChannel(0);
+
+    Run run = {0.0, 0.0, 0, 0.0f};
+    double charge = 0.0;
+    float lastCap = 1.0f;
+    float lastDuty = 1.0f;
+    unsigned long now = 0;
+    while (charge < trace.back().seconds) {
+        float sagRelief = (1.0f - lastDuty) * LampConfig::LED_FULL_DUTY_UA / 1e6f * PACK_RESISTANCE_OHMS;
+        float voltage = loadedVoltage(trace, charge) + sagRelief;
+        if (derate) {
+            uint32_t cap = policy.update(voltage, now);
+            output.setLimit(cap);
+            if (cap / 65536.0f > lastCap + 1e-4f) {
+                run.capRises++;
+            }
+            lastCap = cap / 65536.0f;
+        }
+        output.setSupplyGain(compensate ? LumenCompensationTable::gainFor(voltage) : 1 << 12);
+        output.render(LampConfig::MAX_ANALOG);
+        float duty = (float)HostDevice::current().ledc[channel].duty / LampConfig::MAX_PWM;
+        if (derate) {
+            run.maxOverCap = max(run.maxOverCap, duty - lastCap);
+        }
+
+        charge += duty * STEP_S;
+        run.light += duty * STEP_S;
+        run.seconds += STEP_S;
+        now += STEP_S * 1000;
+        lastDuty = duty;
+    }
+    return run;
+}
+
+std::vector<std::string> tracePaths() {
+    std::vector<std::string> paths;
+    DIR* dir = opendir(TRACE_DIR);
+    if (!dir) {
+        return paths;
+    }
+    while (struct dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".csv") == 0) {
+            paths.push_back(std::string(TRACE_DIR) + "/" + name);
+        }
+    }
+    closedir(dir);
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+HostDevice* device;
+
+void setUp() {
+    device = new HostDevice();
+    HostDevice::select(device);
+}
+
+void tearDown() {
+    HostDevice::select(nullptr);
+    delete device;
+}
+
+void test_first_reading_sets_cap() {
+    // A lamp switched on at a low pack starts derated instead of slewing
+    // down from full output
+    DeratingPolicy policy;
+    uint32_t cap = policy.update(9.9f, 300);
+    TEST_ASSERT_UINT32_WITHIN(2, (uint32_t)(0.40f * 65536.0f), cap);
+
+    // and the slew is timed from that first reading, not from boot
+    cap = policy.update(11.5f, 1300);
+    TEST_ASSERT_UINT32_WITHIN(2, (uint32_t)(0.42f * 65536.0f), cap);
+}
+
+void test_restored_cap_not_reset() {
+    // After a warm reset the saved cap holds; recovery still slews from it
+    DeratingPolicy policy;
+    policy.restore(11.5f, 0.6f);
+    TEST_ASSERT_UINT32_WITHIN(2, (uint32_t)(0.6f * 65536.0f), policy.update(11.5f, 60000));
+    TEST_ASSERT_UINT32_WITHIN(2, (uint32_t)(0.62f * 65536.0f), policy.update(11.5f, 61000));
+}
+
+void test_discharge_traces() {
+    int traces = 0;
+    for (const std::string& path : tracePaths()) {
+        for (const Trace& trace : dischargeSegments(path)) {
+            printf("  %s: %.2fV -> %.2fV\n", path.c_str(), trace.front().voltage, trace.back().voltage);
+            for (bool compensate : {false, true}) {
+                Run baseline = replay(trace, false, compensate);
+                Run derated = replay(trace, true, compensate);
+                float gain = (float)((derated.seconds - baseline.seconds) / baseline.seconds);
+                printf("    %-13s runtime %5.2f h -> %5.2f h (+%.0f%%), mean output %.0f%%, "
+                       "cap rises %d, duty over cap %.3f\n",
+                       compensate ? "compensated" : "uncompensated",
+                       baseline.seconds / 3600.0, derated.seconds / 3600.0, gain * 100.0f,
+                       derated.light / derated.seconds * 100.0, derated.capRises, derated.maxOverCap);
+                TEST_ASSERT_TRUE(gain >= MIN_RUNTIME_GAIN);
+                TEST_ASSERT_EQUAL(0, derated.capRises);
+                TEST_ASSERT_TRUE(derated.maxOverCap < 1.0f / 1024);
+            }
+            traces++;
+        }
+    }
+    TEST_ASSERT_GREATER_THAN(0, traces);
+}
+
+void test_compensation_stays_under_cap() {
+    // 0.6 cap at a pack that asks for a 1.75x gain: without the limit the
+    // duty would saturate at 100%
+    OutputStage output;
+    output.begin();
+    output.setLimit((uint32_t)(0.6f * 65536.0f));
+    output.setSupplyGain(7168);
+    uint32_t level = output.render(LampConfig::MAX_ANALOG);
+    uint32_t duty = device->ledc[OutputStage::ledcChannel(0)].duty;
+    TEST_ASSERT_UINT32_WITHIN(LampConfig::MAX_PWM / 500, (uint32_t)(0.6f * LampConfig::MAX_PWM), duty);
+    TEST_ASSERT_UINT32_WITHIN(64, (uint32_t)(0.6f * 65536.0f), level);
+
+    // Well below the cap the full gain still applies
+    output.render(LampConfig::MAX_ANALOG / 4);
+    uint32_t low = device->ledc[OutputStage::ledcChannel(0)].duty;
+    output.setSupplyGain(4096);
+    output.render(LampConfig::MAX_ANALOG / 4);
+    uint32_t uncompensated = device->ledc[OutputStage::ledcChannel(0)].duty;
+    TEST_ASSERT_UINT32_WITHIN(2, uncompensated * 7168 / 4096, low);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_first_reading_sets_cap);
+    RUN_TEST(test_restored_cap_not_reset);
+    RUN_TEST(test_compensation_stays_under_cap);
+    RUN_TEST(test_discharge_traces);
+    return UNITY_END();
+}
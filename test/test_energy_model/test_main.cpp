@@ -0,0 +1,129 @@
+// Energy model report and runtime charge accounting (pio test -e native)
+#include <unity.h>
+#include "HostDevice.h"
+#include "power/EnergyModel.h"
+#include <string>
+
+// Idle lifetimes the firmware has to keep on the 4400 mAh pack. Lower these
+// only together with a note on what made the lamp draw more.
+const float LOCAL_IDLE_MIN_HOURS = 1400.0f;
+const float DATA_LOGGING_IDLE_MIN_HOURS = 115.0f;
+const float REMOTE_IDLE_MIN_HOURS = 48.0f;
+
+HostDevice* device;
+
+void setUp() {
+    device = new HostDevice();
+    device->useVirtualClock();
+    HostDevice::select(device);
+}
+
+void tearDown() {
+    HostDevice::select(nullptr);
+    delete device;
+}
+
+// Radio-off profile at the idle clock and slow-mode loop
+PowerProfile idleProfile(float ledDuty) {
+    return EnergyModel::profileFor("test", false, false, LampConfig::CPU_FREQ_MHZ, 100, ledDuty);
+}
+
+void test_report_within_budget() {
+    std::string report;
+    device->serialCapture = &report;
+    EnergyModel::printReport();
+    device->serialCapture = nullptr;
+    printf("%s", report.c_str());
+    for (const char* env : {"local_control_pcb_v1", "local_control_pcb_v2", "smart_lamp", "data_logging"}) {
+        TEST_ASSERT_TRUE(report.find(env) != std::string::npos);
+    }
+
+    const int cpuMhz = LampConfig::CPU_FREQ_MHZ;
+    TEST_ASSERT_GREATER_OR_EQUAL(LOCAL_IDLE_MIN_HOURS, EnergyModel::estimateLifetimeHours(
+        EnergyModel::profileFor("local", false, false, cpuMhz, 100, 0.0f)));
+    TEST_ASSERT_GREATER_OR_EQUAL(DATA_LOGGING_IDLE_MIN_HOURS, EnergyModel::estimateLifetimeHours(
+        EnergyModel::profileFor("logging", false, true, cpuMhz, 100, 0.0f)));
+    TEST_ASSERT_GREATER_OR_EQUAL(REMOTE_IDLE_MIN_HOURS, EnergyModel::estimateLifetimeHours(
+        EnergyModel::profileFor("remote", true, false, cpuMhz, 100, 0.0f)));
+}
+
+void test_estimate_orders_profiles() {
+    // Faster loop, higher clock, radio and LED each cost current
+    float base = EnergyModel::estimateCurrentMa(idleProfile(0.0f));
+    TEST_ASSERT_GREATER_THAN(base, EnergyModel::estimateCurrentMa(idleProfile(0.5f)));
+    PowerProfile fast = idleProfile(0.0f);
+    fast.loopSleepMs = 10;
+    TEST_ASSERT_GREATER_THAN(base, EnergyModel::estimateCurrentMa(fast));
+    PowerProfile boosted = idleProfile(0.0f);
+    boosted.cpuMhz = 160;
+    TEST_ASSERT_GREATER_THAN(base, EnergyModel::estimateCurrentMa(boosted));
+}
+
+void test_radio_time_at_network_clock() {
+    // The governor holds the network clock whenever the radio is on, so a
+    // remote-control lamp never runs its loop at the idle clock
+    float remoteMa = EnergyModel::estimateCurrentMa(
+        EnergyModel::profileFor("remote", true, false, LampConfig::CPU_FREQ_MHZ, 100, 0.0f));
+    uint32_t radioOnUa = EnergyModel::currentUa(LampConfig::CPU_FREQ_NETWORK_MHZ, 100, true, 0.0f);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, radioOnUa / 1000.0f, remoteMa);
+    TEST_ASSERT_GREATER_THAN(EnergyModel::currentUa(LampConfig::CPU_FREQ_MHZ, 100, true, 0.0f), radioOnUa);
+
+    // Telemetry mixes the two in proportion to radio-on time
+    PowerProfile logging = EnergyModel::profileFor("logging", false, true, LampConfig::CPU_FREQ_MHZ, 100, 0.0f);
+    float wifiFraction = logging.wifiOnSecondsPerHour / 3600.0f;
+    float radioOffMa = EnergyModel::estimateCurrentMa(idleProfile(0.0f));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, (1.0f - wifiFraction) * radioOffMa + wifiFraction * radioOnUa / 1000.0f,
+                             EnergyModel::estimateCurrentMa(logging));
+}
+
+void test_runtime_matches_estimate() {
+    // One hour of 100ms loop passes at 25% output
+    EnergyModel energy;
+    int samples = 0;
+    for (int pass = 0; pass < 36000; pass++) {
+        device->advanceMs(100);
+        unsigned long now = millis();
+        if (energy.due(now)) {
+            energy.sample(now, LampConfig::CPU_FREQ_MHZ, 100, false, 0.25f);
+            samples++;
+        }
+    }
+    EnergyModel::Snapshot charge = energy.read();
+    TEST_ASSERT_EQUAL(3600, samples);
+    TEST_ASSERT_EQUAL_UINT64(3600000ULL, charge.accountedMs);
+
+    float expectedMah = EnergyModel::estimateCurrentMa(idleProfile(0.25f));
+    TEST_ASSERT_FLOAT_WITHIN(expectedMah * 0.001f, expectedMah, EnergyModel::consumedMah(charge));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, expectedMah, EnergyModel::averageCurrentMa(charge));
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, (LampConfig::PACK_CAPACITY_MAH - expectedMah) / expectedMah,
+                             EnergyModel::remainingHours(charge));
+}
+
+void test_long_uptime_stays_exact() {
+    // 60 days of one-second samples: the integer counter doesn't lose a
+    // step, where a float mAh total stops moving in the third week
+    EnergyModel energy;
+    const uint32_t currentUa = EnergyModel::currentUa(LampConfig::CPU_FREQ_MHZ, 100, false, 0.0f);
+    const unsigned long days = 60;
+    float floatMah = 0.0f;
+    for (unsigned long second = 1; second <= days * 86400; second++) {
+        energy.sample(second * 1000, LampConfig::CPU_FREQ_MHZ, 100, false, 0.0f);
+        floatMah += currentUa / 1000.0f / 3600.0f;
+    }
+    EnergyModel::Snapshot charge = energy.read();
+    TEST_ASSERT_EQUAL_UINT64((uint64_t)currentUa * days * 86400000ULL, charge.consumedUaMs);
+    float exactMah = currentUa / 1000.0f * days * 24;
+    printf("  after %lu days: integer %.1f mAh, float sum %.1f mAh\n",
+           days, EnergyModel::consumedMah(charge), floatMah);
+    TEST_ASSERT_FLOAT_WITHIN(exactMah * 0.0001f, exactMah, EnergyModel::consumedMah(charge));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_report_within_budget);
+    RUN_TEST(test_estimate_orders_profiles);
+    RUN_TEST(test_radio_time_at_network_clock);
+    RUN_TEST(test_runtime_matches_estimate);
+    RUN_TEST(test_long_uptime_stays_exact);
+    return UNITY_END();
+}
@@ -0,0 +1,325 @@
+// LoadShedder's policy, and what it does to the control loop's deadline
+// misses under simulated network stalls, with shedding on and off
+// (pio test -e native)
+//
+// The stall model is one core at the 80 MHz network clock, with rough
+// bench numbers. loop() does LOOP_WORK_US per pass, plus ANIMATION_US while
+// the status LED animates, then sleeps LOOP_SLEEP_MS. The network task
+// wakes every NETWORK_TASK_INTERVAL_MS and shares the 1 ms tick with
+// loop(). Every request, association and POST is also a burst in the WiFi
+// driver and lwIP, which run at high priority: loop() can't preempt them,
+// and they are what make it late.
+#include <unity.h>
+#include "diag/LoadShedder.h"
+#include <stdio.h>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+const int64_t STEP_US = 100;
+const int64_t TICK_US = 1000;
+const int64_t LOOP_SLEEP_MS = 10;
+const int32_t LOOP_WORK_US = 1200;
+const int32_t ANIMATION_US = 400;
+const int64_t SIMULATED_S = 60;
+const uint32_t SEED = 1;
+
+// One network operation: task CPU time, then the high-priority burst it causes
+struct NetJob {
+    const char* source;
+    int32_t taskUs;
+    int32_t burstUs;
+};
+const NetJob REQUEST = {"webServer", 1500, 6000};
+const NetJob CONNECT = {"wifiConnect", 2000, 25000};
+const NetJob POST = {"telemetry", 3000, 8000};
+
+struct Scenario {
+    const char* name;
+    float requestsPerS;
+    float floodStartS;
+    float floodEndS;
+    float floodRequestsPerS;   // 0: no flood
+    float connectFailures;     // Chance an association has to be repeated
+
+    float rate(float s) const {
+        return floodRequestsPerS > 0 && s >= floodStartS && s < floodEndS ? floodRequestsPerS : requestsPerS;
+    }
+};
+const Scenario QUIET = {"quiet", 0.5f, 0, 0, 0, 0.0f};
+const Scenario FLOOD = {"flood", 0.5f, 10, 40, 40, 0.0f};
+const Scenario FLAKY_AP = {"flaky-ap", 0.5f, 0, 0, 0, 0.6f};
+const Scenario FLOOD_FLAKY_AP = {"flood+flaky-ap", 2.0f, 10, 40, 25, 0.6f};
+
+struct Result {
+    int passes;
+    int misses;     // Started late
+    int overruns;   // Ran over LOOP_BUDGET_MS
+    std::map<std::string, int> blame;
+    LoadShedder::Snapshot shed;
+    int served;
+    int left;
+    float p99WaitMs;
+
+    int missed() const { return misses + overruns; }
+};
+
+Result simulate(const Scenario& scenario, bool shedding) {
+    std::mt19937 rng(SEED);
+    std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+    LoadShedder shedder;
+    Result result = {};
+
+    std::deque<std::pair<int32_t, const char*>> bursts;   // us left, source
+    const char* lastBurst = nullptr;                       // For blame
+    std::deque<int64_t> waiting;                           // Arrival times of requests not yet served
+    std::vector<int64_t> waits;
+
+    // loop()
+    bool loopReady = true;
+    bool inPass = false;
+    bool passMissed = false;
+    int32_t passLeftUs = 0;
+    int64_t passStart = 0;
+    int64_t nextPass = 0;
+
+    // Network task
+    std::deque<NetJob> jobs;
+    int64_t netWake = 0;
+    int64_t lastServeMs = -(int64_t)LampConfig::SHED_SERVER_INTERVAL_MS;
+    int64_t nextReportMs = LampConfig::REPORTING_INTERVAL_MS;
+    bool reportPending = false;
+    int64_t deferredSinceMs = -1;
+
+    bool netRunning = false;
+    for (int64_t t = 0; t < SIMULATED_S * 1000000; t += STEP_US) {
+        int64_t nowMs = t / 1000;
+        if (chance(rng) < scenario.rate(t / 1e6f) * STEP_US / 1e6f) {
+            waiting.push_back(t);
+        }
+        if (nowMs >= nextReportMs) {
+            reportPending = true;
+            nextReportMs += LampConfig::REPORTING_INTERVAL_MS;
+        }
+
+        // Network task wake-up, planned like NetworkManager::service()
+        if (jobs.empty() && t >= netWake) {
+            bool throttled = shedder.sheds(ShedLevel::THROTTLE_SERVER);
+            if (!waiting.empty() && (!throttled || nowMs - lastServeMs >= (int64_t)LampConfig::SHED_SERVER_INTERVAL_MS)) {
+                lastServeMs = nowMs;
+                waits.push_back(t - waiting.front());
+                waiting.pop_front();
+                jobs.push_back(REQUEST);
+            }
+            if (reportPending) {
+                bool defer = shedder.sheds(ShedLevel::DEFER_TELEMETRY);
+                if (defer && deferredSinceMs < 0) {
+                    deferredSinceMs = nowMs;
+                }
+                if (!defer || nowMs - deferredSinceMs >= (int64_t)LampConfig::SHED_MAX_TELEMETRY_DEFER_MS) {
+                    deferredSinceMs = -1;
+                    reportPending = false;
+                    int attempts = 1;
+                    while (attempts < 4 && chance(rng) < scenario.connectFailures) {
+                        attempts++;
+                    }
+                    jobs.insert(jobs.end(), attempts, CONNECT);
+                    jobs.push_back(POST);
+                }
+            }
+            netWake = t + LampConfig::NETWORK_TASK_INTERVAL_MS * 1000;
+        }
+
+        // High-priority work always runs first
+        if (!bursts.empty()) {
+            lastBurst = bursts.front().second;
+            bursts.front().first -= STEP_US;
+            if (bursts.front().first <= 0) {
+                bursts.pop_front();
+            }
+            continue;
+        }
+
+        // loop() and the network task take turns on the tick, or when one has nothing to do
+        bool netReady = !jobs.empty();
+        if (t % TICK_US == 0 || (netRunning ? !netReady : !loopReady)) {
+            if (netRunning ? loopReady : netReady) {
+                netRunning = !netRunning;
+            } else if (!(netRunning ? netReady : loopReady)) {
+                netRunning = netReady;
+            }
+        }
+
+        if (!netRunning && loopReady) {
+            if (!inPass) {
+                inPass = true;
+                passStart = t;
+                passMissed = result.passes > 0 && t - nextPass > (int64_t)LampConfig::LOOP_DEADLINE_SLACK_MS * 1000;
+                if (passMissed) {
+                    result.misses++;
+                    result.blame[lastBurst ? lastBurst : "other"]++;
+                }
+                lastBurst = nullptr;
+                bool animating = !shedder.sheds(ShedLevel::SUSPEND_ANIMATIONS);
+                passLeftUs = LOOP_WORK_US + (animating ? ANIMATION_US : 0);
+            }
+            passLeftUs -= STEP_US;
+            if (passLeftUs <= 0) {
+                if (t + STEP_US - passStart > (int64_t)LampConfig::LOOP_BUDGET_MS * 1000) {
+                    result.overruns++;
+                    result.blame[lastBurst ? lastBurst : "lamp"]++;
+                    passMissed = true;
+                }
+                result.passes++;
+                if (shedding) {
+                    shedder.update(passMissed, (unsigned long)nowMs);
+                }
+                nextPass = t + STEP_US + LOOP_SLEEP_MS * 1000;
+                loopReady = false;
+                inPass = false;
+            }
+        } else if (netRunning && netReady) {
+            NetJob& job = jobs.front();
+            if (job.burstUs > 0) {
+                bursts.push_back({job.burstUs, job.source});
+                job.burstUs = 0;
+            } else if ((job.taskUs -= STEP_US) <= 0) {
+                jobs.pop_front();
+            }
+        }
+
+        if (!loopReady && t + STEP_US >= nextPass) {
+            loopReady = true;
+        }
+    }
+
+    result.shed = shedder.read();
+    result.served = (int)waits.size();
+    result.left = (int)waiting.size();
+    std::sort(waits.begin(), waits.end());
+    result.p99WaitMs = waits.empty() ? 0.0f : waits[waits.size() * 99 / 100] / 1000.0f;
+    return result;
+}
+
+void report(const Scenario& scenario, const Result& off, const Result& on) {
+    printf("  %s\n", scenario.name);
+    const Result* runs[] = {&off, &on};
+    for (const Result* run : runs) {
+        std::string blame;
+        for (const auto& entry : run->blame) {
+            blame += (blame.empty() ? "" : ", ") + entry.first + " " + std::to_string(entry.second);
+        }
+        printf("    shedding %-3s %4d misses %3d overruns in %d passes, blame: %s\n", run == &on ? "on" : "off",
+               run->misses, run->overruns, run->passes, blame.empty() ? "-" : blame.c_str());
+        printf("                 requests served %d (p99 wait %.0f ms, %d left)\n", run->served, run->p99WaitMs,
+               run->left);
+    }
+    uint32_t totalMs = 0;
+    for (uint32_t ms : on.shed.msAtLevel) {
+        totalMs += ms;
+    }
+    std::string levels;
+    for (int level = 0; level < (int)ShedLevel::COUNT; level++) {
+        if (on.shed.msAtLevel[level] > 0) {
+            char part[64];
+            snprintf(part, sizeof(part), "%s%s %u%%", levels.empty() ? "" : ", ", LoadShedder::levelName((ShedLevel)level),
+                     on.shed.msAtLevel[level] * 100 / std::max(totalMs, 1u));
+            levels += part;
+        }
+    }
+    printf("                 time at level: %s; raised %u times\n", levels.c_str(), on.shed.raises);
+}
+
+// Windows of misses from nowMs on, one update per pass; returns the time after them
+unsigned long runWindows(LoadShedder& shedder, unsigned long nowMs, int windows, int missesPerWindow) {
+    for (int w = 0; w < windows; w++) {
+        for (int i = 0; i < missesPerWindow; i++) {
+            shedder.update(true, nowMs + 10 + i);
+        }
+        nowMs += LampConfig::SHED_WINDOW_MS;
+        shedder.update(false, nowMs);
+    }
+    return nowMs;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_missed_window_sheds_one_level() {
+    LoadShedder shedder;
+    unsigned long now = runWindows(shedder, 0, 1, LampConfig::SHED_RAISE_MISSES - 1);
+    TEST_ASSERT_EQUAL((int)ShedLevel::NONE, (int)shedder.getLevel());
+
+    runWindows(shedder, now, 1, LampConfig::SHED_RAISE_MISSES);
+    TEST_ASSERT_EQUAL((int)ShedLevel::DEFER_TELEMETRY, (int)shedder.getLevel());
+    TEST_ASSERT_TRUE(shedder.sheds(ShedLevel::DEFER_TELEMETRY));
+    TEST_ASSERT_FALSE(shedder.sheds(ShedLevel::THROTTLE_SERVER));
+    LoadShedder::Snapshot stats = shedder.read();
+    TEST_ASSERT_EQUAL_UINT32(1, stats.raises);
+    TEST_ASSERT_EQUAL_UINT32(2 * LampConfig::SHED_WINDOW_MS, stats.msAtLevel[(int)ShedLevel::NONE]);
+}
+
+void test_level_stops_at_suspend_animations() {
+    LoadShedder shedder;
+    runWindows(shedder, 0, 10, LampConfig::SHED_RAISE_MISSES);
+    TEST_ASSERT_EQUAL((int)ShedLevel::SUSPEND_ANIMATIONS, (int)shedder.getLevel());
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)ShedLevel::COUNT - 1, shedder.read().raises);
+}
+
+void test_clean_windows_restore_one_level() {
+    LoadShedder shedder;
+    unsigned long now = runWindows(shedder, 0, 2, LampConfig::SHED_RAISE_MISSES);
+    TEST_ASSERT_EQUAL((int)ShedLevel::THROTTLE_SERVER, (int)shedder.getLevel());
+
+    // A single miss starts the count again
+    now = runWindows(shedder, now, LampConfig::SHED_RECOVER_WINDOWS - 1, 0);
+    now = runWindows(shedder, now, 1, 1);
+    now = runWindows(shedder, now, LampConfig::SHED_RECOVER_WINDOWS - 1, 0);
+    TEST_ASSERT_EQUAL((int)ShedLevel::THROTTLE_SERVER, (int)shedder.getLevel());
+    now = runWindows(shedder, now, 1, 0);
+    TEST_ASSERT_EQUAL((int)ShedLevel::DEFER_TELEMETRY, (int)shedder.getLevel());
+    runWindows(shedder, now, LampConfig::SHED_RECOVER_WINDOWS, 0);
+    TEST_ASSERT_EQUAL((int)ShedLevel::NONE, (int)shedder.getLevel());
+}
+
+void test_quiet_never_sheds() {
+    Result off = simulate(QUIET, false);
+    Result on = simulate(QUIET, true);
+    report(QUIET, off, on);
+    TEST_ASSERT_EQUAL_UINT32(0, on.shed.raises);
+    TEST_ASSERT_EQUAL(off.missed(), on.missed());
+}
+
+void test_flood_cuts_misses() {
+    const Scenario* floods[] = {&FLOOD, &FLOOD_FLAKY_AP};
+    for (const Scenario* scenario : floods) {
+        Result off = simulate(*scenario, false);
+        Result on = simulate(*scenario, true);
+        report(*scenario, off, on);
+        TEST_ASSERT_TRUE_MESSAGE(on.missed() * 10 <= off.missed() * 7, scenario->name);
+        TEST_ASSERT_TRUE_MESSAGE(on.shed.msAtLevel[(int)ShedLevel::SUSPEND_ANIMATIONS] > 0, scenario->name);
+    }
+}
+
+void test_flaky_ap_no_worse() {
+    // Association bursts can't be shed, only the reports behind them deferred
+    Result off = simulate(FLAKY_AP, false);
+    Result on = simulate(FLAKY_AP, true);
+    report(FLAKY_AP, off, on);
+    TEST_ASSERT_TRUE(on.missed() <= off.missed());
+    TEST_ASSERT_EQUAL(off.served, on.served);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_missed_window_sheds_one_level);
+    RUN_TEST(test_level_stops_at_suspend_animations);
+    RUN_TEST(test_clean_windows_restore_one_level);
+    RUN_TEST(test_quiet_never_sheds);
+    RUN_TEST(test_flood_cuts_misses);
+    RUN_TEST(test_flaky_ap_no_worse);
+    return UNITY_END();
+}
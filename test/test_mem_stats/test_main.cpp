@@ -0,0 +1,105 @@
+// Heap accounting on the host (pio test -e native; the per-subsystem
+// counters need the malloc wrappers of pio test -e native_bench)
+#include <unity.h>
+#include "HostDevice.h"
+#include "diag/MemStats.h"
+#include <atomic>
+#include <string>
+#include <thread>
+
+const size_t LEAK_BYTES = 64 * 1024;
+const int CHURN_ROUNDS = 20000;
+
+// Through a volatile pointer so the optimiser keeps the pair
+void churn(size_t bytes) {
+    void* volatile block = malloc(bytes);
+    free(block);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_free_heap_follows_leak() {
+    uint32_t before = ESP.getFreeHeap();
+    volatile char* leak = (volatile char*)malloc(LEAK_BYTES);
+    leak[0] = 1;
+    uint32_t during = ESP.getFreeHeap();
+    TEST_ASSERT_UINT32_WITHIN(LEAK_BYTES / 8, before - LEAK_BYTES, during);
+    TEST_ASSERT_TRUE(ESP.getMaxAllocHeap() <= during);
+
+    free((void*)leak);
+    TEST_ASSERT_UINT32_WITHIN(LEAK_BYTES / 8, before, ESP.getFreeHeap());
+    // The low-water mark keeps the peak
+    TEST_ASSERT_TRUE(ESP.getMinFreeHeap() <= during);
+
+    String json = MemStats::json();
+    TEST_ASSERT_TRUE(strstr(json.c_str(), "\"minFreeHeap\":") != nullptr);
+    std::string report;
+    HostDevice::current().serialCapture = &report;
+    MemStats::printReport();
+    HostDevice::current().serialCapture = nullptr;
+    TEST_ASSERT_TRUE(report.find("Heap: ") != std::string::npos);
+}
+
+void test_scope_charges_subsystem() {
+    if (!MEM_STATS) {
+        TEST_IGNORE_MESSAGE("needs the malloc wrappers (native_bench)");
+    }
+    MemStats::registerTask(MemTag::LAMP, "test");
+    MemStats::TagCounters lampBefore = MemStats::read(MemTag::LAMP);
+    MemStats::TagCounters otaBefore = MemStats::read(MemTag::OTA);
+    {
+        MemStats::Scope scope(MemTag::OTA);
+        churn(1000);
+    }
+    MemStats::TagCounters lampAfter = MemStats::read(MemTag::LAMP);
+    MemStats::TagCounters otaAfter = MemStats::read(MemTag::OTA);
+    TEST_ASSERT_EQUAL_UINT32(otaBefore.allocations + 1, otaAfter.allocations);
+    TEST_ASSERT_EQUAL_UINT32(otaBefore.frees + 1, otaAfter.frees);
+    TEST_ASSERT_EQUAL(otaBefore.netBytes, otaAfter.netBytes);
+    TEST_ASSERT_TRUE(otaAfter.peakBytes >= otaBefore.netBytes + 1000);
+    TEST_ASSERT_EQUAL_UINT32(lampBefore.allocations, lampAfter.allocations);
+}
+
+void test_scope_while_other_task_allocates() {
+    // One task switches scopes while another allocates; every allocation
+    // must be matched by a free in the same subsystem
+    if (!MEM_STATS) {
+        TEST_IGNORE_MESSAGE("needs the malloc wrappers (native_bench)");
+    }
+    std::atomic<bool> registered{false};
+    std::thread network([&]() {
+        MemStats::registerTask(MemTag::NETWORK, "network");
+        registered = true;
+        for (int i = 0; i < CHURN_ROUNDS; i++) {
+            churn(32 + i % 64);
+            if (i % 64 == 0) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    while (!registered) {
+        std::this_thread::yield();
+    }
+    MemStats::TagCounters telemetryBefore = MemStats::read(MemTag::TELEMETRY);
+    for (int i = 0; i < CHURN_ROUNDS; i++) {
+        MemStats::Scope scope(MemTag::TELEMETRY);
+        churn(48);
+    }
+    network.join();
+
+    MemStats::TagCounters networkAfter = MemStats::read(MemTag::NETWORK);
+    MemStats::TagCounters telemetryAfter = MemStats::read(MemTag::TELEMETRY);
+    TEST_ASSERT_EQUAL_UINT32(networkAfter.allocations, networkAfter.frees);
+    TEST_ASSERT_EQUAL(0, networkAfter.netBytes);
+    TEST_ASSERT_EQUAL_UINT32(telemetryBefore.allocations + CHURN_ROUNDS, telemetryAfter.allocations);
+    TEST_ASSERT_EQUAL(telemetryBefore.netBytes, telemetryAfter.netBytes);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_free_heap_follows_leak);
+    RUN_TEST(test_scope_charges_subsystem);
+    RUN_TEST(test_scope_while_other_task_allocates);
+    return UNITY_END();
+}
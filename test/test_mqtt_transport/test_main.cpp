@@ -0,0 +1,371 @@
+// MqttTransport through the host PubSubClient against mqtt_broker.py
+// (pio test -e native_mqtt, which builds with TELEMETRY_MQTT). The broker
+// runs as a python3 child on a free port and writes its CSVs to a temp dir;
+// brightness commands go to it on stdin like they would from a terminal.
+#include <unity.h>
+#include "HostDevice.h"
+#include "network/MqttTransport.h"
+#include <HTTPClient.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+
+const int BROKER_START_TIMEOUT_MS = 10000;
+const unsigned long DELIVERY_TIMEOUT_MS = 3000;
+
+// Bytes the lamp and data_server.py exchange for one report: the reply is
+// what Flask sends for /api/log, the same one mqtt_broker.py --selftest models
+const char* const HTTP_REPLY =
+    "HTTP/1.1 200 OK\r\nServer: Werkzeug/3.0.1 Python/3.11.6\r\n"
+    "Date: Sat, 18 Oct 2026 12:00:00 GMT\r\nContent-Type: application/json\r\n"
+    "Content-Length: 60\r\nConnection: close\r\n\r\n"
+    "{\"message\":\"Data logged successfully\",\"status\":\"success\"}\n";
+
+struct Broker {
+    pid_t pid = -1;
+    int commands = -1;   // The broker's stdin
+    int output = -1;
+    int port = 0;
+    std::string dataDir;
+
+    bool start() {
+        char dir[] = "/tmp/mqtt_transport_XXXXXX";
+        if (!mkdtemp(dir)) {
+            return false;
+        }
+        dataDir = dir;
+        int in[2], out[2];
+        if (pipe(in) != 0 || pipe(out) != 0) {
+            return false;
+        }
+        pid = fork();
+        if (pid == 0) {
+            dup2(in[0], 0);
+            dup2(out[1], 1);
+            close(in[1]);
+            close(out[0]);
+            execlp("python3", "python3", "mqtt_broker.py", "--port", "0", "--data-dir", dir, (char*)nullptr);
+            _exit(127);
+        }
+        close(in[0]);
+        close(out[1]);
+        commands = in[1];
+        output = out[0];
+
+        // "MQTT broker on port <n>; ..."
+        std::string line;
+        char c;
+        pollfd ready = {output, POLLIN, 0};
+        while (line.find('\n') == std::string::npos && poll(&ready, 1, BROKER_START_TIMEOUT_MS) == 1 &&
+               ::read(output, &c, 1) == 1) {
+            line += c;
+        }
+        return sscanf(line.c_str(), "MQTT broker on port %d", &port) == 1;
+    }
+
+    void command(const std::string& deviceId, int brightness) {
+        std::string line = deviceId + " " + std::to_string(brightness) + "\n";
+        TEST_ASSERT_EQUAL((int)line.size(), (int)write(commands, line.data(), line.size()));
+    }
+
+    // Rows the broker has written for a lamp, header excluded
+    std::vector<std::string> rows(const std::string& deviceId) {
+        std::vector<std::string> lines;
+        FILE* file = fopen((dataDir + "/" + deviceId + ".csv").c_str(), "r");
+        if (!file) {
+            return lines;
+        }
+        char line[256];
+        while (fgets(line, sizeof(line), file)) {
+            lines.push_back(line);
+        }
+        fclose(file);
+        if (!lines.empty()) {
+            lines.erase(lines.begin());
+        }
+        return lines;
+    }
+
+    void stop() {
+        if (pid > 0) {
+            close(commands);   // The broker exits at the end of stdin
+            kill(pid, SIGTERM);
+            waitpid(pid, nullptr, 0);
+            close(output);
+        }
+        if (!dataDir.empty()) {
+            std::string remove = "rm -rf " + dataDir;
+            (void)system(remove.c_str());
+        }
+    }
+};
+
+Broker broker;
+bool brokerRunning = false;
+uint64_t nextMac = 0x0000A1B2C3D40000ULL;
+
+// A lamp with its radio associated and its own MQTT client id. Its clock is
+// virtual so a reconnect can skip MQTT_RETRY_MS; the broker runs in real time.
+struct Lamp {
+    HostDevice device;
+    LampController lamp;
+    MqttTransport mqtt;
+    std::string id;
+
+    Lamp() {
+        device.serialMuted = true;
+        device.useVirtualClock(1000000);
+        device.associationMs = 0;
+        device.efuseMac = nextMac++;
+        device.brokerPort = broker.port;
+        device.setKnob(Board::DIMMER_ANALOG_PIN, 0.3f);
+        device.setPackVoltage(Board::VOLTAGE_PIN, 11.5f, LampConfig::VOLTAGE_DIVIDER_RATIO);
+        HostDevice::select(&device);
+        lamp.begin();
+        mqtt.begin(lamp);
+        WiFi.begin("test");
+        char text[17];
+        snprintf(text, sizeof(text), "%016llX", (unsigned long long)lamp.getSerialNumber());
+        id = text;
+    }
+
+    ~Lamp() {
+        HostDevice::select(nullptr);
+    }
+
+    String report(int position) {
+        char text[96];
+        snprintf(text, sizeof(text), "{\"device_id\":\"%s\",\"voltage\":11.40,\"position\":%d.0}", id.c_str(), position);
+        return String(text);
+    }
+};
+
+// Real time until done() or timeoutMs
+template <typename Done>
+bool waitFor(Done done, unsigned long timeoutMs) {
+    for (unsigned long waited = 0; !done() && waited < timeoutMs; waited += 10) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return done();
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_queue_overflow() {
+    // No session: reports queue up, the oldest make room for new ones
+    Lamp lamp;
+    lamp.device.brokerPort = -1;
+    for (int i = 0; i < LampConfig::MQTT_BATCH_SIZE - 1; i++) {
+        lamp.mqtt.enqueue(lamp.report(i));
+    }
+    TEST_ASSERT_FALSE(lamp.mqtt.batchReady());
+    for (int i = LampConfig::MQTT_BATCH_SIZE - 1; i < LampConfig::MQTT_QUEUE_SIZE + 3; i++) {
+        lamp.mqtt.enqueue(lamp.report(i));
+    }
+    TEST_ASSERT_TRUE(lamp.mqtt.batchReady());
+    TEST_ASSERT_EQUAL_UINT32(3, lamp.mqtt.getDropped());
+
+    // Too big for a queue slot
+    lamp.mqtt.enqueue(String(std::string(LampConfig::MQTT_SAMPLE_SIZE, 'x').c_str()));
+    TEST_ASSERT_EQUAL_UINT32(4, lamp.mqtt.getDropped());
+
+    TEST_ASSERT_FALSE(lamp.mqtt.loop());
+    TEST_ASSERT_FALSE(lamp.mqtt.flush());
+}
+
+void test_batches_and_flush() {
+    // Once connected the whole queue goes out in batches, newest reports kept
+    if (!brokerRunning) {
+        TEST_IGNORE_MESSAGE("python3 mqtt_broker.py did not start");
+    }
+    Lamp lamp;
+    const int reports = LampConfig::MQTT_QUEUE_SIZE + 3;
+    for (int i = 0; i < reports; i++) {
+        lamp.mqtt.enqueue(lamp.report(i));
+    }
+    TEST_ASSERT_TRUE(lamp.mqtt.loop());
+    TEST_ASSERT_TRUE(lamp.mqtt.flush());
+    TEST_ASSERT_TRUE(waitFor([&]() { return (int)broker.rows(lamp.id).size() >= LampConfig::MQTT_QUEUE_SIZE; },
+                             DELIVERY_TIMEOUT_MS));
+    std::vector<std::string> rows = broker.rows(lamp.id);
+    TEST_ASSERT_EQUAL(LampConfig::MQTT_QUEUE_SIZE, (int)rows.size());
+    TEST_ASSERT_TRUE(rows.front().find(",3.0") != std::string::npos);
+    TEST_ASSERT_TRUE(rows.back().find("," + std::to_string(reports - 1) + ".0") != std::string::npos);
+
+    // Nothing left to send
+    lamp.mqtt.enqueue(lamp.report(100));
+    TEST_ASSERT_TRUE(lamp.mqtt.flush());
+    TEST_ASSERT_TRUE(waitFor([&]() { return (int)broker.rows(lamp.id).size() == LampConfig::MQTT_QUEUE_SIZE + 1; },
+                             DELIVERY_TIMEOUT_MS));
+    lamp.mqtt.disconnect();
+}
+
+void test_command_while_offline() {
+    // The persistent session holds a brightness command sent while the radio was off
+    if (!brokerRunning) {
+        TEST_IGNORE_MESSAGE("python3 mqtt_broker.py did not start");
+    }
+    Lamp lamp;
+    TEST_ASSERT_TRUE(lamp.mqtt.loop());
+    lamp.mqtt.disconnect();
+    WiFi.disconnect(true);
+
+    broker.command(lamp.id, 40);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    WiFi.begin("test");
+    lamp.device.advanceMs(LampConfig::MQTT_RETRY_MS);
+    TEST_ASSERT_TRUE(lamp.mqtt.loop());
+    // waitForCommands() runs on the virtual clock, so keep calling it until
+    // the broker's redelivery has arrived in real time
+    TEST_ASSERT_TRUE(waitFor([&]() {
+        lamp.mqtt.waitForCommands(LampConfig::MQTT_COMMAND_WAIT_MS);
+        lamp.lamp.update();
+        return fabsf(lamp.lamp.getStatus().brightness - 40.0f) < 0.5f;
+    }, DELIVERY_TIMEOUT_MS));
+    lamp.mqtt.disconnect();
+}
+
+void test_will_when_dropped() {
+    // Status is "online" while connected. A clean disconnect leaves
+    // "offline"; so does the will when the radio drops under the session.
+    if (!brokerRunning) {
+        TEST_IGNORE_MESSAGE("python3 mqtt_broker.py did not start");
+    }
+    Lamp lamp;
+    HostDevice watcherDevice;
+    watcherDevice.associationMs = 0;
+    watcherDevice.brokerPort = broker.port;
+    WiFiClient watcherSocket;
+    PubSubClient watcher(watcherSocket);
+    std::string status;
+    watcher.setServer("broker", (uint16_t)broker.port);
+    watcher.setCallback([&](char* topic, uint8_t* payload, unsigned int length) {
+        (void)topic;
+        status.assign((const char*)payload, length);
+    });
+    HostDevice::select(&watcherDevice);
+    WiFi.begin("test");
+    TEST_ASSERT_TRUE(watcher.connect("watcher"));
+    TEST_ASSERT_TRUE(watcher.subscribe(("lamp/" + lamp.id + "/status").c_str(), 1));
+    HostDevice::select(&lamp.device);
+    auto sees = [&](const char* expected) {
+        return waitFor([&]() { watcher.loop(); return status == expected; }, DELIVERY_TIMEOUT_MS);
+    };
+
+    TEST_ASSERT_TRUE(lamp.mqtt.loop());
+    TEST_ASSERT_TRUE(sees("online"));
+    lamp.mqtt.disconnect();
+    TEST_ASSERT_TRUE(sees("offline"));
+
+    lamp.device.advanceMs(LampConfig::MQTT_RETRY_MS);
+    TEST_ASSERT_TRUE(lamp.mqtt.loop());
+    TEST_ASSERT_TRUE(sees("online"));
+    WiFi.disconnect(true);
+    lamp.mqtt.enqueue(lamp.report(0));
+    TEST_ASSERT_FALSE(lamp.mqtt.flush());   // Finds the session gone
+    TEST_ASSERT_TRUE(sees("offline"));
+    watcher.disconnect();
+}
+
+// One report POSTed the way NetworkManager::sendDataToServer() does, to a
+// server that answers like data_server.py; returns the bytes both ways, or
+// 0 if the POST failed
+uint64_t httpReportBytes(Lamp& lamp, const String& report) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    bind(listener, (sockaddr*)&address, sizeof(address));
+    listen(listener, 1);
+    getsockname(listener, (sockaddr*)&address, &length);
+    std::thread server([listener]() {
+        int fd = accept(listener, nullptr, nullptr);
+        std::string request;
+        char chunk[1024];
+        ssize_t received;
+        size_t headEnd;
+        int contentLength = 0;
+        while ((headEnd = request.find("\r\n\r\n")) == std::string::npos ||
+               request.size() < headEnd + 4 + (size_t)contentLength) {
+            if ((received = recv(fd, chunk, sizeof(chunk), 0)) <= 0) {
+                break;
+            }
+            request.append(chunk, (size_t)received);
+            size_t field = request.find("Content-Length: ");
+            if (field != std::string::npos) {
+                contentLength = atoi(request.c_str() + field + 16);
+            }
+        }
+        send(fd, HTTP_REPLY, strlen(HTTP_REPLY), MSG_NOSIGNAL);
+        close(fd);
+    });
+
+    lamp.device.serverPort = ntohs(address.sin_port);
+    uint64_t before = lamp.device.tcpBytesSent + lamp.device.tcpBytesReceived;
+    HTTPClient http;
+    http.begin("http://" + String(LampConfig::DEFAULT_LOGGING_SERVER_IP) + ":" +
+               String(LampConfig::DEFAULT_LOGGING_SERVER_PORT) + "/api/log");
+    http.addHeader("Content-Type", "application/json");
+    int code = http.POST(report);
+    http.getString();
+    http.end();
+    server.join();
+    close(listener);
+    return code != 200 ? 0 : lamp.device.tcpBytesSent + lamp.device.tcpBytesReceived - before;
+}
+
+void test_bytes_per_report() {
+    // Application bytes on the lamp's sockets (no TCP/IP headers): an HTTP
+    // POST per report against a batch per radio-on window, and against
+    // publishing over a session that is already open
+    if (!brokerRunning) {
+        TEST_IGNORE_MESSAGE("python3 mqtt_broker.py did not start");
+    }
+    Lamp lamp;
+    String report = lamp.report(50);
+    uint64_t http = httpReportBytes(lamp, report);
+    TEST_ASSERT_TRUE(http > 0);
+
+    uint64_t before = lamp.device.tcpBytesSent + lamp.device.tcpBytesReceived;
+    TEST_ASSERT_TRUE(lamp.mqtt.loop());
+    for (int i = 0; i < LampConfig::MQTT_BATCH_SIZE; i++) {
+        lamp.mqtt.enqueue(report);
+    }
+    uint64_t sessionBefore = lamp.device.tcpBytesSent + lamp.device.tcpBytesReceived;
+    TEST_ASSERT_TRUE(lamp.mqtt.flush());
+    uint64_t session = lamp.device.tcpBytesSent + lamp.device.tcpBytesReceived - sessionBefore;
+    lamp.mqtt.disconnect();
+    uint64_t window = lamp.device.tcpBytesSent + lamp.device.tcpBytesReceived - before;
+
+    printf("  report %u B: HTTP POST %llu B/report, MQTT per batch window %llu B/report, open session %llu B/report\n",
+           report.length(), (unsigned long long)http,
+           (unsigned long long)(window / LampConfig::MQTT_BATCH_SIZE),
+           (unsigned long long)(session / LampConfig::MQTT_BATCH_SIZE));
+    TEST_ASSERT_TRUE(window / LampConfig::MQTT_BATCH_SIZE * 2 < http);
+    TEST_ASSERT_TRUE(session / LampConfig::MQTT_BATCH_SIZE < report.length() + 10);
+}
+
+int main() {
+    brokerRunning = broker.start();
+    UNITY_BEGIN();
+    RUN_TEST(test_queue_overflow);
+    RUN_TEST(test_batches_and_flush);
+    RUN_TEST(test_command_while_offline);
+    RUN_TEST(test_will_when_dropped);
+    RUN_TEST(test_bytes_per_report);
+    int failures = UNITY_END();
+    broker.stop();
+    return failures;
+}
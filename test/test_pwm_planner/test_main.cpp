@@ -0,0 +1,163 @@
+// PwmPlanner phase offsets and the LEDC timers the outputs hop (pio test -e native)
+// Build with -D PWM_FREQ_JITTER=true to check the jittered channel layout too.
+#include <unity.h>
+#include "HostDevice.h"
+#include "lamp/OutputStage.h"
+#include "lamp/PwmPlanner.h"
+#include <math.h>
+#include <vector>
+
+const uint32_t PERIOD = 1UL << LampConfig::PWM_RESOLUTION;
+const float PACK_RESISTANCE_OHMS = 0.15f;   // Cells + wiring, for the sag estimate
+
+struct Load {
+    float duty;   // 0-1
+    float amps;   // Current when fully on
+};
+
+HostDevice* device;
+
+void setUp() {
+    device = new HostDevice();
+    device->useVirtualClock();
+    HostDevice::select(device);
+}
+
+void tearDown() {
+    HostDevice::select(nullptr);
+    delete device;
+}
+
+uint32_t toTicks(float duty) {
+    return min((uint32_t)lroundf(duty * (PERIOD - 1)), PERIOD - 1);
+}
+
+// Supply current over one period, one entry per tick
+std::vector<float> waveform(const Load* loads, const uint32_t* hpoints, int count) {
+    std::vector<float> current(PERIOD, 0.0f);
+    for (int i = 0; i < count; i++) {
+        uint32_t duty = toTicks(loads[i].duty);
+        for (uint32_t tick = hpoints[i]; tick < hpoints[i] + duty; tick++) {
+            current[tick % PERIOD] += loads[i].amps;
+        }
+    }
+    return current;
+}
+
+float peakOf(const std::vector<float>& current) {
+    float peak = 0.0f;
+    for (float c : current) {
+        peak = max(peak, c);
+    }
+    return peak;
+}
+
+float rmsOf(const std::vector<float>& current) {
+    double sum = 0.0;
+    for (float c : current) {
+        sum += (double)c * c;
+    }
+    return (float)sqrt(sum / current.size());
+}
+
+// Lamp outputs plan from 0, the status LED half a period later, as on the lamp
+void planLamp(const Load* lamp, int lampCount, const Load* led, int ledCount, uint32_t* hpoints) {
+    uint32_t duties[8];
+    for (int i = 0; i < lampCount + ledCount; i++) {
+        duties[i] = toTicks(i < lampCount ? lamp[i].duty : led[i - lampCount].duty);
+    }
+    PwmPlanner::plan(duties, hpoints, lampCount, 0);
+    PwmPlanner::plan(duties + lampCount, hpoints + lampCount, ledCount, PERIOD / 2);
+}
+
+void test_on_times_never_wrap() {
+    uint32_t state = 1;
+    for (int round = 0; round < 1000; round++) {
+        uint32_t duties[5];
+        uint32_t hpoints[5];
+        for (int i = 0; i < 5; i++) {
+            state = state * 1664525UL + 1013904223UL;
+            duties[i] = (state >> 8) % (PERIOD + 1);
+        }
+        PwmPlanner::plan(duties, hpoints, 5, (state >> 4) % PERIOD);
+        for (int i = 0; i < 5; i++) {
+            TEST_ASSERT_LESS_OR_EQUAL_UINT32(PERIOD, hpoints[i] + duties[i]);
+        }
+    }
+}
+
+void test_channels_follow_each_other() {
+    // Two 30% channels fit back to back without overlap
+    uint32_t duties[2] = {toTicks(0.3f), toTicks(0.3f)};
+    uint32_t hpoints[2];
+    PwmPlanner::plan(duties, hpoints, 2, 0);
+    TEST_ASSERT_EQUAL_UINT32(0, hpoints[0]);
+    TEST_ASSERT_EQUAL_UINT32(duties[0], hpoints[1]);
+
+    // A single channel has nothing to stagger against
+    PwmPlanner::plan(duties, hpoints, 1, 0);
+    TEST_ASSERT_EQUAL_UINT32(0, hpoints[0]);
+}
+
+void test_stagger_lowers_peak() {
+    // Tunable-white fixture at 60% plus the status LED at RGB_BRIGHTNESS_SCALE
+    const Load lamp[] = {{0.6f, 1.5f}, {0.6f, 1.5f}};
+    const Load led[] = {{0.2f, 0.02f}, {0.2f, 0.02f}, {0.2f, 0.02f}};
+    uint32_t aligned[5] = {};
+    uint32_t staggered[5];
+    planLamp(lamp, 2, led, 3, staggered);
+
+    std::vector<float> before = waveform(lamp, aligned, 2);
+    std::vector<float> after = waveform(lamp, staggered, 2);
+    std::vector<float> ledAligned = waveform(led, aligned, 3);
+    std::vector<float> ledStaggered = waveform(led, staggered + 2, 3);
+    for (uint32_t tick = 0; tick < PERIOD; tick++) {
+        before[tick] += ledAligned[tick];
+        after[tick] += ledStaggered[tick];
+    }
+    printf("  aligned   peak %.3f A, rms %.3f A, sag %.0f mV\n",
+           peakOf(before), rmsOf(before), peakOf(before) * PACK_RESISTANCE_OHMS * 1000.0f);
+    printf("  staggered peak %.3f A, rms %.3f A, sag %.0f mV\n",
+           peakOf(after), rmsOf(after), peakOf(after) * PACK_RESISTANCE_OHMS * 1000.0f);
+    TEST_ASSERT_TRUE(peakOf(after) < peakOf(before));
+    TEST_ASSERT_TRUE(rmsOf(after) <= rmsOf(before));
+}
+
+void test_status_led_off_jittered_timers() {
+    // The status LED never shares a timer with an output whose frequency hops
+    const int ledChannels[] = {LampConfig::RGB_R_CHANNEL, LampConfig::RGB_G_CHANNEL, LampConfig::RGB_B_CHANNEL};
+    for (int i = 0; i < Board::OUTPUT_COUNT; i++) {
+        for (int led : ledChannels) {
+            TEST_ASSERT_NOT_EQUAL(led, OutputStage::ledcChannel(i));
+            if (PWM_FREQ_JITTER) {
+                TEST_ASSERT_NOT_EQUAL(HostDevice::ledcTimer(led), HostDevice::ledcTimer(OutputStage::ledcChannel(i)));
+            }
+        }
+    }
+
+    OutputStage output;
+    output.begin();
+    for (int led : ledChannels) {
+        ledcSetup(led, LampConfig::PWM_FREQ, LampConfig::PWM_RESOLUTION);
+    }
+    int ledTimer = HostDevice::ledcTimer(LampConfig::RGB_R_CHANNEL);
+    uint32_t resetsBefore = device->timerResets[ledTimer];
+    for (int hop = 0; hop < 20; hop++) {
+        device->advanceMs(LampConfig::PWM_JITTER_HOP_MS);
+        output.hopFrequency(millis());
+    }
+    int outputTimer = HostDevice::ledcTimer(OutputStage::ledcChannel(0));
+    TEST_ASSERT_EQUAL_UINT32(PWM_FREQ_JITTER ? 20 : 0, device->timerFrequencyChanges[outputTimer]);
+    TEST_ASSERT_EQUAL_UINT32(0, device->timerFrequencyChanges[ledTimer]);
+    TEST_ASSERT_EQUAL_UINT32(resetsBefore, device->timerResets[ledTimer]);
+    TEST_ASSERT_EQUAL_UINT32(LampConfig::PWM_FREQ, device->ledc[LampConfig::RGB_R_CHANNEL].freq);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_on_times_never_wrap);
+    RUN_TEST(test_channels_follow_each_other);
+    RUN_TEST(test_stagger_lowers_peak);
+    RUN_TEST(test_status_led_off_jittered_timers);
+    return UNITY_END();
+}
@@ -0,0 +1,280 @@
+// Replays touch pad traces through TouchBaseline and TouchGestures
+// (pio test -e native), and on a board with a touch pad through
+// LampController's interrupt and polling path as well (pio test -e native_touch)
+//
+// A trace in traces/ is "ms,raw" rows of pad readings, each holding until
+// the next row, or the "Touch trace <ms> <raw>" lines of a SERIAL_DEBUG log.
+// "# expect: TAP" lists the gestures it should give, "-" for none.
+#include <unity.h>
+#include "HostDevice.h"
+#include "lamp/LampController.h"
+#include "lamp/TouchGestures.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+const char* const TRACE_DIR = "test/test_touch_gestures/traces";
+const float KNOB = 0.5f;
+const float PACK_VOLTS = 11.5f;
+const float HOLD_MIN_CHANGE = 5.0f;    // Brightness (%) a hold in a trace must move
+const unsigned long SETTLE_MS = 2000;  // After the last sample, for a tap to resolve
+const int UNTOUCHED = 60;
+const int TOUCHED = 30;
+
+struct Sample {
+    unsigned long ms;
+    int raw;
+};
+
+struct Trace {
+    std::string name;
+    std::vector<Sample> samples;
+    std::string expected;   // Gesture names separated by spaces
+};
+
+Trace readTrace(const std::string& path) {
+    Trace trace;
+    trace.name = path.substr(path.rfind('/') + 1);
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file) {
+        return trace;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        unsigned long ms;
+        int raw;
+        const char* logged = strstr(line, "Touch trace ");
+        if (strncmp(line, "# expect:", 9) == 0) {
+            char expected[128] = "";
+            sscanf(line + 9, " %127[^\r\n]", expected);
+            trace.expected = strcmp(expected, "-") == 0 ? "" : expected;
+        } else if (sscanf(line, "%lu,%d", &ms, &raw) == 2 ||
+                   (logged && sscanf(logged, "Touch trace %lu %d", &ms, &raw) == 2)) {
+            trace.samples.push_back({ms, raw});
+        }
+    }
+    fclose(file);
+    return trace;
+}
+
+std::vector<Trace> traces() {
+    std::vector<std::string> paths;
+    DIR* dir = opendir(TRACE_DIR);
+    if (dir) {
+        while (struct dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.size() > 4 && (name.compare(name.size() - 4, 4, ".csv") == 0 ||
+                                    name.compare(name.size() - 4, 4, ".log") == 0)) {
+                paths.push_back(std::string(TRACE_DIR) + "/" + name);
+            }
+        }
+        closedir(dir);
+    }
+    std::sort(paths.begin(), paths.end());
+    std::vector<Trace> result;
+    for (const std::string& path : paths) {
+        result.push_back(readTrace(path));
+    }
+    return result;
+}
+
+const char* gestureName(TouchGesture gesture) {
+    switch (gesture) {
+        case TouchGesture::TAP: return "TAP";
+        case TouchGesture::DOUBLE_TAP: return "DOUBLE_TAP";
+        case TouchGesture::HOLD_START: return "HOLD_START";
+        default: return nullptr;   // HOLDING and HOLD_END follow every HOLD_START
+    }
+}
+
+// Every sample straight into the recognizer, as if each were a poll
+std::string recognize(const Trace& trace) {
+    TouchBaseline baseline;
+    int seed = 0;
+    size_t seedCount = std::min<size_t>(trace.samples.size(), 4);
+    for (size_t i = 0; i < seedCount; i++) {
+        seed += trace.samples[i].raw;
+    }
+    baseline.seed(seed / (int)seedCount);
+
+    TouchGestures gestures;
+    std::string found;
+    for (const Sample& sample : trace.samples) {
+        bool touched = baseline.isTouched(sample.raw);
+        if (gestures.isIdle() && !touched) {
+            baseline.update(sample.raw);
+        }
+        const char* name = gestureName(gestures.update(touched, sample.ms));
+        if (name) {
+            found += found.empty() ? name : std::string(" ") + name;
+        }
+    }
+    // A trailing tap resolves once the double tap window has passed
+    const char* name = gestureName(gestures.update(false, trace.samples.back().ms + SETTLE_MS));
+    if (name) {
+        found += found.empty() ? name : std::string(" ") + name;
+    }
+    return found;
+}
+
+// What the lamp did with a trace
+struct LampRun {
+    bool tapped;         // Battery status shown
+    bool switchedOff;
+    float brightnessChange;
+    unsigned long fastPasses;
+    unsigned long passes;
+};
+
+void prepare(HostDevice& device, int untouched) {
+    device.useVirtualClock();
+    device.serialMuted = true;
+    device.setKnob(Board::DIMMER_ANALOG_PIN, KNOB);
+    device.setPackVoltage(Board::VOLTAGE_PIN, PACK_VOLTS, LampConfig::VOLTAGE_DIVIDER_RATIO);
+    device.setTouch(untouched);
+}
+
+// Until the knob filter has caught up and the loop is in slow mode
+void settle(LampController& lamp) {
+    for (int i = 0; i < 1000 && (lamp.getSleepTime() != 100 || lamp.isFading()); i++) {
+        lamp.update();
+        lamp.checkTouchStatus();
+        delay(lamp.getSleepTime());
+    }
+    TEST_ASSERT_EQUAL(100, lamp.getSleepTime());
+    TEST_ASSERT_FALSE(lamp.isFading());
+}
+
+// The pad follows the trace in real time while loop()'s share of the lamp
+// runs at the cadence getSleepTime() asks for, on a virtual clock
+LampRun runLamp(HostDevice& device, const std::vector<Sample>& samples) {
+    prepare(device, samples.front().raw);
+    LampController lamp;
+    lamp.begin();
+    settle(lamp);
+    uint64_t startMs = millis();
+    auto pass = [&]() {
+        lamp.update();
+        lamp.checkTouchStatus();
+    };
+    float startBrightness = lamp.getStatus().brightness;
+    bool wasActive = lamp.isActive();
+
+    LampRun run = {false, false, 0.0f, 0, 0};
+    uint64_t wake = millis() + lamp.getSleepTime();
+    uint64_t end = startMs + samples.back().ms + SETTLE_MS;
+    size_t next = 0;
+    while (millis() < end) {
+        uint64_t sampleAt = next < samples.size() ? startMs + samples[next].ms : UINT64_MAX;
+        uint64_t at = std::min(sampleAt, wake);
+        if (at > millis()) {
+            device.advanceMs(at - millis());
+        }
+        if (at == sampleAt) {
+            device.setTouch(samples[next++].raw);
+            continue;
+        }
+        pass();
+        run.tapped |= lamp.isFading();
+        run.passes++;
+        run.fastPasses += lamp.getSleepTime() == 10 ? 1 : 0;
+        wake = millis() + lamp.getSleepTime();
+    }
+    // Holds stop at TOUCH_DIM_MIN; only a double tap goes to zero
+    run.switchedOff = wasActive && lamp.getStatus().brightness < LampConfig::TOUCH_DIM_MIN / 2;
+    run.brightnessChange = lamp.getStatus().brightness - startBrightness;
+    return run;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_traces_through_recognizer() {
+    int count = 0;
+    for (const Trace& trace : traces()) {
+        TEST_ASSERT_TRUE_MESSAGE(!trace.samples.empty(), trace.name.c_str());
+        std::string found = recognize(trace);
+        printf("  %-22s %-12s expected %s\n", trace.name.c_str(), found.empty() ? "-" : found.c_str(),
+               trace.expected.empty() ? "-" : trace.expected.c_str());
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(trace.expected.c_str(), found.c_str(), trace.name.c_str());
+        count++;
+    }
+    TEST_ASSERT_GREATER_THAN(0, count);
+}
+
+void test_traces_through_lamp() {
+    if (!BoardTouch::AVAILABLE) {
+        TEST_IGNORE_MESSAGE("board without a touch pad (native_touch)");
+    }
+    for (const Trace& trace : traces()) {
+        HostDevice device;
+        HostDevice::select(&device);
+        LampRun run = runLamp(device, trace.samples);
+        HostDevice::select(nullptr);
+        printf("  %-22s tap %d, off %d, brightness %+.0f%%, %lu of %lu passes fast\n", trace.name.c_str(),
+               run.tapped, run.switchedOff, run.brightnessChange, run.fastPasses, run.passes);
+
+        bool hold = trace.expected.find("HOLD_START") != std::string::npos;
+        bool doubleTap = trace.expected.find("DOUBLE_TAP") != std::string::npos;
+        bool tap = trace.expected == "TAP";
+        TEST_ASSERT_EQUAL_MESSAGE(tap, run.tapped, trace.name.c_str());
+        TEST_ASSERT_EQUAL_MESSAGE(doubleTap, run.switchedOff, trace.name.c_str());
+        TEST_ASSERT_EQUAL_MESSAGE(hold, !run.switchedOff && fabsf(run.brightnessChange) > HOLD_MIN_CHANGE,
+                                  trace.name.c_str());
+        // Without a touch the loop settles into slow mode
+        if (trace.expected.empty()) {
+            TEST_ASSERT_TRUE_MESSAGE(run.fastPasses < run.passes / 2, trace.name.c_str());
+        }
+    }
+}
+
+void test_short_tap_during_slow_pass() {
+    // A 60 ms tap that is over before the next 100 ms pass still counts:
+    // the press starts when the interrupt fired
+    if (!BoardTouch::AVAILABLE) {
+        TEST_IGNORE_MESSAGE("board without a touch pad (native_touch)");
+    }
+    HostDevice device;
+    HostDevice::select(&device);
+    prepare(device, UNTOUCHED);
+    LampController lamp;
+    lamp.begin();
+    settle(lamp);
+
+    lamp.update();
+    lamp.checkTouchStatus();
+    device.advanceMs(5);
+    device.setTouch(TOUCHED);
+    TEST_ASSERT_EQUAL(10, lamp.getSleepTime());
+    TEST_ASSERT_EQUAL(0, (int)lamp.getLightSleepMs());
+    device.advanceMs(60);
+    device.setTouch(UNTOUCHED);
+    device.advanceMs(35);
+
+    // The first pass sees the pad let go; fast passes follow until the
+    // double tap window is over
+    unsigned long released = millis();
+    bool tapped = false;
+    while (millis() - released < 1000 && !tapped) {
+        lamp.update();
+        lamp.checkTouchStatus();
+        tapped = lamp.isFading();
+        if (millis() - released < LampConfig::TOUCH_DOUBLE_TAP_MS) {
+            TEST_ASSERT_EQUAL(10, lamp.getSleepTime());
+        }
+        delay(lamp.getSleepTime());
+    }
+    TEST_ASSERT_TRUE(tapped);
+    HostDevice::select(nullptr);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_traces_through_recognizer);
+    RUN_TEST(test_traces_through_lamp);
+    RUN_TEST(test_short_tap_during_slow_pass);
+    return UNITY_END();
+}
@@ -0,0 +1,76 @@
+// Warm boot restore and time to light on the host (pio test -e native)
+#include <unity.h>
+#include "HostDevice.h"
+#include "lamp/LampController.h"
+
+const int ESP_RST_SW_REASON = 3;
+const int UPDATES_BEFORE_RESET = 20;
+
+HostDevice* device;
+
+void setUp() {
+    device = new HostDevice();
+    device->serialMuted = true;
+    device->setPackVoltage(Board::VOLTAGE_PIN, 11.5f, LampConfig::VOLTAGE_DIVIDER_RATIO);
+    HostDevice::select(device);
+}
+
+void tearDown() {
+    HostDevice::select(nullptr);
+    delete device;
+}
+
+// Runs a lamp at the knob position long enough to save its state, then
+// starts a fresh device as if after a software reset
+void runThenReset(float knob) {
+    {
+        LampController lamp;
+        device->setKnob(Board::DIMMER_ANALOG_PIN, knob);
+        lamp.begin();
+        for (int i = 0; i < UPDATES_BEFORE_RESET; i++) {
+            lamp.update();
+        }
+    }
+    tearDown();
+    setUp();
+    device->resetReason = ESP_RST_SW_REASON;
+    device->setKnob(Board::DIMMER_ANALOG_PIN, knob);
+}
+
+void test_begin_keeps_restored_output() {
+    // On the v1 board the blue status LED pin is the lamp output; the status
+    // LED setup in begin() must not blank the light restoreOutput() put back
+    runThenReset(0.6f);
+    LampController lamp;
+    TEST_ASSERT_TRUE(lamp.restoreOutput());
+    float restored = device->pinOutput(LampConfig::PWM_PIN);
+    TEST_ASSERT_TRUE(restored > 0.1f);
+
+    uint32_t detaches = device->pinDetaches[LampConfig::PWM_PIN];
+    lamp.begin();
+    TEST_ASSERT_EQUAL_UINT32(detaches, device->pinDetaches[LampConfig::PWM_PIN]);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, restored, device->pinOutput(LampConfig::PWM_PIN));
+    lamp.update();
+    TEST_ASSERT_TRUE(device->pinOutput(LampConfig::PWM_PIN) > 0.1f);
+    TEST_ASSERT_TRUE(lamp.getStatus().warmBoot);
+}
+
+void test_cold_boot_time_to_light_with_knob_off() {
+    // Timed to the first render, not to when the knob is turned up
+    LampController lamp;
+    device->setKnob(Board::DIMMER_ANALOG_PIN, 0.0f);
+    TEST_ASSERT_FALSE(lamp.restoreOutput());
+    lamp.begin();
+    TEST_ASSERT_EQUAL_UINT32(0, lamp.getTimeToLightUs());
+    lamp.update();
+    TEST_ASSERT_FALSE(lamp.isActive());
+    TEST_ASSERT_NOT_EQUAL(0, lamp.getTimeToLightUs());
+    TEST_ASSERT_FALSE(lamp.getStatus().warmBoot);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_begin_keeps_restored_output);
+    RUN_TEST(test_cold_boot_time_to_light_with_knob_off);
+    return UNITY_END();
+}
@@ -0,0 +1,396 @@
+// NetworkManager routes over the host socket WebServer/DNSServer, and the
+// host HTTPClient against them (pio test -e native)
+#include <unity.h>
+#include "HostDevice.h"
+#include "network/NetworkManager.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+const int CLIENTS = 4;
+const int REQUESTS_PER_CLIENT = 25;
+const unsigned long START_TIMEOUT_MS = 5000;
+
+// One lamp with its network task. The task runs for the rest of the
+// process, so lamps are never torn down. Without the task the lamp is on a
+// virtual clock and the test calls service() itself.
+struct Lamp {
+    HostDevice device;
+    LampController lamp;
+    CpuGovernor governor{lamp};
+    LoopStats loopStats;
+    LoadShedder shedder;
+    EnergyModel energy;
+    NetworkManager network{lamp, governor, loopStats, shedder, energy};
+
+    explicit Lamp(bool configured, bool ownTask = true) {
+        device.serialMuted = true;
+        device.httpPort = 0;
+        device.dnsPort = 0;
+        device.associationMs = 0;
+        device.setKnob(Board::DIMMER_ANALOG_PIN, 0.3f);
+        device.setPackVoltage(Board::VOLTAGE_PIN, 11.5f, LampConfig::VOLTAGE_DIVIDER_RATIO);
+        WiFiConfig config = {};
+        strncpy(config.ssid, "test", sizeof(config.ssid) - 1);
+        config.configured = configured;
+        memcpy(device.eeprom, &config, sizeof(config));
+        HostDevice::select(&device);
+        if (!ownTask) {
+            device.useVirtualClock();
+        }
+        lamp.begin();
+        if (ownTask) {
+            network.startTask();
+        } else {
+            network.begin();
+        }
+        HostDevice::select(nullptr);
+    }
+
+    // loop()'s share: applies the commands the routes queue
+    std::thread runLoop(std::atomic<bool>& stop) {
+        return std::thread([this, &stop]() {
+            HostDevice::select(&device);
+            while (!stop) {
+                lamp.update();
+                delay(LampConfig::NETWORK_TASK_INTERVAL_MS);
+            }
+        });
+    }
+
+    int waitForServer() {
+        for (unsigned long waited = 0; device.boundHttpPort == 0 && waited < START_TIMEOUT_MS; waited += 10) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return device.boundHttpPort;
+    }
+};
+
+struct Response {
+    int code;
+    std::string body;
+};
+
+Response httpRequest(int port, const std::string& method, const std::string& path, const std::string& form = "") {
+    Response response = {0, ""};
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons((uint16_t)port);
+    if (connect(fd, (sockaddr*)&address, sizeof(address)) < 0) {
+        close(fd);
+        return response;
+    }
+    std::string request = method + " " + path + " HTTP/1.1\r\nHost: lamp\r\n";
+    if (!form.empty()) {
+        request += "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: " +
+                   std::to_string(form.size()) + "\r\n";
+    }
+    request += "\r\n" + form;
+    send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+
+    std::string raw;
+    char chunk[1024];
+    ssize_t received;
+    while ((received = recv(fd, chunk, sizeof(chunk), 0)) > 0) {
+        raw.append(chunk, (size_t)received);
+    }
+    close(fd);
+    sscanf(raw.c_str(), "HTTP/1.%*d %d", &response.code);
+    size_t bodyStart = raw.find("\r\n\r\n");
+    if (bodyStart != std::string::npos) {
+        response.body = raw.substr(bodyStart + 4);
+    }
+    return response;
+}
+
+// A query for name; returns the A record's address, or "rcode N" without one
+std::string dnsLookup(int port, const char* name) {
+    uint8_t query[256] = {0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0, 0, 0, 0, 0, 0};
+    size_t length = 12;
+    for (const char* label = name; *label;) {
+        const char* end = strchr(label, '.');
+        size_t labelLength = end ? (size_t)(end - label) : strlen(label);
+        query[length++] = (uint8_t)labelLength;
+        memcpy(query + length, label, labelLength);
+        length += labelLength;
+        label += labelLength + (end ? 1 : 0);
+    }
+    const uint8_t tail[] = {0, 0x00, 0x01, 0x00, 0x01};
+    memcpy(query + length, tail, sizeof(tail));
+    length += sizeof(tail);
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    timeval timeout = {2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons((uint16_t)port);
+    sendto(fd, query, length, 0, (sockaddr*)&address, sizeof(address));
+    uint8_t reply[512];
+    ssize_t received = recv(fd, reply, sizeof(reply), 0);
+    close(fd);
+    if (received < (ssize_t)length || reply[0] != 0x12 || !(reply[2] & 0x80)) {
+        return "no reply";
+    }
+    if (reply[7] == 0) {
+        return "rcode " + std::to_string(reply[3] & 0x0F);
+    }
+    const uint8_t* ip = reply + received - 4;
+    return std::to_string(ip[0]) + "." + std::to_string(ip[1]) + "." + std::to_string(ip[2]) + "." +
+           std::to_string(ip[3]);
+}
+
+Lamp* station;
+Lamp* accessPoint;
+
+void setUp() {}
+void tearDown() {}
+
+void test_station_routes() {
+    station = new Lamp(true);
+    int port = station->waitForServer();
+    TEST_ASSERT_NOT_EQUAL(0, port);
+
+    Response status = httpRequest(port, "GET", "/api/status");
+    TEST_ASSERT_EQUAL(200, status.code);
+    TEST_ASSERT_TRUE(status.body.find("\"brightness\":") != std::string::npos);
+
+    Response control = httpRequest(port, "POST", "/api/control", "brightness=40&cct=3000");
+    TEST_ASSERT_EQUAL(200, control.code);
+    TEST_ASSERT_TRUE(control.body.find("success") != std::string::npos);
+    HostDevice::select(&station->device);
+    station->lamp.update();
+    HostDevice::select(nullptr);
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 40.0f, station->lamp.getStatus().brightness);
+    TEST_ASSERT_EQUAL(3000, station->lamp.getStatus().cct);
+
+    // Checked before anything is queued
+    TEST_ASSERT_EQUAL(400, httpRequest(port, "POST", "/api/control", "cct=4000&brightness=120").code);
+    TEST_ASSERT_EQUAL(400, httpRequest(port, "POST", "/api/control", "cct=9000&brightness=60").code);
+    // Queue almost full: neither command of a pair goes in
+    for (int i = 0; i < LampConfig::COMMAND_QUEUE_SIZE - 2; i++) {
+        TEST_ASSERT_EQUAL(200, httpRequest(port, "POST", "/api/control", "cct=3500").code);
+    }
+    TEST_ASSERT_EQUAL(503, httpRequest(port, "POST", "/api/control", "cct=5000&brightness=60").code);
+    HostDevice::select(&station->device);
+    station->lamp.update();
+    HostDevice::select(nullptr);
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 40.0f, station->lamp.getStatus().brightness);
+    TEST_ASSERT_EQUAL(3500, station->lamp.getStatus().cct);
+
+    TEST_ASSERT_EQUAL(400, httpRequest(port, "POST", "/api/control").code);
+    TEST_ASSERT_EQUAL(404, httpRequest(port, "GET", "/api/missing").code);
+    TEST_ASSERT_EQUAL(200, httpRequest(port, "GET", "/api/loop?reset=1").code);
+}
+
+void test_http_client() {
+    // The host HTTPClient against the station's routes, wherever the URL points
+    HostDevice client;
+    client.serverPort = station->waitForServer();
+    int requests = 0;
+    client.onHttpRequest = [&](const char*, int, uint64_t) { requests++; };
+    HostDevice::select(&client);
+
+    HTTPClient http;
+    http.begin("http://192.168.68.109:4999/api/status");
+    TEST_ASSERT_EQUAL(HTTP_CODE_OK, http.GET());
+    String status = http.getString();
+    TEST_ASSERT_TRUE(strstr(status.c_str(), "\"brightness\":") != nullptr);
+    TEST_ASSERT_EQUAL((int)status.length(), http.getSize());
+    http.end();
+
+    http.begin("http://192.168.68.109:4999/api/control");
+    http.addHeader("Content-Type", "application/x-www-form-urlencoded");
+    TEST_ASSERT_EQUAL(HTTP_CODE_OK, http.POST("brightness=20"));
+    TEST_ASSERT_TRUE(strstr(http.getString().c_str(), "success") != nullptr);
+    http.end();
+
+    client.serverPort = -1;
+    http.begin("http://192.168.68.109:4999/api/status");
+    TEST_ASSERT_EQUAL(HTTPC_ERROR_CONNECTION_REFUSED, http.GET());
+    http.end();
+    HostDevice::select(nullptr);
+
+    TEST_ASSERT_EQUAL_UINT32(2, client.httpResponses);
+    TEST_ASSERT_EQUAL_UINT32(1, client.httpFailures);
+    TEST_ASSERT_EQUAL(3, requests);
+}
+
+void test_concurrent_clients() {
+    int port = station->waitForServer();
+    std::vector<std::vector<double>> latencies(CLIENTS);
+    std::vector<int> failures(CLIENTS, 0);
+    std::atomic<bool> stop{false};
+    std::thread loop = station->runLoop(stop);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> clients;
+    for (int c = 0; c < CLIENTS; c++) {
+        clients.emplace_back([&, c]() {
+            for (int i = 0; i < REQUESTS_PER_CLIENT; i++) {
+                auto sent = std::chrono::steady_clock::now();
+                Response response = i % 4 == 0 ? httpRequest(port, "POST", "/api/control", "brightness=" + std::to_string(10 + i))
+                                               : httpRequest(port, "GET", "/api/status");
+                latencies[c].push_back(std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - sent).count());
+                failures[c] += response.code == 200 ? 0 : 1;
+            }
+        });
+    }
+    for (std::thread& client : clients) {
+        client.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stop = true;
+    loop.join();
+
+    std::vector<double> all;
+    int failed = 0;
+    for (int c = 0; c < CLIENTS; c++) {
+        all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+        failed += failures[c];
+    }
+    std::sort(all.begin(), all.end());
+    printf("  %d clients: %.0f req/s, p50 %.1f ms, p99 %.1f ms\n", CLIENTS, all.size() / seconds,
+           all[all.size() / 2], all[all.size() * 99 / 100]);
+    TEST_ASSERT_EQUAL(0, failed);
+    TEST_ASSERT_EQUAL(CLIENTS * REQUESTS_PER_CLIENT, (int)all.size());
+}
+
+// Real time until done() or timeoutMs
+template <typename Done>
+bool waitFor(Done done, unsigned long timeoutMs) {
+    for (unsigned long waited = 0; !done() && waited < timeoutMs; waited += 10) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return done();
+}
+
+void test_calibrate_route() {
+    // The route answers with what the lamp made of the point
+    int port = station->waitForServer();
+    HostDevice& device = station->device;
+    std::atomic<bool> stop{false};
+    std::thread loop = station->runLoop(stop);
+    auto calibrate = [&](float packVoltage, const std::string& form) {
+        device.setPackVoltage(Board::VOLTAGE_PIN, packVoltage, LampConfig::VOLTAGE_DIVIDER_RATIO);
+        return httpRequest(port, "POST", "/api/calibrate", form);
+    };
+
+    for (const char* form : {"voltage=-1", "voltage=70", "voltage=volts"}) {
+        Response response = calibrate(12.4f, form);
+        TEST_ASSERT_EQUAL(400, response.code);
+        TEST_ASSERT_TRUE(response.body.find("out of range") != std::string::npos);
+    }
+    Response first = calibrate(12.4f, "voltage=12.5");
+    TEST_ASSERT_EQUAL(200, first.code);
+    TEST_ASSERT_TRUE(first.body.find("pending") != std::string::npos);
+    Response tooClose = calibrate(12.0f, "voltage=12.1");
+    TEST_ASSERT_EQUAL(400, tooClose.code);
+    TEST_ASSERT_TRUE(tooClose.body.find("rejected") != std::string::npos);
+    Response second = calibrate(9.6f, "voltage=9.5");
+    TEST_ASSERT_EQUAL(200, second.code);
+    TEST_ASSERT_TRUE(second.body.find("completed") != std::string::npos);
+    TEST_ASSERT_TRUE(strstr(station->lamp.getStatus().adcCalibration, "+2pt") != nullptr);
+
+    TEST_ASSERT_EQUAL(200, calibrate(11.5f, "clear=1").code);
+    TEST_ASSERT_TRUE(waitFor([&]() { return strstr(station->lamp.getStatus().adcCalibration, "+2pt") == nullptr; }, 1000));
+    stop = true;
+    loop.join();
+}
+
+void test_program_turns_radio_off() {
+    // radio=off: the radio goes off after the upload and comes back once the program has ended
+    int port = station->waitForServer();
+    HostDevice& device = station->device;
+    std::atomic<bool> stop{false};
+    std::thread loop = station->runLoop(stop);
+
+    TEST_ASSERT_EQUAL(200, httpRequest(port, "POST", "/api/program", "start=20&steps=1:10").code);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    TEST_ASSERT_NOT_EQUAL(WIFI_OFF, device.wifiMode);
+
+    uint32_t associations = device.associations;
+    TEST_ASSERT_EQUAL(200, httpRequest(port, "POST", "/api/program", "start=20&steps=1:0&radio=off").code);
+    TEST_ASSERT_TRUE(waitFor([&]() { return device.wifiMode == WIFI_OFF; }, 1000));
+    TEST_ASSERT_TRUE(waitFor([&]() { return device.associations > associations && device.wifiMode != WIFI_OFF; }, 5000));
+    TEST_ASSERT_EQUAL(200, httpRequest(port, "GET", "/api/status").code);
+    stop = true;
+    loop.join();
+}
+
+void test_program_reconnect_backs_off() {
+    // The access point is gone when the program ends: retries back off, radio off in between
+    Lamp away(true, false);
+    HostDevice& device = away.device;
+    HostDevice::select(&device);
+    int port = 0;
+    while (port == 0) {
+        away.network.service();
+        port = device.boundHttpPort;
+    }
+    std::atomic<int> code{0};
+    std::thread client([&]() { code = httpRequest(port, "POST", "/api/program", "start=0&steps=1:0&radio=off").code; });
+    while (code == 0) {
+        away.network.service();
+    }
+    client.join();
+    TEST_ASSERT_EQUAL(200, code.load());
+
+    device.apReachable = false;
+    uint32_t associations = device.associations;
+    auto runFor = [&](uint64_t ms) {
+        for (uint64_t end = device.nowUs() / 1000 + ms; device.nowUs() / 1000 < end; device.advanceMs(100)) {
+            away.lamp.update();
+            away.network.service();
+        }
+    };
+    // Without backoff a 30 s connect attempt every pass: 20 in ten minutes
+    runFor(600000);
+    TEST_ASSERT_FALSE(away.lamp.getStatus().programRunning);
+    TEST_ASSERT_LESS_OR_EQUAL(associations + 5, device.associations);
+    TEST_ASSERT_GREATER_THAN(associations + 1, device.associations);
+    TEST_ASSERT_EQUAL(WIFI_OFF, device.wifiMode);
+
+    device.apReachable = true;
+    runFor(600000);
+    TEST_ASSERT_NOT_EQUAL(WIFI_OFF, device.wifiMode);
+    TEST_ASSERT_EQUAL(WL_CONNECTED, WiFi.status());
+    HostDevice::select(nullptr);
+}
+
+void test_setup_portal() {
+    // No stored credentials: access point with the catch-all DNS
+    accessPoint = new Lamp(false);
+    int port = accessPoint->waitForServer();
+    TEST_ASSERT_NOT_EQUAL(0, port);
+    TEST_ASSERT_NOT_EQUAL(0, accessPoint->device.boundDnsPort.load());
+
+    TEST_ASSERT_EQUAL_STRING("192.168.4.1", dnsLookup(accessPoint->device.boundDnsPort, "connectivitycheck.example").c_str());
+    Response page = httpRequest(port, "GET", "/");
+    TEST_ASSERT_EQUAL(200, page.code);
+    TEST_ASSERT_TRUE(page.body.find("SmartLamp WiFi Setup") != std::string::npos);
+    TEST_ASSERT_EQUAL(404, httpRequest(port, "GET", "/generate_204").code);
+    TEST_ASSERT_EQUAL(400, httpRequest(port, "POST", "/save", "ssid=home").code);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_station_routes);
+    RUN_TEST(test_http_client);
+    RUN_TEST(test_concurrent_clients);
+    RUN_TEST(test_calibrate_route);
+    RUN_TEST(test_program_turns_radio_off);
+    RUN_TEST(test_program_reconnect_backs_off);
+    RUN_TEST(test_setup_portal);
+    return UNITY_END();
+}